@@ -4,6 +4,8 @@
 #include "InstancedCubeDemo.h"
 #include "GrassDemo.h"
 #include "SimpleBSPDemo.h"
+#include "ClusterCullingDemo.h"
+#include "GeometryBenchDemo.h"
 
 namespace blithe
 {
@@ -20,6 +22,8 @@ namespace blithe
         ADD_DEMO(InstancedCubeDemo);
         ADD_DEMO(GrassDemo);
         ADD_DEMO(SimpleBSPDemo);
+        ADD_DEMO(ClusterCullingDemo);
+        ADD_DEMO(GeometryBenchDemo);
     }
 
     ///
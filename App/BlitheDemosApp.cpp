@@ -127,6 +127,7 @@ namespace blithe
                     uiData.m_viewportWidth = textureWidth;
                     uiData.m_viewPortHeight = textureHeight;
                     uiData.m_aspect = aspect;
+                    uiData.m_viewPortDepthTexture = m_standardViewPortTarget->GetDepthTexture();
                 }
             }
 
@@ -71,7 +71,8 @@ void BlitheDemosEvents::MouseButtonCallback(GLFWwindow* _window, int _button, in
 {
     double xpos, ypos;
     glfwGetCursorPos(_window, &xpos, &ypos);
-    glm::vec2 pos(xpos, ypos);
+    // Relative to the viewport, like the positions CursorPosCallback() tracks during the drag
+    glm::vec2 pos(xpos - s_uiData.m_viewPortTopLeftX, ypos - s_uiData.m_viewPortTopLeftY);
 
     bool btnKnown = s_glfwToBlitheMouseBtns.count(_button) == 1;
     if ( btnKnown )
@@ -101,6 +102,7 @@ void BlitheDemosEvents::ResetUIDataPerFrame()
     s_uiData.m_guiCaptured = false;
     s_uiData.m_viewportWidth = 0;
     s_uiData.m_viewPortHeight = 0;
+    s_uiData.m_viewPortDepthTexture = 0;
     s_uiData.m_aspect = FLT_MIN;
     s_uiData.m_pressedKeys.clear();
     s_uiData.m_mouseInput.ResetPerFrame();
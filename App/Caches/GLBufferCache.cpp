@@ -1,5 +1,6 @@
 #include "GLBufferCache.h"
 #include "BlitheAssert.h"
+#include "IndexPacker.h"
 
 namespace blithe
 {
@@ -49,34 +50,44 @@ namespace blithe
     }
 
     ///
-    /// \brief Gets the EBO handle for the _key. If the _key is not in the EBO cache, this uploads
-    ///        the _indices to the graphics card and obtains a handle, which it caches and returns.
+    /// \brief Gets the EBO handle for the _key. If the _key is not in the EBO cache, this packs
+    ///        the _indices into the narrowest index type that can address _numVertices (see
+    ///        IndexPacker), uploads them to the graphics card and obtains a handle, which it
+    ///        caches and returns.
     ///
-    /// \param _key     - Name to use for lookup in the cache
-    /// \param _indices - Index data to be uploaded if not cached
+    /// \param _key          - Name to use for lookup in the cache
+    /// \param _indices      - Index data to be uploaded if not cached
+    /// \param _numVertices  - Number of vertices the _indices index into
+    /// \param _outIndexType - Type of the indices in the EBO, to draw with
     ///
     /// \return EBO handle for the name _key
     ///
     GLuint GLBufferCache::GetIndexBuffer(const std::string& _key,
-                                         const std::vector<unsigned int>& _indices)
+                                         const std::vector<unsigned int>& _indices,
+                                         size_t _numVertices,
+                                         GLenum& _outIndexType)
     {
-        GLuint ebo;
-
-        bool needsUpload = m_eboCache.find(_key) == m_eboCache.end();
+        auto it = m_eboCache.find(_key);
+        bool needsUpload = it == m_eboCache.end();
         if ( needsUpload )
         {
-            glGenBuffers(1, &ebo);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+            // Cached meshes are drawn with a single draw call, so don't split them
+            PackedIndices packed = IndexPacker::Pack(_indices, _numVertices, false);
+
+            IndexBuffer indexBuffer;
+            glGenBuffers(1, &indexBuffer.m_ebo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.m_ebo);
             glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                         static_cast<GLsizeiptr>(_indices.size() * sizeof(unsigned int)),
-                         _indices.data(),
+                         static_cast<GLsizeiptr>(packed.m_data.size()),
+                         packed.m_data.data(),
                          GL_STATIC_DRAW);
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-            m_eboCache[_key] = ebo;
+            indexBuffer.m_indexType = packed.m_type;
+            it = m_eboCache.emplace(_key, indexBuffer).first;
         }
-        ebo = m_eboCache[_key];
 
-        return ebo;
+        _outIndexType = it->second.m_indexType;
+        return it->second.m_ebo;
     }
 
     ///
@@ -143,7 +154,7 @@ namespace blithe
         auto it = m_eboCache.find(_key);
         if ( it != m_eboCache.end() )
         {
-            GLuint ebo = it->second;
+            GLuint ebo = it->second.m_ebo;
             glDeleteBuffers(1, &ebo);
             m_eboCache.erase(it);
         }
@@ -174,7 +185,7 @@ namespace blithe
 
         for (auto& pair : m_eboCache)
         {
-            GLuint ebo = pair.second;
+            GLuint ebo = pair.second.m_ebo;
             glDeleteBuffers(1, &ebo);
         }
         m_eboCache.clear();
@@ -20,7 +20,9 @@ namespace blithe
                                size_t _size) override;
 
         GLuint GetIndexBuffer(const std::string& _key,
-                              const std::vector<unsigned int>& _indices) override;
+                              const std::vector<unsigned int>& _indices,
+                              size_t _numVertices,
+                              GLenum& _outIndexType) override;
 
         GLuint GetVertexArray(const std::string& _key,
                               GLuint _vbo,
@@ -36,9 +38,18 @@ namespace blithe
         void CleanUp() override;
 
     private:
-        std::unordered_map<std::string, GLuint> m_vboCache; //!< Cache of name -> VBO handle
-        std::unordered_map<std::string, GLuint> m_eboCache; //!< Cache of name -> EBO handle
-        std::unordered_map<std::string, GLuint> m_vaoCache; //!< Cache of name -> VAO handle
+        ///
+        /// \brief A cached EBO and the type of the indices in it
+        ///
+        struct IndexBuffer
+        {
+            GLuint m_ebo;       //!< EBO handle
+            GLenum m_indexType; //!< GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        };
+
+        std::unordered_map<std::string, GLuint> m_vboCache;      //!< Cache of name -> VBO handle
+        std::unordered_map<std::string, IndexBuffer> m_eboCache; //!< Cache of name -> EBO handle and index type
+        std::unordered_map<std::string, GLuint> m_vaoCache;      //!< Cache of name -> VAO handle
     };
 }
 
@@ -0,0 +1,289 @@
+#include "GLMeshArena.h"
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "BlitheAssert.h"
+#include "InstanceEncoding.h"
+#include "Mesh.h"
+#include "VertexPacker.h"
+
+namespace blithe
+{
+    ///
+    /// \brief Constructor. Creates the shared buffers with the given initial capacities and the
+    ///        VAO describing them.
+    ///
+    /// \param _vertexCapacity - Initial number of vertices the VBO can hold
+    /// \param _indexCapacity  - Initial number of indices the EBO can hold
+    ///
+    GLMeshArena::GLMeshArena(size_t _vertexCapacity, size_t _indexCapacity)
+        : m_vertexAllocator(std::max<size_t>(_vertexCapacity, 1)),
+          m_indexAllocator(std::max<size_t>(_indexCapacity, 1))
+    {
+        m_vbo = CreateBufferWithCopy(0, 0, m_vertexAllocator.GetCapacity() * sizeof(Vertex));
+        m_ebo = CreateBufferWithCopy(0, 0, m_indexAllocator.GetCapacity() * sizeof(unsigned int));
+
+        // The instanced shaders expect a per-instance model matrix. Everything in the arena is
+        // already in world space, so give them a single identity matrix to read.
+        glm::mat4 identity(1.0f);
+        glGenBuffers(1, &m_ibo);
+        glBindBuffer(GL_ARRAY_BUFFER, m_ibo);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(glm::mat4)), &identity, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        SetupVertexArray();
+    }
+
+    ///
+    /// \brief Destructor
+    ///
+    GLMeshArena::~GLMeshArena()
+    {
+        CleanUp();
+    }
+
+    ///
+    /// \brief Sub-allocates room for _mesh in the shared buffers (growing them if needed) and
+    ///        uploads its vertices and indices there.
+    ///
+    /// \param _mesh - Mesh to add. Its indices are relative to its own vertices.
+    ///
+    /// \return Record locating the mesh in the arena, to be used for drawing and removal
+    ///
+    GLMeshArena::MeshRecord GLMeshArena::Add(const Mesh& _mesh)
+    {
+        ASSERT(!_mesh.m_vertices.empty() && !_mesh.m_indices.empty(), "Cannot add an empty mesh to the arena");
+
+        size_t numVertices = _mesh.m_vertices.size();
+        size_t numIndices = _mesh.m_indices.size();
+
+        tl::optional<size_t> vertexOffset = m_vertexAllocator.Allocate(numVertices);
+        while ( !vertexOffset.has_value() )
+        {
+            GrowVertexBuffer(m_vertexAllocator.GetCapacity() + numVertices);
+            vertexOffset = m_vertexAllocator.Allocate(numVertices);
+        }
+
+        tl::optional<size_t> indexOffset = m_indexAllocator.Allocate(numIndices);
+        while ( !indexOffset.has_value() )
+        {
+            GrowIndexBuffer(m_indexAllocator.GetCapacity() + numIndices);
+            indexOffset = m_indexAllocator.Allocate(numIndices);
+        }
+
+        // Upload through the copy-write target so we don't disturb whatever VAO is bound
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER,
+                        static_cast<GLintptr>(vertexOffset.value() * sizeof(Vertex)),
+                        static_cast<GLsizeiptr>(numVertices * sizeof(Vertex)),
+                        _mesh.m_vertices.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_ebo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER,
+                        static_cast<GLintptr>(indexOffset.value() * sizeof(unsigned int)),
+                        static_cast<GLsizeiptr>(numIndices * sizeof(unsigned int)),
+                        _mesh.m_indices.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        MeshRecord record;
+        record.m_baseVertex = static_cast<GLint>(vertexOffset.value());
+        record.m_firstIndex = static_cast<GLuint>(indexOffset.value());
+        record.m_count = static_cast<GLsizei>(numIndices);
+        record.m_numVertices = static_cast<GLsizei>(numVertices);
+        return record;
+    }
+
+    ///
+    /// \brief Releases the vertex and index ranges of _record so they can be reused by later
+    ///        Add() calls. The buffer contents are left as is.
+    ///
+    /// \param _record - Record returned by Add()
+    ///
+    void GLMeshArena::Remove(const MeshRecord& _record)
+    {
+        m_vertexAllocator.Free(static_cast<size_t>(_record.m_baseVertex), static_cast<size_t>(_record.m_numVertices));
+        m_indexAllocator.Free(static_cast<size_t>(_record.m_firstIndex), static_cast<size_t>(_record.m_count));
+    }
+
+    ///
+    /// \brief Releases all the meshes at once. The buffers keep their grown capacity.
+    ///
+    void GLMeshArena::Clear()
+    {
+        m_vertexAllocator.Reset();
+        m_indexAllocator.Reset();
+    }
+
+    ///
+    /// \brief Binds the arena's VAO. All the Draw calls expect this to have been called.
+    ///
+    void GLMeshArena::Bind() const
+    {
+        glBindVertexArray(m_vao);
+    }
+
+    ///
+    /// \brief Unbinds the arena's VAO.
+    ///
+    void GLMeshArena::Unbind() const
+    {
+        glBindVertexArray(0);
+    }
+
+    ///
+    /// \brief Draws a single mesh from the arena.
+    ///
+    /// \param _record - Record returned by Add()
+    ///
+    void GLMeshArena::Draw(const MeshRecord& _record) const
+    {
+        glDrawElementsBaseVertex(GL_TRIANGLES,
+                                 _record.m_count,
+                                 GL_UNSIGNED_INT,
+                                 reinterpret_cast<void*>(_record.m_firstIndex * sizeof(unsigned int)),
+                                 _record.m_baseVertex);
+    }
+
+    ///
+    /// \brief Draws all the meshes in _records, in order, with a single multi-draw call.
+    ///
+    /// \param _records - Records returned by Add()
+    ///
+    void GLMeshArena::DrawMulti(const std::vector<MeshRecord>& _records) const
+    {
+        if ( _records.empty() )
+        {
+            return;
+        }
+
+        m_multiCounts.clear();
+        m_multiOffsets.clear();
+        m_multiBaseVertices.clear();
+        for ( const MeshRecord& record : _records )
+        {
+            m_multiCounts.push_back(record.m_count);
+            m_multiOffsets.push_back(reinterpret_cast<const void*>(record.m_firstIndex * sizeof(unsigned int)));
+            m_multiBaseVertices.push_back(record.m_baseVertex);
+        }
+
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES,
+                                      m_multiCounts.data(),
+                                      GL_UNSIGNED_INT,
+                                      m_multiOffsets.data(),
+                                      static_cast<GLsizei>(_records.size()),
+                                      m_multiBaseVertices.data());
+    }
+
+    ///
+    /// \brief Doubles the vertex buffer (or more, to reach _minCapacity vertices), copying the
+    ///        existing vertices over, and re-points the VAO at the new buffer.
+    ///
+    /// \param _minCapacity - Minimum number of vertices the grown buffer must hold
+    ///
+    void GLMeshArena::GrowVertexBuffer(size_t _minCapacity)
+    {
+        size_t oldCapacity = m_vertexAllocator.GetCapacity();
+        size_t newCapacity = std::max(oldCapacity * 2, _minCapacity);
+        m_vbo = CreateBufferWithCopy(m_vbo, oldCapacity * sizeof(Vertex), newCapacity * sizeof(Vertex));
+        m_vertexAllocator.Grow(newCapacity);
+        SetupVertexArray();
+    }
+
+    ///
+    /// \brief Doubles the index buffer (or more, to reach _minCapacity indices), copying the
+    ///        existing indices over, and re-points the VAO at the new buffer.
+    ///
+    /// \param _minCapacity - Minimum number of indices the grown buffer must hold
+    ///
+    void GLMeshArena::GrowIndexBuffer(size_t _minCapacity)
+    {
+        size_t oldCapacity = m_indexAllocator.GetCapacity();
+        size_t newCapacity = std::max(oldCapacity * 2, _minCapacity);
+        m_ebo = CreateBufferWithCopy(m_ebo, oldCapacity * sizeof(unsigned int), newCapacity * sizeof(unsigned int));
+        m_indexAllocator.Grow(newCapacity);
+        SetupVertexArray();
+    }
+
+    ///
+    /// \brief Creates a buffer of _newBytes and copies the first _oldBytes of _oldBuffer into it
+    ///        on the GPU. _oldBuffer is deleted.
+    ///
+    /// \param _oldBuffer - Buffer whose contents are to be copied over. May be 0 for none.
+    /// \param _oldBytes  - Number of bytes to copy from _oldBuffer
+    /// \param _newBytes  - Size of the new buffer
+    ///
+    /// \return ID of the new buffer
+    ///
+    GLuint GLMeshArena::CreateBufferWithCopy(GLuint _oldBuffer, size_t _oldBytes, size_t _newBytes)
+    {
+        GLuint buffer = 0;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(_newBytes), nullptr, GL_DYNAMIC_DRAW);
+
+        if ( _oldBuffer != 0 )
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, _oldBuffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(_oldBytes));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &_oldBuffer);
+        }
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        return buffer;
+    }
+
+    ///
+    /// \brief (Re)creates the VAO layout pointing at the current VBO, EBO and identity instance
+    ///        buffer. Needs to be redone whenever the buffers are reallocated.
+    ///
+    void GLMeshArena::SetupVertexArray()
+    {
+        if ( m_vao == 0 )
+        {
+            glGenVertexArrays(1, &m_vao);
+        }
+        glBindVertexArray(m_vao);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        const VBOVertexFormat& format = VertexPacker::GetXyzRgbaUvFormat();
+        for (const auto& attr : format.m_attributes)
+        {
+            glEnableVertexAttribArray(attr.m_index);
+            glVertexAttribPointer(attr.m_index,
+                                  attr.m_size,
+                                  attr.m_type,
+                                  attr.m_normalized,
+                                  format.m_stride,
+                                  reinterpret_cast<void*>(attr.m_offset));
+        }
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+
+        // Same instance matrix layout as MeshObject::SetInstances(), with the one identity matrix
+        // used by every draw.
+        glBindBuffer(GL_ARRAY_BUFFER, m_ibo);
+        for (GLuint colIdx = 0; colIdx < 4; colIdx++)
+        {
+            GLuint attrIdx = InstancePacker::ATTRIB_LOCATION + colIdx;
+            glEnableVertexAttribArray(attrIdx);
+            glVertexAttribPointer(attrIdx, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), reinterpret_cast<void*>(colIdx * sizeof(glm::vec4)));
+            glVertexAttribDivisor(attrIdx, 1);
+        }
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ///
+    /// \brief Deletes the VAO and the buffers.
+    ///
+    void GLMeshArena::CleanUp()
+    {
+        glDeleteVertexArrays(1, &m_vao);
+        glDeleteBuffers(1, &m_vbo);
+        glDeleteBuffers(1, &m_ebo);
+        glDeleteBuffers(1, &m_ibo);
+        m_vao = m_vbo = m_ebo = m_ibo = 0;
+        Clear();
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef GLMESHARENA_H
+#define GLMESHARENA_H
+
+#include <vector>
+#include "RangeAllocator.h"
+#include "VBOVertexFormat.h"
+
+namespace blithe
+{
+    struct Mesh;
+
+    ///
+    /// \brief Packs many meshes of the xyz_rgba_uv vertex format into one big VBO and one big EBO
+    ///        under a single VAO.
+    ///
+    ///        Each mesh added gets a MeshRecord locating its vertices and indices in the shared
+    ///        buffers. The indices are kept local to the mesh and the record's base vertex is
+    ///        added at draw time, so a whole scene of small meshes can be drawn with one VAO bind
+    ///        and either a glDrawElementsBaseVertex per mesh or a single
+    ///        glMultiDrawElementsBaseVertex.
+    ///
+    ///        Vertex and index ranges are sub-allocated with a RangeAllocator. When a range
+    ///        doesn't fit, the buffers are doubled and the old contents are copied over on the
+    ///        GPU.
+    ///
+    class GLMeshArena
+    {
+    public:
+        ///
+        /// \brief Location of a mesh inside the arena's shared buffers
+        ///
+        struct MeshRecord
+        {
+            GLint m_baseVertex = 0;    //!< Offset (in vertices) of the mesh's first vertex
+            GLuint m_firstIndex = 0;   //!< Offset (in indices) of the mesh's first index
+            GLsizei m_count = 0;       //!< Number of indices to draw
+            GLsizei m_numVertices = 0; //!< Number of vertices in the mesh
+        };
+
+        GLMeshArena(size_t _vertexCapacity, size_t _indexCapacity);
+        ~GLMeshArena();
+
+        MeshRecord Add(const Mesh& _mesh);
+        void Remove(const MeshRecord& _record);
+        void Clear();
+
+        void Bind() const;
+        void Unbind() const;
+        void Draw(const MeshRecord& _record) const;
+        void DrawMulti(const std::vector<MeshRecord>& _records) const;
+
+        size_t GetNumVertices() const { return m_vertexAllocator.GetUsed(); }
+        size_t GetNumIndices() const { return m_indexAllocator.GetUsed(); }
+
+    private:
+        void GrowVertexBuffer(size_t _minCapacity);
+        void GrowIndexBuffer(size_t _minCapacity);
+        static GLuint CreateBufferWithCopy(GLuint _oldBuffer, size_t _oldBytes, size_t _newBytes);
+        void SetupVertexArray();
+        void CleanUp();
+
+        unsigned int m_vao = 0; //!< ID of Vertex Array Object holding the vertex layout
+        unsigned int m_vbo = 0; //!< ID of the shared Vertex Buffer Object
+        unsigned int m_ebo = 0; //!< ID of the shared Element Buffer Object
+        unsigned int m_ibo = 0; //!< ID of the single identity instance transform buffer
+
+        RangeAllocator m_vertexAllocator; //!< Sub-allocates vertex ranges from m_vbo
+        RangeAllocator m_indexAllocator;  //!< Sub-allocates index ranges from m_ebo
+
+        //! Scratch arrays reused by DrawMulti() so we don't hit the heap every frame
+        mutable std::vector<GLsizei> m_multiCounts;
+        mutable std::vector<const void*> m_multiOffsets;
+        mutable std::vector<GLint> m_multiBaseVertices;
+    };
+}
+
+#endif // GLMESHARENA_H
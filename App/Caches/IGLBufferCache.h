@@ -20,7 +20,9 @@ namespace blithe
                                        size_t _size) = 0;
 
         virtual GLuint GetIndexBuffer(const std::string& _key,
-                                      const std::vector<unsigned int>& _indices) = 0;
+                                      const std::vector<unsigned int>& _indices,
+                                      size_t _numVertices,
+                                      GLenum& _outIndexType) = 0;
 
         virtual GLuint GetVertexArray(const std::string& _key,
                                       GLuint _vbo,
@@ -0,0 +1,110 @@
+#include "MeshBoundsCache.h"
+#include <algorithm>
+#include <cmath>
+#include "GeomHelpers.h"
+#include "Mesh.h"
+
+namespace blithe
+{
+    ///
+    /// \brief Cache shared by the whole app. Never destroyed, so meshes destroyed during static
+    ///        destruction can still remove themselves from it.
+    ///
+    MeshBoundsCache& MeshBoundsCache::GetShared()
+    {
+        static MeshBoundsCache* s_sharedCache = new MeshBoundsCache();
+        return *s_sharedCache;
+    }
+
+    ///
+    /// \brief Gets the bounds of _mesh, computing them if the mesh isn't cached or has changed
+    ///        since it was
+    ///
+    /// \param _mesh - Mesh whose bounds are desired
+    ///
+    /// \return Local space bounds of _mesh
+    ///
+    MeshBounds MeshBoundsCache::Get(const Mesh& _mesh)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_entries.find(_mesh.m_id.GetValue());
+            if ( it != m_entries.end() &&
+                 it->second.m_generation == _mesh.m_generation &&
+                 it->second.m_vertexData == _mesh.m_vertices.data() &&
+                 it->second.m_numVertices == _mesh.m_vertices.size() )
+            {
+                return it->second.m_bounds;
+            }
+        }
+
+        // Compute outside the lock so other threads aren't held up by a big mesh
+        Entry entry;
+        entry.m_bounds = CalcBounds(_mesh);
+        entry.m_generation = _mesh.m_generation;
+        entry.m_vertexData = _mesh.m_vertices.data();
+        entry.m_numVertices = _mesh.m_vertices.size();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        _mesh.m_id.MarkCached();
+        m_entries[_mesh.m_id.GetValue()] = entry;
+        return entry.m_bounds;
+    }
+
+    ///
+    /// \brief Drops the cached bounds of a mesh, if any. Called by MeshId when a mesh that
+    ///        was cached is destroyed or reassigned.
+    ///
+    /// \param _meshId - Value of the m_id of the mesh to forget
+    ///
+    void MeshBoundsCache::Remove(uint64_t _meshId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.erase(_meshId);
+    }
+
+    ///
+    /// \brief Drops all the cached bounds
+    ///
+    void MeshBoundsCache::Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.clear();
+    }
+
+    ///
+    /// \brief Returns the number of meshes whose bounds are cached
+    ///
+    size_t MeshBoundsCache::GetNumEntries() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    ///
+    /// \brief Computes the bounds of _mesh without going through the cache. Walks the vertices
+    ///        several times. If the _mesh has no vertices everything is at the origin.
+    ///
+    /// \param _mesh - Mesh whose bounds are desired
+    ///
+    /// \return Local space bounds of _mesh
+    ///
+    MeshBounds MeshBoundsCache::CalcBounds(const Mesh& _mesh)
+    {
+        MeshBounds bounds;
+        bounds.m_aabb = GeomHelpers::CalcLocalAABB(_mesh);
+        bounds.m_centroid = GeomHelpers::CalcCentroid(_mesh);
+        bounds.m_obb = GeomHelpers::CalcLocalOBB(_mesh, bounds.m_aabb, bounds.m_centroid);
+
+        bounds.m_sphere.m_center = (bounds.m_aabb.m_min + bounds.m_aabb.m_max) * 0.5f;
+        float radiusSq = 0.0f;
+        for ( const Vertex& vertex : _mesh.m_vertices )
+        {
+            glm::vec3 offset = vertex.m_pos - bounds.m_sphere.m_center;
+            radiusSq = std::max(radiusSq, glm::dot(offset, offset));
+        }
+        bounds.m_sphere.m_radius = std::sqrt(radiusSq);
+
+        return bounds;
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef MESHBOUNDSCACHE_H
+#define MESHBOUNDSCACHE_H
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "AABB.h"
+#include "OBB.h"
+#include "Sphere.h"
+
+namespace blithe
+{
+    struct Mesh;
+
+    ///
+    /// \brief Bounds of a mesh's vertex positions, in its local space
+    ///
+    struct MeshBounds
+    {
+        AABB m_aabb;          //!< Box around the vertices
+        OBB m_obb;            //!< Oriented box around the vertices. See GeomHelpers::CalcLocalOBB().
+        Sphere m_sphere;      //!< Sphere around the box center, shrunk to the furthest vertex
+        glm::vec3 m_centroid; //!< Average of the vertex positions
+    };
+
+    ///
+    /// \brief Cache of the bounds of meshes, so they are computed once per mesh rather than
+    ///        every time culling, picking or sorting needs them.
+    ///
+    ///        Entries are keyed by the mesh's m_id and hold the mesh's m_generation and vertex
+    ///        storage from when they were computed. Code that changes a mesh's vertices in place
+    ///        must bump its m_generation, and the next Get() recomputes the bounds. Ids are
+    ///        never reused, and a mesh's entry is removed when the mesh is destroyed.
+    ///
+    ///        Safe to call from several threads.
+    ///
+    class MeshBoundsCache
+    {
+    public:
+        static MeshBoundsCache& GetShared();
+
+        MeshBounds Get(const Mesh& _mesh);
+        void Remove(uint64_t _meshId);
+        void Clear();
+
+        size_t GetNumEntries() const;
+
+        static MeshBounds CalcBounds(const Mesh& _mesh);
+
+    private:
+        ///
+        /// \brief Cached bounds and what they were computed from
+        ///
+        struct Entry
+        {
+            MeshBounds m_bounds;       //!< Bounds of the mesh
+            unsigned int m_generation; //!< Mesh's m_generation when m_bounds was computed
+            const void* m_vertexData;  //!< Mesh's vertex storage when m_bounds was computed
+            size_t m_numVertices;      //!< Mesh's vertex count when m_bounds was computed
+        };
+
+        mutable std::mutex m_mutex;                    //!< Guards m_entries
+        std::unordered_map<uint64_t, Entry> m_entries; //!< Cache of mesh id -> bounds
+    };
+}
+
+#endif // MESHBOUNDSCACHE_H
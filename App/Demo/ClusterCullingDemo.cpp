@@ -0,0 +1,224 @@
+#include "ClusterCullingDemo.h"
+#include "ArcBallCameraDecorator.h"
+#include "BlithePath.h"
+#include "ClusteredMeshObject.h"
+#include "GeomHelpers.h"
+#include "Mesh.h"
+#include "OcclusionBuffer.h"
+#include "ShaderProgram.h"
+#include "Texture.h"
+#include "UIData.h"
+
+#include "imgui.h"
+#include <chrono>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <GLFW/glfw3.h> // Will drag system OpenGL headers
+#include <tracy/Tracy.hpp>
+
+namespace blithe
+{
+    /*!
+     * \brief Destructor
+     */
+    ClusterCullingDemo::~ClusterCullingDemo()
+    {
+        glDisable(GL_DEPTH_TEST);
+        delete m_mesh;
+        delete m_occluderMesh;
+        delete m_occlusionBuffer;
+        delete m_shader;
+        delete m_texture;
+        delete m_cameraDecorator;
+    }
+
+    /*!
+     * \brief Setup for the cluster culling demo
+     */
+    void ClusterCullingDemo::OnInit()
+    {
+        std::string exePath = GetExecutablePath();
+        m_texture = new Texture(exePath + "/Assets/vintage_convertible.jpg", TextureData::FilterParam::LINEAR);
+        m_shader = new ShaderProgram(exePath + "/Shaders/Triangle.vert", exePath + "/Shaders/Triangle.frag");
+        m_cameraDecorator = new ArcBallCameraDecorator();
+        m_occlusionBuffer = new OcclusionBuffer();
+
+        SetupMesh();
+    }
+
+    /*!
+     * \brief Culls the meshlets of the dense mesh and draws the rest
+     */
+    void ClusterCullingDemo::OnRender(double _deltaTimeS, const UIData& _uiData)
+    {
+        ZoneScopedN("ClusterCullingDemo::OnRender");
+
+        float deltaTimeS = static_cast<float>(_deltaTimeS);
+
+        glEnable(GL_DEPTH_TEST);
+        ImVec4 clearCol = _uiData.m_clearColor;
+        glClearColor(clearCol.x * clearCol.w, clearCol.y * clearCol.w, clearCol.z * clearCol.w, clearCol.w);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        const float pi = glm::pi<float>();
+
+        ProcessKeys(_uiData, deltaTimeS);
+        ProcessMouseMove(_uiData, deltaTimeS);
+
+        m_rotationAngleRad += deltaTimeS * m_rotationSpeed * 2.0f * pi; // Update based on speed
+        m_rotationAngleRad = fmod(m_rotationAngleRad, 2.0f * pi); // Keep progress within a full rotation range
+
+        const Camera& camera = m_cameraDecorator->GetCamera();
+        glm::mat4 model = glm::rotate(glm::mat4(1.0f), m_rotationAngleRad, glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 view = camera.GetViewMatrix();
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), _uiData.m_aspect, 0.1f, 100.0f);
+        glm::mat4 viewProjection = projection * view;
+
+        if ( m_occlusionCull )
+        {
+            auto rasterizeStart = std::chrono::steady_clock::now();
+            m_occlusionBuffer->Begin(viewProjection);
+            m_occlusionBuffer->AddOccluder(*m_occluderMesh, model);
+            m_occlusionBuffer->Rasterize();
+            m_rasterizeTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - rasterizeStart).count();
+        }
+
+        {
+            auto cullStart = std::chrono::steady_clock::now();
+            m_mesh->Cull(model, viewProjection, camera.GetPosition(), m_frustumCull, m_backFaceCull,
+                         m_occlusionCull ? m_occlusionBuffer : nullptr);
+            m_cullTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cullStart).count();
+        }
+
+        m_shader->Bind();
+        m_shader->SetUniformMat4f("matrix", viewProjection * model);
+
+        size_t activeUnitOffset = 0;
+        m_texture->Bind(activeUnitOffset);
+        m_shader->SetUniform1i("myTex", static_cast<int>(activeUnitOffset));
+
+        {
+            ZoneScopedN("Meshlets");
+            m_mesh->Render();
+        }
+
+        m_shader->Unbind();
+
+        glDisable(GL_DEPTH_TEST);
+    }
+
+    /*!
+     * \brief ImGui controls specific to the cluster culling demo
+     */
+    void ClusterCullingDemo::OnDrawUI()
+    {
+        ImGui::Begin("Cluster Culling Demo Params");
+
+        ImGui::SliderFloat("Rotation Speed", &m_rotationSpeed, 0.0f, 1.0f);
+        ImGui::Checkbox("Frustum Culling", &m_frustumCull);
+        ImGui::Checkbox("Backface Culling", &m_backFaceCull);
+        ImGui::Checkbox("Occlusion Culling", &m_occlusionCull);
+
+        float numMeshlets = static_cast<float>(m_mesh->GetNumMeshlets());
+        ImGui::Text("Meshlets: %d", static_cast<int>(m_mesh->GetNumMeshlets()));
+        ImGui::Text("Frustum culled: %.1f%%", 100.0f * static_cast<float>(m_mesh->GetNumFrustumCulled()) / numMeshlets);
+        ImGui::Text("Backface culled: %.1f%%", 100.0f * static_cast<float>(m_mesh->GetNumBackFaceCulled()) / numMeshlets);
+        ImGui::Text("Occluded: %.1f%%", 100.0f * static_cast<float>(m_mesh->GetNumOccluded()) / numMeshlets);
+        ImGui::Text("Tris drawn: %.2fM of %.2fM",
+                    static_cast<double>(m_mesh->GetNumTrisDrawn()) / 1e6,
+                    static_cast<double>(m_mesh->GetNumTris()) / 1e6);
+        ImGui::Text("Cull time: %.3f ms", m_cullTimeMs);
+        if ( m_occlusionCull )
+        {
+            ImGui::Text("Occluder tris: %d, rasterized in %.3f ms",
+                        static_cast<int>(m_occlusionBuffer->GetNumOccluderTris()), m_rasterizeTimeMs);
+        }
+
+        ImGui::End();
+    }
+
+    ///
+    /// \brief Sets up a dense mesh, a grid of finely tessellated tori merged into one mesh so
+    ///        that only its meshlets can be culled. The occluder mesh is the same grid with far
+    ///        fewer triangles and thinner tubes, so it always lies inside the visible tori.
+    ///
+    void ClusterCullingDemo::SetupMesh()
+    {
+        const int gridSize = 5;
+        const float spacing = 1.0f;
+
+        Mesh mesh;
+        Mesh occluderMesh;
+        for ( int row = 0; row < gridSize; row++ )
+        {
+            for ( int col = 0; col < gridSize; col++ )
+            {
+                glm::vec3 offset((static_cast<float>(col) - 0.5f * (gridSize - 1)) * spacing,
+                                 (static_cast<float>(row) - 0.5f * (gridSize - 1)) * spacing,
+                                 0.0f);
+                glm::vec4 color(static_cast<float>(col) / (gridSize - 1), static_cast<float>(row) / (gridSize - 1), 0.8f, 1.0f);
+                glm::mat4 transform = glm::translate(glm::mat4(1.0f), offset);
+                Mesh torus = GeomHelpers::CreateTorus(0.35f, 0.12f, 64, 256, color, transform);
+                Mesh occluderTorus = GeomHelpers::CreateTorus(0.35f, 0.1f, 8, 32, color, transform);
+
+                unsigned int baseVertex = static_cast<unsigned int>(mesh.m_vertices.size());
+                mesh.m_vertices.insert(mesh.m_vertices.end(), torus.m_vertices.begin(), torus.m_vertices.end());
+                for ( unsigned int index : torus.m_indices )
+                {
+                    mesh.m_indices.push_back(baseVertex + index);
+                }
+
+                baseVertex = static_cast<unsigned int>(occluderMesh.m_vertices.size());
+                occluderMesh.m_vertices.insert(occluderMesh.m_vertices.end(), occluderTorus.m_vertices.begin(), occluderTorus.m_vertices.end());
+                for ( unsigned int index : occluderTorus.m_indices )
+                {
+                    occluderMesh.m_indices.push_back(baseVertex + index);
+                }
+            }
+        }
+
+        m_mesh = new ClusteredMeshObject(mesh);
+        m_occluderMesh = new Mesh(occluderMesh);
+    }
+
+    void ClusterCullingDemo::ProcessKeys(const UIData& _uiData, float _deltaTime)
+    {
+        if ( _uiData.m_pressedKeys.count(enPressedKey::KEY_W) > 0 )
+        {
+            m_cameraDecorator->ProcessKeyboard(enCameraMovement::FORWARD, _deltaTime);
+        }
+
+        if ( _uiData.m_pressedKeys.count(enPressedKey::KEY_S) > 0 )
+        {
+            m_cameraDecorator->ProcessKeyboard(enCameraMovement::BACKWARD, _deltaTime);
+        }
+
+        if ( _uiData.m_pressedKeys.count(enPressedKey::KEY_A) > 0 )
+        {
+            m_cameraDecorator->ProcessKeyboard(enCameraMovement::LEFT, _deltaTime);
+        }
+
+        if ( _uiData.m_pressedKeys.count(enPressedKey::KEY_D) > 0 )
+        {
+            m_cameraDecorator->ProcessKeyboard(enCameraMovement::RIGHT, _deltaTime);
+        }
+    }
+
+    void ClusterCullingDemo::ProcessMouseMove(const UIData& _uiData, float _deltaTime)
+    {
+        if ( !_uiData.m_guiCaptured )
+        {
+            const MouseInputState& mouseInput = _uiData.m_mouseInput;
+            if ( mouseInput.m_mouseMoved )
+            {
+                m_cameraDecorator->ProcessMouseMove(mouseInput.m_mouseDelta.x,
+                                                    mouseInput.m_mouseDelta.y,
+                                                    mouseInput.GetDraggedButtons(),
+                                                    _deltaTime,
+                                                    true);
+            }
+        }
+    }
+}
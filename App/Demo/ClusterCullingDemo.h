@@ -0,0 +1,52 @@
+#ifndef CLUSTERCULLINGDEMO_H
+#define CLUSTERCULLINGDEMO_H
+
+#include "DemoInterface.h"
+
+namespace blithe
+{
+    class CameraDecorator;
+    class ClusteredMeshObject;
+    struct Mesh;
+    class OcclusionBuffer;
+    class ShaderProgram;
+    class Texture;
+
+    class ClusterCullingDemo : public DemoInterface
+    {
+    public:
+        ~ClusterCullingDemo() override;
+
+        void OnInit() override;
+
+        void OnRender(double _deltaTimeS, const UIData& _uiData) override;
+
+        void OnDrawUI() override;
+
+        bool UsesStandardViewPort() const override { return true; }
+
+    private:
+        void SetupMesh();
+        void ProcessKeys(const UIData& _uiData, float _deltaTime);
+        void ProcessMouseMove(const UIData& _uiData, float _deltaTime);
+
+        ShaderProgram* m_shader = nullptr;
+        ClusteredMeshObject* m_mesh = nullptr;
+        Mesh* m_occluderMesh = nullptr;
+        OcclusionBuffer* m_occlusionBuffer = nullptr;
+        Texture* m_texture = nullptr;
+        CameraDecorator* m_cameraDecorator = nullptr;
+        float m_rotationSpeed = 0.05f;  //!< Value from UI control for the Rotation Speed
+        bool m_frustumCull = true;      //!< Value from UI control for whether meshlets outside the frustum are culled
+        bool m_backFaceCull = true;     //!< Value from UI control for whether back-facing meshlets are culled
+        bool m_occlusionCull = false;   //!< Value from UI control for whether meshlets hidden behind the occluders are culled
+        double m_cullTimeMs = 0.0;      //!< Time the last ClusteredMeshObject::Cull() took
+        double m_rasterizeTimeMs = 0.0; //!< Time rasterizing the occluders took last frame
+
+        float m_rotationAngleRad = 0.0f; // Cumulative rotation progress in radians
+    };
+
+    DECLARE_DEMO(ClusterCullingDemo, "Cluster Culling Demo");
+}
+
+#endif // CLUSTERCULLINGDEMO_H
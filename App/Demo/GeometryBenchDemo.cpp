@@ -0,0 +1,507 @@
+#include "GeometryBenchDemo.h"
+#include "AABBArrays.h"
+#include "BVH.h"
+#include "GeomHelpers.h"
+#include "Mesh.h"
+#include "MeshSoA.h"
+#include "PickingScene.h"
+#include "RayMeshPicker.h"
+#include "SpatialHashGrid.h"
+#include "UIData.h"
+
+#include "imgui.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <tracy/Tracy.hpp>
+
+namespace blithe
+{
+    static const int BENCH_VIEWPORT_SIZE = 1024; //!< Width and height of the virtual viewport the picking rays are cast from
+    static const int BENCH_NUM_FRAMES = 10;      //!< Frames of movement in the spatial hash bench
+    static const int BENCH_NUM_QUERIES = 1000;   //!< Box and ray queries in the spatial hash bench
+
+    /*!
+     * \brief Times _func and converts the time into a rate
+     *
+     * \param _numItems - Number of items _func processes
+     * \param _func     - Work to time
+     *
+     * \return Items per second
+     */
+    template<typename Func>
+    static double MeasureRate(size_t _numItems, Func&& _func)
+    {
+        auto start = std::chrono::steady_clock::now();
+        _func();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return seconds > 0.0 ? static_cast<double>(_numItems) / seconds : 0.0;
+    }
+
+    /*!
+     * \brief Random point in a cube centered on the origin
+     *
+     * \param _rng  - Random number generator
+     * \param _size - Width of the cube
+     *
+     * \return Point in the cube
+     */
+    static glm::vec3 RandomPoint(std::mt19937& _rng, float _size)
+    {
+        std::uniform_real_distribution<float> dist(-0.5f * _size, 0.5f * _size);
+        return glm::vec3(dist(_rng), dist(_rng), dist(_rng));
+    }
+
+    /*!
+     * \brief Random box whose center is in a cube centered on the origin
+     *
+     * \param _rng           - Random number generator
+     * \param _size          - Width of the cube
+     * \param _minHalfExtent - Smallest half extent of the box along each axis
+     * \param _maxHalfExtent - Largest half extent of the box along each axis
+     *
+     * \return Box in the cube
+     */
+    static AABB RandomBox(std::mt19937& _rng, float _size, float _minHalfExtent, float _maxHalfExtent)
+    {
+        glm::vec3 center = RandomPoint(_rng, _size);
+        std::uniform_real_distribution<float> extentDist(_minHalfExtent, _maxHalfExtent);
+        glm::vec3 halfExtents(extentDist(_rng), extentDist(_rng), extentDist(_rng));
+        return { center - halfExtents, center + halfExtents };
+    }
+
+    /*!
+     * \brief Random rigid model matrix: a rotation about a random axis, then a translation to a
+     *        point in a cube centered on the origin
+     *
+     * \param _rng  - Random number generator
+     * \param _size - Width of the cube
+     *
+     * \return Model matrix
+     */
+    static glm::mat4 RandomModelMat(std::mt19937& _rng, float _size)
+    {
+        std::uniform_real_distribution<float> angleDist(0.0f, glm::two_pi<float>());
+        glm::vec3 axis = glm::normalize(RandomPoint(_rng, 1.0f) + 0.6f);
+        glm::mat4 modelMat = glm::translate(glm::mat4(1.0f), RandomPoint(_rng, _size));
+        return glm::rotate(modelMat, angleDist(_rng), axis);
+    }
+
+    /*!
+     * \brief Destructor
+     */
+    GeometryBenchDemo::~GeometryBenchDemo()
+    {
+        delete m_pickingScene;
+        delete m_torus;
+    }
+
+    /*!
+     * \brief Setup for the geometry bench demo
+     */
+    void GeometryBenchDemo::OnInit()
+    {
+        m_torus = new Mesh(GeomHelpers::CreateTorus(1.0f, 0.3f, 24, 48, glm::vec4(1.0f)));
+        m_pickingScene = new PickingScene();
+        SetupScene();
+    }
+
+    /*!
+     * \brief Nothing to render. The benchmarks run from the UI.
+     */
+    void GeometryBenchDemo::OnRender(double /*_deltaTimeS*/, const UIData& /*_uiData*/)
+    {
+    }
+
+    /*!
+     * \brief ImGui controls specific to the geometry bench demo
+     */
+    void GeometryBenchDemo::OnDrawUI()
+    {
+        ImGui::Begin("Geometry Bench Demo Params");
+
+        ImGui::Text("Picking");
+        if ( ImGui::SliderInt("Meshes", &m_numMeshes, 100, 20000) )
+        {
+            SetupScene();
+        }
+        ImGui::SliderInt("Marquee Rays Per Side", &m_gridSize, 8, 1024);
+        if ( ImGui::Button("Run Picking Bench") )
+        {
+            RunPickingBench();
+        }
+        ImGui::Text("Boxes, single rays: %.2f Mrays/s", m_singleAABBRaysPerS / 1e6);
+        ImGui::Text("Boxes, ray packets: %.2f Mrays/s", m_packetAABBRaysPerS / 1e6);
+        ImGui::Text("Triangles, single rays: %.2f Mrays/s", m_singleTriangleRaysPerS / 1e6);
+        ImGui::Text("Triangles, ray packets: %.2f Mrays/s", m_packetTriangleRaysPerS / 1e6);
+        ImGui::Text("Triangle hits: %d of %d rays", m_numTriangleHits, m_gridSize * m_gridSize);
+
+        ImGui::Separator();
+        ImGui::Text("Bounds");
+        ImGui::SliderInt("Boxes", &m_numBoxes, 1000, 1000000);
+        if ( ImGui::Button("Run Bounds Bench") )
+        {
+            RunBoundsBench();
+        }
+        ImGui::Text("Corners, one box at a time: %.2f ns/box", m_cornersNsPerBox);
+        ImGui::Text("Arvo, batched: %.2f ns/box", m_batchNsPerBox);
+        ImGui::Text("Max difference: %g", m_boundsMaxError);
+
+        ImGui::Separator();
+        ImGui::Text("Mesh Reductions");
+        ImGui::SliderInt("Vertices", &m_numVertices, 10000, 10000000);
+        if ( ImGui::Button("Run Reduction Bench") )
+        {
+            RunReductionBench();
+        }
+        ImGui::Text("Centroid: %.2f Mverts/s (%.3f, %.3f, %.3f)", m_centroidVertsPerS / 1e6, m_centroid.x, m_centroid.y, m_centroid.z);
+        ImGui::Text("Local AABB: %.2f Mverts/s (%.2f, %.2f, %.2f) - (%.2f, %.2f, %.2f)", m_localAABBVertsPerS / 1e6,
+                    m_localAABB.m_min.x, m_localAABB.m_min.y, m_localAABB.m_min.z, m_localAABB.m_max.x, m_localAABB.m_max.y, m_localAABB.m_max.z);
+        ImGui::Text("World AABB: %.2f Mverts/s (%.2f, %.2f, %.2f) - (%.2f, %.2f, %.2f)", m_worldAABBVertsPerS / 1e6,
+                    m_worldAABB.m_min.x, m_worldAABB.m_min.y, m_worldAABB.m_min.z, m_worldAABB.m_max.x, m_worldAABB.m_max.y, m_worldAABB.m_max.z);
+        ImGui::Text("Local AABB, MeshSoA: %.2f Mverts/s (%.2f, %.2f, %.2f) - (%.2f, %.2f, %.2f)", m_soaLocalAABBVertsPerS / 1e6,
+                    m_soaLocalAABB.m_min.x, m_soaLocalAABB.m_min.y, m_soaLocalAABB.m_min.z, m_soaLocalAABB.m_max.x, m_soaLocalAABB.m_max.y, m_soaLocalAABB.m_max.z);
+        ImGui::Text("Max difference from serial: %g", m_reductionMaxError);
+
+        ImGui::Separator();
+        ImGui::Text("Spatial Hash");
+        ImGui::SliderInt("Moving Boxes", &m_numMovers, 1000, 20000);
+        if ( ImGui::Button("Run Spatial Hash Bench") )
+        {
+            RunSpatialHashBench();
+        }
+        ImGui::Text("Updates: %.2f Mmoves/s (BVH refit: %.2f Mboxes/s)", m_gridMovesPerS / 1e6, m_bvhRefitsPerS / 1e6);
+        ImGui::Text("Box queries: %.0f/s (brute force: %.0f/s)", m_gridAABBQueriesPerS, m_bruteAABBQueriesPerS);
+        ImGui::Text("Ray queries: %.0f/s (brute force: %.0f/s)", m_gridRayQueriesPerS, m_bruteRayQueriesPerS);
+        ImGui::Text("Overlapping pairs: %.2f ms (brute force: %.2f ms)", m_gridPairsMs, m_brutePairsMs);
+        ImGui::Text("Pairs found: %d (brute force: %d)", m_numGridPairs, m_numBrutePairs);
+
+        ImGui::End();
+    }
+
+    /*!
+     * \brief Scatters m_numMeshes randomly oriented tori, all sharing m_torus, in a cube in
+     *        front of the benchmark camera
+     */
+    void GeometryBenchDemo::SetupScene()
+    {
+        std::mt19937 rng(42);
+
+        m_modelMats.resize(static_cast<size_t>(m_numMeshes));
+        std::vector<const Mesh*> meshes(m_modelMats.size(), m_torus);
+        std::vector<glm::mat4*> modelMatPtrs;
+        for ( glm::mat4& modelMat : m_modelMats )
+        {
+            modelMat = RandomModelMat(rng, 60.0f);
+            modelMatPtrs.push_back(&modelMat);
+        }
+        m_pickingScene->SetMeshes(meshes, modelMatPtrs);
+    }
+
+    /*!
+     * \brief Casts a grid of rays over the whole virtual viewport, as a marquee covering it
+     *        would, one ray at a time and then in packets, and measures the throughput of each
+     */
+    void GeometryBenchDemo::RunPickingBench()
+    {
+        ZoneScoped;
+
+        float size = static_cast<float>(BENCH_VIEWPORT_SIZE);
+        glm::mat4 proj = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 200.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 70.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        RayMeshPicker picker(BENCH_VIEWPORT_SIZE, BENCH_VIEWPORT_SIZE, glm::inverse(proj * view));
+        std::vector<glm::vec2> positions = RayMeshPicker::CalcGridPositions(glm::vec2(0.0f), glm::vec2(size), glm::ivec2(m_gridSize));
+
+        // Build the triangle BVHs up front so they aren't part of the timings
+        picker.PickMeshTriangles(positions, *m_pickingScene);
+
+        m_singleAABBRaysPerS = MeasureRate(positions.size(), [&]()
+        {
+            for ( const glm::vec2& pos : positions )
+            {
+                picker.PickSingleMeshAABB(pos, *m_pickingScene);
+            }
+        });
+        m_packetAABBRaysPerS = MeasureRate(positions.size(), [&]()
+        {
+            picker.PickMeshesAABB(positions, *m_pickingScene);
+        });
+        m_singleTriangleRaysPerS = MeasureRate(positions.size(), [&]()
+        {
+            for ( const glm::vec2& pos : positions )
+            {
+                picker.PickSingleMeshTriangle(pos, *m_pickingScene);
+            }
+        });
+
+        std::vector<tl::optional<RayMeshPicker::TriangleResult>> triangleResults;
+        m_packetTriangleRaysPerS = MeasureRate(positions.size(), [&]()
+        {
+            triangleResults = picker.PickMeshTriangles(positions, *m_pickingScene);
+        });
+        m_numTriangleHits = 0;
+        for ( const tl::optional<RayMeshPicker::TriangleResult>& result : triangleResults )
+        {
+            m_numTriangleHits += result.has_value() ? 1 : 0;
+        }
+    }
+
+    /*!
+     * \brief Transforms m_numBoxes random boxes by random matrices one box at a time with
+     *        GeomHelpers::TransformAABB(), and then all at once with
+     *        GeomHelpers::TransformAABBs(), and measures the cost per box of each
+     */
+    void GeometryBenchDemo::RunBoundsBench()
+    {
+        ZoneScoped;
+
+        std::mt19937 rng(42);
+
+        size_t numBoxes = static_cast<size_t>(m_numBoxes);
+        std::vector<AABB> boxes(numBoxes);
+        std::vector<glm::mat4> mats(numBoxes);
+        for ( size_t i = 0; i < numBoxes; i++ )
+        {
+            boxes[i] = RandomBox(rng, 60.0f, 0.05f, 0.55f);
+            mats[i] = glm::scale(RandomModelMat(rng, 60.0f), RandomPoint(rng, 1.0f) + 1.0f);
+        }
+        AABBArrays boxArrays;
+        boxArrays.Assign(boxes);
+
+        std::vector<AABB> cornerResults(numBoxes);
+        double cornersPerS = MeasureRate(numBoxes, [&]()
+        {
+            for ( size_t i = 0; i < numBoxes; i++ )
+            {
+                cornerResults[i] = GeomHelpers::TransformAABB(boxes[i], mats[i]);
+            }
+        });
+        AABBArrays batchResults;
+        double batchPerS = MeasureRate(numBoxes, [&]()
+        {
+            GeomHelpers::TransformAABBs(boxArrays, mats, batchResults);
+        });
+        m_cornersNsPerBox = cornersPerS > 0.0 ? 1e9 / cornersPerS : 0.0;
+        m_batchNsPerBox = batchPerS > 0.0 ? 1e9 / batchPerS : 0.0;
+
+        m_boundsMaxError = 0.0f;
+        for ( size_t i = 0; i < numBoxes; i++ )
+        {
+            AABB batchResult = batchResults.Get(i);
+            glm::vec3 error = glm::max(glm::abs(batchResult.m_min - cornerResults[i].m_min), glm::abs(batchResult.m_max - cornerResults[i].m_max));
+            m_boundsMaxError = std::max(m_boundsMaxError, std::max(error.x, std::max(error.y, error.z)));
+        }
+    }
+
+    /*!
+     * \brief Reduces a mesh of m_numVertices random vertices to its centroid, local AABB and
+     *        world AABB, and measures the throughput of each. The local AABB is also found from
+     *        the MeshSoA of the mesh, which only streams the positions. The results are checked
+     *        against a serial loop over the vertices.
+     */
+    void GeometryBenchDemo::RunReductionBench()
+    {
+        ZoneScoped;
+
+        std::mt19937 rng(42);
+
+        Mesh mesh;
+        mesh.m_vertices.resize(static_cast<size_t>(m_numVertices));
+        for ( Vertex& vertex : mesh.m_vertices )
+        {
+            vertex.m_pos = RandomPoint(rng, 60.0f);
+            vertex.m_color = glm::vec4(1.0f);
+            vertex.m_texCoords = glm::vec2(0.0f);
+        }
+        glm::mat4 modelMat = RandomModelMat(rng, 10.0f);
+
+        m_centroidVertsPerS = MeasureRate(mesh.m_vertices.size(), [&]()
+        {
+            m_centroid = GeomHelpers::CalcCentroid(mesh);
+        });
+        m_localAABBVertsPerS = MeasureRate(mesh.m_vertices.size(), [&]()
+        {
+            m_localAABB = GeomHelpers::CalcLocalAABB(mesh);
+        });
+        m_worldAABBVertsPerS = MeasureRate(mesh.m_vertices.size(), [&]()
+        {
+            m_worldAABB = GeomHelpers::CalcWorldAABB(mesh, modelMat);
+        });
+
+        MeshSoA meshSoA = MeshSoA::FromMesh(mesh);
+        m_soaLocalAABBVertsPerS = MeasureRate(meshSoA.GetNumVertices(), [&]()
+        {
+            m_soaLocalAABB = GeomHelpers::CalcLocalAABB(meshSoA);
+        });
+
+        // Serial reference, with the sum in double so it's at least as accurate as the chunks
+        glm::dvec3 sum(0.0);
+        AABB localAABB = { glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()) };
+        AABB worldAABB = localAABB;
+        for ( const Vertex& vertex : mesh.m_vertices )
+        {
+            sum += glm::dvec3(vertex.m_pos);
+            localAABB.m_min = glm::min(localAABB.m_min, vertex.m_pos);
+            localAABB.m_max = glm::max(localAABB.m_max, vertex.m_pos);
+            glm::vec3 worldPos = glm::vec3(modelMat * glm::vec4(vertex.m_pos, 1.0f));
+            worldAABB.m_min = glm::min(worldAABB.m_min, worldPos);
+            worldAABB.m_max = glm::max(worldAABB.m_max, worldPos);
+        }
+        glm::vec3 centroid = glm::vec3(sum / static_cast<double>(mesh.m_vertices.size()));
+
+        auto maxDiff = [](const glm::vec3& _a, const glm::vec3& _b)
+        {
+            glm::vec3 diff = glm::abs(_a - _b);
+            return std::max(diff.x, std::max(diff.y, diff.z));
+        };
+        m_reductionMaxError = maxDiff(m_centroid, centroid);
+        for ( const AABB* aabb : { &m_localAABB, &m_soaLocalAABB } )
+        {
+            m_reductionMaxError = std::max(m_reductionMaxError, std::max(maxDiff(aabb->m_min, localAABB.m_min), maxDiff(aabb->m_max, localAABB.m_max)));
+        }
+        m_reductionMaxError = std::max(m_reductionMaxError, std::max(maxDiff(m_worldAABB.m_min, worldAABB.m_min), maxDiff(m_worldAABB.m_max, worldAABB.m_max)));
+    }
+
+    /*!
+     * \brief Moves m_numMovers boxes around for a few frames in a SpatialHashGrid and measures
+     *        the update rate against refitting a BVH over them, then measures box queries, ray
+     *        queries and finding all the overlapping pairs against testing every box
+     */
+    void GeometryBenchDemo::RunSpatialHashBench()
+    {
+        ZoneScoped;
+
+        std::mt19937 rng(42);
+
+        // Boxes about 1 wide, at a fixed density, in cells twice that
+        size_t numBoxes = static_cast<size_t>(m_numMovers);
+        float worldSize = 4.0f * std::cbrt(static_cast<float>(numBoxes));
+        std::vector<AABB> boxes(numBoxes);
+        std::vector<glm::vec3> velocities(numBoxes);
+        SpatialHashGrid grid(2.0f);
+        for ( size_t i = 0; i < numBoxes; i++ )
+        {
+            boxes[i] = RandomBox(rng, worldSize, 0.25f, 0.75f);
+            velocities[i] = RandomPoint(rng, 0.5f);
+            grid.Insert(static_cast<uint32_t>(i), boxes[i]);
+        }
+        BVH bvh;
+        bvh.Build(boxes);
+
+        // Move the boxes the same way before each update, so only the updates are compared
+        std::vector<std::vector<AABB>> frames(BENCH_NUM_FRAMES, boxes);
+        for ( int frame = 0; frame < BENCH_NUM_FRAMES; frame++ )
+        {
+            for ( size_t i = 0; i < numBoxes; i++ )
+            {
+                glm::vec3 offset = velocities[i] * static_cast<float>(frame + 1);
+                frames[frame][i] = { boxes[i].m_min + offset, boxes[i].m_max + offset };
+            }
+        }
+        m_gridMovesPerS = MeasureRate(numBoxes * BENCH_NUM_FRAMES, [&]()
+        {
+            for ( const std::vector<AABB>& frameBoxes : frames )
+            {
+                for ( size_t i = 0; i < numBoxes; i++ )
+                {
+                    grid.Move(static_cast<uint32_t>(i), frameBoxes[i]);
+                }
+            }
+        });
+        m_bvhRefitsPerS = MeasureRate(numBoxes * BENCH_NUM_FRAMES, [&]()
+        {
+            for ( const std::vector<AABB>& frameBoxes : frames )
+            {
+                bvh.Refit(frameBoxes);
+            }
+        });
+        boxes = frames.back();
+
+        std::vector<AABB> queryBoxes(BENCH_NUM_QUERIES);
+        std::vector<Ray> queryRays(BENCH_NUM_QUERIES);
+        for ( int i = 0; i < BENCH_NUM_QUERIES; i++ )
+        {
+            glm::vec3 center = RandomPoint(rng, worldSize);
+            queryBoxes[i] = { center - 2.0f, center + 2.0f };
+            queryRays[i] = { RandomPoint(rng, worldSize), glm::normalize(RandomPoint(rng, 1.0f)) };
+        }
+        const float rayLength = 20.0f;
+
+        std::vector<uint32_t> hits;
+        m_gridAABBQueriesPerS = MeasureRate(queryBoxes.size(), [&]()
+        {
+            for ( const AABB& queryBox : queryBoxes )
+            {
+                hits.clear();
+                grid.QueryAABB(queryBox, hits);
+            }
+        });
+        m_bruteAABBQueriesPerS = MeasureRate(queryBoxes.size(), [&]()
+        {
+            for ( const AABB& queryBox : queryBoxes )
+            {
+                hits.clear();
+                for ( size_t i = 0; i < numBoxes; i++ )
+                {
+                    if ( glm::all(glm::lessThanEqual(boxes[i].m_min, queryBox.m_max)) && glm::all(glm::lessThanEqual(queryBox.m_min, boxes[i].m_max)) )
+                    {
+                        hits.push_back(static_cast<uint32_t>(i));
+                    }
+                }
+            }
+        });
+        m_gridRayQueriesPerS = MeasureRate(queryRays.size(), [&]()
+        {
+            for ( const Ray& queryRay : queryRays )
+            {
+                hits.clear();
+                grid.QueryRay(queryRay, rayLength, hits);
+            }
+        });
+        m_bruteRayQueriesPerS = MeasureRate(queryRays.size(), [&]()
+        {
+            for ( const Ray& queryRay : queryRays )
+            {
+                hits.clear();
+                glm::vec3 invDir = 1.0f / queryRay.m_dir;
+                for ( size_t i = 0; i < numBoxes; i++ )
+                {
+                    float tNear = 0.0f;
+                    if ( BVH::RayHitsAABB(boxes[i], queryRay.m_origin, invDir, rayLength, tNear) )
+                    {
+                        hits.push_back(static_cast<uint32_t>(i));
+                    }
+                }
+            }
+        });
+
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        double gridPairsPerS = MeasureRate(1, [&]()
+        {
+            grid.FindOverlappingPairs(pairs);
+        });
+        m_numGridPairs = static_cast<int>(pairs.size());
+        pairs.clear();
+        double brutePairsPerS = MeasureRate(1, [&]()
+        {
+            for ( size_t i = 0; i < numBoxes; i++ )
+            {
+                for ( size_t j = i + 1; j < numBoxes; j++ )
+                {
+                    if ( glm::all(glm::lessThanEqual(boxes[i].m_min, boxes[j].m_max)) && glm::all(glm::lessThanEqual(boxes[j].m_min, boxes[i].m_max)) )
+                    {
+                        pairs.emplace_back(static_cast<uint32_t>(i), static_cast<uint32_t>(j));
+                    }
+                }
+            }
+        });
+        m_numBrutePairs = static_cast<int>(pairs.size());
+        m_gridPairsMs = gridPairsPerS > 0.0 ? 1e3 / gridPairsPerS : 0.0;
+        m_brutePairsMs = brutePairsPerS > 0.0 ? 1e3 / brutePairsPerS : 0.0;
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef GEOMETRYBENCHDEMO_H
+#define GEOMETRYBENCHDEMO_H
+
+#include "DemoInterface.h"
+#include <vector>
+#include <glm/glm.hpp>
+#include "AABB.h"
+
+namespace blithe
+{
+    struct Mesh;
+    class PickingScene;
+
+    /*!
+     * \brief Benchmarks of the geometry queries, run on demand from the UI. Nothing is drawn.
+     */
+    class GeometryBenchDemo : public DemoInterface
+    {
+    public:
+        ~GeometryBenchDemo() override;
+
+        void OnInit() override;
+
+        void OnRender(double _deltaTimeS, const UIData& _uiData) override;
+
+        void OnDrawUI() override;
+
+        bool UsesStandardViewPort() const override { return false; }
+
+    private:
+        void SetupScene();
+        void RunPickingBench();
+        void RunBoundsBench();
+        void RunReductionBench();
+        void RunSpatialHashBench();
+
+        Mesh* m_torus = nullptr;
+        PickingScene* m_pickingScene = nullptr;
+        std::vector<glm::mat4> m_modelMats;    //!< Model matrix of each torus in m_pickingScene
+        int m_numMeshes = 2000;                //!< Value from UI control for the number of tori to pick from
+        int m_gridSize = 256;                  //!< Value from UI control for the number of rays along each side of the marquee
+        double m_singleAABBRaysPerS = 0.0;     //!< Rays per second picking mesh boxes one ray at a time
+        double m_packetAABBRaysPerS = 0.0;     //!< Rays per second picking mesh boxes with ray packets
+        double m_singleTriangleRaysPerS = 0.0; //!< Rays per second picking triangles one ray at a time
+        double m_packetTriangleRaysPerS = 0.0; //!< Rays per second picking triangles with ray packets
+        int m_numTriangleHits = 0;             //!< Rays of the last run that hit a triangle
+        int m_numBoxes = 100000;               //!< Value from UI control for the number of boxes to transform
+        double m_cornersNsPerBox = 0.0;        //!< Nanoseconds per box transforming the 8 corners of each box
+        double m_batchNsPerBox = 0.0;          //!< Nanoseconds per box transforming all the boxes in one batch
+        float m_boundsMaxError = 0.0f;         //!< Largest difference between the two ways of transforming the boxes
+        int m_numVertices = 1000000;           //!< Value from UI control for the number of mesh vertices to reduce
+        double m_centroidVertsPerS = 0.0;      //!< Vertices per second of GeomHelpers::CalcCentroid()
+        double m_localAABBVertsPerS = 0.0;     //!< Vertices per second of GeomHelpers::CalcLocalAABB()
+        double m_worldAABBVertsPerS = 0.0;     //!< Vertices per second of GeomHelpers::CalcWorldAABB()
+        double m_soaLocalAABBVertsPerS = 0.0;  //!< Vertices per second of GeomHelpers::CalcLocalAABB() on a MeshSoA
+        glm::vec3 m_centroid = {};             //!< Centroid the last reduction run found
+        AABB m_localAABB = {};                 //!< Local AABB the last reduction run found
+        AABB m_worldAABB = {};                 //!< World AABB the last reduction run found
+        AABB m_soaLocalAABB = {};              //!< Local AABB the last reduction run found from the MeshSoA
+        float m_reductionMaxError = 0.0f;      //!< Largest difference between the reductions and a serial loop over the vertices
+        int m_numMovers = 5000;                //!< Value from UI control for the number of moving boxes in the spatial hash bench
+        double m_gridMovesPerS = 0.0;          //!< Boxes per second moved in the SpatialHashGrid
+        double m_bvhRefitsPerS = 0.0;          //!< Boxes per second refitted in a BVH, for comparison
+        double m_gridAABBQueriesPerS = 0.0;    //!< Box queries per second with the SpatialHashGrid
+        double m_bruteAABBQueriesPerS = 0.0;   //!< Box queries per second testing every box
+        double m_gridRayQueriesPerS = 0.0;     //!< Ray queries per second with the SpatialHashGrid
+        double m_bruteRayQueriesPerS = 0.0;    //!< Ray queries per second testing every box
+        double m_gridPairsMs = 0.0;            //!< Milliseconds to find the overlapping pairs with the SpatialHashGrid
+        double m_brutePairsMs = 0.0;           //!< Milliseconds to find the overlapping pairs testing every pair
+        int m_numGridPairs = 0;                //!< Overlapping pairs the SpatialHashGrid found
+        int m_numBrutePairs = 0;               //!< Overlapping pairs testing every pair found
+    };
+
+    DECLARE_DEMO(GeometryBenchDemo, "Geometry Bench Demo");
+}
+
+#endif // GEOMETRYBENCHDEMO_H
@@ -2,23 +2,26 @@
 #include "ArcBallCameraDecorator.h"
 #include "BlithePath.h"
 #include "GeomHelpers.h"
+#include "LODMeshObject.h"
+#include "MeshImporter.h"
 #include "MeshObject.h"
 #include "ShaderProgram.h"
 #include "Texture.h"
+#include "ThreadPool.h"
 #include "UIData.h"
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>           // Includes the data structure
-#include <assimp/postprocess.h>     // Includes the post processing flags
-
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include <stdio.h>
+#include <chrono>
 #include <ctime>
+#include <stdexcept>
 
 namespace blithe
 {
+    static const float FOV_Y_DEGREES = 45.0f; //!< Vertical field of view of the camera, for the projection and the LOD selection
+
     ///
     /// \brief Destructor
     ///
@@ -30,14 +33,25 @@ namespace blithe
         delete m_texture;
         delete m_cameraDecorator;
         delete m_grass;
+        if ( m_grassLODsFuture.valid() )
+        {
+            m_grassLODsFuture.wait();
+        }
+        m_cubeTicket.reset();
+        m_grassLODTickets.clear();
+        delete m_uploadService;
     }
 
     void GrassDemo::OnInit()
     {
         std::string exePath = GetExecutablePath();
         m_texture = new Texture(exePath + "/Assets/vintage_convertible.jpg", TextureData::FilterParam::LINEAR);
-        m_shader = new ShaderProgram(exePath + "/Shaders/TriangleInstanced.vert", exePath + "/Shaders/Triangle.frag");
+        // The grass and cubes are laid out on a grid with no rotation or scale, so the instances
+        // only need a translation (and scale) each
+        std::string vertexShaderName = InstancePacker::GetVertexShaderName(enInstanceEncoding::TRANS_SCALE);
+        m_shader = new ShaderProgram(exePath + "/Shaders/" + vertexShaderName, exePath + "/Shaders/Triangle.frag");
         m_cameraDecorator = new ArcBallCameraDecorator();
+        m_uploadService = new MeshUploadService(static_cast<size_t>(m_uploadKBPerFrame) * 1024);
 
         SetupCube();
 
@@ -58,6 +72,9 @@ namespace blithe
         ProcessKeys(_uiData, deltaTimeS);
         ProcessMouseMove(_uiData, deltaTimeS);
 
+        m_uploadService->ProcessUploads();
+        CollectUploadedMeshes();
+
         m_rotationAngleRad += deltaTimeS * m_rotationSpeed * 2.0f * pi; // Update based on speed
         m_rotationAngleRad = fmod(m_rotationAngleRad, 2.0f * pi); // Keep progress within a full rotation range
 
@@ -67,7 +84,8 @@ namespace blithe
         //model = glm::scale(model, glm::vec3(0.5f));
         glm::mat4 view = m_cameraDecorator->GetCamera().GetViewMatrix();
         float aspect = m_useCustomAspect ? m_customAspect : _uiData.m_aspect;
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
+        float fovY = glm::radians(FOV_Y_DEGREES);
+        glm::mat4 projection = glm::perspective(fovY, aspect, 0.1f, 100.0f);
         glm::mat4 viewProjection = projection * view; // I just mat mult here as opposed to per vertex in the shader
 
         m_shader->Bind();
@@ -78,7 +96,12 @@ namespace blithe
         m_shader->SetUniform1i("myTex", static_cast<int>(activeUnitOffset));
 
         //m_cube->Render();
-        m_grass->Render();
+        if ( m_grass )
+        {
+            float projectionScale = LODMeshObject::CalcProjectionScale(fovY, _uiData.m_viewPortHeight);
+            m_grass->SelectLODs(viewProjection, m_cameraDecorator->GetCamera().GetPosition(), projectionScale, m_lodPixelError, m_cullWithBVH);
+            m_grass->Render();
+        }
 
         m_shader->Unbind();
 
@@ -108,6 +131,69 @@ namespace blithe
             ImGui::EndDisabled();
         }
 
+        // Slider for the per-frame mesh upload budget
+        if ( ImGui::SliderInt("Upload KB/Frame", &m_uploadKBPerFrame, 16, 4096) )
+        {
+            m_uploadService->SetBytesPerFrame(static_cast<size_t>(m_uploadKBPerFrame) * 1024);
+        }
+
+        // Slider for the max screen-space error of the grass LODs
+        ImGui::SliderFloat("LOD Pixel Error", &m_lodPixelError, 0.0f, 8.0f, "%.2f");
+
+        // Slider for the grass field size. 1000^2 is a million instances, most of them off screen.
+        // The field is only rebuilt when the slider is let go, not on every step of the drag.
+        ImGui::SliderInt("Grass Field Size", &m_grassFieldSize, 1, 1000);
+        if ( ImGui::IsItemDeactivatedAfterEdit() && m_grass )
+        {
+            SetupGrassField(m_grassFieldSize);
+        }
+
+        // Checkbox for culling the grass with a BVH. It's built in the background the first time
+        // it's used, and the grass is culled box by box until it's ready.
+        ImGui::Checkbox("Cull With BVH", &m_cullWithBVH);
+
+        if ( m_uploadService->GetNumPending() > 0 )
+        {
+            ImGui::Text("Loading %d mesh(es)...", static_cast<int>(m_uploadService->GetNumPending()));
+        }
+        else if ( m_grassLODsFuture.valid() )
+        {
+            ImGui::Text("Building grass LODs...");
+        }
+        if ( !m_grassLoadError.empty() )
+        {
+            ImGui::Text("Could not load the grass: %s", m_grassLoadError.c_str());
+        }
+
+        if ( m_grass )
+        {
+            ImGui::Text("Grass instances: %d visible of %d",
+                        static_cast<int>(m_grass->GetNumVisible()),
+                        m_grassFieldSize * m_grassFieldSize);
+            if ( m_cullWithBVH )
+            {
+                ImGui::Text("BVH nodes visited: %d", static_cast<int>(m_grass->GetNumNodesVisited()));
+            }
+            ImGui::Text("Grass vertex size: %d B (%d B unpacked)",
+                        static_cast<int>(VertexPacker::GetPackedFormat(m_grassPackOptions).m_stride),
+                        static_cast<int>(sizeof(Vertex)));
+            ImGui::Text("Grass tris: %.2fM (%.2fM at full detail)",
+                        static_cast<double>(m_grass->GetNumTrisDrawn()) * 1e-6,
+                        static_cast<double>(m_grass->GetNumTrisFullDetail()) * 1e-6);
+            for ( size_t lod = 0; lod < m_grass->GetNumLODs(); lod++ )
+            {
+                ImGui::Text("  LOD %d: %d instances", static_cast<int>(lod), static_cast<int>(m_grass->GetNumInstances(lod)));
+            }
+        }
+
+        // Vertex cache stats of the grass mesh before and after the import optimizations. Only
+        // read once the grass is collected, i.e. after the worker is done writing them.
+        if ( m_grass && m_grassOptimizeReport )
+        {
+            ImGui::Text("Grass ACMR: %.3f -> %.3f", m_grassOptimizeReport->m_before.m_acmr, m_grassOptimizeReport->m_after.m_acmr);
+            ImGui::Text("Grass ATVR: %.3f -> %.3f", m_grassOptimizeReport->m_before.m_atvr, m_grassOptimizeReport->m_after.m_atvr);
+        }
+
         ImGui::End();
     }
 
@@ -126,12 +212,92 @@ namespace blithe
             { 0.5f, 0.0f, 0.5f, 1.0f }, // purple
         };
 
-        Mesh mesh = GeomHelpers::CreateCuboid(sides, colors);
+        m_cubeTicket = m_uploadService->Enqueue([sides, colors]() {
+            return GeomHelpers::CreateCuboid(sides, colors);
+        });
+    }
+
+    ///
+    /// \brief Takes ownership of the meshes that have finished uploading and sets up their
+    ///        instances.
+    ///
+    void GrassDemo::CollectUploadedMeshes()
+    {
+        if ( m_cubeTicket && m_cubeTicket->HasFailed() )
+        {
+            m_cubeTicket.reset();
+        }
+        if ( m_cubeTicket && m_cubeTicket->IsReady() )
+        {
+            m_cube = m_cubeTicket->TakeMeshObject();
+            m_cubeTicket.reset();
+
+            std::vector<glm::mat4> modelTransforms = GenerateGridModelMatrices(10, 10, 10, 2.0);
+            m_cube->SetInstanceEncoding(enInstanceEncoding::TRANS_SCALE);
+            m_cube->SetInstances(modelTransforms);
+        }
+
+        // Once the LOD chain is built, stream in each LOD
+        if ( m_grassLODsFuture.valid() && m_grassLODsFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready )
+        {
+            std::vector<MeshLOD> lods;
+            try
+            {
+                lods = m_grassLODsFuture.get();
+            }
+            catch ( const std::exception& e )
+            {
+                m_grassLoadError = e.what();
+            }
+            if ( lods.empty() && m_grassLoadError.empty() )
+            {
+                m_grassLoadError = "No LODs were built";
+            }
+
+            for ( MeshLOD& lod : lods )
+            {
+                std::shared_ptr<Mesh> lodMesh = std::make_shared<Mesh>(std::move(lod.m_mesh));
+                m_grassLODTickets.push_back(m_uploadService->Enqueue([lodMesh]() { return *lodMesh; }, m_grassPackOptions));
+                m_grassLODErrors.push_back(lod.m_error);
+            }
+        }
 
-        m_cube = new MeshObject(mesh);
+        // The LODs are only useful together, so if any fails the grass is given up on
+        bool allGrassLODsReady = !m_grassLODTickets.empty();
+        for ( const std::shared_ptr<MeshUploadService::Ticket>& ticket : m_grassLODTickets )
+        {
+            if ( ticket->HasFailed() )
+            {
+                m_grassLoadError = ticket->GetError();
+                m_grassLODTickets.clear();
+                m_grassLODErrors.clear();
+                return;
+            }
+            allGrassLODsReady = allGrassLODsReady && ticket->IsReady();
+        }
+        if ( allGrassLODsReady )
+        {
+            std::vector<MeshObject*> lodObjects;
+            for ( const std::shared_ptr<MeshUploadService::Ticket>& ticket : m_grassLODTickets )
+            {
+                lodObjects.push_back(ticket->TakeMeshObject());
+            }
+            m_grassLODTickets.clear();
 
-        std::vector<glm::mat4> modelTransforms = GenerateGridModelMatrices(10, 10, 10, 2.0);
-        m_cube->SetInstances(modelTransforms);
+            m_grass = new LODMeshObject(lodObjects, m_grassLODErrors);
+            m_grass->SetInstanceEncoding(enInstanceEncoding::TRANS_SCALE);
+            SetupGrassField(m_grassFieldSize);
+        }
+    }
+
+    ///
+    /// \brief Lays the grass instances out on a flat square field.
+    ///
+    /// \param _fieldSize - Number of grass instances along each side of the field
+    ///
+    void GrassDemo::SetupGrassField(int _fieldSize)
+    {
+        m_grass->SetInstances(GenerateGridModelMatrices(_fieldSize, 1, _fieldSize, 2.0));
     }
 
     void GrassDemo::ProcessKeys(const UIData& _uiData, float _deltaTime)
@@ -268,85 +434,30 @@ namespace blithe
         return modelMatrices;
     }
 
+    ///
+    /// \brief Queues the grass model to be loaded and simplified into a LOD chain on a worker
+    ///        thread. CollectUploadedMeshes() then streams the LODs to the GPU and sets m_grass
+    ///        once they're all ready.
+    ///
+    /// \param _grassFileName - Path to the grass model file
+    ///
     void GrassDemo::SetupGrass(const std::string& _grassFileName)
     {
-        Mesh grassMesh;
-        bool couldLoad = Load3DFile(_grassFileName, grassMesh);
-        ASSERT(couldLoad, "Could not load grass model");
-
-        m_grass = new MeshObject(grassMesh);
-
-        std::vector<glm::mat4> modelTransforms = GenerateGridModelMatrices(10, 10, 10, 2.0);
-        m_grass->SetInstances(modelTransforms);
-    }
-
-    bool GrassDemo::Load3DFile(const std::string& _filename, Mesh& _outMesh)
-    {
-        Assimp::Importer importer;
-
-        // Import the 3D file with post-processing steps
-        const aiScene* scene = importer.ReadFile(_filename,
-                                                 aiProcess_Triangulate |              // Convert all shapes to triangles
-                                                 aiProcess_JoinIdenticalVertices |    // Merge identical vertices
-                                                 aiProcess_GenSmoothNormals |         // Generate normals if missing
-                                                 aiProcess_CalcTangentSpace |         // Calculate tangents and bitangents
-                                                 aiProcess_FlipUVs);                  // Flip UVs if needed
-
-        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
-        {
-            std::cerr << "Error loading file: " << importer.GetErrorString() << std::endl;
-            return false;
-        }
-
-        // Only load the first mesh for simplicity
-        aiMesh* mesh = scene->mMeshes[0];
-
-        // Populate vertices
-        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
-        {
-            Vertex vertex;
-            // Position
-            vertex.m_pos = glm::vec3(
-                mesh->mVertices[i].x,
-                mesh->mVertices[i].y,
-                mesh->mVertices[i].z);
-
-            // Color (if available in vertex colors, otherwise set default)
-            if (mesh->HasVertexColors(0))
-            {
-                aiColor4D color = mesh->mColors[0][i];
-                vertex.m_color = glm::vec4(color.r, color.g, color.b, color.a);
-            }
-            else
-            {
-                vertex.m_color = glm::vec4(1.0f); // Default color (white)
-            }
-
-            // Texture Coordinates (if available)
-            if (mesh->HasTextureCoords(0))
-            {
-                vertex.m_texCoords = glm::vec2(
-                    mesh->mTextureCoords[0][i].x,
-                    mesh->mTextureCoords[0][i].y);
-            }
-            else
-            {
-                vertex.m_texCoords = glm::vec2(0.0f); // Default UV (0,0)
-            }
-
-            _outMesh.m_vertices.push_back(vertex);
-        }
-
-        // Populate indices
-        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
-        {
-            aiFace face = mesh->mFaces[i];
-            for (unsigned int j = 0; j < face.mNumIndices; j++)
+        // Quantized positions, RGBA8 colors and half float UVs. The UI shows the resulting
+        // vertex size (see VertexPacker::GetPackedFormat()).
+        m_grassPackOptions.m_quantizePositions = true;
+        m_grassPackOptions.m_packColors = true;
+        m_grassPackOptions.m_texCoordPacking = enTexCoordPacking::HALF;
+
+        m_grassOptimizeReport = std::make_shared<MeshOptimizeReport>();
+        std::shared_ptr<MeshOptimizeReport> report = m_grassOptimizeReport;
+        m_grassLODsFuture = ThreadPool::GetShared().Submit([_grassFileName, report]() {
+            Mesh grassMesh;
+            if ( !MeshImporter::Load3DFile(_grassFileName, grassMesh, MeshImportOptions(), report.get()) )
             {
-                _outMesh.m_indices.push_back(face.mIndices[j]);
+                throw std::runtime_error("Could not load grass model " + _grassFileName);
             }
-        }
-
-        return true;
+            return MeshSimplifier::BuildLODChain(grassMesh);
+        });
     }
 }
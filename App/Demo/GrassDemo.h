@@ -1,15 +1,21 @@
 #ifndef GRASSDEMO_H
 #define GRASSDEMO_H
 
+#include <future>
+#include <memory>
+#include <string>
 #include <vector>
 #include <glm/glm.hpp>
 #include "DemoInterface.h"
+#include "MeshSimplifier.h"
+#include "MeshUploadService.h"
 
 namespace blithe
 {
     class CameraDecorator;
-    class Mesh;
+    class LODMeshObject;
     class MeshObject;
+    struct MeshOptimizeReport;
     class ShaderProgram;
     class Texture;
 
@@ -28,19 +34,32 @@ namespace blithe
 
     private:
         void SetupCube();
+        void CollectUploadedMeshes();
         void ProcessKeys(const UIData& _uiData, float _deltaTime);
         void ProcessMouseMove(const UIData& _uiData, float _deltaTime);
         std::vector<glm::mat4> GenerateRandomModelMatrices(int _count, float _maxTranslation, float _minScale, float _maxScale);
         std::vector<glm::mat4> GenerateGridModelMatrices(int _xCount, int _yCount, int _zCount, float _spacing);
 
         void SetupGrass(const std::string& _grassFileName);
-        bool Load3DFile(const std::string& _filename, Mesh& _outMesh);
+        void SetupGrassField(int _fieldSize);
 
         ShaderProgram* m_shader = nullptr;
         MeshObject* m_cube = nullptr;
-        MeshObject* m_grass = nullptr;
+        LODMeshObject* m_grass = nullptr;
         Texture* m_texture = nullptr;
         CameraDecorator* m_cameraDecorator = nullptr;
+        MeshUploadService* m_uploadService = nullptr;                              //!< Builds and streams in the meshes
+        std::shared_ptr<MeshUploadService::Ticket> m_cubeTicket;                   //!< Ticket for m_cube while it is loading
+        std::shared_ptr<MeshOptimizeReport> m_grassOptimizeReport;                 //!< Vertex cache stats of the grass mesh, filled in when it's built
+        std::future<std::vector<MeshLOD>> m_grassLODsFuture;                       //!< Grass LOD chain being built on a worker
+        std::vector<std::shared_ptr<MeshUploadService::Ticket>> m_grassLODTickets; //!< Tickets for the grass LODs while they are loading
+        std::vector<float> m_grassLODErrors;                                       //!< Error bounds of the grass LODs
+        std::string m_grassLoadError;                                              //!< Why the grass LODs failed to load, if they did
+        VertexPackOptions m_grassPackOptions;                                      //!< How the grass LODs' vertices are packed
+        int m_uploadKBPerFrame = 256;   //!< Value from UI control for the per-frame upload budget in KB
+        float m_lodPixelError = 1.0f;   //!< Value from UI control for the max screen-space error of the grass LODs
+        int m_grassFieldSize = 32;      //!< Value from UI control for the number of grass instances along each side of the field
+        bool m_cullWithBVH = false;     //!< Value from UI control for whether the grass is culled with a BVH rather than a linear scan
         float m_rotationSpeed = 0.5f;   //!< Value from UI control for the Rotation Speed
         bool m_useCustomAspect = false; //!< Value from UI control for whether the custom aspect ratio is used
         float m_customAspect = 1.0f;    //!< Value from UI control for the custom aspect ratio
@@ -2,7 +2,9 @@
 #include "ArcBallCameraDecorator.h"
 #include "BlithePath.h"
 #include "GeomHelpers.h"
+#include "GPUInstanceCuller.h"
 #include "MeshObject.h"
+#include "RayMeshPicker.h"
 #include "ShaderProgram.h"
 #include "Texture.h"
 #include "UIData.h"
@@ -11,7 +13,10 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include <stdio.h>
+#include <algorithm>
+#include <chrono>
 #include <ctime>
+#include <glm/gtc/matrix_transform.hpp>
 
 namespace blithe
 {
@@ -21,6 +26,7 @@ namespace blithe
     InstancedCubeDemo::~InstancedCubeDemo()
     {
         glDisable(GL_DEPTH_TEST);
+        delete m_gpuCuller;
         delete m_cube;
         delete m_shader;
         delete m_texture;
@@ -54,6 +60,11 @@ namespace blithe
         m_rotationAngleRad += deltaTimeS * m_rotationSpeed * 2.0f * pi; // Update based on speed
         m_rotationAngleRad = fmod(m_rotationAngleRad, 2.0f * pi); // Keep progress within a full rotation range
 
+        if ( m_animateInstances )
+        {
+            AnimateInstances();
+        }
+
         // create transformations (inspired from learnopengl.com)
         //glm::mat4 model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
         //model = glm::rotate(model, m_rotationAngleRad, glm::vec3(0.5f, 1.0f, 0.0f));
@@ -63,6 +74,8 @@ namespace blithe
         glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
         glm::mat4 viewProjection = projection * view; // I just mat mult here as opposed to per vertex in the shader
 
+        UpdateMarqueeSelection(_uiData, viewProjection);
+
         m_shader->Bind();
         m_shader->SetUniformMat4f("viewProjection", viewProjection);
 
@@ -70,7 +83,39 @@ namespace blithe
         m_texture->Bind(activeUnitOffset);
         m_shader->SetUniform1i("myTex", static_cast<int>(activeUnitOffset));
 
-        m_cube->Render();
+        if ( m_gpuCull )
+        {
+            // The GPU decides the instance count, so the draw is issued even if none are visible
+            m_gpuCuller->Cull(viewProjection, *m_cube, m_hiZCull);
+            m_cube->RenderIndirect(m_gpuCuller->GetIndirectBuffer());
+            m_shader->Unbind();
+
+            // This frame's depth is what the next frame culls against
+            if ( m_hiZCull )
+            {
+                m_gpuCuller->BuildHiZ(_uiData.m_viewPortDepthTexture, _uiData.m_viewportWidth, _uiData.m_viewPortHeight);
+            }
+
+            glDisable(GL_DEPTH_TEST);
+            return;
+        }
+
+        bool anyVisible = true;
+        if ( m_frustumCull )
+        {
+            const std::vector<glm::mat4>& frustumTransforms = m_culler.Cull(viewProjection, m_cullWithBVH);
+            const std::vector<glm::mat4>& visibleTransforms = m_occlusionCull ? CullOccluded(frustumTransforms, viewProjection) : frustumTransforms;
+            anyVisible = !visibleTransforms.empty();
+            if ( anyVisible )
+            {
+                m_cube->SetInstances(visibleTransforms);
+            }
+        }
+
+        if ( anyVisible )
+        {
+            m_cube->Render();
+        }
 
         m_shader->Unbind();
 
@@ -100,6 +145,134 @@ namespace blithe
             ImGui::EndDisabled();
         }
 
+        // Slider for the grid size. 46^3 is just under 100k cubes.
+        if ( ImGui::SliderInt("Grid Size", &m_gridSize, 1, 46) )
+        {
+            SetupGrid(m_gridSize);
+        }
+        ImGui::Text("Instances: %d", static_cast<int>(m_gridTransforms.size()));
+
+        // Combo for the instance transform encoding
+        const char* encodingNames[] = { "Mat4 (64 B)", "Affine 3x4 (48 B)", "Quat+Trans+Scale (32 B)", "Trans+Scale (16 B)" };
+        if ( ImGui::Combo("Instance Encoding", &m_instanceEncodingIdx, encodingNames, IM_ARRAYSIZE(encodingNames)) )
+        {
+            ApplyInstanceEncoding(static_cast<enInstanceEncoding>(m_instanceEncodingIdx));
+        }
+        ImGui::Text("Instance Data: %.1f KB", static_cast<float>(m_gridTransforms.size() * InstancePacker::GetStride(m_cube->GetInstanceEncoding())) / 1024.0f);
+
+        // Checkbox for culling on the GPU, against the frustum and the previous frame's depth.
+        // It writes plain mat4 instances, and takes over from the CPU culling.
+        bool gpuCullAvailable = GPUInstanceCuller::IsSupported() && m_cube->GetInstanceEncoding() == enInstanceEncoding::MAT4;
+        if ( !gpuCullAvailable )
+        {
+            ImGui::BeginDisabled();
+        }
+        if ( ImGui::Checkbox("GPU Culling", &m_gpuCull) )
+        {
+            if ( m_gpuCull )
+            {
+                if ( !m_gpuCuller )
+                {
+                    m_gpuCuller = new GPUInstanceCuller(GetExecutablePath() + "/Shaders");
+                }
+                m_gpuCuller->SetInstances(m_cubeBounds, m_instanceTransforms);
+                m_frustumCull = false;
+            }
+            // The culled instances are written over the mesh's, so put them all back
+            m_cube->SetInstances(m_instanceTransforms);
+        }
+        if ( !gpuCullAvailable )
+        {
+            ImGui::EndDisabled();
+            ImGui::Text("%s", GPUInstanceCuller::IsSupported() ? "GPU culling needs the Mat4 encoding" : "GPU culling needs OpenGL 4.3");
+        }
+        if ( m_gpuCull )
+        {
+            ImGui::Checkbox("Hi-Z Occlusion Culling", &m_hiZCull);
+            ImGui::Text("Visible Instances: %d", static_cast<int>(m_gpuCuller->GetNumVisible()));
+            ImGui::BeginDisabled();
+        }
+
+        // Checkbox for only uploading the instances in the frustum. Turning it off puts all of
+        // them back.
+        if ( ImGui::Checkbox("Frustum Culling", &m_frustumCull) )
+        {
+            if ( m_frustumCull )
+            {
+                m_culler.SetInstances(m_cubeBounds, m_instanceTransforms);
+            }
+            else
+            {
+                m_cube->SetInstances(m_instanceTransforms);
+            }
+        }
+        if ( m_frustumCull )
+        {
+            ImGui::Checkbox("Cull With BVH", &m_cullWithBVH);
+            ImGui::Text("Visible Instances: %d", static_cast<int>(m_culler.GetNumVisible()));
+            if ( m_cullWithBVH )
+            {
+                ImGui::Text("BVH nodes visited: %d", static_cast<int>(m_culler.GetNumNodesVisited()));
+            }
+
+            // Checkbox for also culling the instances hidden behind the nearest ones
+            ImGui::Checkbox("Occlusion Culling", &m_occlusionCull);
+            if ( m_occlusionCull )
+            {
+                ImGui::SliderInt("Occluders", &m_numOccluders, 1, 256);
+                ImGui::Text("Occluded Instances: %d", static_cast<int>(m_numOccluded));
+            }
+        }
+        if ( m_gpuCull )
+        {
+            ImGui::EndDisabled();
+        }
+
+        // Checkbox for selecting the instances in a marquee dragged out with the right mouse
+        // button. The culler's boxes are kept up to date while it's on.
+        if ( ImGui::Checkbox("Marquee Select (Right Drag)", &m_marqueeSelect) )
+        {
+            m_culler.SetInstances(m_cubeBounds, m_instanceTransforms);
+            m_selectedInstances.clear();
+        }
+        if ( m_marqueeSelect )
+        {
+            ImGui::Checkbox("Select With BVH", &m_selectWithBVH);
+            ImGui::Text("Selected Instances: %d", static_cast<int>(m_selectedInstances.size()));
+            ImGui::Text("Selection time: %.3f ms", m_selectTimeMs);
+        }
+
+        // Checkbox for testing the boxes that straddle the frustum or marquee edges again as
+        // the rotated cubes themselves
+        if ( m_frustumCull || m_marqueeSelect )
+        {
+            if ( ImGui::Checkbox("Refine With OBBs", &m_refineWithOBBs) )
+            {
+                m_culler.SetRefineWithOBBs(m_refineWithOBBs);
+            }
+        }
+        if ( m_marqueeDragging )
+        {
+            ImVec2 start(m_viewPortTopLeft.x + m_marqueeStart.x, m_viewPortTopLeft.y + m_marqueeStart.y);
+            ImVec2 end(m_viewPortTopLeft.x + m_marqueeEnd.x, m_viewPortTopLeft.y + m_marqueeEnd.y);
+            ImGui::GetForegroundDrawList()->AddRectFilled(start, end, IM_COL32(80, 160, 255, 40));
+            ImGui::GetForegroundDrawList()->AddRect(start, end, IM_COL32(80, 160, 255, 255));
+        }
+
+        // Checkbox for animating the instances every frame
+        ImGui::Checkbox("Animate Instances", &m_animateInstances);
+
+        if (!m_animateInstances) {
+            ImGui::BeginDisabled();
+        }
+
+        // Slider for the fraction of instances that get updated each frame
+        ImGui::SliderFloat("Dirty Fraction", &m_dirtyFraction, 0.0f, 1.0f, "%.2f");
+
+        if (!m_animateInstances) {
+            ImGui::EndDisabled();
+        }
+
         ImGui::End();
     }
 
@@ -121,9 +294,141 @@ namespace blithe
         Mesh mesh = GeomHelpers::CreateCuboid(sides, colors);
 
         m_cube = new MeshObject(mesh);
+        m_cubeBounds = GeomHelpers::CalcLocalAABB(mesh);
+        m_cubeMesh = mesh;
+
+        SetupGrid(m_gridSize);
+    }
+
+    ///
+    /// \brief Lays the cube instances out in a cubic grid with _gridSize cubes along each side.
+    ///
+    /// \param _gridSize - Number of cubes along each side of the grid
+    ///
+    void InstancedCubeDemo::SetupGrid(int _gridSize)
+    {
+        m_gridTransforms = GenerateGridModelMatrices(_gridSize, _gridSize, _gridSize, 2.0);
+        m_instanceTransforms = m_gridTransforms;
+        m_cube->SetInstances(m_instanceTransforms);
+        m_culler.SetInstances(m_cubeBounds, m_instanceTransforms);
+        if ( m_gpuCuller )
+        {
+            m_gpuCuller->SetInstances(m_cubeBounds, m_instanceTransforms);
+        }
+    }
+
+    ///
+    /// \brief Switches the cube instances over to _encoding, along with the shader that decodes
+    ///        it.
+    ///
+    /// \param _encoding - Instance encoding
+    ///
+    void InstancedCubeDemo::ApplyInstanceEncoding(enInstanceEncoding _encoding)
+    {
+        delete m_shader;
+        std::string exePath = GetExecutablePath();
+        m_shader = new ShaderProgram(exePath + "/Shaders/" + InstancePacker::GetVertexShaderName(_encoding), exePath + "/Shaders/Triangle.frag");
 
-        std::vector<glm::mat4> modelTransforms = GenerateGridModelMatrices(10, 10, 10, 2.0);
-        m_cube->SetInstances(modelTransforms);
+        // GPU culling only writes mat4 instances
+        if ( _encoding != enInstanceEncoding::MAT4 )
+        {
+            m_gpuCull = false;
+        }
+
+        m_cube->SetInstanceEncoding(_encoding);
+        m_cube->SetInstances(m_instanceTransforms);
+    }
+
+    ///
+    /// \brief Spins and bobs the first m_dirtyFraction of the instances and writes just those
+    ///        to the instance buffer. With culling on, they go to the culler instead (which on
+    ///        the CPU refits its BVH rather than rebuilding it), and the visible instances are
+    ///        uploaded after culling. With marquee selection on, the CPU culler gets them too.
+    ///
+    void InstancedCubeDemo::AnimateInstances()
+    {
+        size_t numInstances = m_gridTransforms.size();
+        size_t numDirty = static_cast<size_t>(m_dirtyFraction * static_cast<float>(numInstances));
+        if ( numDirty == 0 )
+        {
+            return;
+        }
+
+        for ( size_t i = 0; i < numDirty; i++ )
+        {
+            float phase = m_rotationAngleRad + 0.05f * static_cast<float>(i);
+            float cosPhase = std::cos(phase);
+            float sinPhase = std::sin(phase);
+
+            // The grid transforms are pure translations, so we can write the rotation about the
+            // Y axis straight into the first three columns.
+            glm::mat4& model = m_instanceTransforms[i];
+            model = m_gridTransforms[i];
+            model[0] = glm::vec4(cosPhase, 0.0f, -sinPhase, 0.0f);
+            model[2] = glm::vec4(sinPhase, 0.0f, cosPhase, 0.0f);
+            model[3].y += 0.25f * sinPhase;
+        }
+
+        // The marquee selects from the CPU culler's boxes, so they're kept up to date whichever
+        // way the instances are culled
+        if ( m_frustumCull || m_marqueeSelect )
+        {
+            m_culler.UpdateInstances(0, m_instanceTransforms.data(), numDirty);
+        }
+        if ( m_gpuCull )
+        {
+            m_gpuCuller->UpdateInstances(0, m_instanceTransforms.data(), numDirty);
+            return;
+        }
+        if ( m_frustumCull )
+        {
+            return;
+        }
+
+        if ( numDirty == numInstances )
+        {
+            m_cube->SetInstances(m_instanceTransforms);
+        }
+        else
+        {
+            m_cube->UpdateInstances(0, m_instanceTransforms.data(), numDirty);
+        }
+    }
+
+    ///
+    /// \brief Rasterizes the m_numOccluders visible cubes nearest the camera into the occlusion
+    ///        buffer and culls the visible instances hidden behind them. The occluders are
+    ///        shrunk a little so that a cube never hides itself.
+    ///
+    /// \param _transforms     - Transforms of the instances in the frustum
+    /// \param _viewProjection - View-projection matrix of the camera
+    ///
+    /// \return Transforms of the instances that aren't occluded
+    ///
+    const std::vector<glm::mat4>& InstancedCubeDemo::CullOccluded(const std::vector<glm::mat4>& _transforms, const glm::mat4& _viewProjection)
+    {
+        glm::vec3 cameraPos = m_cameraDecorator->GetCamera().GetPosition();
+        auto distanceSq = [&cameraPos](const glm::mat4& _transform)
+        {
+            glm::vec3 offset = glm::vec3(_transform[3]) - cameraPos;
+            return glm::dot(offset, offset);
+        };
+
+        m_occluderTransforms = _transforms;
+        size_t numOccluders = std::min(static_cast<size_t>(m_numOccluders), m_occluderTransforms.size());
+        std::partial_sort(m_occluderTransforms.begin(), m_occluderTransforms.begin() + static_cast<std::ptrdiff_t>(numOccluders), m_occluderTransforms.end(),
+                          [&distanceSq](const glm::mat4& _a, const glm::mat4& _b) { return distanceSq(_a) < distanceSq(_b); });
+
+        glm::mat4 shrink = glm::scale(glm::mat4(1.0f), glm::vec3(0.9f));
+        m_occlusionBuffer.Begin(_viewProjection);
+        for ( size_t i = 0; i < numOccluders; i++ )
+        {
+            m_occlusionBuffer.AddOccluder(m_cubeMesh, m_occluderTransforms[i] * shrink);
+        }
+        m_occlusionBuffer.Rasterize();
+
+        m_numOccluded = m_occlusionBuffer.CullInstances(m_cubeBounds, _transforms, m_drawTransforms);
+        return m_drawTransforms;
     }
 
     void InstancedCubeDemo::ProcessKeys(const UIData& _uiData, float _deltaTime)
@@ -165,6 +470,34 @@ namespace blithe
         }
     }
 
+    ///
+    /// \brief While the right mouse button is dragged with m_marqueeSelect on, selects the
+    ///        instances whose boxes show in the marquee between the drag's start and the mouse.
+    ///        The selection is redone every frame of the drag, so it follows the mouse and the
+    ///        animation, and stays once the button is released.
+    ///
+    /// \param _uiData         - Mouse drag info and the viewport size
+    /// \param _viewProjection - View-projection matrix of the camera
+    ///
+    void InstancedCubeDemo::UpdateMarqueeSelection(const UIData& _uiData, const glm::mat4& _viewProjection)
+    {
+        const MouseButtonDragInfo& dragInfo = _uiData.m_mouseInput.GetDragInfo(enMouseButton::Right);
+        m_marqueeDragging = m_marqueeSelect && dragInfo.m_dragging && _uiData.m_viewportWidth > 0 && _uiData.m_viewPortHeight > 0;
+        if ( !m_marqueeDragging )
+        {
+            return;
+        }
+
+        m_marqueeStart = dragInfo.m_dragStart;
+        m_marqueeEnd = dragInfo.m_lastPos;
+        m_viewPortTopLeft = glm::vec2(_uiData.m_viewPortTopLeftX, _uiData.m_viewPortTopLeftY);
+
+        auto selectStart = std::chrono::steady_clock::now();
+        RayMeshPicker picker(_uiData.m_viewportWidth, _uiData.m_viewPortHeight, glm::inverse(_viewProjection));
+        m_selectedInstances = picker.SelectInstances(m_marqueeStart, m_marqueeEnd, m_culler, m_selectWithBVH);
+        m_selectTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - selectStart).count();
+    }
+
     ///
     /// \brief Generate a vector of model matrices with random transformations
     ///        (source: chatgippity)
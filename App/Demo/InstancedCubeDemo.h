@@ -3,11 +3,17 @@
 
 #include <vector>
 #include <glm/glm.hpp>
+#include "AABB.h"
 #include "DemoInterface.h"
+#include "InstanceCuller.h"
+#include "InstanceEncoding.h"
+#include "Mesh.h"
+#include "OcclusionBuffer.h"
 
 namespace blithe
 {
     class CameraDecorator;
+    class GPUInstanceCuller;
     class MeshObject;
     class ShaderProgram;
     class Texture;
@@ -27,8 +33,13 @@ namespace blithe
 
     private:
         void SetupCube();
+        void SetupGrid(int _gridSize);
+        void AnimateInstances();
+        const std::vector<glm::mat4>& CullOccluded(const std::vector<glm::mat4>& _transforms, const glm::mat4& _viewProjection);
+        void ApplyInstanceEncoding(enInstanceEncoding _encoding);
         void ProcessKeys(const UIData& _uiData, float _deltaTime);
         void ProcessMouseMove(const UIData& _uiData, float _deltaTime);
+        void UpdateMarqueeSelection(const UIData& _uiData, const glm::mat4& _viewProjection);
         std::vector<glm::mat4> GenerateRandomModelMatrices(int _count, float _maxTranslation, float _minScale, float _maxScale);
         std::vector<glm::mat4> GenerateGridModelMatrices(int _xCount, int _yCount, int _zCount, float _spacing);
 
@@ -36,9 +47,39 @@ namespace blithe
         MeshObject* m_cube = nullptr;
         Texture* m_texture = nullptr;
         CameraDecorator* m_cameraDecorator = nullptr;
+        GPUInstanceCuller* m_gpuCuller = nullptr;
         float m_rotationSpeed = 0.5f;   //!< Value from UI control for the Rotation Speed
         bool m_useCustomAspect = false; //!< Value from UI control for whether the custom aspect ratio is used
         float m_customAspect = 1.0f;    //!< Value from UI control for the custom aspect ratio
+        bool m_animateInstances = true; //!< Value from UI control for whether the instances are animated every frame
+        float m_dirtyFraction = 1.0f;   //!< Value from UI control for the fraction of instances updated every frame
+        int m_gridSize = 10;            //!< Value from UI control for the number of cubes along each side of the grid
+        int m_instanceEncodingIdx = 0;  //!< Value from UI control for the enInstanceEncoding of the instances
+        bool m_frustumCull = false;     //!< Value from UI control for whether only the instances in the frustum are uploaded
+        bool m_cullWithBVH = false;     //!< Value from UI control for whether the culling walks a BVH, refit as the instances move
+        bool m_occlusionCull = false;   //!< Value from UI control for whether instances hidden behind the nearest ones are culled too
+        int m_numOccluders = 64;        //!< Value from UI control for the number of nearest visible cubes rasterized as occluders
+        bool m_gpuCull = false;         //!< Value from UI control for whether the instances are culled on the GPU instead
+        bool m_hiZCull = true;          //!< Value from UI control for whether the GPU culling tests the previous frame's depth too
+        bool m_marqueeSelect = false;   //!< Value from UI control for whether dragging with the right mouse button selects the instances in a marquee
+        bool m_selectWithBVH = true;    //!< Value from UI control for whether the marquee selection walks the culler's BVH
+        bool m_refineWithOBBs = false;  //!< Value from UI control for whether the culler tests the boxes straddling a plane again as OBBs
+
+        std::vector<glm::mat4> m_gridTransforms;       //!< Rest transforms of the cubes in the grid
+        std::vector<glm::mat4> m_instanceTransforms;   //!< Animated transforms, reused every frame
+        InstanceCuller m_culler;                       //!< Picks out the instances in the frustum when m_frustumCull is set, and in the marquee when m_marqueeSelect is set
+        AABB m_cubeBounds;                             //!< Bounding box of the cube mesh
+        Mesh m_cubeMesh;                               //!< The cube geometry, rasterized as an occluder
+        OcclusionBuffer m_occlusionBuffer;             //!< Occluder depths when m_occlusionCull is set
+        std::vector<glm::mat4> m_occluderTransforms;   //!< Scratch space for picking the occluders
+        std::vector<glm::mat4> m_drawTransforms;       //!< Transforms of the visible instances that aren't occluded
+        size_t m_numOccluded = 0;                      //!< Instances culled by the occlusion buffer last frame
+        std::vector<uint32_t> m_selectedInstances;     //!< Instances in the last marquee
+        glm::vec2 m_marqueeStart = glm::vec2(0.0f);    //!< Corner of the marquee where the drag started, relative to the viewport
+        glm::vec2 m_marqueeEnd = glm::vec2(0.0f);      //!< Corner of the marquee under the mouse, relative to the viewport
+        glm::vec2 m_viewPortTopLeft = glm::vec2(0.0f); //!< Screen position of the viewport's top left corner, for drawing the marquee
+        bool m_marqueeDragging = false;                //!< Whether the marquee is being dragged out this frame
+        double m_selectTimeMs = 0.0;                   //!< Time the last marquee selection took
 
         float m_rotationAngleRad = 0.0f; // Cumulative rotation progress in radians
     };
@@ -3,7 +3,9 @@
 #include "BlithePath.h"
 #include "BlitheShared.h"
 #include "GeomHelpers.h"
-#include "MeshView.h"
+#include "MeshOptimizer.h"
+#include "MeshSoA.h"
+#include "MeshSoAView.h"
 #include "TriBSPTree.h"
 #include "MeshObject.h"
 #include "ShaderProgram.h"
@@ -31,7 +33,8 @@ namespace blithe
     SimpleBSPDemo::~SimpleBSPDemo()
     {
         glDisable(GL_DEPTH_TEST);
-        ClearAllBSPMeshObjects();
+        ClearAllBSPMeshRecords();
+        delete m_bspArena;
         delete m_shader;
         delete m_texture;
         delete m_cameraDecorator;
@@ -50,6 +53,8 @@ namespace blithe
         SetupTorus();
         SetupCubes();
         SetupBSPTree();
+
+        m_bspArena = new GLMeshArena(3 * m_bspNumTris, 3 * m_bspNumTris);
     }
 
     void SimpleBSPDemo::OnRender(double _deltaTimeS, const UIData& _uiData)
@@ -110,14 +115,12 @@ namespace blithe
         }
         else
         {
-            for ( size_t objIdx = 0; objIdx < m_bspMeshObjects.size(); objIdx++ )
-            {
-                std::vector<MeshObject*>& coplanarMeshObjects = m_bspMeshObjects[objIdx];
-                for ( MeshObject* object : coplanarMeshObjects )
-                {
-                    object->Render();
-                }
-            }
+            // All the triangles live in the one arena, one record per coplanar group, so this is
+            // a single VAO bind and a single multi-draw (rather than a VAO bind and draw per
+            // triangle).
+            m_bspArena->Bind();
+            m_bspArena->DrawMulti(m_bspMeshRecords);
+            m_bspArena->Unbind();
         }
 
         glDisable(GL_BLEND);
@@ -159,7 +162,8 @@ namespace blithe
     {
         glm::mat4 modelTransform(1.0f);
         modelTransform = glm::rotate(modelTransform, glm::pi<float>()*0.5f, {1,0,0});
-        Mesh torusMesh = CreateTorus(8, 2, 8, 8, {0.1, 0.5, 0.9, 0.1}, modelTransform);
+        Mesh torusMesh = GeomHelpers::CreateTorus(8, 2, 8, 8, {0.1, 0.5, 0.9, 0.1}, modelTransform);
+        MeshOptimizer::Optimize(torusMesh); // CreateTorus() emits ring by ring strips
         m_torus = new MeshObject(torusMesh);
         m_torus->SetInstances({glm::mat4(1.0f)});
     }
@@ -211,27 +215,27 @@ namespace blithe
         size_t origNumTris = 0;
         for ( size_t i = 0; i < m_cubeMeshes.size(); i++ )
         {
-            Mesh mesh = m_cubeMeshes[i];
-            MeshView meshView(mesh);
+            // The tree only reads the positions of a triangle until it needs to store or split it
+            MeshSoA meshSoA = MeshSoA::FromMesh(m_cubeMeshes[i]);
+            MeshSoAView meshView(meshSoA);
             size_t numTris = meshView.GetNumTriangles();
             std::vector<size_t> randomizedTriIndices = GetShuffledIndices(numTris);
             for ( size_t triIdx : randomizedTriIndices )
             {
-                Tri tri = meshView.GetTriangle(triIdx);
-                m_bspTree->AddTriangle(tri);
+                m_bspTree->AddTriangle(meshView, triIdx);
             }
             origNumTris += numTris;
         }
 
         if ( m_torus )
         {
-            MeshView meshView(m_torus->GetMesh());
+            MeshSoA meshSoA = MeshSoA::FromMesh(m_torus->GetMesh());
+            MeshSoAView meshView(meshSoA);
             size_t numTris = meshView.GetNumTriangles();
             std::vector<size_t> randomizedTriIndices = GetShuffledIndices(numTris);
             for ( size_t triIdx : randomizedTriIndices )
             {
-                Tri tri = meshView.GetTriangle(triIdx);
-                m_bspTree->AddTriangle(tri);
+                m_bspTree->AddTriangle(meshView, triIdx);
             }
             origNumTris += numTris;
         }
@@ -259,31 +263,13 @@ namespace blithe
         {
             m_prevView = _camera.GetViewMatrix();
 
-            ClearAllBSPMeshObjects();
+            ClearAllBSPMeshRecords();
 
             // Traverse tree
             std::vector<std::vector<Tri>> trisList;
             TriBSPTree::TraverseRecursively(m_bspTree, _camera.GetPosition(), trisList);
 
-            for ( size_t i = 0; i < trisList.size(); i++ )
-            {
-                const std::vector<Tri>& tris = trisList[i];
-                std::vector<MeshObject*> meshObjects;
-                for ( const Tri& tri : tris )
-                {
-                    Mesh mesh;
-                    mesh.m_vertices.push_back(tri.m_v0);
-                    mesh.m_vertices.push_back(tri.m_v1);
-                    mesh.m_vertices.push_back(tri.m_v2);
-                    mesh.m_indices.push_back(0);
-                    mesh.m_indices.push_back(1);
-                    mesh.m_indices.push_back(2);
-                    MeshObject* object = new MeshObject(mesh);
-                    object->SetInstances({glm::mat4(1.0f)});
-                    meshObjects.push_back(object);
-                }
-                m_bspMeshObjects.push_back(meshObjects);
-            }
+            AddBSPTrisToArena(trisList);
 
             m_dbgVarsValid = false;
         }
@@ -309,7 +295,7 @@ namespace blithe
         {
             m_prevView = _camera.GetViewMatrix();
 
-            ClearAllBSPMeshObjects();
+            ClearAllBSPMeshRecords();
 
             m_traversing = true;
             m_nodeStack = std::stack<TriBSPTreeStackEntry>();
@@ -326,44 +312,47 @@ namespace blithe
                                                    24);
             m_traversing = !m_nodeStack.empty();
 
-            for ( size_t i = 0; i < trisList.size(); i++ )
-            {
-                const std::vector<Tri>& coplanarTris = trisList[i];
-                std::vector<MeshObject*> coplanarMeshObjects;
-                for ( const Tri& tri : coplanarTris )
-                {
-                    Mesh mesh;
-                    mesh.m_vertices.push_back(tri.m_v0);
-                    mesh.m_vertices.push_back(tri.m_v1);
-                    mesh.m_vertices.push_back(tri.m_v2);
-                    mesh.m_indices.push_back(0);
-                    mesh.m_indices.push_back(1);
-                    mesh.m_indices.push_back(2);
-                    MeshObject* object = new MeshObject(mesh);
-                    object->SetInstances({glm::mat4(1.0f)});
-                    coplanarMeshObjects.push_back(object);
-                }
-                m_bspMeshObjects.push_back(coplanarMeshObjects);
-            }
+            AddBSPTrisToArena(trisList);
 
             m_dbgVarsValid = false;
         }
     }
 
     ///
-    /// \brief Clears the list of all bsp mesh objects after deleting them.
+    /// \brief Clears the list of all bsp triangle records after releasing them from the arena.
     ///
-    void SimpleBSPDemo::ClearAllBSPMeshObjects()
+    void SimpleBSPDemo::ClearAllBSPMeshRecords()
     {
-        for ( size_t i = 0; i < m_bspMeshObjects.size(); i++ )
+        if ( m_bspArena )
         {
-            std::vector<MeshObject*>& coplanarMeshObjects = m_bspMeshObjects[i];
-            for ( MeshObject* object : coplanarMeshObjects )
+            m_bspArena->Clear();
+        }
+        m_bspMeshRecords.clear();
+    }
+
+    ///
+    /// \brief Adds each of the traversed triangles to the arena, keeping them grouped by their
+    ///        coplanar lists so they can be drawn back to front.
+    ///
+    /// \param _trisList - List of list of coplanar triangles obtained from bsp traversal
+    ///
+    void SimpleBSPDemo::AddBSPTrisToArena(const std::vector<std::vector<Tri>>& _trisList)
+    {
+        Mesh mesh;
+        m_bspMeshRecords.reserve(m_bspMeshRecords.size() + _trisList.size());
+        for ( const std::vector<Tri>& coplanarTris : _trisList )
+        {
+            // One mesh (and so one arena upload) per coplanar group, keeping the traversal order
+            mesh.m_vertices.clear();
+            mesh.m_indices.clear();
+            for ( const Tri& tri : coplanarTris )
             {
-                DeleteAndNull(object);
+                unsigned int firstIdx = static_cast<unsigned int>(mesh.m_vertices.size());
+                mesh.m_vertices.insert(mesh.m_vertices.end(), {tri.m_v0, tri.m_v1, tri.m_v2});
+                mesh.m_indices.insert(mesh.m_indices.end(), {firstIdx, firstIdx + 1, firstIdx + 2});
             }
+            m_bspMeshRecords.push_back(m_bspArena->Add(mesh));
         }
-        m_bspMeshObjects.clear();
     }
 
     ///
@@ -374,7 +363,7 @@ namespace blithe
         if ( !m_dbgVarsValid )
         {
             m_dbgVarsValid = true;
-            m_dbgBackToFrontGradient = InterpolateColors({1,0,0,1.0},{1,1,1,0.1},m_bspMeshObjects.size());
+            m_dbgBackToFrontGradient = InterpolateColors({1,0,0,1.0},{1,1,1,0.1},m_bspMeshRecords.size());
             m_maxDbgTrisPerRenderLoop = 0;
             m_dbgTimeAccumulatorS = 0;
         }
@@ -387,7 +376,7 @@ namespace blithe
     ///
     void SimpleBSPDemo::DrawDbgTris(float _deltaTimeS)
     {
-        ASSERT(m_dbgBackToFrontGradient.size() == m_bspMeshObjects.size(), "Gradient for debugging back to front polygon ordering is not populated correctly. Expected size " << m_bspMeshObjects.size() << ", got " << m_dbgBackToFrontGradient.size());
+        ASSERT(m_dbgBackToFrontGradient.size() == m_bspMeshRecords.size(), "Gradient for debugging back to front polygon ordering is not populated correctly. Expected size " << m_bspMeshRecords.size() << ", got " << m_dbgBackToFrontGradient.size());
 
         m_dbgTimeAccumulatorS += _deltaTimeS;
         if ( m_dbgTimeAccumulatorS >= 0.01 )
@@ -396,20 +385,19 @@ namespace blithe
             m_maxDbgTrisPerRenderLoop += 1;
         }
 
-        size_t numTrisSoFar = 0;
-        bool done = false;
-        for ( size_t objIdx = 0; objIdx < m_bspMeshObjects.size() && !done; objIdx++ )
+        size_t numTrisLeft = m_maxDbgTrisPerRenderLoop;
+        m_bspArena->Bind();
+        for ( size_t objIdx = 0; objIdx < m_bspMeshRecords.size() && numTrisLeft > 0; objIdx++ )
         {
-            std::vector<MeshObject*>& coplanarMeshObjects = m_bspMeshObjects[objIdx];
+            // Draw only the first numTrisLeft tris of the coplanar group
+            GLMeshArena::MeshRecord record = m_bspMeshRecords[objIdx];
+            size_t numTris = std::min(static_cast<size_t>(record.m_count / 3), numTrisLeft);
+            record.m_count = static_cast<GLsizei>(numTris * 3);
+            numTrisLeft -= numTris;
             m_shader->SetUniformVec4f("colorOverride", m_dbgBackToFrontGradient[objIdx]);
-            for ( size_t idx = 0; idx < coplanarMeshObjects.size() && !done; idx++ )
-            {
-                ++numTrisSoFar;
-                done = (numTrisSoFar >= m_maxDbgTrisPerRenderLoop);
-                MeshObject* object = coplanarMeshObjects[idx];
-                object->Render();
-            }
+            m_bspArena->Draw(record);
         }
+        m_bspArena->Unbind();
     }
 
 
@@ -500,74 +488,6 @@ namespace blithe
         return modelMatrices;
     }
 
-    ///
-    /// \brief Creates a torus mesh. (source: chatgippity)
-    ///
-    /// \param _majorRadius    - Major radius R, the distance from the center of the torus to the center of the tube
-    /// \param _minorRadius    - Minor radius r, the radius of the tube itself
-    /// \param _numSides       - the number of subdivisions around the torus's central ring
-    /// \param _numRings       - the number of subdivisions around the torus's tube
-    /// \param _color          - Color to use for the vertices
-    /// \param _modelTransform - (optional) Transform to apply to all vertex positions.
-    ///                          Defaults to identity.
-    ///
-    /// \return Torus mesh
-    ///
-    Mesh SimpleBSPDemo::CreateTorus(float _majorRadius, float _minorRadius,
-                                    int _numSides, int _numRings,
-                                    const glm::vec4& _color,
-                                    const glm::mat4& _modelTransform/* = glm::mat4(1.0f)*/)
-    {
-        Mesh torusMesh;
-
-        float sideStep = glm::two_pi<float>() / static_cast<float>(_numSides);  // Angle step around minor radius
-        float ringStep = glm::two_pi<float>() / static_cast<float>(_numRings);  // Angle step around major radius
-
-        // Generate vertices
-        for (int ring = 0; ring <= _numRings; ++ring)
-        {
-            float phi = static_cast<float>(ring) * ringStep;  // Angle along major radius
-            glm::vec3 ringCenter = glm::vec3(_majorRadius * glm::cos(phi), _majorRadius * glm::sin(phi), 0.0f);
-
-            for (int side = 0; side <= _numSides; ++side)
-            {
-                float theta = static_cast<float>(side) * sideStep;  // Angle along tube
-                glm::vec3 position = ringCenter +
-                                     glm::vec3(_minorRadius * glm::cos(theta) * glm::cos(phi),
-                                               _minorRadius * glm::cos(theta) * glm::sin(phi),
-                                               _minorRadius * glm::sin(theta));
-
-                // Texture coordinates for wrapping
-                glm::vec2 texCoords = glm::vec2(static_cast<float>(ring) / static_cast<float>(_numRings),
-                                                static_cast<float>(side) / static_cast<float>(_numSides));
-
-                // Add vertex to list
-                position = _modelTransform * glm::vec4(position, 1.0f);
-                torusMesh.m_vertices.push_back({ position, _color, texCoords });
-            }
-        }
-
-        // Generate indices for triangle strips
-        for (int ring = 0; ring < _numRings; ++ring)
-        {
-            for (int side = 0; side < _numSides; ++side)
-            {
-                unsigned int current = static_cast<unsigned int>(ring * (_numSides + 1) + side);
-                unsigned int next = current + static_cast<unsigned int>(_numSides) + 1;
-
-                torusMesh.m_indices.push_back(current);
-                torusMesh.m_indices.push_back(next);
-                torusMesh.m_indices.push_back(current + 1);
-
-                torusMesh.m_indices.push_back(current + 1);
-                torusMesh.m_indices.push_back(next);
-                torusMesh.m_indices.push_back(next + 1);
-            }
-        }
-
-        return torusMesh;
-    }
-
     ///
     /// \brief Interpolates between two glm::vec4 colors over a specified number of steps.
     ///
@@ -5,6 +5,7 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include "DemoInterface.h"
+#include "GLMeshArena.h"
 #include "Mesh.h"
 #include "TriBSPTree.h"
 
@@ -36,15 +37,13 @@ namespace blithe
         void SetupBSPTree();
         void UpdateBSPTreeFull(const Camera& _camera);
         void UpdateBSPTreeIterative(const Camera& _camera);
-        void ClearAllBSPMeshObjects();
+        void ClearAllBSPMeshRecords();
+        void AddBSPTrisToArena(const std::vector<std::vector<Tri>>& _trisList);
         void ReInitDbgVars();
         void DrawDbgTris(float _deltaTimeS);
         void ProcessKeys(const UIData& _uiData, float _deltaTime);
         void ProcessMouseMove(const UIData& _uiData, float _deltaTime);
         std::vector<glm::mat4> GenerateGridModelMatrices(int _xCount, int _yCount, int _zCount, float _spacing);
-        static Mesh CreateTorus(float _majorRadius, float _minorRadius,
-                                int _numSides, int _numRings, const glm::vec4& _color,
-                                const glm::mat4& _modelTransform = glm::mat4(1.0f));
 
         std::vector<glm::vec4> InterpolateColors(const glm::vec4& _startColor, const glm::vec4& _endColor, size_t _steps);
         std::vector<size_t> GetShuffledIndices(size_t _numItems);
@@ -57,7 +56,8 @@ namespace blithe
         MeshObject* m_torus = nullptr;     //!< Torus mesh object (we make a renderable object so we can wireframe it)
 
         TriBSPTree* m_bspTree = nullptr; //!< BSP Tree. All mesh tris are added to it on Setup. It is traversed in the Render loop.
-        std::vector<std::vector<MeshObject*>> m_bspMeshObjects; //!< List of list of coplanar mesh objects obtained from bsp traversal, so they should be in back to front order.
+        GLMeshArena* m_bspArena = nullptr; //!< Shared buffers holding all the triangles obtained from bsp traversal
+        std::vector<GLMeshArena::MeshRecord> m_bspMeshRecords; //!< Records in m_bspArena of the coplanar triangle groups obtained from bsp traversal, so they should be in back to front order.
         size_t m_bspNumTris = 0; //!< Num tris in bsp tree
         glm::mat4 m_prevView = glm::mat4(0.0f); //!< View matrix "key" to cache the traversal
         bool m_traversing = false; //!< Whether we're currently doing the iterative traverse
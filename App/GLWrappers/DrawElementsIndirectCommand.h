@@ -0,0 +1,21 @@
+#ifndef DRAWELEMENTSINDIRECTCOMMAND_H
+#define DRAWELEMENTSINDIRECTCOMMAND_H
+
+#include <glad/glad.h>
+
+namespace blithe
+{
+    ///
+    /// \brief Layout glDrawElementsIndirect() reads a draw from (GL 4.0)
+    ///
+    struct DrawElementsIndirectCommand
+    {
+        GLuint m_count;         //!< Number of indices
+        GLuint m_instanceCount; //!< Number of instances
+        GLuint m_firstIndex;    //!< Offset (in indices) of the first index
+        GLint m_baseVertex;     //!< Added to every index at draw time
+        GLuint m_baseInstance;  //!< First instance
+    };
+}
+
+#endif // DRAWELEMENTSINDIRECTCOMMAND_H
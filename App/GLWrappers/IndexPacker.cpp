@@ -0,0 +1,150 @@
+#include "IndexPacker.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "BlitheAssert.h"
+
+namespace blithe
+{
+    namespace
+    {
+        const size_t MAX_16BIT_VERTICES = 65536;  //!< Number of vertices addressable by 16 bit indices
+        const size_t MIN_TRIS_PER_RANGE = 256;    //!< Fewer than this per split range isn't worth the extra draw calls
+    }
+
+    ///
+    /// \brief Chooses the narrowest index type that can address _numVertices vertices.
+    ///
+    /// \param _numVertices - Number of vertices in the mesh
+    ///
+    /// \return GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    ///
+    GLenum IndexPacker::ChooseIndexType(size_t _numVertices)
+    {
+        return _numVertices <= MAX_16BIT_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
+    ///
+    /// \brief Gets the size in bytes of one index of _indexType.
+    ///
+    /// \param _indexType - GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    ///
+    /// \return Size of an index in bytes
+    ///
+    size_t IndexPacker::GetIndexSize(GLenum _indexType)
+    {
+        ASSERT(_indexType == GL_UNSIGNED_SHORT || _indexType == GL_UNSIGNED_INT, "Unsupported index type " << _indexType);
+        return _indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    ///
+    /// \brief Packs _indices into the narrowest index type that works for them.
+    ///
+    /// \param _indices     - Triangle indices into the mesh's vertices
+    /// \param _numVertices - Number of vertices in the mesh
+    /// \param _allowSplit  - Whether a mesh with too many vertices for 16 bit indices may be
+    ///                       split into several 16 bit ranges. The caller then needs to draw
+    ///                       each range with its base vertex.
+    ///
+    /// \return The packed indices and their draw ranges
+    ///
+    PackedIndices IndexPacker::Pack(const std::vector<unsigned int>& _indices, size_t _numVertices, bool _allowSplit)
+    {
+        ASSERT(_indices.size() % 3 == 0, "Expected triangle indices, but got " << _indices.size() << " indices");
+
+        PackedIndices packed;
+
+        if ( ChooseIndexType(_numVertices) == GL_UNSIGNED_SHORT )
+        {
+            packed.m_type = GL_UNSIGNED_SHORT;
+            packed.m_data.resize(_indices.size() * sizeof(uint16_t));
+            uint16_t* out = reinterpret_cast<uint16_t*>(packed.m_data.data());
+            for ( size_t i = 0; i < _indices.size(); i++ )
+            {
+                out[i] = static_cast<uint16_t>(_indices[i]);
+            }
+            packed.m_ranges.push_back({0, static_cast<GLsizei>(_indices.size()), 0});
+            return packed;
+        }
+
+        if ( _allowSplit && SplitInto16BitRanges(_indices, packed) )
+        {
+            return packed;
+        }
+
+        packed.m_type = GL_UNSIGNED_INT;
+        packed.m_data.resize(_indices.size() * sizeof(uint32_t));
+        std::memcpy(packed.m_data.data(), _indices.data(), packed.m_data.size());
+        packed.m_ranges.push_back({0, static_cast<GLsizei>(_indices.size()), 0});
+        return packed;
+    }
+
+    ///
+    /// \brief Greedily groups consecutive triangles into ranges whose vertices lie within a
+    ///        window of MAX_16BIT_VERTICES, and stores their indices as 16 bit offsets from the
+    ///        start of the window.
+    ///
+    /// \param _indices    - Triangle indices into the mesh's vertices
+    /// \param _outPacked  - Output packed indices. Only valid if this returns true.
+    ///
+    /// \return Whether the split worked out. It doesn't if a triangle spans more than the
+    ///         window, or if the ranges would end up too small to be worth drawing separately.
+    ///
+    bool IndexPacker::SplitInto16BitRanges(const std::vector<unsigned int>& _indices, PackedIndices& _outPacked)
+    {
+        _outPacked.m_type = GL_UNSIGNED_SHORT;
+        _outPacked.m_data.resize(_indices.size() * sizeof(uint16_t));
+        _outPacked.m_ranges.clear();
+        uint16_t* out = reinterpret_cast<uint16_t*>(_outPacked.m_data.data());
+
+        size_t rangeStart = 0;
+        unsigned int rangeMin = 0;
+        unsigned int rangeMax = 0;
+
+        auto closeRange = [&](size_t _rangeEnd)
+        {
+            for ( size_t i = rangeStart; i < _rangeEnd; i++ )
+            {
+                out[i] = static_cast<uint16_t>(_indices[i] - rangeMin);
+            }
+            _outPacked.m_ranges.push_back({rangeStart, static_cast<GLsizei>(_rangeEnd - rangeStart), static_cast<GLint>(rangeMin)});
+        };
+
+        for ( size_t triStart = 0; triStart < _indices.size(); triStart += 3 )
+        {
+            unsigned int triMin = std::min(_indices[triStart], std::min(_indices[triStart + 1], _indices[triStart + 2]));
+            unsigned int triMax = std::max(_indices[triStart], std::max(_indices[triStart + 1], _indices[triStart + 2]));
+            if ( triMax - triMin >= MAX_16BIT_VERTICES )
+            {
+                return false;
+            }
+
+            if ( triStart == rangeStart )
+            {
+                rangeMin = triMin;
+                rangeMax = triMax;
+                continue;
+            }
+
+            unsigned int newMin = std::min(rangeMin, triMin);
+            unsigned int newMax = std::max(rangeMax, triMax);
+            if ( newMax - newMin >= MAX_16BIT_VERTICES )
+            {
+                closeRange(triStart);
+                rangeStart = triStart;
+                newMin = triMin;
+                newMax = triMax;
+            }
+            rangeMin = newMin;
+            rangeMax = newMax;
+        }
+
+        if ( rangeStart < _indices.size() )
+        {
+            closeRange(_indices.size());
+        }
+
+        size_t numTris = _indices.size() / 3;
+        return _outPacked.m_ranges.size() <= 1 || numTris / _outPacked.m_ranges.size() >= MIN_TRIS_PER_RANGE;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef INDEXPACKER_H
+#define INDEXPACKER_H
+
+#include <glad/glad.h>
+#include <vector>
+
+namespace blithe
+{
+    ///
+    /// \brief A run of packed indices drawn with one draw call
+    ///
+    struct IndexRange
+    {
+        size_t m_firstIndex = 0; //!< Offset (in indices) of the first index of the range
+        GLsizei m_count = 0;     //!< Number of indices in the range
+        GLint m_baseVertex = 0;  //!< Added to every index of the range at draw time
+    };
+
+    ///
+    /// \brief Indices packed by IndexPacker::Pack(), ready to upload to an EBO
+    ///
+    struct PackedIndices
+    {
+        std::vector<unsigned char> m_data; //!< Packed index data
+        GLenum m_type = GL_UNSIGNED_INT;   //!< GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        std::vector<IndexRange> m_ranges;  //!< Draw ranges covering all of m_data, in order
+    };
+
+    ///
+    /// \brief Packs 32 bit mesh indices into the narrowest index type that can address the
+    ///        mesh's vertices.
+    ///
+    ///        Meshes with up to 65536 vertices get 16 bit indices and a single range. Bigger meshes
+    ///        can be split into ranges of consecutive triangles whose vertices all lie within a
+    ///        65536 vertex window, so that they can still use 16 bit indices relative to a base
+    ///        vertex. Meshes whose triangles reference vertices too far apart to split well
+    ///        fall back to 32 bit indices.
+    ///
+    class IndexPacker
+    {
+    public:
+        static GLenum ChooseIndexType(size_t _numVertices);
+        static size_t GetIndexSize(GLenum _indexType);
+
+        static PackedIndices Pack(const std::vector<unsigned int>& _indices, size_t _numVertices, bool _allowSplit = true);
+
+    private:
+        static bool SplitInto16BitRanges(const std::vector<unsigned int>& _indices, PackedIndices& _outPacked);
+    };
+}
+
+#endif // INDEXPACKER_H
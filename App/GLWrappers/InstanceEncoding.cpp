@@ -0,0 +1,145 @@
+#include "InstanceEncoding.h"
+#include <glm/gtc/quaternion.hpp>
+#include "BlitheAssert.h"
+
+namespace blithe
+{
+    constexpr GLuint InstancePacker::ATTRIB_LOCATION;
+
+    ///
+    /// \brief Gets the number of vec4 instance attributes used by _encoding.
+    ///
+    /// \param _encoding - Instance encoding
+    ///
+    /// \return Number of vec4 attributes per instance
+    ///
+    GLuint InstancePacker::GetNumAttributes(enInstanceEncoding _encoding)
+    {
+        switch ( _encoding )
+        {
+            case enInstanceEncoding::MAT4:             return 4;
+            case enInstanceEncoding::AFFINE_3X4:       return 3;
+            case enInstanceEncoding::QUAT_TRANS_SCALE: return 2;
+            case enInstanceEncoding::TRANS_SCALE:      return 1;
+        }
+
+        ASSERT(false, "Unknown instance encoding " << static_cast<int>(_encoding));
+        return 4;
+    }
+
+    ///
+    /// \brief Gets the number of bytes per instance used by _encoding.
+    ///
+    /// \param _encoding - Instance encoding
+    ///
+    /// \return Bytes per instance
+    ///
+    size_t InstancePacker::GetStride(enInstanceEncoding _encoding)
+    {
+        return GetNumAttributes(_encoding) * sizeof(glm::vec4);
+    }
+
+    ///
+    /// \brief Gets the file name of the vertex shader that decodes _encoding. The shaders all
+    ///        share the inputs, uniforms and outputs of TriangleInstanced.vert.
+    ///
+    /// \param _encoding - Instance encoding
+    ///
+    /// \return Vertex shader file name, relative to the Shaders directory
+    ///
+    std::string InstancePacker::GetVertexShaderName(enInstanceEncoding _encoding)
+    {
+        switch ( _encoding )
+        {
+            case enInstanceEncoding::MAT4:             return "TriangleInstanced.vert";
+            case enInstanceEncoding::AFFINE_3X4:       return "TriangleInstancedAffine.vert";
+            case enInstanceEncoding::QUAT_TRANS_SCALE: return "TriangleInstancedQuat.vert";
+            case enInstanceEncoding::TRANS_SCALE:      return "TriangleInstancedTransScale.vert";
+        }
+
+        ASSERT(false, "Unknown instance encoding " << static_cast<int>(_encoding));
+        return "TriangleInstanced.vert";
+    }
+
+    ///
+    /// \brief Encodes _count transforms into _outData.
+    ///
+    ///        The transforms must be affine. QUAT_TRANS_SCALE and TRANS_SCALE also assume a
+    ///        uniform scale, which is taken from the length of the first column, and
+    ///        TRANS_SCALE drops any rotation.
+    ///
+    /// \param _encoding   - Instance encoding to pack to
+    /// \param _transforms - Pointer to _count transforms
+    /// \param _count      - Number of transforms
+    /// \param _outData    - Output with room for _count * GetNumAttributes(_encoding) vec4s
+    ///
+    void InstancePacker::Pack(enInstanceEncoding _encoding, const glm::mat4* _transforms, size_t _count, glm::vec4* _outData)
+    {
+        switch ( _encoding )
+        {
+            case enInstanceEncoding::MAT4:
+            {
+                for ( size_t i = 0; i < _count; i++ )
+                {
+                    const glm::mat4& mat = _transforms[i];
+                    *_outData++ = mat[0];
+                    *_outData++ = mat[1];
+                    *_outData++ = mat[2];
+                    *_outData++ = mat[3];
+                }
+                break;
+            }
+            case enInstanceEncoding::AFFINE_3X4:
+            {
+                // Rows, so the shader can get each world coordinate with a dot product
+                for ( size_t i = 0; i < _count; i++ )
+                {
+                    const glm::mat4& mat = _transforms[i];
+                    for ( int row = 0; row < 3; row++ )
+                    {
+                        *_outData++ = glm::vec4(mat[0][row], mat[1][row], mat[2][row], mat[3][row]);
+                    }
+                }
+                break;
+            }
+            case enInstanceEncoding::QUAT_TRANS_SCALE:
+            {
+                for ( size_t i = 0; i < _count; i++ )
+                {
+                    const glm::mat4& mat = _transforms[i];
+                    float scale = glm::length(glm::vec3(mat[0]));
+                    glm::quat rotation;
+                    if ( scale > 0.0f )
+                    {
+                        rotation = glm::normalize(glm::quat_cast(glm::mat3(mat) * (1.0f / scale)));
+                    }
+                    *_outData++ = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+                    *_outData++ = glm::vec4(glm::vec3(mat[3]), scale);
+                }
+                break;
+            }
+            case enInstanceEncoding::TRANS_SCALE:
+            {
+                for ( size_t i = 0; i < _count; i++ )
+                {
+                    const glm::mat4& mat = _transforms[i];
+                    *_outData++ = glm::vec4(glm::vec3(mat[3]), glm::length(glm::vec3(mat[0])));
+                }
+                break;
+            }
+        }
+    }
+
+    ///
+    /// \brief Encodes all of _transforms into _outData, resizing it to fit.
+    ///
+    /// \param _encoding   - Instance encoding to pack to
+    /// \param _transforms - Transforms to pack
+    /// \param _outData    - Output packed data
+    ///
+    void InstancePacker::Pack(enInstanceEncoding _encoding, const std::vector<glm::mat4>& _transforms, std::vector<glm::vec4>& _outData)
+    {
+        _outData.resize(_transforms.size() * GetNumAttributes(_encoding));
+        Pack(_encoding, _transforms.data(), _transforms.size(), _outData.data());
+    }
+}
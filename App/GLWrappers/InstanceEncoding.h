@@ -0,0 +1,42 @@
+#ifndef INSTANCEENCODING_H
+#define INSTANCEENCODING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace blithe
+{
+    ///
+    /// \brief Ways of encoding a per-instance transform in an instance buffer. Every encoding is
+    ///        laid out as consecutive vec4 attributes starting at
+    ///        InstancePacker::ATTRIB_LOCATION.
+    ///
+    enum class enInstanceEncoding
+    {
+        MAT4,             //!< Full 4x4 matrix as 4 column vec4s (64 B)
+        AFFINE_3X4,       //!< Top 3 rows of an affine matrix as 3 row vec4s (48 B)
+        QUAT_TRANS_SCALE, //!< Rotation quaternion, then translation and uniform scale (32 B)
+        TRANS_SCALE,      //!< Translation and uniform scale only, no rotation (16 B)
+    };
+
+    ///
+    /// \brief Packs instance transforms into the compact instance encodings, and describes the
+    ///        matching instance attribute layout and vertex shader.
+    ///
+    class InstancePacker
+    {
+    public:
+        static constexpr GLuint ATTRIB_LOCATION = 3; //!< Location of the first instance attribute
+
+        static GLuint GetNumAttributes(enInstanceEncoding _encoding);
+        static size_t GetStride(enInstanceEncoding _encoding);
+        static std::string GetVertexShaderName(enInstanceEncoding _encoding);
+
+        static void Pack(enInstanceEncoding _encoding, const glm::mat4* _transforms, size_t _count, glm::vec4* _outData);
+        static void Pack(enInstanceEncoding _encoding, const std::vector<glm::mat4>& _transforms, std::vector<glm::vec4>& _outData);
+    };
+}
+
+#endif // INSTANCEENCODING_H
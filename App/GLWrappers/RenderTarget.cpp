@@ -5,7 +5,8 @@
 namespace blithe
 {
     /*!
-     * \brief Constructor that creates a texture and a framebuffer that targets it.
+     * \brief Constructor that creates a texture, a depth texture and a framebuffer that targets
+     *        them.
      *
      * \param _width        - Texture width
      * \param _height       - Texture height
@@ -20,14 +21,18 @@ namespace blithe
         glGenFramebuffers(1, &m_targetFBO);
         glBindFramebuffer(GL_FRAMEBUFFER, m_targetFBO);
 
-        // Is this how we do depth? Or we pass in a texture with some "depth" format? I don't know.
-        // But if we do we'll probably have to have GL_NONE attachment in the draw buffers below
-		// This seems to work for the standard viewport render target, but no idea how well it generalizes.
-        GLuint renderBuffer;
-        glGenRenderbuffers(1, &renderBuffer);
-        glBindRenderbuffer(GL_RENDERBUFFER, renderBuffer);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, _width, _height);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderBuffer);
+        // Depth goes to a texture rather than a renderbuffer, so that demos can read it back
+        // after rendering, e.g. to build a depth pyramid for occlusion culling. Nearest
+        // filtering and no comparison mode, since it's only ever read with texelFetch().
+        glGenTextures(1, &m_depthTexture);
+        glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, _width, _height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthTexture, 0);
 
         // I've done the setup of the framebuffer texture as a loop, pretending like I
         // might have multiple color attachment textures in the future.
@@ -93,13 +98,16 @@ namespace blithe
     }
 
     /*!
-     * \brief Cleans up the framebuffer and target texture.
+     * \brief Cleans up the framebuffer, target texture and depth texture.
      */
     void RenderTarget::CleanUp()
     {
         glDeleteFramebuffers(1, &m_targetFBO);
         m_targetFBO = 0;
 
+        glDeleteTextures(1, &m_depthTexture);
+        m_depthTexture = 0;
+
         delete m_targetTexture;
     }
 }
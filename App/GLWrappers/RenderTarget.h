@@ -24,6 +24,7 @@ namespace blithe
 
         unsigned int GetTargetFBO() const { return m_targetFBO; }
         Texture* GetTargetTexture() const { return m_targetTexture; }
+        unsigned int GetDepthTexture() const { return m_depthTexture; }
         bool GetDepthTestEnabled() const { return m_depthTestEnabled; }
         void SetDepthTestEnabled(bool _enable) { m_depthTestEnabled = _enable; }
         glm::vec4 GetClearColor() const { return m_clearColor; }
@@ -34,6 +35,7 @@ namespace blithe
     private:
         Texture* m_targetTexture = nullptr; //!< Target texture
         unsigned int m_targetFBO = 0;       //!< ID of framebuffer, assigned by OpenGL
+        unsigned int m_depthTexture = 0;    //!< ID of the depth attachment texture, assigned by OpenGL
         bool m_depthTestEnabled = false;    //!< Whether depth testing is enabled
         glm::vec4 m_clearColor;             //!< The color to clear to when binding this
         GLbitfield m_clearMask = 0x0000;    //!< Mask specifying buffers we'd like to clear
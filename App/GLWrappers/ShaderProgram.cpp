@@ -3,6 +3,7 @@
 #include <sstream>
 #include <iostream>
 #include "BlitheAssert.h"
+#include "InstanceEncoding.h"
 
 namespace blithe
 {
@@ -39,6 +40,29 @@ namespace blithe
         glDeleteShader(fragmentShader);
     }
 
+    /*!
+     * \brief Constructor. Compiles the compute shader at _computePath and links it to a program.
+     *        Compute shaders need OpenGL 4.3.
+     *
+     * \param _computePath - Path to compute shader
+     */
+    ShaderProgram::ShaderProgram(const std::string& _computePath)
+    {
+        tl::optional<std::string> computeSrc = LoadShaderSource(_computePath);
+        ASSERT(computeSrc.has_value(), "Error opening compute shader file: " << _computePath);
+
+        GLuint computeShader = CompileShader(computeSrc.value(), GL_COMPUTE_SHADER);
+
+        m_programID = glCreateProgram();
+        glAttachShader(m_programID, computeShader);
+        glLinkProgram(m_programID);
+
+        GLint linkStatus = CheckLinkingErrors();
+        ASSERT(linkStatus, "Error linking shader program. Compute shader:\n" << computeSrc.value());
+
+        glDeleteShader(computeShader);
+    }
+
     /*!
      * \brief Deletes the shader program.
      */
@@ -202,5 +226,14 @@ namespace blithe
         glBindAttribLocation(m_programID, 0, "VertexPosition");
         glBindAttribLocation(m_programID, 1, "VertexColor");
         glBindAttribLocation(m_programID, 2, "VertexTexCoords");
+
+        // Instance attributes (see InstanceEncoding.h). A shader only uses one of these, so it's
+        // fine for them to alias.
+        glBindAttribLocation(m_programID, InstancePacker::ATTRIB_LOCATION, "InstanceMatrix");
+        for ( GLuint attrIdx = 0; attrIdx < 4; attrIdx++ )
+        {
+            std::string attrName = "InstanceData" + std::to_string(attrIdx);
+            glBindAttribLocation(m_programID, InstancePacker::ATTRIB_LOCATION + attrIdx, attrName.c_str());
+        }
     }
 }
@@ -15,6 +15,7 @@ namespace blithe
     {
     public:
         ShaderProgram(const std::string& _vertexPath, const std::string& _fragmentPath);
+        explicit ShaderProgram(const std::string& _computePath);
         ~ShaderProgram();
 
         void Bind() const;
@@ -0,0 +1,183 @@
+#include "VertexPacker.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include "BlitheAssert.h"
+#include "GeomHelpers.h"
+#include "Mesh.h"
+
+namespace blithe
+{
+    ///
+    /// \brief Gets the plain vertex format matching the layout of Vertex.
+    ///
+    /// \return Vertex format with float positions, colors and texture coords
+    ///
+    const VBOVertexFormat& VertexPacker::GetXyzRgbaUvFormat()
+    {
+        static const VBOVertexFormat s_format_xyz_rgba_uv = {
+            { {0, 3, GL_FLOAT, GL_FALSE, 0},                   // position
+              {1, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 3},   // color
+              {2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 7} }, // texture coords
+            sizeof(float) * 9
+        };
+        return s_format_xyz_rgba_uv;
+    }
+
+    ///
+    /// \brief Gets the vertex format Pack() emits for _options.
+    ///
+    ///        The layouts used are
+    ///          - position: 3 floats (12 B) or 3 UNORM16s padded to 8 B
+    ///          - color: 4 floats (16 B) or RGBA8 (4 B)
+    ///          - texture coords: see enTexCoordPacking
+    ///
+    /// \param _options - How to pack each attribute
+    ///
+    /// \return Vertex format with the position, color and texture coords, in that order
+    ///
+    VBOVertexFormat VertexPacker::GetPackedFormat(const VertexPackOptions& _options)
+    {
+        VBOVertexFormat format = { {}, 0 };
+        std::vector<VBOVertexAttribute>& attributes = format.m_attributes;
+        size_t stride = 0;
+
+        if ( _options.m_quantizePositions )
+        {
+            // The 4th short is padding to keep the next attribute 4 byte aligned
+            attributes.push_back({0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride});
+            stride += sizeof(uint16_t) * 4;
+        }
+        else
+        {
+            attributes.push_back({0, 3, GL_FLOAT, GL_FALSE, stride});
+            stride += sizeof(float) * 3;
+        }
+
+        if ( _options.m_packColors )
+        {
+            attributes.push_back({1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride});
+            stride += sizeof(uint8_t) * 4;
+        }
+        else
+        {
+            attributes.push_back({1, 4, GL_FLOAT, GL_FALSE, stride});
+            stride += sizeof(float) * 4;
+        }
+
+        switch ( _options.m_texCoordPacking )
+        {
+            case enTexCoordPacking::FLOAT:
+                attributes.push_back({2, 2, GL_FLOAT, GL_FALSE, stride});
+                stride += sizeof(float) * 2;
+                break;
+            case enTexCoordPacking::HALF:
+                attributes.push_back({2, 2, GL_HALF_FLOAT, GL_FALSE, stride});
+                stride += sizeof(uint16_t) * 2;
+                break;
+            case enTexCoordPacking::UNORM16:
+                attributes.push_back({2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride});
+                stride += sizeof(uint16_t) * 2;
+                break;
+        }
+
+        format.m_stride = stride;
+        return format;
+    }
+
+    ///
+    /// \brief Packs the vertices of _mesh according to _options, in the layout given by
+    ///        GetPackedFormat().
+    ///
+    /// \param _mesh    - Mesh whose vertices are to be packed
+    /// \param _options - How to pack each attribute
+    ///
+    /// \return The packed vertices and their vertex format
+    ///
+    PackedVertices VertexPacker::Pack(const Mesh& _mesh, const VertexPackOptions& _options)
+    {
+        PackedVertices packed;
+        packed.m_format = GetPackedFormat(_options);
+        size_t stride = packed.m_format.m_stride;
+        size_t posOffset = packed.m_format.m_attributes[0].m_offset;
+        size_t colorOffset = packed.m_format.m_attributes[1].m_offset;
+        size_t texCoordsOffset = packed.m_format.m_attributes[2].m_offset;
+
+        // Quantize against the bounding cube (rather than box) of the mesh so that the
+        // dequantize transform has a uniform scale, which every instance encoding can hold.
+        glm::vec3 quantOrigin(0.0f);
+        float quantExtent = 1.0f;
+        if ( _options.m_quantizePositions && !_mesh.m_vertices.empty() )
+        {
+            AABB bounds = GeomHelpers::CalcLocalAABB(_mesh);
+            glm::vec3 size = bounds.m_max - bounds.m_min;
+            quantOrigin = bounds.m_min;
+            quantExtent = std::max(size.x, std::max(size.y, size.z));
+            if ( quantExtent <= 0.0f )
+            {
+                quantExtent = 1.0f;
+            }
+
+            packed.m_dequantizeTransform = glm::translate(glm::mat4(1.0f), quantOrigin);
+            packed.m_dequantizeTransform = glm::scale(packed.m_dequantizeTransform, glm::vec3(quantExtent));
+            packed.m_positionsQuantized = true;
+        }
+
+        packed.m_data.resize(_mesh.m_vertices.size() * stride);
+        unsigned char* out = packed.m_data.data();
+        for ( size_t vIdx = 0; vIdx < _mesh.m_vertices.size(); vIdx++, out += stride )
+        {
+            const Vertex& vertex = _mesh.m_vertices[vIdx];
+
+            if ( _options.m_quantizePositions )
+            {
+                glm::vec3 unitPos = (vertex.m_pos - quantOrigin) / quantExtent;
+                uint16_t pos[4] = { glm::packUnorm1x16(unitPos.x), glm::packUnorm1x16(unitPos.y), glm::packUnorm1x16(unitPos.z), 0 };
+                std::memcpy(out + posOffset, pos, sizeof(pos));
+            }
+            else
+            {
+                std::memcpy(out + posOffset, &vertex.m_pos, sizeof(vertex.m_pos));
+            }
+
+            if ( _options.m_packColors )
+            {
+                // Write the bytes out individually so that the order doesn't depend on endianness
+                for ( int c = 0; c < 4; c++ )
+                {
+                    out[colorOffset + c] = static_cast<unsigned char>(std::round(glm::clamp(vertex.m_color[c], 0.0f, 1.0f) * 255.0f));
+                }
+            }
+            else
+            {
+                std::memcpy(out + colorOffset, &vertex.m_color, sizeof(vertex.m_color));
+            }
+
+            switch ( _options.m_texCoordPacking )
+            {
+                case enTexCoordPacking::FLOAT:
+                {
+                    std::memcpy(out + texCoordsOffset, &vertex.m_texCoords, sizeof(vertex.m_texCoords));
+                    break;
+                }
+                case enTexCoordPacking::HALF:
+                {
+                    uint16_t texCoords[2] = { glm::packHalf1x16(vertex.m_texCoords.x), glm::packHalf1x16(vertex.m_texCoords.y) };
+                    std::memcpy(out + texCoordsOffset, texCoords, sizeof(texCoords));
+                    break;
+                }
+                case enTexCoordPacking::UNORM16:
+                {
+                    uint16_t texCoords[2] = { glm::packUnorm1x16(vertex.m_texCoords.x), glm::packUnorm1x16(vertex.m_texCoords.y) };
+                    std::memcpy(out + texCoordsOffset, texCoords, sizeof(texCoords));
+                    break;
+                }
+            }
+        }
+
+        return packed;
+    }
+}
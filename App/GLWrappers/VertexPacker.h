@@ -0,0 +1,63 @@
+#ifndef VERTEXPACKER_H
+#define VERTEXPACKER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "VBOVertexFormat.h"
+
+namespace blithe
+{
+    struct Mesh;
+
+    ///
+    /// \brief Ways of packing the texture coordinates of a vertex
+    ///
+    enum class enTexCoordPacking
+    {
+        FLOAT,   //!< 2 floats (8 B)
+        HALF,    //!< 2 half floats (4 B)
+        UNORM16, //!< 2 normalized unsigned shorts (4 B). Only for texture coords in [0, 1].
+    };
+
+    ///
+    /// \brief Options for VertexPacker::Pack(). The defaults give the plain xyz_rgba_uv layout
+    ///        of Vertex.
+    ///
+    struct VertexPackOptions
+    {
+        bool m_quantizePositions = false;                               //!< Store positions as 16 bit normalized values within the mesh's bounds
+        bool m_packColors = false;                                      //!< Store colors as RGBA8 normalized values
+        enTexCoordPacking m_texCoordPacking = enTexCoordPacking::FLOAT; //!< How to store texture coords
+    };
+
+    ///
+    /// \brief Vertex data packed by VertexPacker::Pack(), ready to upload to a VBO
+    ///
+    struct PackedVertices
+    {
+        std::vector<unsigned char> m_data;                 //!< Interleaved vertex data
+        VBOVertexFormat m_format = { {}, 0 };              //!< Layout of m_data
+        glm::mat4 m_dequantizeTransform = glm::mat4(1.0f); //!< Maps the stored positions back to the mesh's space
+        bool m_positionsQuantized = false;                 //!< Whether the positions are quantized
+    };
+
+    ///
+    /// \brief Packs the vertices of a Mesh into more compact vertex formats, and emits the
+    ///        VBOVertexFormat describing each.
+    ///
+    ///        Quantized positions are stored as normalized unsigned shorts relative to the mesh's
+    ///        bounding cube, so the shader sees them in [0, 1]. The returned m_dequantizeTransform
+    ///        (a translation and a uniform scale) maps them back, and is meant to be folded into
+    ///        the model or instance transforms.
+    ///
+    class VertexPacker
+    {
+    public:
+        static const VBOVertexFormat& GetXyzRgbaUvFormat();
+        static VBOVertexFormat GetPackedFormat(const VertexPackOptions& _options);
+
+        static PackedVertices Pack(const Mesh& _mesh, const VertexPackOptions& _options);
+    };
+}
+
+#endif // VERTEXPACKER_H
@@ -0,0 +1,78 @@
+#ifndef AABBARRAYS_H
+#define AABBARRAYS_H
+
+#include <stddef.h>
+#include <vector>
+#include "AABB.h"
+
+namespace blithe
+{
+    ///
+    /// \brief Boxes stored as structure-of-arrays, one array per min/max coordinate, so SIMD
+    ///        kernels can load the same coordinate of 8 consecutive boxes at once.
+    ///
+    ///        The arrays are padded so that 8 boxes can be loaded starting at any box. What
+    ///        the padding holds is unspecified, so kernels must mask off the lanes past the end.
+    ///
+    struct AABBArrays
+    {
+        static constexpr size_t PADDING = 8; //!< Number of boxes a kernel may load past any box
+
+        std::vector<float> m_minX; //!< Min x of each box
+        std::vector<float> m_minY; //!< Min y of each box
+        std::vector<float> m_minZ; //!< Min z of each box
+        std::vector<float> m_maxX; //!< Max x of each box
+        std::vector<float> m_maxY; //!< Max y of each box
+        std::vector<float> m_maxZ; //!< Max z of each box
+        size_t m_size = 0;         //!< Number of boxes, not counting the padding
+
+        ///
+        /// \brief Resizes the arrays to hold _size boxes plus the padding. New boxes are
+        ///        zero-sized at the origin.
+        ///
+        /// \param _size - Number of boxes
+        ///
+        void Resize(size_t _size)
+        {
+            size_t paddedSize = (_size + 2 * PADDING - 2) / PADDING * PADDING;
+            for ( std::vector<float>* array : { &m_minX, &m_minY, &m_minZ, &m_maxX, &m_maxY, &m_maxZ } )
+            {
+                array->resize(paddedSize, 0.0f);
+            }
+            m_size = _size;
+        }
+
+        ///
+        /// \brief Replaces the boxes with _boxes
+        ///
+        /// \param _boxes - Boxes to copy in
+        ///
+        void Assign(const std::vector<AABB>& _boxes)
+        {
+            Resize(_boxes.size());
+            for ( size_t i = 0; i < _boxes.size(); i++ )
+            {
+                Set(i, _boxes[i]);
+            }
+        }
+
+        void Set(size_t _idx, const AABB& _box)
+        {
+            m_minX[_idx] = _box.m_min.x;
+            m_minY[_idx] = _box.m_min.y;
+            m_minZ[_idx] = _box.m_min.z;
+            m_maxX[_idx] = _box.m_max.x;
+            m_maxY[_idx] = _box.m_max.y;
+            m_maxZ[_idx] = _box.m_max.z;
+        }
+
+        AABB Get(size_t _idx) const
+        {
+            return { glm::vec3(m_minX[_idx], m_minY[_idx], m_minZ[_idx]), glm::vec3(m_maxX[_idx], m_maxY[_idx], m_maxZ[_idx]) };
+        }
+
+        size_t GetSize() const { return m_size; }
+    };
+}
+
+#endif // AABBARRAYS_H
@@ -0,0 +1,514 @@
+#include "BVH.h"
+#include <iterator>
+#include <numeric>
+#include <tracy/Tracy.hpp>
+#include "BlitheAssert.h"
+#include "Frustum.h"
+
+namespace blithe
+{
+    constexpr size_t BVH::MAX_LEAF_SIZE;
+    constexpr size_t BVH::MAX_DEPTH;
+
+    namespace
+    {
+        const int NUM_SAH_BINS = 16;
+        const uint32_t ALL_PLANES_MASK = (1u << Frustum::NUM_PLANES) - 1;
+
+        glm::vec3 CalcCentroid(const AABB& _aabb)
+        {
+            return (_aabb.m_min + _aabb.m_max) * 0.5f;
+        }
+
+        AABB CalcUnion(const AABB& _a, const AABB& _b)
+        {
+            return { glm::min(_a.m_min, _b.m_min), glm::max(_a.m_max, _b.m_max) };
+        }
+
+        float CalcHalfArea(const AABB& _aabb)
+        {
+            glm::vec3 size = _aabb.m_max - _aabb.m_min;
+            return size.x * size.y + size.y * size.z + size.z * size.x;
+        }
+
+        AABB EmptyAABB()
+        {
+            float inf = std::numeric_limits<float>::infinity();
+            return { glm::vec3(inf), glm::vec3(-inf) };
+        }
+
+        bool Overlaps(const AABB& _a, const AABB& _b)
+        {
+            return glm::all(glm::lessThanEqual(_a.m_min, _b.m_max)) && glm::all(glm::lessThanEqual(_b.m_min, _a.m_max));
+        }
+
+        bool Overlaps(const AABB& _aabb, const Sphere& _sphere)
+        {
+            glm::vec3 closest = glm::clamp(_sphere.m_center, _aabb.m_min, _aabb.m_max);
+            glm::vec3 offset = closest - _sphere.m_center;
+            return glm::dot(offset, offset) <= _sphere.m_radius * _sphere.m_radius;
+        }
+    }
+
+    ///
+    /// \brief Builds the tree over _primBounds, top down. Each node is split where the binned
+    ///        surface area heuristic is lowest, except past half of MAX_DEPTH, where nodes are
+    ///        split at the median to bound the depth.
+    ///
+    /// \param _primBounds  - Bounds of the primitives. Primitive i is reported as i by the
+    ///                       queries.
+    /// \param _maxLeafSize - Max primitives per leaf. Must be at least 1.
+    ///
+    void BVH::Build(const std::vector<AABB>& _primBounds, size_t _maxLeafSize)
+    {
+        ZoneScoped;
+
+        ASSERT(_maxLeafSize >= 1, "Leaves must hold at least one primitive");
+        ASSERT(_primBounds.size() < std::numeric_limits<uint32_t>::max(), "Too many primitives: " << _primBounds.size());
+
+        uint32_t numPrims = static_cast<uint32_t>(_primBounds.size());
+        m_nodes.clear();
+        m_primIndices.resize(numPrims);
+        std::iota(m_primIndices.begin(), m_primIndices.end(), 0u);
+        m_primBounds.clear();
+        if ( numPrims == 0 )
+        {
+            return;
+        }
+
+        std::vector<glm::vec3> centroids(numPrims);
+        for ( uint32_t i = 0; i < numPrims; i++ )
+        {
+            centroids[i] = CalcCentroid(_primBounds[i]);
+        }
+
+        m_nodes.reserve(2 * static_cast<size_t>(numPrims) - 1);
+        m_nodes.push_back({});
+
+        std::vector<BuildEntry> stack = { { 0, 0, numPrims, 0 } };
+        while ( !stack.empty() )
+        {
+            BuildEntry entry = stack.back();
+            stack.pop_back();
+
+            if ( entry.m_count <= _maxLeafSize )
+            {
+                m_nodes[entry.m_node].m_first = entry.m_first;
+                m_nodes[entry.m_node].m_count = entry.m_count;
+                continue;
+            }
+
+            uint32_t leftCount = entry.m_depth < MAX_DEPTH / 2 ? PartitionSAH(_primBounds, centroids, entry) : 0;
+            if ( leftCount == 0 )
+            {
+                leftCount = PartitionMedian(centroids, entry);
+            }
+
+            uint32_t left = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.push_back({});
+            m_nodes.push_back({});
+            m_nodes[entry.m_node].m_first = left;
+            m_nodes[entry.m_node].m_count = 0;
+
+            stack.push_back({ left + 1, entry.m_first + leftCount, entry.m_count - leftCount, entry.m_depth + 1 });
+            stack.push_back({ left, entry.m_first, leftCount, entry.m_depth + 1 });
+        }
+
+        Refit(_primBounds);
+    }
+
+    ///
+    /// \brief Updates the bounds of all the nodes for the primitives' new bounds, keeping the
+    ///        tree as is. Children come after their parents, so one backwards pass does it.
+    ///
+    /// \param _primBounds - New bounds of the primitives. Must be as many as Build() got.
+    ///
+    void BVH::Refit(const std::vector<AABB>& _primBounds)
+    {
+        ZoneScoped;
+
+        ASSERT(_primBounds.size() == m_primIndices.size(), "Built with " << m_primIndices.size() << " primitives but refitting with " << _primBounds.size());
+
+        m_primBounds.resize(m_primIndices.size());
+        for ( size_t i = 0; i < m_primIndices.size(); i++ )
+        {
+            m_primBounds[i] = _primBounds[m_primIndices[i]];
+        }
+
+        for ( size_t i = m_nodes.size(); i-- > 0; )
+        {
+            BVHNode& node = m_nodes[i];
+            if ( node.IsLeaf() )
+            {
+                CalcLeafBounds(node);
+            }
+            else
+            {
+                node.m_bounds = CalcUnion(m_nodes[node.m_first].m_bounds, m_nodes[node.m_first + 1].m_bounds);
+            }
+        }
+    }
+
+    ///
+    /// \brief Finds the primitives whose bounds overlap _frustum. Each node only tests the
+    ///        planes its parent wasn't entirely inside of, and subtrees entirely inside the
+    ///        frustum are reported without testing anything further.
+    ///
+    ///        Callers with tighter bounds than the boxes, e.g. OBBs, can have the primitives
+    ///        whose boxes straddle a plane reported separately, and only test those.
+    ///
+    /// \param _frustum            - Frustum to test against
+    /// \param _outPrims           - Primitives are appended to this
+    /// \param _outStraddlingPrims - If given, the primitives whose boxes straddle a plane are
+    ///                              appended to this instead of _outPrims
+    ///
+    /// \return Number of nodes visited
+    ///
+    size_t BVH::QueryFrustum(const Frustum& _frustum, std::vector<uint32_t>& _outPrims, std::vector<uint32_t>* _outStraddlingPrims) const
+    {
+        ZoneScoped;
+
+        if ( m_nodes.empty() )
+        {
+            return 0;
+        }
+
+        // Returns the planes _aabb straddles, or ~0 if it's entirely outside one
+        auto classify = [&_frustum](const AABB& _aabb, uint32_t _planeMask) {
+            glm::vec3 center = CalcCentroid(_aabb);
+            glm::vec3 extent = _aabb.m_max - center;
+            uint32_t straddled = 0;
+            for ( uint32_t p = 0; p < Frustum::NUM_PLANES; p++ )
+            {
+                if ( (_planeMask & (1u << p)) == 0 )
+                {
+                    continue;
+                }
+                const Plane& plane = _frustum.m_planes[p];
+                float centerDist = glm::dot(plane.m_normal, center) + plane.m_d;
+                float radius = glm::dot(glm::abs(plane.m_normal), extent);
+                if ( centerDist + radius < 0.0f )
+                {
+                    return ~0u;
+                }
+                if ( centerDist - radius < 0.0f )
+                {
+                    straddled |= 1u << p;
+                }
+            }
+            return straddled;
+        };
+
+        std::pair<uint32_t, uint32_t> stack[MAX_DEPTH];
+        size_t stackSize = 0;
+        stack[stackSize++] = std::make_pair(0u, ALL_PLANES_MASK);
+        size_t numVisited = 0;
+        while ( stackSize > 0 )
+        {
+            uint32_t nodeIdx = stack[stackSize - 1].first;
+            uint32_t planeMask = classify(m_nodes[nodeIdx].m_bounds, stack[stackSize - 1].second);
+            stackSize--;
+            numVisited++;
+
+            if ( planeMask == ~0u )
+            {
+                continue;
+            }
+            if ( planeMask == 0 )
+            {
+                numVisited += AppendSubtreePrims(nodeIdx, _outPrims);
+                continue;
+            }
+
+            const BVHNode& node = m_nodes[nodeIdx];
+            if ( node.IsLeaf() )
+            {
+                for ( uint32_t i = node.m_first; i < node.m_first + node.m_count; i++ )
+                {
+                    uint32_t primPlaneMask = classify(m_primBounds[i], planeMask);
+                    if ( primPlaneMask == ~0u )
+                    {
+                        continue;
+                    }
+                    bool straddles = primPlaneMask != 0 && _outStraddlingPrims != nullptr;
+                    (straddles ? *_outStraddlingPrims : _outPrims).push_back(m_primIndices[i]);
+                }
+            }
+            else
+            {
+                stack[stackSize++] = std::make_pair(node.m_first + 1, planeMask);
+                stack[stackSize++] = std::make_pair(node.m_first, planeMask);
+            }
+        }
+
+        return numVisited;
+    }
+
+    ///
+    /// \brief Finds the primitives whose bounds overlap _aabb.
+    ///
+    /// \param _aabb     - Box to test against
+    /// \param _outPrims - Primitives are appended to this
+    ///
+    /// \return Number of nodes visited
+    ///
+    size_t BVH::QueryAABB(const AABB& _aabb, std::vector<uint32_t>& _outPrims) const
+    {
+        return QueryOverlaps([&_aabb](const AABB& _bounds) { return Overlaps(_bounds, _aabb); }, _outPrims);
+    }
+
+    ///
+    /// \brief Finds the primitives whose bounds overlap _sphere.
+    ///
+    /// \param _sphere   - Sphere to test against
+    /// \param _outPrims - Primitives are appended to this
+    ///
+    /// \return Number of nodes visited
+    ///
+    size_t BVH::QuerySphere(const Sphere& _sphere, std::vector<uint32_t>& _outPrims) const
+    {
+        return QueryOverlaps([&_sphere](const AABB& _bounds) { return Overlaps(_bounds, _sphere); }, _outPrims);
+    }
+
+    ///
+    /// \brief Finds the primitives whose bounds _ray passes through within _maxT. For the
+    ///        closest hit with the primitives themselves, use IntersectRay().
+    ///
+    /// \param _ray      - Ray to test against
+    /// \param _maxT     - Max distance along the ray
+    /// \param _outPrims - Primitives are appended to this
+    ///
+    /// \return Number of nodes visited
+    ///
+    size_t BVH::QueryRay(const Ray& _ray, float _maxT, std::vector<uint32_t>& _outPrims) const
+    {
+        glm::vec3 invDir = 1.0f / _ray.m_dir;
+        return QueryOverlaps([&_ray, &invDir, _maxT](const AABB& _bounds) {
+            float tNear = 0.0f;
+            return RayHitsAABB(_bounds, _ray.m_origin, invDir, _maxT, tNear);
+        }, _outPrims);
+    }
+
+    ///
+    /// \brief Depth first traversal reporting the primitives whose bounds pass _overlaps.
+    ///
+    /// \param _overlaps - Callable as bool(const AABB&)
+    /// \param _outPrims - Primitives are appended to this
+    ///
+    /// \return Number of nodes visited
+    ///
+    template<typename OverlapFunc>
+    size_t BVH::QueryOverlaps(OverlapFunc&& _overlaps, std::vector<uint32_t>& _outPrims) const
+    {
+        if ( m_nodes.empty() )
+        {
+            return 0;
+        }
+
+        uint32_t stack[MAX_DEPTH];
+        size_t stackSize = 0;
+        stack[stackSize++] = 0;
+        size_t numVisited = 0;
+        while ( stackSize > 0 )
+        {
+            const BVHNode& node = m_nodes[stack[--stackSize]];
+            numVisited++;
+            if ( !_overlaps(node.m_bounds) )
+            {
+                continue;
+            }
+
+            if ( node.IsLeaf() )
+            {
+                for ( uint32_t i = node.m_first; i < node.m_first + node.m_count; i++ )
+                {
+                    if ( _overlaps(m_primBounds[i]) )
+                    {
+                        _outPrims.push_back(m_primIndices[i]);
+                    }
+                }
+            }
+            else
+            {
+                stack[stackSize++] = node.m_first + 1;
+                stack[stackSize++] = node.m_first;
+            }
+        }
+
+        return numVisited;
+    }
+
+    ///
+    /// \brief Partitions the primitives of _entry along the axis and bin boundary with the
+    ///        lowest surface area heuristic cost, binning the primitives by their centroids.
+    ///
+    /// \param _primBounds - Bounds of all the primitives
+    /// \param _centroids  - Centroids of all the primitives
+    /// \param _entry      - Node being split
+    ///
+    /// \return Number of primitives that went left, or 0 if the centroids can't be split
+    ///
+    uint32_t BVH::PartitionSAH(const std::vector<AABB>& _primBounds, const std::vector<glm::vec3>& _centroids, const BuildEntry& _entry)
+    {
+        uint32_t* begin = m_primIndices.data() + _entry.m_first;
+        uint32_t* end = begin + _entry.m_count;
+
+        AABB centroidBounds = EmptyAABB();
+        for ( const uint32_t* prim = begin; prim != end; prim++ )
+        {
+            centroidBounds.m_min = glm::min(centroidBounds.m_min, _centroids[*prim]);
+            centroidBounds.m_max = glm::max(centroidBounds.m_max, _centroids[*prim]);
+        }
+        glm::vec3 extent = centroidBounds.m_max - centroidBounds.m_min;
+        glm::vec3 scale(0.0f);
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            scale[axis] = extent[axis] > 0.0f ? NUM_SAH_BINS / extent[axis] : 0.0f;
+        }
+        auto calcBin = [&](uint32_t _prim, int _axis) {
+            return std::min(NUM_SAH_BINS - 1, static_cast<int>((_centroids[_prim][_axis] - centroidBounds.m_min[_axis]) * scale[_axis]));
+        };
+
+        // Bin along all three axes in one pass over the primitives
+        AABB binBounds[3][NUM_SAH_BINS];
+        uint32_t binCounts[3][NUM_SAH_BINS] = {};
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            std::fill(std::begin(binBounds[axis]), std::end(binBounds[axis]), EmptyAABB());
+        }
+        for ( const uint32_t* prim = begin; prim != end; prim++ )
+        {
+            const AABB& bounds = _primBounds[*prim];
+            for ( int axis = 0; axis < 3; axis++ )
+            {
+                int bin = calcBin(*prim, axis);
+                binBounds[axis][bin] = CalcUnion(binBounds[axis][bin], bounds);
+                binCounts[axis][bin]++;
+            }
+        }
+
+        float bestCost = std::numeric_limits<float>::infinity();
+        int bestAxis = -1;
+        int bestBin = 0;
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            if ( extent[axis] <= 0.0f )
+            {
+                continue;
+            }
+
+            // Sweep from the right to get the cost of everything right of each boundary, then
+            // from the left to add the cost of everything left of it.
+            float rightCosts[NUM_SAH_BINS] = {};
+            AABB rightBounds = EmptyAABB();
+            uint32_t rightCount = 0;
+            for ( int bin = NUM_SAH_BINS - 1; bin > 0; bin-- )
+            {
+                rightBounds = CalcUnion(rightBounds, binBounds[axis][bin]);
+                rightCount += binCounts[axis][bin];
+                rightCosts[bin] = rightCount > 0 ? CalcHalfArea(rightBounds) * static_cast<float>(rightCount) : 0.0f;
+            }
+
+            AABB leftBounds = EmptyAABB();
+            uint32_t leftCount = 0;
+            for ( int bin = 0; bin < NUM_SAH_BINS - 1; bin++ )
+            {
+                leftBounds = CalcUnion(leftBounds, binBounds[axis][bin]);
+                leftCount += binCounts[axis][bin];
+                if ( leftCount == 0 || leftCount == _entry.m_count )
+                {
+                    continue;
+                }
+                float cost = CalcHalfArea(leftBounds) * static_cast<float>(leftCount) + rightCosts[bin + 1];
+                if ( cost < bestCost )
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = bin;
+                }
+            }
+        }
+
+        if ( bestAxis < 0 )
+        {
+            return 0;
+        }
+
+        uint32_t* mid = std::partition(begin, end, [&](uint32_t _prim) { return calcBin(_prim, bestAxis) <= bestBin; });
+        return static_cast<uint32_t>(mid - begin);
+    }
+
+    ///
+    /// \brief Partitions the primitives of _entry into two halves about the median centroid
+    ///        along the axis where the centroids are most spread out.
+    ///
+    /// \param _centroids - Centroids of all the primitives
+    /// \param _entry     - Node being split
+    ///
+    /// \return Number of primitives that went left
+    ///
+    uint32_t BVH::PartitionMedian(const std::vector<glm::vec3>& _centroids, const BuildEntry& _entry)
+    {
+        uint32_t* begin = m_primIndices.data() + _entry.m_first;
+        uint32_t* end = begin + _entry.m_count;
+
+        AABB centroidBounds = EmptyAABB();
+        for ( const uint32_t* prim = begin; prim != end; prim++ )
+        {
+            centroidBounds.m_min = glm::min(centroidBounds.m_min, _centroids[*prim]);
+            centroidBounds.m_max = glm::max(centroidBounds.m_max, _centroids[*prim]);
+        }
+        glm::vec3 extent = centroidBounds.m_max - centroidBounds.m_min;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+        uint32_t* mid = begin + _entry.m_count / 2;
+        std::nth_element(begin, mid, end, [&](uint32_t _a, uint32_t _b) { return _centroids[_a][axis] < _centroids[_b][axis]; });
+        return static_cast<uint32_t>(mid - begin);
+    }
+
+    ///
+    /// \brief Sets a leaf's bounds to the union of its primitives' bounds.
+    ///
+    /// \param _node - Leaf node
+    ///
+    void BVH::CalcLeafBounds(BVHNode& _node) const
+    {
+        _node.m_bounds = m_primBounds[_node.m_first];
+        for ( uint32_t i = _node.m_first + 1; i < _node.m_first + _node.m_count; i++ )
+        {
+            _node.m_bounds = CalcUnion(_node.m_bounds, m_primBounds[i]);
+        }
+    }
+
+    ///
+    /// \brief Appends all the primitives under _node. They're contiguous in m_primIndices, from
+    ///        the first of its leftmost leaf to the last of its rightmost leaf.
+    ///
+    /// \param _node     - Subtree root
+    /// \param _outPrims - Primitives are appended to this
+    ///
+    /// \return Number of nodes visited to find the leaves
+    ///
+    size_t BVH::AppendSubtreePrims(uint32_t _node, std::vector<uint32_t>& _outPrims) const
+    {
+        size_t numVisited = 0;
+        uint32_t leftmost = _node;
+        while ( !m_nodes[leftmost].IsLeaf() )
+        {
+            leftmost = m_nodes[leftmost].m_first;
+            numVisited++;
+        }
+        uint32_t rightmost = _node;
+        while ( !m_nodes[rightmost].IsLeaf() )
+        {
+            rightmost = m_nodes[rightmost].m_first + 1;
+            numVisited++;
+        }
+
+        const BVHNode& last = m_nodes[rightmost];
+        _outPrims.insert(_outPrims.end(),
+                         m_primIndices.begin() + m_nodes[leftmost].m_first,
+                         m_primIndices.begin() + last.m_first + last.m_count);
+        return numVisited;
+    }
+}
@@ -0,0 +1,338 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "AABB.h"
+#include "Ray.h"
+#include "RayPacket.h"
+#include "Sphere.h"
+
+namespace blithe
+{
+    struct Frustum;
+
+    ///
+    /// \brief Node of a BVH. Nodes are 32 bytes, so two fit in a cache line.
+    ///
+    struct BVHNode
+    {
+        AABB m_bounds;    //!< Bounds of everything under this node
+        uint32_t m_first; //!< Leaf: index of its first entry in BVH::GetPrimIndices(). Internal: index of the left child, with the right child right after it.
+        uint32_t m_count; //!< Number of primitives in a leaf. 0 for internal nodes.
+
+        bool IsLeaf() const { return m_count > 0; }
+    };
+
+    ///
+    /// \brief Bounding volume hierarchy over a set of primitive bounding boxes, stored as a flat
+    ///        array of nodes with the root at index 0.
+    ///
+    ///        Build() splits the primitives with the binned surface area heuristic. When the
+    ///        primitives move a little, Refit() updates the node bounds in a single pass without
+    ///        changing the tree, which is much cheaper than rebuilding it but lets the boxes
+    ///        overlap more and more, so rebuild once in a while.
+    ///
+    ///        The queries return the number of nodes they visited, which stays logarithmic in
+    ///        the number of primitives for small query regions.
+    ///
+    class BVH
+    {
+    public:
+        static constexpr size_t MAX_LEAF_SIZE = 4; //!< Default max primitives per leaf
+
+        void Build(const std::vector<AABB>& _primBounds, size_t _maxLeafSize = MAX_LEAF_SIZE);
+        void Refit(const std::vector<AABB>& _primBounds);
+
+        size_t QueryFrustum(const Frustum& _frustum, std::vector<uint32_t>& _outPrims, std::vector<uint32_t>* _outStraddlingPrims = nullptr) const;
+        size_t QueryAABB(const AABB& _aabb, std::vector<uint32_t>& _outPrims) const;
+        size_t QuerySphere(const Sphere& _sphere, std::vector<uint32_t>& _outPrims) const;
+        size_t QueryRay(const Ray& _ray, float _maxT, std::vector<uint32_t>& _outPrims) const;
+
+        template<typename IntersectFunc>
+        size_t IntersectRay(const Ray& _ray, float& _ioMaxT, IntersectFunc&& _intersect) const;
+        template<typename IntersectLeafFunc>
+        size_t IntersectRayLeaves(const Ray& _ray, float& _ioMaxT, IntersectLeafFunc&& _intersectLeaf) const;
+        template<typename IntersectLeafFunc>
+        size_t IntersectRayPacket(const RayPacket& _packet, float* _ioMaxT, IntersectLeafFunc&& _intersectLeaf) const;
+
+        bool IsEmpty() const { return m_nodes.empty(); }
+        const std::vector<BVHNode>& GetNodes() const { return m_nodes; }
+        const std::vector<uint32_t>& GetPrimIndices() const { return m_primIndices; }
+
+        static inline bool RayHitsAABB(const AABB& _aabb, const glm::vec3& _origin, const glm::vec3& _invDir, float _maxT, float& _outTNear);
+
+    private:
+        struct BuildEntry
+        {
+            uint32_t m_node;  //!< Node to split
+            uint32_t m_first; //!< First entry of the node's primitives in m_primIndices
+            uint32_t m_count; //!< Number of primitives under the node
+            uint32_t m_depth; //!< Depth of the node, the root being 0
+        };
+
+        uint32_t PartitionSAH(const std::vector<AABB>& _primBounds, const std::vector<glm::vec3>& _centroids, const BuildEntry& _entry);
+        uint32_t PartitionMedian(const std::vector<glm::vec3>& _centroids, const BuildEntry& _entry);
+        void CalcLeafBounds(BVHNode& _node) const;
+        size_t AppendSubtreePrims(uint32_t _node, std::vector<uint32_t>& _outPrims) const;
+
+        template<typename OverlapFunc>
+        size_t QueryOverlaps(OverlapFunc&& _overlaps, std::vector<uint32_t>& _outPrims) const;
+
+        static constexpr size_t MAX_DEPTH = 64; //!< Size of the traversal stacks. Build() never goes deeper.
+
+        std::vector<BVHNode> m_nodes;        //!< Nodes, root first. Children always come after their parent.
+        std::vector<uint32_t> m_primIndices; //!< Primitive indices, grouped by leaf. Each subtree's are contiguous.
+        std::vector<AABB> m_primBounds;      //!< Bounds of the primitives, in the same order as m_primIndices
+    };
+
+    ///
+    /// \brief Slab test of a ray against a box.
+    ///
+    /// \param _aabb     - Box to test
+    /// \param _origin   - Ray origin
+    /// \param _invDir   - 1 / the ray direction, per component
+    /// \param _maxT     - Max distance along the ray
+    /// \param _outTNear - Set to the distance at which the ray enters the box, if it hits
+    ///
+    /// \return Whether the ray hits the box between 0 and _maxT
+    ///
+    bool BVH::RayHitsAABB(const AABB& _aabb, const glm::vec3& _origin, const glm::vec3& _invDir, float _maxT, float& _outTNear)
+    {
+        glm::vec3 t0 = (_aabb.m_min - _origin) * _invDir;
+        glm::vec3 t1 = (_aabb.m_max - _origin) * _invDir;
+        glm::vec3 tMin = glm::min(t0, t1);
+        glm::vec3 tMax = glm::max(t0, t1);
+        float tNear = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+        float tFar = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, _maxT));
+        _outTNear = tNear;
+        return tNear <= tFar;
+    }
+
+    ///
+    /// \brief Finds the closest hit of _ray with the primitives, visiting nodes front to back
+    ///        and skipping any that start beyond the closest hit so far.
+    ///
+    /// \param _ray       - Ray to cast
+    /// \param _ioMaxT    - Max distance along the ray. Set to the distance to the closest hit.
+    /// \param _intersect - Callable as float(uint32_t _prim, float _maxT), returning the
+    ///                     distance to the primitive's hit, or anything >= _maxT if it misses
+    ///                     or hits further away
+    ///
+    /// \return Number of nodes visited
+    ///
+    template<typename IntersectFunc>
+    size_t BVH::IntersectRay(const Ray& _ray, float& _ioMaxT, IntersectFunc&& _intersect) const
+    {
+        return IntersectRayLeaves(_ray, _ioMaxT, [&](uint32_t _first, uint32_t _count, float _maxT)
+        {
+            for ( uint32_t i = _first; i < _first + _count; i++ )
+            {
+                _maxT = std::min(_maxT, _intersect(m_primIndices[i], _maxT));
+            }
+            return _maxT;
+        });
+    }
+
+    ///
+    /// \brief Same as IntersectRay(), but hands each leaf over whole, so the primitives of a
+    ///        leaf can be tested together (e.g. with SIMD) if they are stored in leaf order.
+    ///
+    /// \param _ray           - Ray to cast
+    /// \param _ioMaxT        - Max distance along the ray. Set to the distance to the closest hit.
+    /// \param _intersectLeaf - Callable as float(uint32_t _first, uint32_t _count, float _maxT),
+    ///                         testing the primitives at entries [_first, _first + _count) of
+    ///                         GetPrimIndices() and returning the distance to the closest hit,
+    ///                         or anything >= _maxT if none is closer
+    ///
+    /// \return Number of nodes visited
+    ///
+    template<typename IntersectLeafFunc>
+    size_t BVH::IntersectRayLeaves(const Ray& _ray, float& _ioMaxT, IntersectLeafFunc&& _intersectLeaf) const
+    {
+        if ( m_nodes.empty() )
+        {
+            return 0;
+        }
+
+        glm::vec3 invDir = 1.0f / _ray.m_dir;
+        float tNear = 0.0f;
+        if ( !RayHitsAABB(m_nodes[0].m_bounds, _ray.m_origin, invDir, _ioMaxT, tNear) )
+        {
+            return 1;
+        }
+
+        // Far children put off for later, with the distance at which the ray enters them
+        std::pair<uint32_t, float> stack[MAX_DEPTH];
+        size_t stackSize = 0;
+        uint32_t nodeIdx = 0;
+        size_t numVisited = 1;
+        while ( true )
+        {
+            const BVHNode& node = m_nodes[nodeIdx];
+            if ( node.IsLeaf() )
+            {
+                _ioMaxT = std::min(_ioMaxT, _intersectLeaf(node.m_first, node.m_count, _ioMaxT));
+            }
+            else
+            {
+                uint32_t nearChild = node.m_first;
+                uint32_t farChild = node.m_first + 1;
+                float tNearChild = 0.0f;
+                float tFarChild = 0.0f;
+                bool hitsNear = RayHitsAABB(m_nodes[nearChild].m_bounds, _ray.m_origin, invDir, _ioMaxT, tNearChild);
+                bool hitsFar = RayHitsAABB(m_nodes[farChild].m_bounds, _ray.m_origin, invDir, _ioMaxT, tFarChild);
+                numVisited += 2;
+                if ( hitsNear && hitsFar )
+                {
+                    if ( tFarChild < tNearChild )
+                    {
+                        std::swap(nearChild, farChild);
+                        std::swap(tNearChild, tFarChild);
+                    }
+                    stack[stackSize++] = std::make_pair(farChild, tFarChild);
+                    nodeIdx = nearChild;
+                    continue;
+                }
+                if ( hitsNear || hitsFar )
+                {
+                    nodeIdx = hitsNear ? nearChild : farChild;
+                    continue;
+                }
+            }
+
+            // Pop the next far child that still starts before the closest hit
+            while ( stackSize > 0 && stack[stackSize - 1].second > _ioMaxT )
+            {
+                stackSize--;
+            }
+            if ( stackSize == 0 )
+            {
+                break;
+            }
+            nodeIdx = stack[--stackSize].first;
+        }
+
+        return numVisited;
+    }
+
+    ///
+    /// \brief Finds the closest hits of the rays of a packet with the primitives, walking the
+    ///        tree once for the whole packet. Each node is tested against all the rays that hit
+    ///        its parent, and is skipped once none of them hit it before their closest hit so far.
+    ///        Children are visited in the order of the closest distance at which any ray enters
+    ///        them.
+    ///
+    ///        This is worth it for coherent rays, that mostly visit the same nodes. Divergent
+    ///        rays end up visiting the union of the nodes each would visit alone.
+    ///
+    /// \param _packet        - Rays to cast
+    /// \param _ioMaxT        - RayPacket::SIZE floats with the max distance along each ray. The
+    ///                         leaf function lowers them as it finds closer hits.
+    /// \param _intersectLeaf - Callable as void(uint32_t _first, uint32_t _count, uint32_t _mask),
+    ///                         testing the rays in _mask against the primitives at entries
+    ///                         [_first, _first + _count) of GetPrimIndices() and lowering their
+    ///                         entries of _ioMaxT to the distances to any closer hits
+    ///
+    /// \return Number of nodes visited
+    ///
+    template<typename IntersectLeafFunc>
+    size_t BVH::IntersectRayPacket(const RayPacket& _packet, float* _ioMaxT, IntersectLeafFunc&& _intersectLeaf) const
+    {
+        if ( m_nodes.empty() )
+        {
+            return 0;
+        }
+
+        float tNear = 0.0f;
+        uint32_t mask = _packet.IntersectAABB(m_nodes[0].m_bounds, _ioMaxT, _packet.m_activeMask, tNear);
+        if ( mask == 0 )
+        {
+            return 1;
+        }
+
+        // Far children put off for later, with the rays that hit them and the closest
+        // distance at which any of those rays enter them
+        struct StackEntry
+        {
+            uint32_t m_node;
+            uint32_t m_mask;
+            float m_tNear;
+        };
+        StackEntry stack[MAX_DEPTH];
+        size_t stackSize = 0;
+        uint32_t nodeIdx = 0;
+        size_t numVisited = 1;
+        while ( true )
+        {
+            const BVHNode& node = m_nodes[nodeIdx];
+            if ( node.IsLeaf() )
+            {
+                _intersectLeaf(node.m_first, node.m_count, mask);
+            }
+            else
+            {
+                uint32_t nearChild = node.m_first;
+                uint32_t farChild = node.m_first + 1;
+                float tNearChild = 0.0f;
+                float tFarChild = 0.0f;
+                uint32_t nearMask = _packet.IntersectAABB(m_nodes[nearChild].m_bounds, _ioMaxT, mask, tNearChild);
+                uint32_t farMask = _packet.IntersectAABB(m_nodes[farChild].m_bounds, _ioMaxT, mask, tFarChild);
+                numVisited += 2;
+                if ( nearMask != 0 && farMask != 0 )
+                {
+                    if ( tFarChild < tNearChild )
+                    {
+                        std::swap(nearChild, farChild);
+                        std::swap(nearMask, farMask);
+                        std::swap(tNearChild, tFarChild);
+                    }
+                    stack[stackSize++] = { farChild, farMask, tFarChild };
+                    nodeIdx = nearChild;
+                    mask = nearMask;
+                    continue;
+                }
+                if ( nearMask != 0 || farMask != 0 )
+                {
+                    nodeIdx = nearMask != 0 ? nearChild : farChild;
+                    mask = nearMask | farMask;
+                    continue;
+                }
+            }
+
+            // Pop the next far child that some of its rays may still hit before their closest hit
+            while ( stackSize > 0 )
+            {
+                const StackEntry& entry = stack[stackSize - 1];
+                float maxT = 0.0f;
+                for ( uint32_t lane = 0, bits = entry.m_mask; bits != 0; lane++, bits >>= 1 )
+                {
+                    if ( bits & 1 )
+                    {
+                        maxT = std::max(maxT, _ioMaxT[lane]);
+                    }
+                }
+                if ( entry.m_tNear <= maxT )
+                {
+                    break;
+                }
+                stackSize--;
+            }
+            if ( stackSize == 0 )
+            {
+                break;
+            }
+            stackSize--;
+            nodeIdx = stack[stackSize].m_node;
+            mask = stack[stackSize].m_mask;
+        }
+
+        return numVisited;
+    }
+}
+
+#endif // BVH_H
@@ -0,0 +1,118 @@
+#include "Frustum.h"
+#include <cmath>
+
+namespace blithe
+{
+    constexpr size_t Frustum::NUM_PLANES;
+
+    ///
+    /// \brief Extracts the frustum planes from a projection matrix (Gribb and Hartmann). The
+    ///        planes are in the space the matrix maps from, so a view-projection matrix gives a
+    ///        world space frustum and a model-view-projection matrix a model space one.
+    ///
+    ///        The side planes can be pulled in to a rectangle of the screen, e.g. a marquee, to
+    ///        get the sub-frustum of everything that projects into it.
+    ///
+    /// \param _matrix - Matrix mapping to clip space
+    /// \param _ndcMin - Bottom left corner of the rectangle, in normalized device coordinates
+    /// \param _ndcMax - Top right corner of the rectangle, in normalized device coordinates
+    ///
+    /// \return Frustum with normalized planes
+    ///
+    Frustum Frustum::FromMatrix(const glm::mat4& _matrix, glm::vec2 _ndcMin, glm::vec2 _ndcMax)
+    {
+        // glm is column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+        glm::vec4 rows[4];
+        for ( int i = 0; i < 4; i++ )
+        {
+            rows[i] = glm::vec4(_matrix[0][i], _matrix[1][i], _matrix[2][i], _matrix[3][i]);
+        }
+
+        glm::vec4 coeffs[NUM_PLANES] = {
+            rows[0] - _ndcMin.x * rows[3], // Left, x >= _ndcMin.x * w
+            _ndcMax.x * rows[3] - rows[0], // Right, x <= _ndcMax.x * w
+            rows[1] - _ndcMin.y * rows[3], // Bottom, y >= _ndcMin.y * w
+            _ndcMax.y * rows[3] - rows[1], // Top, y <= _ndcMax.y * w
+            rows[3] + rows[2],             // Near
+            rows[3] - rows[2],             // Far
+        };
+
+        Frustum frustum;
+        for ( size_t i = 0; i < NUM_PLANES; i++ )
+        {
+            glm::vec3 normal(coeffs[i]);
+            float length = glm::length(normal);
+            frustum.m_planes[i].m_normal = normal / length;
+            frustum.m_planes[i].m_d = coeffs[i].w / length;
+        }
+        return frustum;
+    }
+
+    ///
+    /// \brief Conservatively checks whether _sphere overlaps the frustum. Spheres just outside a
+    ///        corner of the frustum can pass.
+    ///
+    /// \param _sphere - Sphere to test
+    ///
+    /// \return false if the sphere is certainly outside the frustum
+    ///
+    bool Frustum::Intersects(const Sphere& _sphere) const
+    {
+        for ( const Plane& plane : m_planes )
+        {
+            if ( glm::dot(plane.m_normal, _sphere.m_center) + plane.m_d < -_sphere.m_radius )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ///
+    /// \brief Conservatively checks whether _aabb overlaps the frustum, by testing the corner
+    ///        furthest along each plane's normal. Boxes just outside a corner of the frustum can
+    ///        pass.
+    ///
+    /// \param _aabb - Box to test
+    ///
+    /// \return false if the box is certainly outside the frustum
+    ///
+    bool Frustum::Intersects(const AABB& _aabb) const
+    {
+        for ( const Plane& plane : m_planes )
+        {
+            glm::vec3 positiveCorner(plane.m_normal.x >= 0.0f ? _aabb.m_max.x : _aabb.m_min.x,
+                                     plane.m_normal.y >= 0.0f ? _aabb.m_max.y : _aabb.m_min.y,
+                                     plane.m_normal.z >= 0.0f ? _aabb.m_max.z : _aabb.m_min.z);
+            if ( glm::dot(plane.m_normal, positiveCorner) + plane.m_d < 0.0f )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ///
+    /// \brief Conservatively checks whether _obb overlaps the frustum. Like the AABB test, a
+    ///        box is only rejected if it's entirely behind one of the planes, i.e. if its
+    ///        center is further behind than its extents projected onto the normal.
+    ///
+    /// \param _obb - Box to test
+    ///
+    /// \return false if the box is certainly outside the frustum
+    ///
+    bool Frustum::Intersects(const OBB& _obb) const
+    {
+        for ( const Plane& plane : m_planes )
+        {
+            float radius = std::abs(glm::dot(plane.m_normal, _obb.m_axes[0])) * _obb.m_halfExtents.x +
+                           std::abs(glm::dot(plane.m_normal, _obb.m_axes[1])) * _obb.m_halfExtents.y +
+                           std::abs(glm::dot(plane.m_normal, _obb.m_axes[2])) * _obb.m_halfExtents.z;
+            if ( glm::dot(plane.m_normal, _obb.m_center) + plane.m_d < -radius )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <array>
+#include <glm/glm.hpp>
+#include "AABB.h"
+#include "OBB.h"
+#include "Plane.h"
+#include "Sphere.h"
+
+namespace blithe
+{
+    ///
+    /// \brief View frustum as 6 planes whose normals point inwards. Points inside the frustum
+    ///        are on the positive side of all of them.
+    ///
+    struct Frustum
+    {
+        static constexpr size_t NUM_PLANES = 6;
+
+        std::array<Plane, NUM_PLANES> m_planes; //!< Left, right, bottom, top, near and far planes
+
+        static Frustum FromMatrix(const glm::mat4& _matrix,
+                                  glm::vec2 _ndcMin = glm::vec2(-1.0f),
+                                  glm::vec2 _ndcMax = glm::vec2(1.0f));
+
+        bool Intersects(const Sphere& _sphere) const;
+        bool Intersects(const AABB& _aabb) const;
+        bool Intersects(const OBB& _obb) const;
+    };
+}
+
+#endif // FRUSTUM_H
@@ -1,64 +1,581 @@
 #include "GeomHelpers.h"
+#include "BlitheAssert.h"
+#include "BlitheSIMD.h"
 #include "Mesh.h"
+#include "MeshSoA.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <glm/gtc/constants.hpp>
+#include <tracy/Tracy.hpp>
 
 namespace blithe
 {
+    namespace
+    {
+        const size_t TRANSFORM_CHUNK_SIZE = 16384; // Boxes per ThreadPool task in TransformAABBs(). A multiple of 8.
+
+        ///
+        /// \brief Transforms boxes [_first, _last) of _aabbs by the matching matrices of _mats
+        ///        into _outAABBs. See GeomHelpers::TransformAABBs().
+        ///
+        void TransformAABBRange(const AABBArrays& _aabbs, const glm::mat4* _mats, size_t _first, size_t _last, AABBArrays& _outAABBs)
+        {
+            const float* mins[3] = { _aabbs.m_minX.data(), _aabbs.m_minY.data(), _aabbs.m_minZ.data() };
+            const float* maxs[3] = { _aabbs.m_maxX.data(), _aabbs.m_maxY.data(), _aabbs.m_maxZ.data() };
+            float* outMins[3] = { _outAABBs.m_minX.data(), _outAABBs.m_minY.data(), _outAABBs.m_minZ.data() };
+            float* outMaxs[3] = { _outAABBs.m_maxX.data(), _outAABBs.m_maxY.data(), _outAABBs.m_maxZ.data() };
+
+            // The terms are summed in the same order as glm's mat4 * vec4, ((x + y) + (z + w)),
+            // so the boxes match TransformAABB()'s.
+            size_t i = _first;
+#if defined(BLITHE_SIMD_AVX2)
+            // Gather each matrix element of 8 consecutive matrices, 16 floats apart
+            const __m256i matOffsets = _mm256_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112);
+            for ( ; i + 8 <= _last; i += 8 )
+            {
+                const float* mat = &_mats[i][0][0];
+                __m256 lo[3];
+                __m256 hi[3];
+                for ( int axis = 0; axis < 3; axis++ )
+                {
+                    lo[axis] = _mm256_loadu_ps(mins[axis] + i);
+                    hi[axis] = _mm256_loadu_ps(maxs[axis] + i);
+                }
+                __m256 outLo[3];
+                __m256 outHi[3];
+                for ( int row = 0; row < 3; row++ )
+                {
+                    __m256 termLo[3];
+                    __m256 termHi[3];
+                    for ( int col = 0; col < 3; col++ )
+                    {
+                        __m256 m = _mm256_i32gather_ps(mat + col * 4 + row, matOffsets, 4);
+                        __m256 a = _mm256_mul_ps(m, lo[col]);
+                        __m256 b = _mm256_mul_ps(m, hi[col]);
+                        termLo[col] = _mm256_min_ps(a, b);
+                        termHi[col] = _mm256_max_ps(a, b);
+                    }
+                    __m256 translation = _mm256_i32gather_ps(mat + 12 + row, matOffsets, 4);
+                    outLo[row] = _mm256_add_ps(_mm256_add_ps(termLo[0], termLo[1]), _mm256_add_ps(termLo[2], translation));
+                    outHi[row] = _mm256_add_ps(_mm256_add_ps(termHi[0], termHi[1]), _mm256_add_ps(termHi[2], translation));
+                }
+                // Stored after all the loads, in case _outAABBs is _aabbs
+                for ( int axis = 0; axis < 3; axis++ )
+                {
+                    _mm256_storeu_ps(outMins[axis] + i, outLo[axis]);
+                    _mm256_storeu_ps(outMaxs[axis] + i, outHi[axis]);
+                }
+            }
+#elif defined(BLITHE_SIMD_SSE2)
+            for ( ; i + 4 <= _last; i += 4 )
+            {
+                const glm::mat4* mats = _mats + i;
+                __m128 lo[3];
+                __m128 hi[3];
+                for ( int axis = 0; axis < 3; axis++ )
+                {
+                    lo[axis] = _mm_loadu_ps(mins[axis] + i);
+                    hi[axis] = _mm_loadu_ps(maxs[axis] + i);
+                }
+                __m128 outLo[3];
+                __m128 outHi[3];
+                for ( int row = 0; row < 3; row++ )
+                {
+                    __m128 termLo[3];
+                    __m128 termHi[3];
+                    for ( int col = 0; col < 3; col++ )
+                    {
+                        __m128 m = _mm_setr_ps(mats[0][col][row], mats[1][col][row], mats[2][col][row], mats[3][col][row]);
+                        __m128 a = _mm_mul_ps(m, lo[col]);
+                        __m128 b = _mm_mul_ps(m, hi[col]);
+                        termLo[col] = _mm_min_ps(a, b);
+                        termHi[col] = _mm_max_ps(a, b);
+                    }
+                    __m128 translation = _mm_setr_ps(mats[0][3][row], mats[1][3][row], mats[2][3][row], mats[3][3][row]);
+                    outLo[row] = _mm_add_ps(_mm_add_ps(termLo[0], termLo[1]), _mm_add_ps(termLo[2], translation));
+                    outHi[row] = _mm_add_ps(_mm_add_ps(termHi[0], termHi[1]), _mm_add_ps(termHi[2], translation));
+                }
+                // Stored after all the loads, in case _outAABBs is _aabbs
+                for ( int axis = 0; axis < 3; axis++ )
+                {
+                    _mm_storeu_ps(outMins[axis] + i, outLo[axis]);
+                    _mm_storeu_ps(outMaxs[axis] + i, outHi[axis]);
+                }
+            }
+#endif
+            for ( ; i < _last; i++ )
+            {
+                const glm::mat4& mat = _mats[i];
+                float lo[3] = { mins[0][i], mins[1][i], mins[2][i] };
+                float hi[3] = { maxs[0][i], maxs[1][i], maxs[2][i] };
+                for ( int row = 0; row < 3; row++ )
+                {
+                    float termLo[3];
+                    float termHi[3];
+                    for ( int col = 0; col < 3; col++ )
+                    {
+                        float a = mat[col][row] * lo[col];
+                        float b = mat[col][row] * hi[col];
+                        termLo[col] = std::min(a, b);
+                        termHi[col] = std::max(a, b);
+                    }
+                    outMins[row][i] = (termLo[0] + termLo[1]) + (termLo[2] + mat[3][row]);
+                    outMaxs[row][i] = (termHi[0] + termHi[1]) + (termHi[2] + mat[3][row]);
+                }
+            }
+        }
+
+        ///
+        /// \brief Finds the eigenvectors of a symmetric 3x3 matrix with cyclic Jacobi rotations
+        ///
+        /// \param _ioMat         - Symmetric matrix. Left (nearly) diagonal, with the eigenvalues
+        ///                         on the diagonal.
+        /// \param _outEigenvecs - Set to the eigenvectors, as columns (_outEigenvecs[row][col])
+        ///
+        void CalcSymmetricEigenvectors(double _ioMat[3][3], double _outEigenvecs[3][3])
+        {
+            for ( int row = 0; row < 3; row++ )
+            {
+                for ( int col = 0; col < 3; col++ )
+                {
+                    _outEigenvecs[row][col] = row == col ? 1.0 : 0.0;
+                }
+            }
+
+            const int pairs[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+            for ( int sweep = 0; sweep < 32; sweep++ )
+            {
+                double offDiagonal = std::abs(_ioMat[0][1]) + std::abs(_ioMat[0][2]) + std::abs(_ioMat[1][2]);
+                double diagonal = std::abs(_ioMat[0][0]) + std::abs(_ioMat[1][1]) + std::abs(_ioMat[2][2]);
+                if ( offDiagonal <= 1e-12 * diagonal )
+                {
+                    break;
+                }
+
+                for ( const int* pair : pairs )
+                {
+                    int p = pair[0];
+                    int q = pair[1];
+                    if ( _ioMat[p][q] == 0.0 )
+                    {
+                        continue;
+                    }
+
+                    // Rotation in the pq plane that zeroes _ioMat[p][q] (Numerical Recipes 11.1)
+                    double theta = (_ioMat[q][q] - _ioMat[p][p]) / (2.0 * _ioMat[p][q]);
+                    double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                    double c = 1.0 / std::sqrt(t * t + 1.0);
+                    double s = t * c;
+                    for ( int k = 0; k < 3; k++ )
+                    {
+                        double kp = _ioMat[k][p];
+                        double kq = _ioMat[k][q];
+                        _ioMat[k][p] = c * kp - s * kq;
+                        _ioMat[k][q] = s * kp + c * kq;
+                    }
+                    for ( int k = 0; k < 3; k++ )
+                    {
+                        double pk = _ioMat[p][k];
+                        double qk = _ioMat[q][k];
+                        _ioMat[p][k] = c * pk - s * qk;
+                        _ioMat[q][k] = s * pk + c * qk;
+                    }
+                    for ( int k = 0; k < 3; k++ )
+                    {
+                        double kp = _outEigenvecs[k][p];
+                        double kq = _outEigenvecs[k][q];
+                        _outEigenvecs[k][p] = c * kp - s * kq;
+                        _outEigenvecs[k][q] = s * kp + c * kq;
+                    }
+                }
+            }
+        }
+
+        float CalcVolume(const glm::vec3& _halfExtents)
+        {
+            return _halfExtents.x * _halfExtents.y * _halfExtents.z;
+        }
+
+        const size_t REDUCE_CHUNK_SIZE = 65536;  // Vertices per chunk of the mesh reductions. Fixed, so the results don't depend on the thread count.
+        const size_t PAIRWISE_BLOCK_SIZE = 128;  // Vertices SumPositions() adds up directly instead of splitting them in two
+
+        // The SIMD paths load 4 floats from each m_pos, so there must be a float after it
+        static_assert(offsetof(Vertex, m_pos) + 4 * sizeof(float) <= sizeof(Vertex), "The SIMD paths read a float past Vertex::m_pos");
+
+        // The kernels below take either the vertices of a Mesh or the positions of a MeshSoA
+        const glm::vec3& GetPosition(const Vertex& _vertex) { return _vertex.m_pos; }
+        const glm::vec3& GetPosition(const glm::vec3& _pos) { return _pos; }
+
+#if defined(BLITHE_SIMD_SSE2)
+        ///
+        /// \brief Loads the position of _vertex into the x, y and z lanes. The w lane gets the
+        ///        float after it.
+        ///
+        __m128 LoadPosition(const Vertex& _vertex)
+        {
+            return _mm_loadu_ps(&_vertex.m_pos.x);
+        }
+
+        ///
+        /// \brief Loads _pos into the x, y and z lanes. Packed positions have no float to spare
+        ///        after the last one, so it's loaded as xy and then z. The w lane gets 0.
+        ///
+        __m128 LoadPosition(const glm::vec3& _pos)
+        {
+            __m128 xy = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&_pos.x)));
+            return _mm_movelh_ps(xy, _mm_load_ss(&_pos.z));
+        }
+#endif
+
+        ///
+        /// \brief Calls _chunkFunc(chunk, first, last) for each _chunkSize chunk of [0, _size),
+        ///        spread over the shared ThreadPool, and returns once they've all run.
+        ///
+        ///        The calling thread takes chunks too, and only waits for the chunks that workers
+        ///        have already started. So this doesn't stall behind long pool tasks, and can't
+        ///        deadlock when it's called from a ThreadPool task while every worker is busy
+        ///        (e.g. VertexPacker::Pack() in MeshUploadService).
+        ///
+        /// \param _size      - Number of items to split into chunks
+        /// \param _chunkSize - Number of items per chunk
+        /// \param _chunkFunc - Callable processing a chunk of items
+        ///
+        template<typename ChunkFunc>
+        void ForEachChunk(size_t _size, size_t _chunkSize, const ChunkFunc& _chunkFunc)
+        {
+            size_t numChunks = (_size + _chunkSize - 1) / _chunkSize;
+            if ( numChunks <= 1 )
+            {
+                if ( numChunks == 1 )
+                {
+                    _chunkFunc(0, 0, _size);
+                }
+                return;
+            }
+
+            // Shared with the workers, since some may only start after we've returned
+            struct ChunkState
+            {
+                std::atomic<size_t> m_nextChunk{0};
+                size_t m_numDone = 0;
+                std::mutex m_mutex;
+                std::condition_variable m_allDone;
+            };
+            auto state = std::make_shared<ChunkState>();
+
+            // _chunkFunc is only used while there are chunks left, i.e. before we return
+            auto work = [state, numChunks, _size, _chunkSize, &_chunkFunc]() {
+                for ( size_t chunk = state->m_nextChunk++; chunk < numChunks; chunk = state->m_nextChunk++ )
+                {
+                    size_t first = chunk * _chunkSize;
+                    _chunkFunc(chunk, first, std::min(first + _chunkSize, _size));
+
+                    std::lock_guard<std::mutex> lock(state->m_mutex);
+                    if ( ++state->m_numDone == numChunks )
+                    {
+                        state->m_allDone.notify_one();
+                    }
+                }
+            };
+
+            ThreadPool& pool = ThreadPool::GetShared();
+            size_t numHelpers = std::min(numChunks - 1, pool.GetNumThreads());
+            for ( size_t i = 0; i < numHelpers; i++ )
+            {
+                pool.Submit(work);
+            }
+            work();
+
+            std::unique_lock<std::mutex> lock(state->m_mutex);
+            state->m_allDone.wait(lock, [&state, numChunks]() { return state->m_numDone == numChunks; });
+        }
+
+        ///
+        /// \brief Calls _chunkFunc(first, last) for each REDUCE_CHUNK_SIZE chunk of [0, _size)
+        ///        with ForEachChunk(), and returns the results in chunk order.
+        ///
+        /// \param _size      - Number of items to split into chunks
+        /// \param _chunkFunc - Callable reducing a range of items to a T
+        ///
+        /// \return Result of each chunk
+        ///
+        template<typename T, typename ChunkFunc>
+        std::vector<T> ReduceChunks(size_t _size, const ChunkFunc& _chunkFunc)
+        {
+            std::vector<T> results((_size + REDUCE_CHUNK_SIZE - 1) / REDUCE_CHUNK_SIZE);
+            ForEachChunk(_size, REDUCE_CHUNK_SIZE, [&results, &_chunkFunc](size_t _chunk, size_t _first, size_t _last) {
+                results[_chunk] = _chunkFunc(_first, _last);
+            });
+            return results;
+        }
+
+        ///
+        /// \brief Sums the positions of _count vertices pairwise: the range is split in two until
+        ///        it's at most PAIRWISE_BLOCK_SIZE, so the rounding error grows with log(_count)
+        ///        instead of _count. Every path adds the same numbers in the same order, so they
+        ///        all give the same bits.
+        ///
+        /// \param _vertices - First vertex (Vertex or position)
+        /// \param _count    - Number of vertices
+        ///
+        /// \return Sum of the positions
+        ///
+        template<typename VertexType>
+        glm::vec3 SumPositions(const VertexType* _vertices, size_t _count)
+        {
+            if ( _count > PAIRWISE_BLOCK_SIZE )
+            {
+                size_t half = _count / 2;
+                return SumPositions(_vertices, half) + SumPositions(_vertices + half, _count - half);
+            }
+
+            // One running sum per vertex index mod 4, added as ((0 + 1) + (2 + 3))
+            size_t i = 0;
+#if defined(BLITHE_SIMD_SSE2)
+            __m128 sums[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+            for ( ; i + 4 <= _count; i += 4 )
+            {
+                sums[0] = _mm_add_ps(sums[0], LoadPosition(_vertices[i]));
+                sums[1] = _mm_add_ps(sums[1], LoadPosition(_vertices[i + 1]));
+                sums[2] = _mm_add_ps(sums[2], LoadPosition(_vertices[i + 2]));
+                sums[3] = _mm_add_ps(sums[3], LoadPosition(_vertices[i + 3]));
+            }
+            for ( ; i < _count; i++ )
+            {
+                sums[i % 4] = _mm_add_ps(sums[i % 4], LoadPosition(_vertices[i]));
+            }
+            float sum[4];
+            _mm_storeu_ps(sum, _mm_add_ps(_mm_add_ps(sums[0], sums[1]), _mm_add_ps(sums[2], sums[3])));
+            return glm::vec3(sum[0], sum[1], sum[2]);
+#else
+            glm::vec3 sums[4] = { glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f) };
+            for ( ; i + 4 <= _count; i += 4 )
+            {
+                sums[0] += GetPosition(_vertices[i]);
+                sums[1] += GetPosition(_vertices[i + 1]);
+                sums[2] += GetPosition(_vertices[i + 2]);
+                sums[3] += GetPosition(_vertices[i + 3]);
+            }
+            for ( ; i < _count; i++ )
+            {
+                sums[i % 4] += GetPosition(_vertices[i]);
+            }
+            return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#endif
+        }
+
+        ///
+        /// \brief Adds up _count partial sums pairwise, like SumPositions()
+        ///
+        /// \param _sums  - Sums to add. At least one.
+        /// \param _count - Number of sums
+        ///
+        /// \return Total
+        ///
+        glm::vec3 SumPairwise(const glm::vec3* _sums, size_t _count)
+        {
+            if ( _count == 1 )
+            {
+                return _sums[0];
+            }
+            size_t half = _count / 2;
+            return SumPairwise(_sums, half) + SumPairwise(_sums + half, _count - half);
+        }
+
+        ///
+        /// \brief Finds the box around the positions of _count vertices, optionally transformed
+        ///        by _mat. The positions are transformed with the same rounding as glm's
+        ///        mat4 * vec4, ((x + y) + (z + w)), so the box matches transforming each one.
+        ///
+        /// \param _vertices - First vertex (Vertex or position)
+        /// \param _count    - Number of vertices. At least one.
+        /// \param _mat      - Matrix to transform the positions by, or nullptr for none
+        ///
+        /// \return Box around the (transformed) positions
+        ///
+        template<typename VertexType>
+        AABB CalcPositionBounds(const VertexType* _vertices, size_t _count, const glm::mat4* _mat)
+        {
+#if defined(BLITHE_SIMD_SSE2)
+            // Two boxes, for the even and odd vertices, to overlap the min/max latencies
+            __m128 cols[4];
+            for ( int col = 0; col < 4 && _mat; col++ )
+            {
+                cols[col] = _mm_loadu_ps(&(*_mat)[col][0]);
+            }
+            auto loadPos = [&cols, _mat](const VertexType& _vertex) {
+                __m128 pos = LoadPosition(_vertex);
+                if ( !_mat )
+                {
+                    return pos;
+                }
+                __m128 xy = _mm_add_ps(_mm_mul_ps(cols[0], _mm_shuffle_ps(pos, pos, 0x00)), _mm_mul_ps(cols[1], _mm_shuffle_ps(pos, pos, 0x55)));
+                return _mm_add_ps(xy, _mm_add_ps(_mm_mul_ps(cols[2], _mm_shuffle_ps(pos, pos, 0xAA)), cols[3]));
+            };
+            __m128 lo[2];
+            __m128 hi[2];
+            lo[0] = lo[1] = hi[0] = hi[1] = loadPos(_vertices[0]);
+            size_t i = 1;
+            for ( ; i + 2 <= _count; i += 2 )
+            {
+                __m128 pos0 = loadPos(_vertices[i]);
+                __m128 pos1 = loadPos(_vertices[i + 1]);
+                lo[0] = _mm_min_ps(lo[0], pos0);
+                hi[0] = _mm_max_ps(hi[0], pos0);
+                lo[1] = _mm_min_ps(lo[1], pos1);
+                hi[1] = _mm_max_ps(hi[1], pos1);
+            }
+            if ( i < _count )
+            {
+                __m128 pos = loadPos(_vertices[i]);
+                lo[0] = _mm_min_ps(lo[0], pos);
+                hi[0] = _mm_max_ps(hi[0], pos);
+            }
+            float min[4];
+            float max[4];
+            _mm_storeu_ps(min, _mm_min_ps(lo[0], lo[1]));
+            _mm_storeu_ps(max, _mm_max_ps(hi[0], hi[1]));
+            return { glm::vec3(min[0], min[1], min[2]), glm::vec3(max[0], max[1], max[2]) };
+#else
+            auto loadPos = [_mat](const VertexType& _vertex) {
+                const glm::vec3& pos = GetPosition(_vertex);
+                return _mat ? glm::vec3(*_mat * glm::vec4(pos, 1.0f)) : pos;
+            };
+            AABB aabb;
+            aabb.m_min = aabb.m_max = loadPos(_vertices[0]);
+            for ( size_t i = 1; i < _count; i++ )
+            {
+                glm::vec3 pos = loadPos(_vertices[i]);
+                aabb.m_min = glm::min(aabb.m_min, pos);
+                aabb.m_max = glm::max(aabb.m_max, pos);
+            }
+            return aabb;
+#endif
+        }
+
+        ///
+        /// \brief Finds the box around the (transformed) positions of _count vertices, in
+        ///        parallel chunks. See CalcPositionBounds().
+        ///
+        template<typename VertexType>
+        AABB CalcBounds(const VertexType* _vertices, size_t _count, const glm::mat4* _mat)
+        {
+            if ( _count == 0 )
+            {
+                return { glm::vec3(0), glm::vec3(0) };
+            }
+
+            std::vector<AABB> chunkBounds = ReduceChunks<AABB>(_count, [_vertices, _mat](size_t _first, size_t _last) {
+                return CalcPositionBounds(_vertices + _first, _last - _first, _mat);
+            });
+            AABB aabb = chunkBounds[0];
+            for ( const AABB& bounds : chunkBounds )
+            {
+                aabb.m_min = glm::min(aabb.m_min, bounds.m_min);
+                aabb.m_max = glm::max(aabb.m_max, bounds.m_max);
+            }
+            return aabb;
+        }
+
+        ///
+        /// \brief Finds the centroid of the positions of _count vertices, summing them pairwise
+        ///        in parallel chunks. See SumPositions().
+        ///
+        template<typename VertexType>
+        glm::vec3 CalcPositionCentroid(const VertexType* _vertices, size_t _count)
+        {
+            if ( _count == 0 )
+            {
+                return glm::vec3(0, 0, 0);
+            }
+
+            std::vector<glm::vec3> chunkSums = ReduceChunks<glm::vec3>(_count, [_vertices](size_t _first, size_t _last) {
+                return SumPositions(_vertices + _first, _last - _first);
+            });
+            return SumPairwise(chunkSums.data(), chunkSums.size()) / static_cast<float>(_count);
+        }
+    }
+
     ///
     /// \brief Calculates the centroid of the _mesh vertex positions.
     ///        If the _mesh has no vertices this just returns (0, 0, 0).
     ///
+    ///        The positions are summed pairwise in fixed-size chunks on the shared ThreadPool,
+    ///        and the chunk sums are then added pairwise in order, so the result is accurate for
+    ///        meshes with millions of vertices and the same however many threads there are.
+    ///
     /// \param _mesh - Mesh whose vertex position centroid is desired
     ///
     /// \return Centroid of the _mesh vertex positions.
     ///
     glm::vec3 GeomHelpers::CalcCentroid(const Mesh& _mesh)
     {
-        glm::vec3 centroid(0, 0, 0);
+        ZoneScoped;
 
-        // Do a rolling average: new_centroid = (i*old_centroid + v[i]) / (i+1)
-        for ( size_t i = 0; i < _mesh.m_vertices.size(); i++ )
-        {
-            const auto& v = _mesh.m_vertices[i].m_pos;
-            centroid = centroid + (glm::vec3(v[0], v[1], v[2]) - centroid) / static_cast<float>(i + 1);
-        }
+        return CalcPositionCentroid(_mesh.m_vertices.data(), _mesh.m_vertices.size());
+    }
+
+    ///
+    /// \brief Calculates the centroid of the _mesh vertex positions, like
+    ///        CalcCentroid(const Mesh&) and giving the same result, but only streaming the
+    ///        positions.
+    ///
+    /// \param _mesh - Mesh whose vertex position centroid is desired
+    ///
+    /// \return Centroid of the _mesh vertex positions.
+    ///
+    glm::vec3 GeomHelpers::CalcCentroid(const MeshSoA& _mesh)
+    {
+        ZoneScoped;
 
-        return centroid;
+        return CalcPositionCentroid(_mesh.m_positions.data(), _mesh.m_positions.size());
     }
 
     ///
     //// \brief Computes the local-space AABB of a mesh based on its untransformed vertices
     ///
+    ///         Big meshes are split into chunks that are bounded in parallel on the shared
+    ///         ThreadPool.
+    ///
     /// \param _mesh - The mesh whose local AABB is to be computed
     ///
     /// \return AABB enclosing all vertices in the mesh's local coordinate system
     ///
     AABB GeomHelpers::CalcLocalAABB(const Mesh& _mesh)
     {
-        AABB aabb;
+        ZoneScoped;
 
-        if ( _mesh.m_vertices.empty() )
-        {
-            aabb.m_min = glm::vec3(0);
-            aabb.m_max = glm::vec3(0);
-        }
-        else
-        {
-            aabb.m_min = _mesh.m_vertices[0].m_pos;
-            aabb.m_max = _mesh.m_vertices[0].m_pos;
-            for ( size_t i = 0; i < _mesh.m_vertices.size(); i++ )
-            {
-                const auto& p = _mesh.m_vertices[i].m_pos;
-                aabb.m_min = glm::min(aabb.m_min, p);
-                aabb.m_max = glm::max(aabb.m_max, p);
-            }
-        }
+        return CalcBounds(_mesh.m_vertices.data(), _mesh.m_vertices.size(), nullptr);
+    }
 
-        return aabb;
+    ///
+    //// \brief Computes the local-space AABB of a mesh, like CalcLocalAABB(const Mesh&), but
+    ///         only streaming the positions
+    ///
+    /// \param _mesh - The mesh whose local AABB is to be computed
+    ///
+    /// \return AABB enclosing all vertices in the mesh's local coordinate system
+    ///
+    AABB GeomHelpers::CalcLocalAABB(const MeshSoA& _mesh)
+    {
+        ZoneScoped;
+
+        return CalcBounds(_mesh.m_positions.data(), _mesh.m_positions.size(), nullptr);
     }
 
     ///
     //// \brief Computes the world-space AABB of a mesh by transforming each vertex by the model matrix.
     ///
+    ///         Big meshes are split into chunks that are bounded in parallel on the shared
+    ///         ThreadPool.
+    ///
     /// \param _mesh     - The mesh whose world-space AABB is to be computed
     /// \param _modelMat - The model matrix used to transform local vertices to world space
     ///
@@ -66,26 +583,25 @@ namespace blithe
     ///
     AABB GeomHelpers::CalcWorldAABB(const Mesh& _mesh, const glm::mat4& _modelMat)
     {
-        AABB aabb;
+        ZoneScoped;
 
-        if ( _mesh.m_vertices.empty() )
-        {
-            aabb.m_min = glm::vec3(0);
-            aabb.m_max = glm::vec3(0);
-        }
-        else
-        {
-            aabb.m_min = _modelMat * glm::vec4(_mesh.m_vertices[0].m_pos, 1.0);
-            aabb.m_max = _modelMat * glm::vec4(_mesh.m_vertices[0].m_pos, 1.0);
-            for ( size_t i = 0; i < _mesh.m_vertices.size(); i++ )
-            {
-                glm::vec3 p = _modelMat * glm::vec4(_mesh.m_vertices[i].m_pos, 1.0);
-                aabb.m_min = glm::min(aabb.m_min, p);
-                aabb.m_max = glm::max(aabb.m_max, p);
-            }
-        }
+        return CalcBounds(_mesh.m_vertices.data(), _mesh.m_vertices.size(), &_modelMat);
+    }
+
+    ///
+    //// \brief Computes the world-space AABB of a mesh, like CalcWorldAABB(const Mesh&, const glm::mat4&),
+    ///         but only streaming the positions
+    ///
+    /// \param _mesh     - The mesh whose world-space AABB is to be computed
+    /// \param _modelMat - The model matrix used to transform local vertices to world space
+    ///
+    /// \return AABB enclosing the transformed vertices in world space
+    ///
+    AABB GeomHelpers::CalcWorldAABB(const MeshSoA& _mesh, const glm::mat4& _modelMat)
+    {
+        ZoneScoped;
 
-        return aabb;
+        return CalcBounds(_mesh.m_positions.data(), _mesh.m_positions.size(), &_modelMat);
     }
 
     ///
@@ -132,6 +648,168 @@ namespace blithe
         return result;
     }
 
+    ///
+    /// \brief Transforms many boxes at once, giving the same boxes as TransformAABB() on each.
+    ///
+    ///         Uses Arvo's method: each world axis of the new box is the translation plus, for
+    ///         each local axis, the smaller (or larger) of the matrix entry times the local min
+    ///         and times the local max. That's 18 multiplies instead of transforming 8 corners,
+    ///         and it runs on 4 (SSE2) or 8 (AVX2) boxes at once. Chunks of TRANSFORM_CHUNK_SIZE
+    ///         boxes are transformed in parallel, with the calling thread taking chunks too (see
+    ///         ForEachChunk()).
+    ///
+    /// \param _aabbs    - Boxes to transform
+    /// \param _mats     - Matrix for each box
+    /// \param _outAABBs - Resized to hold the transformed boxes. Can be _aabbs.
+    ///
+    void GeomHelpers::TransformAABBs(const AABBArrays& _aabbs, const std::vector<glm::mat4>& _mats, AABBArrays& _outAABBs)
+    {
+        ZoneScoped;
+
+        ASSERT(_mats.size() == _aabbs.GetSize(), "There should be one matrix per box, but got " << _mats.size() << " matrices for " << _aabbs.GetSize() << " boxes");
+
+        size_t size = _aabbs.GetSize();
+        _outAABBs.Resize(size);
+        ForEachChunk(size, TRANSFORM_CHUNK_SIZE, [&_aabbs, &_mats, &_outAABBs](size_t /*_chunk*/, size_t _first, size_t _last) {
+            TransformAABBRange(_aabbs, _mats.data(), _first, _last, _outAABBs);
+        });
+    }
+
+    ///
+    /// \brief Fits an oriented bounding box to the _mesh vertex positions. The axes are the
+    ///        principal axes of the positions (the eigenvectors of their covariance), and the
+    ///        extents are the furthest positions along each. PCA can do worse than the local
+    ///        AABB, e.g. for a cube whose covariance has no preferred axis, so whichever box is
+    ///        smaller is returned. If the _mesh has no vertices the box is empty, at the origin.
+    ///
+    /// \param _mesh - Mesh to fit the box to
+    ///
+    /// \return Box around all the vertices, in the mesh's local space
+    ///
+    OBB GeomHelpers::CalcLocalOBB(const Mesh& _mesh)
+    {
+        return CalcLocalOBB(_mesh, CalcLocalAABB(_mesh), CalcCentroid(_mesh));
+    }
+
+    ///
+    /// \brief Fits an oriented bounding box to the _mesh vertex positions as CalcLocalOBB(_mesh)
+    ///        does, reusing the local AABB and centroid the caller already has rather than
+    ///        walking the vertices again for them.
+    ///
+    /// \param _mesh      - Mesh to fit the box to
+    /// \param _localAABB - CalcLocalAABB() of _mesh
+    /// \param _centroid  - CalcCentroid() of _mesh
+    ///
+    /// \return Box around all the vertices, in the mesh's local space
+    ///
+    OBB GeomHelpers::CalcLocalOBB(const Mesh& _mesh, const AABB& _localAABB, const glm::vec3& _centroid)
+    {
+        ZoneScoped;
+
+        if ( _mesh.m_vertices.empty() )
+        {
+            return OBB::FromAABB(_localAABB);
+        }
+
+        // Accumulate in double so big meshes far from the origin keep their precision
+        double covariance[3][3] = {};
+        for ( const Vertex& vertex : _mesh.m_vertices )
+        {
+            glm::vec3 offset = vertex.m_pos - _centroid;
+            for ( int row = 0; row < 3; row++ )
+            {
+                for ( int col = row; col < 3; col++ )
+                {
+                    covariance[row][col] += static_cast<double>(offset[row]) * static_cast<double>(offset[col]);
+                }
+            }
+        }
+        for ( int row = 0; row < 3; row++ )
+        {
+            for ( int col = 0; col < row; col++ )
+            {
+                covariance[row][col] = covariance[col][row];
+            }
+        }
+
+        double eigenvecs[3][3];
+        CalcSymmetricEigenvectors(covariance, eigenvecs);
+
+        // Keep the axes a right-handed rotation
+        glm::mat3 axes;
+        for ( int col = 0; col < 2; col++ )
+        {
+            axes[col] = glm::normalize(glm::vec3(static_cast<float>(eigenvecs[0][col]), static_cast<float>(eigenvecs[1][col]), static_cast<float>(eigenvecs[2][col])));
+        }
+        axes[1] = glm::normalize(axes[1] - glm::dot(axes[1], axes[0]) * axes[0]);
+        axes[2] = glm::cross(axes[0], axes[1]);
+
+        glm::vec3 projMin(std::numeric_limits<float>::max());
+        glm::vec3 projMax(std::numeric_limits<float>::lowest());
+        for ( const Vertex& vertex : _mesh.m_vertices )
+        {
+            glm::vec3 proj(glm::dot(vertex.m_pos, axes[0]), glm::dot(vertex.m_pos, axes[1]), glm::dot(vertex.m_pos, axes[2]));
+            projMin = glm::min(projMin, proj);
+            projMax = glm::max(projMax, proj);
+        }
+
+        OBB obb;
+        obb.m_axes = axes;
+        obb.m_center = axes * ((projMin + projMax) * 0.5f);
+        obb.m_halfExtents = (projMax - projMin) * 0.5f;
+
+        OBB aabbAsOBB = OBB::FromAABB(_localAABB);
+        return CalcVolume(aabbAsOBB.m_halfExtents) <= CalcVolume(obb.m_halfExtents) ? aabbAsOBB : obb;
+    }
+
+    ///
+    /// \brief Transforms an OBB by an affine matrix.
+    ///
+    ///         Rotations, translations and scales along the box's axes keep the box exact. A
+    ///         scale along other directions shears the box into a parallelepiped, and then the
+    ///         result is an OBB around it, aligned with its first edge.
+    ///
+    /// \param _obb - The OBB to transform
+    /// \param _mat - The affine transformation matrix to apply
+    ///
+    /// \return OBB around the transformed box
+    ///
+    OBB GeomHelpers::TransformOBB(const OBB& _obb, const glm::mat4& _mat)
+    {
+        glm::mat3 linear(_mat);
+        glm::vec3 halfEdges[3];
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            halfEdges[axis] = linear * _obb.m_axes[axis] * _obb.m_halfExtents[axis];
+        }
+
+        // Gram-Schmidt the transformed axes, falling back to the world axes if the matrix
+        // flattens the box
+        OBB result;
+        result.m_center = glm::vec3(_mat * glm::vec4(_obb.m_center, 1.0f));
+        result.m_axes = glm::mat3(1.0f);
+        glm::vec3 axis0 = linear * _obb.m_axes[0];
+        glm::vec3 axis1 = linear * _obb.m_axes[1];
+        axis1 = axis1 - glm::dot(axis1, axis0) / std::max(glm::dot(axis0, axis0), std::numeric_limits<float>::min()) * axis0;
+        glm::vec3 axis2 = glm::cross(axis0, axis1);
+        float length0 = glm::length(axis0);
+        float length1 = glm::length(axis1);
+        float length2 = glm::length(axis2);
+        if ( length0 > 0.0f && length1 > 0.0f && length2 > 0.0f )
+        {
+            result.m_axes = glm::mat3(axis0 / length0, axis1 / length1, axis2 / length2);
+        }
+
+        // Project the half edges onto the new axes. Exact when they're already along the axes.
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            result.m_halfExtents[axis] = std::abs(glm::dot(result.m_axes[axis], halfEdges[0])) +
+                                         std::abs(glm::dot(result.m_axes[axis], halfEdges[1])) +
+                                         std::abs(glm::dot(result.m_axes[axis], halfEdges[2]));
+        }
+        return result;
+    }
+
     ///
     /// \brief Creates a cuboid mesh with _sides expressing the width x height x depth, and 8
     ///        _colors for each of the vertices.
@@ -217,4 +895,72 @@ namespace blithe
 
         return Mesh{ vertices, indices };
     }
+
+    ///
+    /// \brief Creates a torus mesh. (source: chatgippity)
+    ///
+    /// \param _majorRadius    - Major radius R, the distance from the center of the torus to the center of the tube
+    /// \param _minorRadius    - Minor radius r, the radius of the tube itself
+    /// \param _numSides       - the number of subdivisions around the torus's central ring
+    /// \param _numRings       - the number of subdivisions around the torus's tube
+    /// \param _color          - Color to use for the vertices
+    /// \param _modelTransform - (optional) Transform to apply to all vertex positions.
+    ///                          Defaults to identity.
+    ///
+    /// \return Torus mesh
+    ///
+    Mesh GeomHelpers::CreateTorus(float _majorRadius, float _minorRadius,
+                                  int _numSides, int _numRings,
+                                  const glm::vec4& _color,
+                                  const glm::mat4& _modelTransform/* = glm::mat4(1.0f)*/)
+    {
+        Mesh torusMesh;
+
+        float sideStep = glm::two_pi<float>() / static_cast<float>(_numSides);  // Angle step around minor radius
+        float ringStep = glm::two_pi<float>() / static_cast<float>(_numRings);  // Angle step around major radius
+
+        // Generate vertices
+        for (int ring = 0; ring <= _numRings; ++ring)
+        {
+            float phi = static_cast<float>(ring) * ringStep;  // Angle along major radius
+            glm::vec3 ringCenter = glm::vec3(_majorRadius * glm::cos(phi), _majorRadius * glm::sin(phi), 0.0f);
+
+            for (int side = 0; side <= _numSides; ++side)
+            {
+                float theta = static_cast<float>(side) * sideStep;  // Angle along tube
+                glm::vec3 position = ringCenter +
+                                     glm::vec3(_minorRadius * glm::cos(theta) * glm::cos(phi),
+                                               _minorRadius * glm::cos(theta) * glm::sin(phi),
+                                               _minorRadius * glm::sin(theta));
+
+                // Texture coordinates for wrapping
+                glm::vec2 texCoords = glm::vec2(static_cast<float>(ring) / static_cast<float>(_numRings),
+                                                static_cast<float>(side) / static_cast<float>(_numSides));
+
+                // Add vertex to list
+                position = _modelTransform * glm::vec4(position, 1.0f);
+                torusMesh.m_vertices.push_back({ position, _color, texCoords });
+            }
+        }
+
+        // Generate indices for triangle strips
+        for (int ring = 0; ring < _numRings; ++ring)
+        {
+            for (int side = 0; side < _numSides; ++side)
+            {
+                unsigned int current = static_cast<unsigned int>(ring * (_numSides + 1) + side);
+                unsigned int next = current + static_cast<unsigned int>(_numSides) + 1;
+
+                torusMesh.m_indices.push_back(current);
+                torusMesh.m_indices.push_back(next);
+                torusMesh.m_indices.push_back(current + 1);
+
+                torusMesh.m_indices.push_back(current + 1);
+                torusMesh.m_indices.push_back(next);
+                torusMesh.m_indices.push_back(next + 1);
+            }
+        }
+
+        return torusMesh;
+    }
 }
@@ -4,20 +4,33 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include "AABB.h"
+#include "AABBArrays.h"
+#include "OBB.h"
 
 namespace blithe
 {
     struct Mesh;
+    struct MeshSoA;
 
     class GeomHelpers
     {
     public:
         static glm::vec3 CalcCentroid(const Mesh& _mesh);
+        static glm::vec3 CalcCentroid(const MeshSoA& _mesh);
         static AABB CalcLocalAABB(const Mesh& _mesh);
+        static AABB CalcLocalAABB(const MeshSoA& _mesh);
         static AABB CalcWorldAABB(const Mesh& _mesh, const glm::mat4& _modelMat);
+        static AABB CalcWorldAABB(const MeshSoA& _mesh, const glm::mat4& _modelMat);
         static AABB TransformAABB(const AABB& _aabb, const glm::mat4& _mat);
+        static void TransformAABBs(const AABBArrays& _aabbs, const std::vector<glm::mat4>& _mats, AABBArrays& _outAABBs);
+        static OBB CalcLocalOBB(const Mesh& _mesh);
+        static OBB CalcLocalOBB(const Mesh& _mesh, const AABB& _localAABB, const glm::vec3& _centroid);
+        static OBB TransformOBB(const OBB& _obb, const glm::mat4& _mat);
         static Mesh CreateCuboid(glm::vec3 _sides, const std::vector<glm::vec4>& _colors,
                                  const glm::mat4& _modelTransform = glm::mat4(1.0f));
+        static Mesh CreateTorus(float _majorRadius, float _minorRadius,
+                                int _numSides, int _numRings, const glm::vec4& _color,
+                                const glm::mat4& _modelTransform = glm::mat4(1.0f));
     };
 }
 
@@ -0,0 +1,455 @@
+#include "InstanceCuller.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <tracy/Tracy.hpp>
+#include "BlitheAssert.h"
+#include "BlitheSIMD.h"
+#include "Frustum.h"
+#include "ThreadPool.h"
+
+namespace blithe
+{
+    namespace
+    {
+        const size_t SIMD_WIDTH = 8;      // Box arrays are padded to this, so any of the paths can run without a tail
+        const size_t CHUNK_SIZE = 16384;  // Instances per ThreadPool task. A multiple of SIMD_WIDTH.
+    }
+
+    ///
+    /// \brief Sets the instances and calculates their world bounding boxes, by transforming
+    ///        _localBounds with each instance transform (Arvo's method).
+    ///
+    /// \param _localBounds - Bounding box of the instanced mesh, in its local space
+    ///                       (e.g. from GeomHelpers::CalcLocalAABB())
+    /// \param _transforms  - Instance transforms
+    /// \param _localOBB    - Oriented box of the instanced mesh, in its local space (e.g. from
+    ///                       GeomHelpers::CalcLocalOBB()). _localBounds is used if not given.
+    ///
+    void InstanceCuller::SetInstances(const AABB& _localBounds, const std::vector<glm::mat4>& _transforms, const tl::optional<OBB>& _localOBB)
+    {
+        ZoneScoped;
+
+        m_localBounds = _localBounds;
+        m_localOBB = _localOBB.value_or(OBB::FromAABB(_localBounds));
+        m_localOBBHalfEdges = glm::mat3(m_localOBB.m_axes[0] * m_localOBB.m_halfExtents.x,
+                                        m_localOBB.m_axes[1] * m_localOBB.m_halfExtents.y,
+                                        m_localOBB.m_axes[2] * m_localOBB.m_halfExtents.z);
+        m_transforms = _transforms;
+
+        // Padding boxes have NaN centers. Every comparison with NaN is false, so they're never visible.
+        size_t paddedSize = (_transforms.size() + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        m_centerX.assign(paddedSize, nan);
+        m_centerY.assign(paddedSize, nan);
+        m_centerZ.assign(paddedSize, nan);
+        m_extentX.assign(paddedSize, 0.0f);
+        m_extentY.assign(paddedSize, 0.0f);
+        m_extentZ.assign(paddedSize, 0.0f);
+        CalcWorldBounds(0, _transforms.size());
+
+        // A build still running for the old instances is abandoned. It only holds copies of their boxes.
+        m_bvhBuildFuture = std::future<BVH>();
+        m_bvhBuilt = false;
+        m_bvhNeedsRefit = false;
+        m_visibleTransforms = m_transforms;
+    }
+
+    ///
+    /// \brief Overwrites the transforms of _count instances starting at _firstInstance and
+    ///        updates their world boxes. The BVH, if built or being built, is refit on the next use
+    ///        rather than rebuilt.
+    ///
+    /// \param _firstInstance - Index of the first instance to overwrite
+    /// \param _transforms    - New transforms
+    /// \param _count         - Number of transforms. _firstInstance + _count must not be more
+    ///                         than the number of instances.
+    ///
+    void InstanceCuller::UpdateInstances(size_t _firstInstance, const glm::mat4* _transforms, size_t _count)
+    {
+        ZoneScoped;
+
+        ASSERT(_firstInstance + _count <= m_transforms.size(), "Updating instances [" << _firstInstance << ", " << _firstInstance + _count << ") of " << m_transforms.size());
+
+        std::copy(_transforms, _transforms + _count, m_transforms.begin() + static_cast<std::ptrdiff_t>(_firstInstance));
+        CalcWorldBounds(_firstInstance, _count);
+        m_bvhNeedsRefit = m_bvhBuilt || m_bvhBuildFuture.valid();
+    }
+
+    ///
+    /// \brief Finds the instances whose world bounding boxes overlap the view frustum.
+    ///        See Query().
+    ///
+    /// \param _viewProjection - View-projection matrix of the camera
+    /// \param _useBVH         - Whether to cull with the BVH rather than test every box
+    ///
+    /// \return Transforms of the visible instances, valid until the next call to this or to
+    ///         SetInstances()
+    ///
+    const std::vector<glm::mat4>& InstanceCuller::Cull(const glm::mat4& _viewProjection, bool _useBVH)
+    {
+        ZoneScoped;
+
+        Query(Frustum::FromMatrix(_viewProjection), _useBVH, m_visibleInstances);
+
+        m_visibleTransforms.clear();
+        for ( uint32_t instance : m_visibleInstances )
+        {
+            m_visibleTransforms.push_back(m_transforms[instance]);
+        }
+
+        return m_visibleTransforms;
+    }
+
+    ///
+    /// \brief Finds the instances whose world bounding boxes overlap _frustum. Chunks of
+    ///        CHUNK_SIZE instances are tested in parallel, with the first chunk on the calling
+    ///        thread (all of them while the BVH is building), and the instances come out in
+    ///        order. With SetRefineWithOBBs(), boxes that straddle a plane are tested again as
+    ///        OBBs, see IntersectsOBB().
+    ///
+    ///        With _useBVH, the BVH is walked instead, and the instances come out in the BVH's
+    ///        order. If the BVH isn't built yet, this starts building it in the background and
+    ///        tests the boxes as without _useBVH until it's ready.
+    ///
+    /// \param _frustum      - Frustum to test against
+    /// \param _useBVH       - Whether to walk the BVH rather than test every box
+    /// \param _outInstances - Overwritten with the indices of the instances overlapping _frustum
+    ///
+    void InstanceCuller::Query(const Frustum& _frustum, bool _useBVH, std::vector<uint32_t>& _outInstances)
+    {
+        ZoneScoped;
+
+        _outInstances.clear();
+        if ( _useBVH && PollBVHBuild() )
+        {
+            m_straddlingInstances.clear();
+            m_numNodesVisited = GetBVH().QueryFrustum(_frustum, _outInstances, m_refineWithOBBs ? &m_straddlingInstances : nullptr);
+            for ( uint32_t instance : m_straddlingInstances )
+            {
+                if ( IntersectsOBB(_frustum, instance) )
+                {
+                    _outInstances.push_back(instance);
+                }
+            }
+            return;
+        }
+
+        m_numNodesVisited = 0;
+        size_t paddedSize = m_centerX.size();
+        size_t numChunks = (paddedSize + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        m_chunkVisible.resize(numChunks);
+
+        // While the BVH is building, chunks submitted to the ThreadPool could queue behind it
+        // and stall the caller, so they're all tested here instead
+        bool bvhBuilding = m_bvhBuildFuture.valid() && m_bvhBuildFuture.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+
+        std::vector<std::future<void>> futures;
+        for ( size_t chunk = 1; chunk < numChunks; chunk++ )
+        {
+            size_t first = chunk * CHUNK_SIZE;
+            size_t last = std::min(first + CHUNK_SIZE, paddedSize);
+            std::vector<uint32_t>* outVisible = &m_chunkVisible[chunk];
+            if ( bvhBuilding )
+            {
+                CullRange(_frustum, first, last, *outVisible);
+                continue;
+            }
+            futures.push_back(ThreadPool::GetShared().Submit([this, _frustum, first, last, outVisible]() {
+                CullRange(_frustum, first, last, *outVisible);
+            }));
+        }
+        if ( numChunks > 0 )
+        {
+            CullRange(_frustum, 0, std::min(CHUNK_SIZE, paddedSize), m_chunkVisible[0]);
+        }
+        for ( std::future<void>& future : futures )
+        {
+            future.wait();
+        }
+
+        for ( const std::vector<uint32_t>& chunkVisible : m_chunkVisible )
+        {
+            _outInstances.insert(_outInstances.end(), chunkVisible.begin(), chunkVisible.end());
+        }
+    }
+
+    ///
+    /// \brief Gets the world bounding box of an instance
+    ///
+    /// \param _instance - Index of the instance
+    ///
+    /// \return The instance's world box
+    ///
+    AABB InstanceCuller::GetWorldBounds(size_t _instance) const
+    {
+        ASSERT(_instance < m_transforms.size(), "Instance " << _instance << " out of range. There are " << m_transforms.size() << " instances.");
+
+        glm::vec3 center(m_centerX[_instance], m_centerY[_instance], m_centerZ[_instance]);
+        glm::vec3 extent(m_extentX[_instance], m_extentY[_instance], m_extentZ[_instance]);
+        return { center - extent, center + extent };
+    }
+
+    ///
+    /// \brief Gets the BVH over the instances' world boxes, building or refitting it first if
+    ///        the instances changed. Waits for the build if it's running in the background.
+    ///
+    /// \return BVH whose primitives are the instance indices
+    ///
+    const BVH& InstanceCuller::GetBVH()
+    {
+        if ( !m_bvhBuilt && m_bvhBuildFuture.valid() )
+        {
+            m_bvh = m_bvhBuildFuture.get();
+            m_bvhBuilt = true;
+        }
+
+        if ( !m_bvhBuilt )
+        {
+            GatherWorldBounds();
+            m_bvh.Build(m_worldBounds);
+            m_bvhBuilt = true;
+            m_bvhNeedsRefit = false;
+        }
+        else if ( m_bvhNeedsRefit )
+        {
+            GatherWorldBounds();
+            m_bvh.Refit(m_worldBounds);
+            m_bvhNeedsRefit = false;
+        }
+        return m_bvh;
+    }
+
+    ///
+    /// \brief Starts building the BVH on the shared ThreadPool if it isn't built or being built,
+    ///        and takes it once the build is done. Instances moved by UpdateInstances() in the
+    ///        meantime are picked up by refitting it in GetBVH().
+    ///
+    /// \return Whether the BVH is built, so GetBVH() won't have to wait
+    ///
+    bool InstanceCuller::PollBVHBuild()
+    {
+        if ( m_bvhBuilt )
+        {
+            return true;
+        }
+
+        if ( !m_bvhBuildFuture.valid() )
+        {
+            // The build takes the boxes. m_worldBounds is scratch space that's regathered before each use.
+            GatherWorldBounds();
+            m_bvhBuildFuture = ThreadPool::GetShared().Submit([worldBounds = std::move(m_worldBounds)]() {
+                ZoneScopedN("InstanceCuller BVH build");
+                BVH bvh;
+                bvh.Build(worldBounds);
+                return bvh;
+            });
+            return false;
+        }
+
+        return m_bvhBuildFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    ///
+    /// \brief Tests the boxes in [_first, _last) against _frustum. A box is outside if it's
+    ///        entirely behind any plane, i.e. if n * c + d + |n| * e < 0 for its center c and
+    ///        half extents e. It's inside if it's entirely in front of all of them, i.e. if
+    ///        n * c + d - |n| * e >= 0. With m_refineWithOBBs, the boxes in between are tested
+    ///        again as OBBs.
+    ///
+    /// \param _frustum    - Frustum to test against
+    /// \param _first      - First box to test. A multiple of SIMD_WIDTH.
+    /// \param _last       - One past the last box to test. A multiple of SIMD_WIDTH.
+    /// \param _outVisible - Overwritten with the indices of the boxes that overlap the frustum
+    ///
+    void InstanceCuller::CullRange(const Frustum& _frustum, size_t _first, size_t _last, std::vector<uint32_t>& _outVisible) const
+    {
+        ZoneScoped;
+
+        _outVisible.clear();
+
+#if defined(BLITHE_SIMD_AVX2)
+        __m256 normals[Frustum::NUM_PLANES][3];
+        __m256 absNormals[Frustum::NUM_PLANES][3];
+        __m256 ds[Frustum::NUM_PLANES];
+        for ( size_t p = 0; p < Frustum::NUM_PLANES; p++ )
+        {
+            for ( int axis = 0; axis < 3; axis++ )
+            {
+                normals[p][axis] = _mm256_set1_ps(_frustum.m_planes[p].m_normal[axis]);
+                absNormals[p][axis] = _mm256_set1_ps(std::abs(_frustum.m_planes[p].m_normal[axis]));
+            }
+            ds[p] = _mm256_set1_ps(_frustum.m_planes[p].m_d);
+        }
+        const __m256 zero = _mm256_setzero_ps();
+
+        for ( size_t i = _first; i < _last; i += 8 )
+        {
+            __m256 cx = _mm256_loadu_ps(&m_centerX[i]);
+            __m256 cy = _mm256_loadu_ps(&m_centerY[i]);
+            __m256 cz = _mm256_loadu_ps(&m_centerZ[i]);
+            __m256 ex = _mm256_loadu_ps(&m_extentX[i]);
+            __m256 ey = _mm256_loadu_ps(&m_extentY[i]);
+            __m256 ez = _mm256_loadu_ps(&m_extentZ[i]);
+
+            int mask = 0xFF;
+            int inside = 0xFF;
+            for ( size_t p = 0; p < Frustum::NUM_PLANES && mask != 0; p++ )
+            {
+                __m256 centerDist = _mm256_add_ps(ds[p], _mm256_mul_ps(normals[p][0], cx));
+                centerDist = _mm256_add_ps(centerDist, _mm256_mul_ps(normals[p][1], cy));
+                centerDist = _mm256_add_ps(centerDist, _mm256_mul_ps(normals[p][2], cz));
+                __m256 radius = _mm256_mul_ps(absNormals[p][0], ex);
+                radius = _mm256_add_ps(radius, _mm256_mul_ps(absNormals[p][1], ey));
+                radius = _mm256_add_ps(radius, _mm256_mul_ps(absNormals[p][2], ez));
+                mask &= _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(centerDist, radius), zero, _CMP_GE_OQ));
+                inside &= _mm256_movemask_ps(_mm256_cmp_ps(_mm256_sub_ps(centerDist, radius), zero, _CMP_GE_OQ));
+            }
+
+            for ( int lane = 0; mask != 0; lane++, mask >>= 1, inside >>= 1 )
+            {
+                if ( (mask & 1) && ((inside & 1) || !m_refineWithOBBs || IntersectsOBB(_frustum, i + lane)) )
+                {
+                    _outVisible.push_back(static_cast<uint32_t>(i + lane));
+                }
+            }
+        }
+#elif defined(BLITHE_SIMD_SSE2)
+        __m128 normals[Frustum::NUM_PLANES][3];
+        __m128 absNormals[Frustum::NUM_PLANES][3];
+        __m128 ds[Frustum::NUM_PLANES];
+        for ( size_t p = 0; p < Frustum::NUM_PLANES; p++ )
+        {
+            for ( int axis = 0; axis < 3; axis++ )
+            {
+                normals[p][axis] = _mm_set1_ps(_frustum.m_planes[p].m_normal[axis]);
+                absNormals[p][axis] = _mm_set1_ps(std::abs(_frustum.m_planes[p].m_normal[axis]));
+            }
+            ds[p] = _mm_set1_ps(_frustum.m_planes[p].m_d);
+        }
+        const __m128 zero = _mm_setzero_ps();
+
+        for ( size_t i = _first; i < _last; i += 4 )
+        {
+            __m128 cx = _mm_loadu_ps(&m_centerX[i]);
+            __m128 cy = _mm_loadu_ps(&m_centerY[i]);
+            __m128 cz = _mm_loadu_ps(&m_centerZ[i]);
+            __m128 ex = _mm_loadu_ps(&m_extentX[i]);
+            __m128 ey = _mm_loadu_ps(&m_extentY[i]);
+            __m128 ez = _mm_loadu_ps(&m_extentZ[i]);
+
+            int mask = 0xF;
+            int inside = 0xF;
+            for ( size_t p = 0; p < Frustum::NUM_PLANES && mask != 0; p++ )
+            {
+                __m128 centerDist = _mm_add_ps(ds[p], _mm_mul_ps(normals[p][0], cx));
+                centerDist = _mm_add_ps(centerDist, _mm_mul_ps(normals[p][1], cy));
+                centerDist = _mm_add_ps(centerDist, _mm_mul_ps(normals[p][2], cz));
+                __m128 radius = _mm_mul_ps(absNormals[p][0], ex);
+                radius = _mm_add_ps(radius, _mm_mul_ps(absNormals[p][1], ey));
+                radius = _mm_add_ps(radius, _mm_mul_ps(absNormals[p][2], ez));
+                mask &= _mm_movemask_ps(_mm_cmpge_ps(_mm_add_ps(centerDist, radius), zero));
+                inside &= _mm_movemask_ps(_mm_cmpge_ps(_mm_sub_ps(centerDist, radius), zero));
+            }
+
+            for ( int lane = 0; mask != 0; lane++, mask >>= 1, inside >>= 1 )
+            {
+                if ( (mask & 1) && ((inside & 1) || !m_refineWithOBBs || IntersectsOBB(_frustum, i + lane)) )
+                {
+                    _outVisible.push_back(static_cast<uint32_t>(i + lane));
+                }
+            }
+        }
+#else
+        for ( size_t i = _first; i < _last; i++ )
+        {
+            bool visible = true;
+            bool inside = true;
+            for ( size_t p = 0; p < Frustum::NUM_PLANES && visible; p++ )
+            {
+                const Plane& plane = _frustum.m_planes[p];
+                float centerDist = plane.m_d + plane.m_normal.x * m_centerX[i] + plane.m_normal.y * m_centerY[i] + plane.m_normal.z * m_centerZ[i];
+                float radius = std::abs(plane.m_normal.x) * m_extentX[i] + std::abs(plane.m_normal.y) * m_extentY[i] + std::abs(plane.m_normal.z) * m_extentZ[i];
+                visible = centerDist + radius >= 0.0f;
+                inside = inside && centerDist - radius >= 0.0f;
+            }
+            if ( visible && (inside || !m_refineWithOBBs || IntersectsOBB(_frustum, i)) )
+            {
+                _outVisible.push_back(static_cast<uint32_t>(i));
+            }
+        }
+#endif
+    }
+
+    ///
+    /// \brief Tests an instance's OBB against _frustum. Rotating an instance inflates its world
+    ///        box, so a box can poke into the frustum while the mesh stays well outside. This is
+    ///        only worth doing for the boxes that straddle a plane, and even then reading their
+    ///        transforms costs about a cache miss each.
+    ///
+    /// \param _frustum  - Frustum to test against
+    /// \param _instance - Index of the instance
+    ///
+    /// \return false if the instance's OBB is certainly outside the frustum
+    ///
+    bool InstanceCuller::IntersectsOBB(const Frustum& _frustum, size_t _instance) const
+    {
+        // Same test as Frustum::Intersects(const OBB&), but on the transformed half edges of
+        // the box, which skips normalizing the axes and stays exact if the transform shears
+        const glm::mat4& transform = m_transforms[_instance];
+        glm::vec3 center(transform * glm::vec4(m_localOBB.m_center, 1.0f));
+        glm::mat3 halfEdges = glm::mat3(transform) * m_localOBBHalfEdges;
+        for ( const Plane& plane : _frustum.m_planes )
+        {
+            float radius = std::abs(glm::dot(plane.m_normal, halfEdges[0])) +
+                           std::abs(glm::dot(plane.m_normal, halfEdges[1])) +
+                           std::abs(glm::dot(plane.m_normal, halfEdges[2]));
+            if ( glm::dot(plane.m_normal, center) + plane.m_d < -radius )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ///
+    /// \brief Transforms m_localBounds by the transforms of _count instances starting at
+    ///        _first (Arvo's method) and stores the world boxes.
+    ///
+    /// \param _first - First instance
+    /// \param _count - Number of instances
+    ///
+    void InstanceCuller::CalcWorldBounds(size_t _first, size_t _count)
+    {
+        glm::vec4 localCenter((m_localBounds.m_min + m_localBounds.m_max) * 0.5f, 1.0f);
+        glm::vec3 localExtent = (m_localBounds.m_max - m_localBounds.m_min) * 0.5f;
+        for ( size_t i = _first; i < _first + _count; i++ )
+        {
+            const glm::mat4& transform = m_transforms[i];
+            glm::vec3 center(transform * localCenter);
+            glm::vec3 extent = glm::abs(glm::vec3(transform[0])) * localExtent.x +
+                               glm::abs(glm::vec3(transform[1])) * localExtent.y +
+                               glm::abs(glm::vec3(transform[2])) * localExtent.z;
+            m_centerX[i] = center.x;
+            m_centerY[i] = center.y;
+            m_centerZ[i] = center.z;
+            m_extentX[i] = extent.x;
+            m_extentY[i] = extent.y;
+            m_extentZ[i] = extent.z;
+        }
+    }
+
+    ///
+    /// \brief Copies the world boxes out of the structure-of-arrays into m_worldBounds.
+    ///
+    void InstanceCuller::GatherWorldBounds()
+    {
+        m_worldBounds.resize(m_transforms.size());
+        for ( size_t i = 0; i < m_transforms.size(); i++ )
+        {
+            m_worldBounds[i] = GetWorldBounds(i);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef INSTANCECULLER_H
+#define INSTANCECULLER_H
+
+#include <optional.hpp>
+#include <cstdint>
+#include <future>
+#include <vector>
+#include <glm/glm.hpp>
+#include "AABB.h"
+#include "BVH.h"
+#include "OBB.h"
+
+namespace blithe
+{
+    struct Frustum;
+
+    ///
+    /// \brief Frustum culls the instances of a mesh, so that only the visible ones need to be
+    ///        uploaded and drawn.
+    ///
+    ///        SetInstances() transforms the mesh's bounding box by each instance and keeps the
+    ///        resulting world boxes as structure-of-arrays, so that Cull() can test 4 (SSE2) or
+    ///        8 (AVX2) boxes against each plane at once. Large instance counts are split into
+    ///        chunks that are culled on the shared ThreadPool.
+    ///
+    ///        With SetRefineWithOBBs(), the boxes that straddle a plane are tested again with
+    ///        the mesh's OBB transformed by the instance. That drops the rotated instances whose
+    ///        inflated world box only grazes the frustum, which matters most for small frustums
+    ///        like a selection marquee's.
+    ///
+    ///        Cull() can instead walk a BVH over the boxes, which only touches the parts of the
+    ///        scene near the frustum. The BVH is built on the shared ThreadPool the first time
+    ///        it's asked for, since that takes a while for large instance sets, and the boxes
+    ///        are tested one by one until it's ready. It's refit after UpdateInstances(), so it
+    ///        suits large, mostly static instance sets. GetBVH() also serves ray and overlap
+    ///        queries over the instances.
+    ///
+    ///        Query() runs the same tests against any frustum and returns instance indices, e.g.
+    ///        for selecting the instances in a marquee's sub-frustum.
+    ///
+    class InstanceCuller
+    {
+    public:
+        void SetInstances(const AABB& _localBounds, const std::vector<glm::mat4>& _transforms, const tl::optional<OBB>& _localOBB = tl::nullopt);
+        void UpdateInstances(size_t _firstInstance, const glm::mat4* _transforms, size_t _count);
+
+        const std::vector<glm::mat4>& Cull(const glm::mat4& _viewProjection, bool _useBVH = false);
+        void Query(const Frustum& _frustum, bool _useBVH, std::vector<uint32_t>& _outInstances);
+
+        const BVH& GetBVH();
+        size_t GetNumNodesVisited() const { return m_numNodesVisited; }
+
+        void SetRefineWithOBBs(bool _refine) { m_refineWithOBBs = _refine; }
+        bool GetRefineWithOBBs() const { return m_refineWithOBBs; }
+
+        size_t GetNumInstances() const { return m_transforms.size(); }
+        AABB GetWorldBounds(size_t _instance) const;
+        size_t GetNumVisible() const { return m_visibleTransforms.size(); }
+        const std::vector<glm::mat4>& GetVisibleInstances() const { return m_visibleTransforms; }
+
+    private:
+        void CullRange(const Frustum& _frustum, size_t _first, size_t _last, std::vector<uint32_t>& _outVisible) const;
+        bool IntersectsOBB(const Frustum& _frustum, size_t _instance) const;
+        bool PollBVHBuild();
+        void CalcWorldBounds(size_t _first, size_t _count);
+        void GatherWorldBounds();
+
+        AABB m_localBounds;                                //!< Bounding box of the instanced mesh
+        OBB m_localOBB;                                    //!< Oriented box of the instanced mesh, for the boxes that straddle a plane
+        glm::mat3 m_localOBBHalfEdges;                     //!< Axes of m_localOBB scaled by its half extents
+        std::vector<glm::mat4> m_transforms;               //!< Instance transforms
+        std::vector<float> m_centerX;                      //!< X of the world box centers, padded to a multiple of 8
+        std::vector<float> m_centerY;                      //!< Y of the world box centers, padded to a multiple of 8
+        std::vector<float> m_centerZ;                      //!< Z of the world box centers, padded to a multiple of 8
+        std::vector<float> m_extentX;                      //!< X half extents of the world boxes, padded to a multiple of 8
+        std::vector<float> m_extentY;                      //!< Y half extents of the world boxes, padded to a multiple of 8
+        std::vector<float> m_extentZ;                      //!< Z half extents of the world boxes, padded to a multiple of 8
+        std::vector<std::vector<uint32_t>> m_chunkVisible; //!< Scratch space for the visible instances of each chunk
+        std::vector<uint32_t> m_visibleInstances;          //!< Scratch space for the indices of the visible instances
+        std::vector<uint32_t> m_straddlingInstances;       //!< Scratch space for the instances whose boxes straddle a plane of the frustum
+        std::vector<glm::mat4> m_visibleTransforms;        //!< Transforms of the instances that passed the last Cull()
+        BVH m_bvh;                                         //!< BVH over the world boxes
+        std::vector<AABB> m_worldBounds;                   //!< Scratch space for the world boxes, for building and refitting m_bvh
+        std::future<BVH> m_bvhBuildFuture;                 //!< BVH over the current instances being built on the ThreadPool
+        bool m_bvhBuilt = false;                           //!< Whether m_bvh has been built for the current instances
+        bool m_bvhNeedsRefit = false;                      //!< Whether instances have moved since m_bvh was last fit
+        size_t m_numNodesVisited = 0;                      //!< BVH nodes the last Cull() visited, if it used the BVH
+        bool m_refineWithOBBs = false;                     //!< Whether boxes straddling a plane are tested again as OBBs
+    };
+}
+
+#endif // INSTANCECULLER_H
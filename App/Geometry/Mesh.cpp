@@ -0,0 +1,58 @@
+#include "Mesh.h"
+#include <atomic>
+#include "MeshBoundsCache.h"
+
+namespace blithe
+{
+    namespace
+    {
+        std::atomic<uint64_t> s_nextMeshId(0); //!< Id the next MeshId takes
+    }
+
+    ///
+    /// \brief Constructor. Takes the next unused id.
+    ///
+    MeshId::MeshId()
+        : m_value(s_nextMeshId.fetch_add(1, std::memory_order_relaxed))
+    {
+    }
+
+    ///
+    /// \brief Copy constructor. Takes the next unused id rather than sharing _other's.
+    ///
+    /// \param _other - Unused
+    ///
+    MeshId::MeshId(const MeshId& /*_other*/)
+        : MeshId()
+    {
+    }
+
+    ///
+    /// \brief Assignment operator. Drops the current id from the MeshBoundsCache (if it was
+    ///        cached) and takes the next unused one, as the mesh's contents are being replaced.
+    ///
+    /// \param _other - Unused
+    ///
+    /// \return Ref to this id
+    ///
+    MeshId& MeshId::operator=(const MeshId& /*_other*/)
+    {
+        if ( m_cached.exchange(false) )
+        {
+            MeshBoundsCache::GetShared().Remove(m_value);
+        }
+        m_value = s_nextMeshId.fetch_add(1, std::memory_order_relaxed);
+        return *this;
+    }
+
+    ///
+    /// \brief Destructor. Drops the id from the MeshBoundsCache, if it was cached.
+    ///
+    MeshId::~MeshId()
+    {
+        if ( m_cached.load() )
+        {
+            MeshBoundsCache::GetShared().Remove(m_value);
+        }
+    }
+}
@@ -2,21 +2,58 @@
 #define MESH_H
 
 #include "Vertex.h"
+#include <atomic>
+#include <cstdint>
 #include <vector>
 
 namespace blithe
 {
+    /*!
+     * \brief Identifier of a Mesh. Unlike the mesh's address it is never reused, so caches of
+     *        data derived from meshes can be keyed on it.
+     *
+     *        Copying or assigning a mesh gives it a new id, since its contents may no longer
+     *        match what was cached under the old one. Destroying or reassigning the id drops
+     *        the old id from the MeshBoundsCache, but only if it was ever cached, so that the
+     *        many meshes that never are (temporaries, meshes being built on worker threads)
+     *        don't take the cache's lock.
+     */
+    class MeshId
+    {
+    public:
+        MeshId();
+        MeshId(const MeshId& _other);
+        MeshId& operator=(const MeshId& _other);
+        ~MeshId();
+
+        uint64_t GetValue() const { return m_value; }
+
+    private:
+        friend class MeshBoundsCache;
+
+        void MarkCached() const { m_cached.store(true); }
+
+        uint64_t m_value;                          //!< Unique id, taken from a global counter
+        mutable std::atomic<bool> m_cached{false}; //!< Whether MeshBoundsCache may hold an entry for m_value
+    };
+
     /*!
      * \brief Simple mesh class describing a list of vertices and indices into the
      *        vertices.
      *        
      *        The indices should be consecutive triples describing the triangle faces
      *        in CCW order.
+     *
+     *        Code that changes the vertices or indices of an existing mesh should bump
+     *        m_generation, so that caches of data derived from it (see MeshBoundsCache) know
+     *        to recompute it.
      */
     struct Mesh
     {
         std::vector<Vertex> m_vertices;
         std::vector<unsigned int> m_indices;
+        unsigned int m_generation = 0;
+        MeshId m_id{};
     };
 }
 
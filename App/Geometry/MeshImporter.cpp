@@ -0,0 +1,104 @@
+#include "MeshImporter.h"
+#include <iostream>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>           // Includes the data structure
+#include <assimp/postprocess.h>     // Includes the post processing flags
+#include "Mesh.h"
+
+namespace blithe
+{
+    ///
+    /// \brief Loads the first mesh in _filename, triangulated and with identical vertices
+    ///        merged, and optionally optimizes its triangle and vertex order.
+    ///
+    /// \param _filename  - Path to the 3D model file
+    /// \param _outMesh   - Output mesh. Expected to be empty.
+    /// \param _options   - Import options
+    /// \param _outReport - If not null and the mesh is optimized, gets the vertex cache stats
+    ///                     before and after optimizing
+    ///
+    /// \return Whether the file could be loaded
+    ///
+    bool MeshImporter::Load3DFile(const std::string& _filename,
+                                  Mesh& _outMesh,
+                                  const MeshImportOptions& _options,
+                                  MeshOptimizeReport* _outReport)
+    {
+        Assimp::Importer importer;
+
+        // Import the 3D file with post-processing steps
+        const aiScene* scene = importer.ReadFile(_filename,
+                                                 aiProcess_Triangulate |              // Convert all shapes to triangles
+                                                 aiProcess_JoinIdenticalVertices |    // Merge identical vertices
+                                                 aiProcess_GenSmoothNormals |         // Generate normals if missing
+                                                 aiProcess_CalcTangentSpace |         // Calculate tangents and bitangents
+                                                 aiProcess_FlipUVs);                  // Flip UVs if needed
+
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        {
+            std::cerr << "Error loading file: " << importer.GetErrorString() << std::endl;
+            return false;
+        }
+
+        // Only load the first mesh for simplicity
+        aiMesh* mesh = scene->mMeshes[0];
+
+        // Populate vertices
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            Vertex vertex;
+            // Position
+            vertex.m_pos = glm::vec3(
+                mesh->mVertices[i].x,
+                mesh->mVertices[i].y,
+                mesh->mVertices[i].z);
+
+            // Color (if available in vertex colors, otherwise set default)
+            if (mesh->HasVertexColors(0))
+            {
+                aiColor4D color = mesh->mColors[0][i];
+                vertex.m_color = glm::vec4(color.r, color.g, color.b, color.a);
+            }
+            else
+            {
+                vertex.m_color = glm::vec4(1.0f); // Default color (white)
+            }
+
+            // Texture Coordinates (if available)
+            if (mesh->HasTextureCoords(0))
+            {
+                vertex.m_texCoords = glm::vec2(
+                    mesh->mTextureCoords[0][i].x,
+                    mesh->mTextureCoords[0][i].y);
+            }
+            else
+            {
+                vertex.m_texCoords = glm::vec2(0.0f); // Default UV (0,0)
+            }
+
+            _outMesh.m_vertices.push_back(vertex);
+        }
+
+        // Populate indices
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            aiFace face = mesh->mFaces[i];
+            for (unsigned int j = 0; j < face.mNumIndices; j++)
+            {
+                _outMesh.m_indices.push_back(face.mIndices[j]);
+            }
+        }
+        _outMesh.m_generation++;
+
+        if ( _options.m_optimize )
+        {
+            MeshOptimizeReport report = MeshOptimizer::Optimize(_outMesh, _options.m_overdrawThreshold);
+            if ( _outReport )
+            {
+                *_outReport = report;
+            }
+        }
+
+        return true;
+    }
+}
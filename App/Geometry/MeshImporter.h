@@ -0,0 +1,33 @@
+#ifndef MESHIMPORTER_H
+#define MESHIMPORTER_H
+
+#include <string>
+#include "MeshOptimizer.h"
+
+namespace blithe
+{
+    struct Mesh;
+
+    ///
+    /// \brief Options for MeshImporter::Load3DFile()
+    ///
+    struct MeshImportOptions
+    {
+        bool m_optimize = true;            //!< Whether to run MeshOptimizer::Optimize() on the loaded mesh
+        float m_overdrawThreshold = 1.05f; //!< ACMR factor the overdraw pass may give up (see MeshOptimizer)
+    };
+
+    ///
+    /// \brief Loads meshes from 3D model files (anything Assimp reads)
+    ///
+    class MeshImporter
+    {
+    public:
+        static bool Load3DFile(const std::string& _filename,
+                               Mesh& _outMesh,
+                               const MeshImportOptions& _options = MeshImportOptions(),
+                               MeshOptimizeReport* _outReport = nullptr);
+    };
+}
+
+#endif // MESHIMPORTER_H
@@ -2,7 +2,7 @@
 #define MESHITERATOR_H
 
 #include <cstddef>
-#include <functional>
+#include <iterator>
 
 namespace blithe
 {
@@ -10,22 +10,51 @@ namespace blithe
     /// \brief A templated class for iterating or accessing over triangle (and other facets, no
     ///        pun intended) of a Mesh.
     ///
-    template <typename T, typename MeshType>
+    ///        The accessor is a template argument rather than a stored callable, so each
+    ///        dereference is a direct (inlinable) call. Dereferencing builds the element and
+    ///        returns it by value, so there's no operator-> and nothing can be written through
+    ///        it. That's why it's tagged as an input iterator, even though it has the random
+    ///        access operations too: code using it directly can offset, compare and split it into
+    ///        index ranges in O(1), but standard algorithms only rely on the single pass input
+    ///        iterator guarantees.
+    ///
+    ///        The accessor doesn't check anything. The owner of the iterators (e.g. MeshView)
+    ///        validates the mesh once up front.
+    ///
+    template <typename T, typename MeshType, T (*Accessor)(const MeshType&, size_t)>
     class MeshIterator
     {
     public:
-        using AccessorFunc = std::function<T(const MeshType&, size_t)>;
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = T;
+
+        ///
+        /// \brief Default constructor. Gives an iterator that can only be assigned to.
+        ///
+        MeshIterator() = default;
 
         ///
         /// \brief Constructor for the iterator
         ///
-        /// \param _mesh         - Const ref to the Mesh
-        /// \param _index        - Initial value for the current index
-        /// \param _accessorFunc - The accessor function to use
+        /// \param _mesh  - Const ref to the Mesh
+        /// \param _index - Initial value for the current index
+        ///
+        MeshIterator(const MeshType& _mesh, size_t _index)
+            : m_mesh(&_mesh), m_index(_index)
+        {
+        }
+
+        ///
+        /// \brief Gets the index of the element the iterator is at
         ///
-        MeshIterator(const MeshType& _mesh, size_t _index, AccessorFunc _accessorFunc)
-            : m_mesh(_mesh), m_index(_index), m_accessorFunc(_accessorFunc)
+        /// \return Current index
+        ///
+        size_t GetIndex() const
         {
+            return m_index;
         }
 
         ///
@@ -35,7 +64,19 @@ namespace blithe
         ///
         T operator*() const
         {
-            return m_accessorFunc(m_mesh, m_index);
+            return Accessor(*m_mesh, m_index);
+        }
+
+        ///
+        /// \brief operator [] for the iterator
+        ///
+        /// \param _offset - Offset from the current index
+        ///
+        /// \return The value _offset elements away
+        ///
+        T operator[](difference_type _offset) const
+        {
+            return Accessor(*m_mesh, m_index + static_cast<size_t>(_offset));
         }
 
         ///
@@ -50,21 +91,190 @@ namespace blithe
         }
 
         ///
-        /// \brief operator != for the iterator
+        /// \brief Post-increment operator ++ for the iterator
+        ///
+        /// \return Copy of the iterator before incrementing
+        ///
+        MeshIterator operator++(int)
+        {
+            MeshIterator prev = *this;
+            ++m_index;
+            return prev;
+        }
+
+        ///
+        /// \brief operator -- for the iterator
+        ///
+        /// \return Ref to the decremented iterator
+        ///
+        MeshIterator& operator--()
+        {
+            --m_index;
+            return *this;
+        }
+
+        ///
+        /// \brief Post-decrement operator -- for the iterator
+        ///
+        /// \return Copy of the iterator before decrementing
+        ///
+        MeshIterator operator--(int)
+        {
+            MeshIterator prev = *this;
+            --m_index;
+            return prev;
+        }
+
+        ///
+        /// \brief operator += for the iterator
+        ///
+        /// \param _offset - Number of elements to move forward by. Can be negative.
+        ///
+        /// \return Ref to the moved iterator
+        ///
+        MeshIterator& operator+=(difference_type _offset)
+        {
+            m_index += static_cast<size_t>(_offset);
+            return *this;
+        }
+
+        ///
+        /// \brief operator -= for the iterator
+        ///
+        /// \param _offset - Number of elements to move back by. Can be negative.
+        ///
+        /// \return Ref to the moved iterator
+        ///
+        MeshIterator& operator-=(difference_type _offset)
+        {
+            m_index -= static_cast<size_t>(_offset);
+            return *this;
+        }
+
+        ///
+        /// \brief operator + for the iterator
+        ///
+        /// \param _offset - Number of elements to move forward by. Can be negative.
+        ///
+        /// \return Iterator _offset elements after this one
+        ///
+        MeshIterator operator+(difference_type _offset) const
+        {
+            return MeshIterator(*this) += _offset;
+        }
+
+        ///
+        /// \brief operator + with the offset first, as in _offset + _it
+        ///
+        /// \param _offset - Number of elements to move forward by. Can be negative.
+        /// \param _it     - Iterator to move from
+        ///
+        /// \return Iterator _offset elements after _it
+        ///
+        friend MeshIterator operator+(difference_type _offset, const MeshIterator& _it)
+        {
+            return _it + _offset;
+        }
+
+        ///
+        /// \brief operator - for the iterator
+        ///
+        /// \param _offset - Number of elements to move back by. Can be negative.
+        ///
+        /// \return Iterator _offset elements before this one
+        ///
+        MeshIterator operator-(difference_type _offset) const
+        {
+            return MeshIterator(*this) -= _offset;
+        }
+
+        ///
+        /// \brief operator - between two iterators over the same mesh
+        ///
+        /// \param _other - Other iterator
+        ///
+        /// \return Number of elements from _other to this iterator
+        ///
+        difference_type operator-(const MeshIterator& _other) const
+        {
+            return static_cast<difference_type>(m_index) - static_cast<difference_type>(_other.m_index);
+        }
+
+        ///
+        /// \brief operator == for the iterator
         ///
         /// \param _other - Other iterator to compare against
         ///
         /// \return True if the iterators are equal, else false
         ///
+        bool operator==(const MeshIterator& _other) const
+        {
+            return m_index == _other.m_index;
+        }
+
+        ///
+        /// \brief operator != for the iterator
+        ///
+        /// \param _other - Other iterator to compare against
+        ///
+        /// \return True if the iterators are not equal, else false
+        ///
         bool operator!=(const MeshIterator& _other) const
         {
             return m_index != _other.m_index;
         }
 
+        ///
+        /// \brief operator < for the iterator
+        ///
+        /// \param _other - Other iterator to compare against
+        ///
+        /// \return True if this iterator is before _other
+        ///
+        bool operator<(const MeshIterator& _other) const
+        {
+            return m_index < _other.m_index;
+        }
+
+        ///
+        /// \brief operator > for the iterator
+        ///
+        /// \param _other - Other iterator to compare against
+        ///
+        /// \return True if this iterator is after _other
+        ///
+        bool operator>(const MeshIterator& _other) const
+        {
+            return m_index > _other.m_index;
+        }
+
+        ///
+        /// \brief operator <= for the iterator
+        ///
+        /// \param _other - Other iterator to compare against
+        ///
+        /// \return True if this iterator is not after _other
+        ///
+        bool operator<=(const MeshIterator& _other) const
+        {
+            return m_index <= _other.m_index;
+        }
+
+        ///
+        /// \brief operator >= for the iterator
+        ///
+        /// \param _other - Other iterator to compare against
+        ///
+        /// \return True if this iterator is not before _other
+        ///
+        bool operator>=(const MeshIterator& _other) const
+        {
+            return m_index >= _other.m_index;
+        }
+
     private:
-        const MeshType& m_mesh;       //!< Const ref the Mesh to be iterated over
-        size_t m_index;               //!< Current index of the iterator
-        AccessorFunc m_accessorFunc;  //!< Accessor function to use
+        const MeshType* m_mesh = nullptr; //!< Mesh to be iterated over. A pointer so the iterator can be assigned.
+        size_t m_index = 0;               //!< Current index of the iterator
     };
 }
 
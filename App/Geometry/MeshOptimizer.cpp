@@ -0,0 +1,434 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cmath>
+#include <numeric>
+#include <vector>
+#include <tracy/Tracy.hpp>
+#include "BlitheAssert.h"
+#include "Mesh.h"
+
+namespace blithe
+{
+    constexpr size_t MeshOptimizer::CACHE_SIZE;
+
+    namespace
+    {
+        ///
+        /// \brief Simulates a FIFO post-transform vertex cache. Each vertex remembers the miss
+        ///        count at which it was last loaded, so lookups and flushes are O(1).
+        ///
+        class FifoCacheSim
+        {
+        public:
+            FifoCacheSim(size_t _numVertices, size_t _cacheSize) :
+                m_loadedAt(_numVertices, 0),
+                m_cacheSize(_cacheSize),
+                m_misses(_cacheSize)
+            {
+            }
+
+            /// \brief Looks up _vertex, loading it on a miss. Returns whether it missed.
+            bool Access(unsigned int _vertex)
+            {
+                if ( m_misses - m_loadedAt[_vertex] < m_cacheSize )
+                {
+                    return false;
+                }
+                m_misses++;
+                m_loadedAt[_vertex] = m_misses;
+                return true;
+            }
+
+            /// \brief Evicts everything, as if the cache had just been filled with other vertices
+            void Flush() { m_misses += m_cacheSize; }
+
+        private:
+            std::vector<size_t> m_loadedAt; //!< Miss count at which each vertex was last loaded
+            size_t m_cacheSize;             //!< Number of vertices the cache holds
+            size_t m_misses;                //!< Running miss count (offset so that everything starts out evicted)
+        };
+
+        ///
+        /// \brief Scores a vertex for Forsyth's algorithm. Vertices high up in the cache, and
+        ///        vertices with few triangles left to draw, score higher.
+        ///
+        /// \param _cachePos      - Position of the vertex in the cache, or -1 if it's not cached
+        /// \param _trisRemaining - Number of triangles using the vertex that are still to be drawn
+        ///
+        /// \return Score of the vertex
+        ///
+        float ForsythVertexScore(int _cachePos, size_t _trisRemaining)
+        {
+            const float CacheDecayPower = 1.5f;
+            const float LastTriScore = 0.75f;
+            const float ValenceBoostScale = 2.0f;
+            const float ValenceBoostPower = 0.5f;
+
+            if ( _trisRemaining == 0 )
+            {
+                // No triangles left to draw, so the vertex shouldn't pull any triangle in
+                return -1.0f;
+            }
+
+            float score = 0.0f;
+            if ( _cachePos >= 0 )
+            {
+                if ( _cachePos < 3 )
+                {
+                    // Used by the last triangle. Fixed score so the algorithm doesn't just
+                    // hug the last triangle's edges and produce long strips.
+                    score = LastTriScore;
+                }
+                else
+                {
+                    const float scaler = 1.0f / static_cast<float>(MeshOptimizer::CACHE_SIZE - 3);
+                    score = std::pow(1.0f - static_cast<float>(_cachePos - 3) * scaler, CacheDecayPower);
+                }
+            }
+
+            // Boost vertices with few triangles left, to finish them off and avoid lone stragglers
+            score += ValenceBoostScale * std::pow(static_cast<float>(_trisRemaining), -ValenceBoostPower);
+            return score;
+        }
+    }
+
+    ///
+    /// \brief Runs all the optimization passes on _mesh, in order.
+    ///
+    /// \param _mesh              - Mesh to optimize in place
+    /// \param _overdrawThreshold - Max ACMR the overdraw pass may give up, as a factor of the
+    ///                             ACMR after the vertex cache pass
+    ///
+    /// \return Vertex cache stats before and after
+    ///
+    MeshOptimizeReport MeshOptimizer::Optimize(Mesh& _mesh, float _overdrawThreshold)
+    {
+        ZoneScoped;
+
+        MeshOptimizeReport report;
+        report.m_before = AnalyzeVertexCache(_mesh);
+        OptimizeVertexCache(_mesh);
+        OptimizeOverdraw(_mesh, _overdrawThreshold);
+        OptimizeVertexFetch(_mesh);
+        report.m_after = AnalyzeVertexCache(_mesh);
+        return report;
+    }
+
+    ///
+    /// \brief Reorders the triangles of _mesh for post-transform vertex cache locality, using
+    ///        Tom Forsyth's "Linear-Speed Vertex Cache Optimisation". It greedily draws the
+    ///        triangle whose vertices score highest, given a simulated LRU cache of
+    ///        CACHE_SIZE vertices. That doesn't depend much on the actual cache size of the GPU.
+    ///
+    /// \param _mesh - Mesh to reorder in place
+    ///
+    void MeshOptimizer::OptimizeVertexCache(Mesh& _mesh)
+    {
+        ZoneScoped;
+
+        std::vector<unsigned int>& indices = _mesh.m_indices;
+        ASSERT(indices.size() % 3 == 0, "Expected triangle indices, but got " << indices.size() << " indices");
+        const size_t numVertices = _mesh.m_vertices.size();
+        const size_t numTris = indices.size() / 3;
+        if ( numTris == 0 )
+        {
+            return;
+        }
+
+        // Build vertex -> triangles adjacency. The first trisRemaining[v] entries of each
+        // vertex's run are the triangles not yet drawn.
+        std::vector<size_t> trisRemaining(numVertices, 0);
+        for ( unsigned int index : indices )
+        {
+            ASSERT(index < numVertices, "Index " << index << " out of range of " << numVertices << " vertices");
+            trisRemaining[index]++;
+        }
+        std::vector<size_t> adjacencyOffsets(numVertices + 1, 0);
+        std::partial_sum(trisRemaining.begin(), trisRemaining.end(), adjacencyOffsets.begin() + 1);
+        std::vector<size_t> adjacency(indices.size());
+        std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for ( size_t tri = 0; tri < numTris; tri++ )
+        {
+            for ( size_t corner = 0; corner < 3; corner++ )
+            {
+                adjacency[fill[indices[tri * 3 + corner]]++] = tri;
+            }
+        }
+
+        std::vector<int> cachePos(numVertices, -1);
+        std::vector<float> vertexScores(numVertices);
+        for ( size_t v = 0; v < numVertices; v++ )
+        {
+            vertexScores[v] = ForsythVertexScore(-1, trisRemaining[v]);
+        }
+
+        std::vector<float> triScores(numTris);
+        std::vector<bool> triDrawn(numTris, false);
+        size_t bestTri = 0;
+        for ( size_t tri = 0; tri < numTris; tri++ )
+        {
+            triScores[tri] = vertexScores[indices[tri * 3]] + vertexScores[indices[tri * 3 + 1]] + vertexScores[indices[tri * 3 + 2]];
+            if ( triScores[tri] > triScores[bestTri] )
+            {
+                bestTri = tri;
+            }
+        }
+
+        std::vector<unsigned int> newIndices;
+        newIndices.reserve(indices.size());
+        std::vector<unsigned int> cache;
+        std::vector<unsigned int> newCache;
+        cache.reserve(CACHE_SIZE + 3);
+        newCache.reserve(CACHE_SIZE + 3);
+        size_t scanCursor = 0;
+
+        for ( size_t numDrawn = 0; numDrawn < numTris; numDrawn++ )
+        {
+            if ( bestTri == SIZE_MAX )
+            {
+                // Nothing in the cache leads anywhere, so pick up the next undrawn triangle
+                while ( triDrawn[scanCursor] )
+                {
+                    scanCursor++;
+                }
+                bestTri = scanCursor;
+            }
+
+            // Draw the triangle and take it out of its vertices' adjacency
+            triDrawn[bestTri] = true;
+            const unsigned int* tri = &indices[bestTri * 3];
+            newCache.clear();
+            for ( size_t corner = 0; corner < 3; corner++ )
+            {
+                unsigned int v = tri[corner];
+                newIndices.push_back(v);
+
+                size_t* begin = &adjacency[adjacencyOffsets[v]];
+                size_t* end = begin + trisRemaining[v];
+                std::iter_swap(std::find(begin, end, bestTri), end - 1);
+                trisRemaining[v]--;
+
+                if ( std::find(newCache.begin(), newCache.end(), v) == newCache.end() )
+                {
+                    newCache.push_back(v);
+                }
+            }
+
+            // The drawn triangle's vertices move to the front of the cache
+            for ( unsigned int v : cache )
+            {
+                if ( std::find(newCache.begin(), newCache.end(), v) == newCache.end() )
+                {
+                    newCache.push_back(v);
+                }
+            }
+
+            // Rescore the cached vertices (and the ones that just fell out), then their triangles
+            for ( size_t pos = 0; pos < newCache.size(); pos++ )
+            {
+                unsigned int v = newCache[pos];
+                cachePos[v] = pos < CACHE_SIZE ? static_cast<int>(pos) : -1;
+                vertexScores[v] = ForsythVertexScore(cachePos[v], trisRemaining[v]);
+            }
+
+            bestTri = SIZE_MAX;
+            float bestScore = 0.0f;
+            for ( unsigned int v : newCache )
+            {
+                for ( size_t i = 0; i < trisRemaining[v]; i++ )
+                {
+                    size_t adjTri = adjacency[adjacencyOffsets[v] + i];
+                    const unsigned int* adj = &indices[adjTri * 3];
+                    triScores[adjTri] = vertexScores[adj[0]] + vertexScores[adj[1]] + vertexScores[adj[2]];
+                    if ( triScores[adjTri] > bestScore )
+                    {
+                        bestScore = triScores[adjTri];
+                        bestTri = adjTri;
+                    }
+                }
+            }
+
+            newCache.resize(std::min(newCache.size(), CACHE_SIZE));
+            std::swap(cache, newCache);
+        }
+
+        indices = std::move(newIndices);
+        _mesh.m_generation++;
+    }
+
+    ///
+    /// \brief Reorders clusters of triangles of _mesh so that those facing outwards from the
+    ///        mesh's center come first. When the mesh is seen from any side, its near triangles
+    ///        then tend to be drawn before the ones behind them, which the depth test can reject
+    ///        before shading (a cheap take on Sander et al.'s "Tipsify" overdraw pass).
+    ///
+    ///        Should run after OptimizeVertexCache(). Each cluster starts with a cold vertex
+    ///        cache, so clusters are only cut off once their own ACMR is within _threshold of
+    ///        the whole mesh's, which bounds the ACMR of the result by the same factor.
+    ///
+    /// \param _mesh      - Mesh to reorder in place
+    /// \param _threshold - Max factor the ACMR may get worse by. 1 keeps it as is (and leaves
+    ///                     few places to cut), 1.05 is a good trade.
+    ///
+    void MeshOptimizer::OptimizeOverdraw(Mesh& _mesh, float _threshold)
+    {
+        ZoneScoped;
+
+        ASSERT(_threshold >= 1.0f, "Overdraw threshold must be at least 1, but got " << _threshold);
+        std::vector<unsigned int>& indices = _mesh.m_indices;
+        const size_t numTris = indices.size() / 3;
+        if ( numTris == 0 )
+        {
+            return;
+        }
+
+        const float maxClusterAcmr = AnalyzeVertexCache(_mesh).m_acmr * _threshold;
+
+        // Cut the triangle order into clusters
+        std::vector<size_t> clusterStarts;
+        FifoCacheSim cacheSim(_mesh.m_vertices.size(), CACHE_SIZE);
+        size_t clusterMisses = 0;
+        size_t clusterTris = 0;
+        for ( size_t tri = 0; tri < numTris; tri++ )
+        {
+            if ( clusterTris == 0 )
+            {
+                clusterStarts.push_back(tri);
+            }
+
+            for ( size_t corner = 0; corner < 3; corner++ )
+            {
+                clusterMisses += cacheSim.Access(indices[tri * 3 + corner]) ? 1 : 0;
+            }
+            clusterTris++;
+
+            if ( static_cast<float>(clusterMisses) <= maxClusterAcmr * static_cast<float>(clusterTris) )
+            {
+                cacheSim.Flush();
+                clusterMisses = 0;
+                clusterTris = 0;
+            }
+        }
+        clusterStarts.push_back(numTris);
+
+        const size_t numClusters = clusterStarts.size() - 1;
+        if ( numClusters < 2 )
+        {
+            return;
+        }
+
+        // Area weighted centroid and normal of each cluster
+        std::vector<glm::vec3> clusterCentroids(numClusters, glm::vec3(0.0f));
+        std::vector<glm::vec3> clusterNormals(numClusters, glm::vec3(0.0f));
+        std::vector<float> clusterAreas(numClusters, 0.0f);
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        for ( size_t cluster = 0; cluster < numClusters; cluster++ )
+        {
+            for ( size_t tri = clusterStarts[cluster]; tri < clusterStarts[cluster + 1]; tri++ )
+            {
+                const glm::vec3& p0 = _mesh.m_vertices[indices[tri * 3]].m_pos;
+                const glm::vec3& p1 = _mesh.m_vertices[indices[tri * 3 + 1]].m_pos;
+                const glm::vec3& p2 = _mesh.m_vertices[indices[tri * 3 + 2]].m_pos;
+                glm::vec3 scaledNormal = glm::cross(p1 - p0, p2 - p0);
+                float area = glm::length(scaledNormal);
+                clusterCentroids[cluster] += (p0 + p1 + p2) * (area / 3.0f);
+                clusterNormals[cluster] += scaledNormal;
+                clusterAreas[cluster] += area;
+            }
+            meshCentroid += clusterCentroids[cluster];
+            meshArea += clusterAreas[cluster];
+        }
+        if ( meshArea > 0.0f )
+        {
+            meshCentroid /= meshArea;
+        }
+
+        // Clusters facing most outwards (relative to the mesh center) go first
+        std::vector<float> sortKeys(numClusters, 0.0f);
+        for ( size_t cluster = 0; cluster < numClusters; cluster++ )
+        {
+            float normalLength = glm::length(clusterNormals[cluster]);
+            if ( clusterAreas[cluster] > 0.0f && normalLength > 0.0f )
+            {
+                glm::vec3 centroid = clusterCentroids[cluster] / clusterAreas[cluster];
+                sortKeys[cluster] = glm::dot(centroid - meshCentroid, clusterNormals[cluster] / normalLength);
+            }
+        }
+
+        std::vector<size_t> order(numClusters);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t _a, size_t _b) {
+            return sortKeys[_a] > sortKeys[_b];
+        });
+
+        std::vector<unsigned int> newIndices;
+        newIndices.reserve(indices.size());
+        for ( size_t cluster : order )
+        {
+            newIndices.insert(newIndices.end(),
+                              indices.begin() + static_cast<std::ptrdiff_t>(clusterStarts[cluster] * 3),
+                              indices.begin() + static_cast<std::ptrdiff_t>(clusterStarts[cluster + 1] * 3));
+        }
+        indices = std::move(newIndices);
+        _mesh.m_generation++;
+    }
+
+    ///
+    /// \brief Reorders the vertices of _mesh in the order the indices first reference them, so
+    ///        that vertex fetches walk through the vertex buffer mostly linearly. Vertices that
+    ///        no triangle references are dropped.
+    ///
+    /// \param _mesh - Mesh to reorder in place
+    ///
+    void MeshOptimizer::OptimizeVertexFetch(Mesh& _mesh)
+    {
+        ZoneScoped;
+
+        std::vector<unsigned int> remap(_mesh.m_vertices.size(), UINT_MAX);
+        std::vector<Vertex> newVertices;
+        newVertices.reserve(_mesh.m_vertices.size());
+        for ( unsigned int& index : _mesh.m_indices )
+        {
+            if ( remap[index] == UINT_MAX )
+            {
+                remap[index] = static_cast<unsigned int>(newVertices.size());
+                newVertices.push_back(_mesh.m_vertices[index]);
+            }
+            index = remap[index];
+        }
+        _mesh.m_vertices = std::move(newVertices);
+        _mesh.m_generation++;
+    }
+
+    ///
+    /// \brief Simulates drawing _mesh through a FIFO post-transform vertex cache, which is
+    ///        roughly what GPUs have.
+    ///
+    /// \param _mesh      - Mesh to analyze
+    /// \param _cacheSize - Number of vertices the cache holds
+    ///
+    /// \return ACMR and ATVR of the mesh's current index order
+    ///
+    VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const Mesh& _mesh, size_t _cacheSize)
+    {
+        VertexCacheStats stats;
+        if ( _mesh.m_indices.empty() || _mesh.m_vertices.empty() )
+        {
+            return stats;
+        }
+
+        FifoCacheSim cacheSim(_mesh.m_vertices.size(), _cacheSize);
+        size_t misses = 0;
+        for ( unsigned int index : _mesh.m_indices )
+        {
+            misses += cacheSim.Access(index) ? 1 : 0;
+        }
+
+        stats.m_acmr = static_cast<float>(misses) / static_cast<float>(_mesh.m_indices.size() / 3);
+        stats.m_atvr = static_cast<float>(misses) / static_cast<float>(_mesh.m_vertices.size());
+        return stats;
+    }
+}
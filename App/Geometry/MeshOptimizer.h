@@ -0,0 +1,56 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <cstddef>
+
+namespace blithe
+{
+    struct Mesh;
+
+    ///
+    /// \brief Post-transform vertex cache statistics of a mesh's index order
+    ///
+    struct VertexCacheStats
+    {
+        float m_acmr = 0.0f; //!< Average Cache Miss Ratio: transformed vertices per triangle (0.5 is ideal, 3 is worst)
+        float m_atvr = 0.0f; //!< Average Transformed Vertex Ratio: transformed vertices per vertex (1 is ideal)
+    };
+
+    ///
+    /// \brief Vertex cache statistics before and after MeshOptimizer::Optimize()
+    ///
+    struct MeshOptimizeReport
+    {
+        VertexCacheStats m_before; //!< Stats of the original index order
+        VertexCacheStats m_after;  //!< Stats of the optimized index order
+    };
+
+    ///
+    /// \brief Reorders the triangles and vertices of meshes for faster rendering, without
+    ///        changing what they look like.
+    ///
+    ///        The passes are meant to be run in order (which Optimize() does):
+    ///        1. OptimizeVertexCache() reorders triangles so vertices are reused while they're
+    ///           still in the post-transform cache (Forsyth's linear-speed algorithm).
+    ///        2. OptimizeOverdraw() splits that order into clusters and sorts them so that
+    ///           outward facing clusters come first, for earlier depth rejects. Clusters are only
+    ///           cut where that costs little vertex cache efficiency.
+    ///        3. OptimizeVertexFetch() reorders the vertices in the order they're first used, so
+    ///           vertex fetches walk through memory linearly.
+    ///
+    class MeshOptimizer
+    {
+    public:
+        static constexpr size_t CACHE_SIZE = 32; //!< Size of the simulated post-transform vertex cache
+
+        static MeshOptimizeReport Optimize(Mesh& _mesh, float _overdrawThreshold = 1.05f);
+
+        static void OptimizeVertexCache(Mesh& _mesh);
+        static void OptimizeOverdraw(Mesh& _mesh, float _threshold = 1.05f);
+        static void OptimizeVertexFetch(Mesh& _mesh);
+
+        static VertexCacheStats AnalyzeVertexCache(const Mesh& _mesh, size_t _cacheSize = CACHE_SIZE);
+    };
+}
+
+#endif // MESHOPTIMIZER_H
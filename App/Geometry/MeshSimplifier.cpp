@@ -0,0 +1,523 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <tracy/Tracy.hpp>
+#include "BlitheAssert.h"
+#include "MeshOptimizer.h"
+
+namespace blithe
+{
+    namespace
+    {
+        ///
+        /// \brief Symmetric 4x4 matrix Q such that v^T Q v (with v = (p, 1)) is the sum of the
+        ///        squared distances of p to a set of planes.
+        ///
+        struct Quadric
+        {
+            double m_a2 = 0, m_ab = 0, m_ac = 0, m_ad = 0;
+            double m_b2 = 0, m_bc = 0, m_bd = 0;
+            double m_c2 = 0, m_cd = 0;
+            double m_d2 = 0;
+
+            /// \brief Adds the plane through _p with unit _normal
+            void AddPlane(const glm::vec3& _normal, const glm::vec3& _p)
+            {
+                double a = _normal.x, b = _normal.y, c = _normal.z;
+                double d = -(a * _p.x + b * _p.y + c * _p.z);
+                m_a2 += a * a; m_ab += a * b; m_ac += a * c; m_ad += a * d;
+                m_b2 += b * b; m_bc += b * c; m_bd += b * d;
+                m_c2 += c * c; m_cd += c * d;
+                m_d2 += d * d;
+            }
+
+            void Add(const Quadric& _other)
+            {
+                m_a2 += _other.m_a2; m_ab += _other.m_ab; m_ac += _other.m_ac; m_ad += _other.m_ad;
+                m_b2 += _other.m_b2; m_bc += _other.m_bc; m_bd += _other.m_bd;
+                m_c2 += _other.m_c2; m_cd += _other.m_cd;
+                m_d2 += _other.m_d2;
+            }
+
+            /// \brief Sum of squared distances of _p to the planes
+            double Eval(const glm::vec3& _p) const
+            {
+                double x = _p.x, y = _p.y, z = _p.z;
+                double result = m_a2 * x * x + 2 * m_ab * x * y + 2 * m_ac * x * z + 2 * m_ad * x
+                              + m_b2 * y * y + 2 * m_bc * y * z + 2 * m_bd * y
+                              + m_c2 * z * z + 2 * m_cd * z
+                              + m_d2;
+                return std::max(result, 0.0);
+            }
+        };
+
+        ///
+        /// \brief How a vertex may move when simplifying
+        ///
+        enum class enVertexKind
+        {
+            MANIFOLD, //!< Interior vertex, can collapse onto any neighbour
+            BORDER,   //!< On one open border, can only collapse along it
+            SEAM,     //!< One of a pair of vertices on a UV/color seam, can only collapse along it together with its twin
+            LOCKED,   //!< Seam junctions, seam ends, non-manifold vertices etc., never move
+        };
+
+        ///
+        /// \brief Candidate collapse of m_from onto m_to
+        ///
+        struct Collapse
+        {
+            double m_cost;         //!< Quadric error of m_from at m_to's position
+            unsigned int m_from;   //!< Vertex that moves
+            unsigned int m_to;     //!< Vertex it moves onto
+            unsigned int m_stamp;  //!< Version of m_from when this was queued
+
+            bool operator>(const Collapse& _other) const { return m_cost > _other.m_cost; }
+        };
+
+        ///
+        /// \brief Hashes positions bit-exactly, to find vertices that share a position
+        ///
+        struct PositionHash
+        {
+            size_t operator()(const glm::vec3& _p) const
+            {
+                uint32_t bits[3];
+                std::memcpy(bits, &_p[0], sizeof(bits));
+                return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+            }
+        };
+    }
+
+    ///
+    /// \brief Simplifies _mesh down to about _targetNumTris triangles, or until the next
+    ///        collapse would exceed _maxError, whichever comes first.
+    ///
+    /// \param _mesh          - Mesh to simplify
+    /// \param _targetNumTris - Number of triangles to stop at
+    /// \param _maxError      - Max distance (in mesh units) the surface may move
+    /// \param _outError      - If not null, gets the distance the surface moved at most
+    ///
+    /// \return The simplified mesh, with unused vertices dropped
+    ///
+    Mesh MeshSimplifier::Simplify(const Mesh& _mesh, size_t _targetNumTris, float _maxError, float* _outError)
+    {
+        ZoneScoped;
+
+        const std::vector<Vertex>& vertices = _mesh.m_vertices;
+        std::vector<unsigned int> indices = _mesh.m_indices;
+        ASSERT(indices.size() % 3 == 0, "Expected triangle indices, but got " << indices.size() << " indices");
+        const size_t numVertices = vertices.size();
+        const size_t numTris = indices.size() / 3;
+
+        // Group the vertices by position. Groups of more than one vertex sit on a seam.
+        std::unordered_map<glm::vec3, unsigned int, PositionHash> positionIds;
+        std::vector<unsigned int> positionId(numVertices);
+        std::vector<unsigned int> positionGroupSize;
+        for ( size_t v = 0; v < numVertices; v++ )
+        {
+            auto inserted = positionIds.emplace(vertices[v].m_pos, static_cast<unsigned int>(positionGroupSize.size()));
+            if ( inserted.second )
+            {
+                positionGroupSize.push_back(0);
+            }
+            positionId[v] = inserted.first->second;
+            positionGroupSize[positionId[v]]++;
+        }
+
+        // Count how many triangles use each edge by position, and by vertex. An edge used once
+        // by vertex is open: it's an open border if it's also used once by position, and a seam
+        // if the triangle on the other side uses other vertices at the same positions.
+        std::unordered_map<uint64_t, unsigned int> edgeUses;
+        std::unordered_map<uint64_t, unsigned int> vertexEdgeUses;
+        auto edgeKey = [&positionId](unsigned int _a, unsigned int _b) {
+            uint64_t pa = positionId[_a];
+            uint64_t pb = positionId[_b];
+            return pa < pb ? (pa << 32) | pb : (pb << 32) | pa;
+        };
+        auto vertexEdgeKey = [](uint64_t _a, uint64_t _b) {
+            return _a < _b ? (_a << 32) | _b : (_b << 32) | _a;
+        };
+        for ( size_t tri = 0; tri < numTris; tri++ )
+        {
+            for ( size_t corner = 0; corner < 3; corner++ )
+            {
+                unsigned int a = indices[tri * 3 + corner];
+                unsigned int b = indices[tri * 3 + (corner + 1) % 3];
+                edgeUses[edgeKey(a, b)]++;
+                vertexEdgeUses[vertexEdgeKey(a, b)]++;
+            }
+        }
+
+        // Count the open edges of each vertex, by type
+        std::vector<unsigned int> numBorderEdges(numVertices, 0);
+        std::vector<unsigned int> numSeamEdges(numVertices, 0);
+        std::vector<unsigned int> numOtherOpenEdges(numVertices, 0);
+        for ( const auto& vertexEdge : vertexEdgeUses )
+        {
+            unsigned int a = static_cast<unsigned int>(vertexEdge.first >> 32);
+            unsigned int b = static_cast<unsigned int>(vertexEdge.first & 0xffffffffu);
+            if ( vertexEdge.second != 1 )
+            {
+                if ( vertexEdge.second > 2 )
+                {
+                    numOtherOpenEdges[a]++;
+                    numOtherOpenEdges[b]++;
+                }
+                continue;
+            }
+
+            unsigned int uses = edgeUses[edgeKey(a, b)];
+            std::vector<unsigned int>& counts = (uses == 1) ? numBorderEdges : (uses == 2) ? numSeamEdges : numOtherOpenEdges;
+            counts[a]++;
+            counts[b]++;
+        }
+
+        // Interior vertices move freely. Vertices on a simple border, or on a simple seam
+        // between exactly two vertices, can only move along it. Everything else stays put.
+        std::vector<std::vector<unsigned int>> positionVertices(positionGroupSize.size());
+        for ( size_t v = 0; v < numVertices; v++ )
+        {
+            positionVertices[positionId[v]].push_back(static_cast<unsigned int>(v));
+        }
+        std::vector<enVertexKind> kinds(numVertices, enVertexKind::LOCKED);
+        std::vector<unsigned int> seamTwins(numVertices, 0);
+        auto isSeamVertex = [&](unsigned int _v) {
+            return numSeamEdges[_v] == 2 && numBorderEdges[_v] == 0 && numOtherOpenEdges[_v] == 0;
+        };
+        for ( size_t v = 0; v < numVertices; v++ )
+        {
+            if ( numOtherOpenEdges[v] > 0 )
+            {
+                continue;
+            }
+
+            const std::vector<unsigned int>& group = positionVertices[positionId[v]];
+            if ( group.size() == 1 )
+            {
+                if ( numBorderEdges[v] == 0 && numSeamEdges[v] == 0 )
+                {
+                    kinds[v] = enVertexKind::MANIFOLD;
+                }
+                else if ( numBorderEdges[v] == 2 && numSeamEdges[v] == 0 )
+                {
+                    kinds[v] = enVertexKind::BORDER;
+                }
+            }
+            else if ( group.size() == 2 && isSeamVertex(group[0]) && isSeamVertex(group[1]) )
+            {
+                kinds[v] = enVertexKind::SEAM;
+                seamTwins[v] = (group[0] == v) ? group[1] : group[0];
+            }
+        }
+
+        // Plane quadrics and triangle adjacency of the vertices. Open edges also add the plane
+        // through the edge perpendicular to the triangle, so moving a border or seam vertex off
+        // the line of its edges costs as much as moving any vertex off its surface.
+        std::vector<Quadric> quadrics(numVertices);
+        std::vector<std::vector<size_t>> vertexTris(numVertices);
+        for ( size_t tri = 0; tri < numTris; tri++ )
+        {
+            const glm::vec3& p0 = vertices[indices[tri * 3]].m_pos;
+            const glm::vec3& p1 = vertices[indices[tri * 3 + 1]].m_pos;
+            const glm::vec3& p2 = vertices[indices[tri * 3 + 2]].m_pos;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(normal);
+            for ( size_t corner = 0; corner < 3; corner++ )
+            {
+                unsigned int v = indices[tri * 3 + corner];
+                if ( length > 0.0f )
+                {
+                    quadrics[v].AddPlane(normal / length, p0);
+
+                    unsigned int next = indices[tri * 3 + (corner + 1) % 3];
+                    glm::vec3 edgeNormal = glm::cross(vertices[next].m_pos - vertices[v].m_pos, normal);
+                    float edgeNormalLength = glm::length(edgeNormal);
+                    if ( vertexEdgeUses[vertexEdgeKey(v, next)] == 1 && edgeNormalLength > 0.0f )
+                    {
+                        Quadric edgeQuadric;
+                        edgeQuadric.AddPlane(edgeNormal / edgeNormalLength, vertices[v].m_pos);
+                        quadrics[v].Add(edgeQuadric);
+                        quadrics[next].Add(edgeQuadric);
+                    }
+                }
+                vertexTris[v].push_back(tri);
+            }
+        }
+
+        std::vector<bool> triAlive(numTris, true);
+        std::vector<bool> vertexAlive(numVertices, true);
+        std::vector<unsigned int> stamps(numVertices, 0);
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+        // Whether the edge between vertices _a and _b is used by exactly one live triangle
+        auto isOpenEdge = [&](unsigned int _a, unsigned int _b) {
+            unsigned int uses = 0;
+            for ( size_t tri : vertexTris[_a] )
+            {
+                const unsigned int* corners = &indices[tri * 3];
+                if ( triAlive[tri] && (corners[0] == _b || corners[1] == _b || corners[2] == _b) )
+                {
+                    uses++;
+                }
+            }
+            return uses == 1;
+        };
+
+        // Seam vertices collapse together with their twin, so they're costed on both quadrics
+        auto pushCollapse = [&](unsigned int _from, unsigned int _to) {
+            if ( kinds[_from] == enVertexKind::LOCKED || positionId[_from] == positionId[_to] )
+            {
+                return;
+            }
+
+            double cost = quadrics[_from].Eval(vertices[_to].m_pos);
+            if ( kinds[_from] == enVertexKind::SEAM )
+            {
+                cost += quadrics[seamTwins[_from]].Eval(vertices[_to].m_pos);
+            }
+            queue.push({cost, _from, _to, stamps[_from]});
+        };
+        for ( size_t tri = 0; tri < numTris; tri++ )
+        {
+            for ( size_t corner = 0; corner < 3; corner++ )
+            {
+                pushCollapse(indices[tri * 3 + corner], indices[tri * 3 + (corner + 1) % 3]);
+                pushCollapse(indices[tri * 3 + (corner + 1) % 3], indices[tri * 3 + corner]);
+            }
+        }
+
+        // Whether moving _from onto _to is still along an edge and doesn't flip any triangle
+        auto canMove = [&](unsigned int _from, unsigned int _to) {
+            bool isEdge = false;
+            const glm::vec3& newPos = vertices[_to].m_pos;
+            for ( size_t tri : vertexTris[_from] )
+            {
+                if ( !triAlive[tri] )
+                {
+                    continue;
+                }
+
+                const unsigned int* corners = &indices[tri * 3];
+                if ( corners[0] == _to || corners[1] == _to || corners[2] == _to )
+                {
+                    isEdge = true;
+                    continue;
+                }
+
+                glm::vec3 p[3];
+                for ( size_t corner = 0; corner < 3; corner++ )
+                {
+                    p[corner] = vertices[corners[corner]].m_pos;
+                }
+                glm::vec3 oldNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+                for ( size_t corner = 0; corner < 3; corner++ )
+                {
+                    if ( corners[corner] == _from )
+                    {
+                        p[corner] = newPos;
+                    }
+                }
+                glm::vec3 newNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+                if ( glm::dot(oldNormal, newNormal) <= 0.0f )
+                {
+                    return false;
+                }
+            }
+            return isEdge;
+        };
+
+        // Moves _from onto _to. Triangles that now have two corners at the same position are gone.
+        size_t numAliveTris = numTris;
+        auto move = [&](unsigned int _from, unsigned int _to) {
+            for ( size_t tri : vertexTris[_from] )
+            {
+                if ( !triAlive[tri] )
+                {
+                    continue;
+                }
+
+                unsigned int* corners = &indices[tri * 3];
+                for ( size_t corner = 0; corner < 3; corner++ )
+                {
+                    if ( corners[corner] == _from )
+                    {
+                        corners[corner] = _to;
+                    }
+                }
+
+                if ( positionId[corners[0]] == positionId[corners[1]] ||
+                     positionId[corners[1]] == positionId[corners[2]] ||
+                     positionId[corners[2]] == positionId[corners[0]] )
+                {
+                    triAlive[tri] = false;
+                    numAliveTris--;
+                }
+                else
+                {
+                    vertexTris[_to].push_back(tri);
+                }
+            }
+            vertexTris[_from].clear();
+            vertexAlive[_from] = false;
+            quadrics[_to].Add(quadrics[_from]);
+            stamps[_to]++;
+        };
+
+        const double maxCost = static_cast<double>(_maxError) * static_cast<double>(_maxError);
+        double worstCost = 0.0;
+
+        while ( numAliveTris > _targetNumTris && !queue.empty() )
+        {
+            Collapse collapse = queue.top();
+            queue.pop();
+
+            const unsigned int from = collapse.m_from;
+            const unsigned int to = collapse.m_to;
+            if ( !vertexAlive[from] || !vertexAlive[to] || collapse.m_stamp != stamps[from] )
+            {
+                continue;
+            }
+            if ( collapse.m_cost > maxCost )
+            {
+                break;
+            }
+
+            // Border and seam vertices may only slide along their open edges. A seam vertex's
+            // twin has to slide along its own open edge onto a vertex at the same position as
+            // _to (or onto _to itself, where the seam closes), so both sides stay stitched.
+            unsigned int twinFrom = from;
+            unsigned int twinTo = to;
+            if ( kinds[from] != enVertexKind::MANIFOLD && !isOpenEdge(from, to) )
+            {
+                continue;
+            }
+            if ( kinds[from] == enVertexKind::SEAM )
+            {
+                twinFrom = seamTwins[from];
+                bool foundTwinTo = false;
+                for ( unsigned int candidate : positionVertices[positionId[to]] )
+                {
+                    if ( vertexAlive[candidate] && isOpenEdge(twinFrom, candidate) )
+                    {
+                        twinTo = candidate;
+                        foundTwinTo = true;
+                        break;
+                    }
+                }
+                if ( !foundTwinTo || !canMove(twinFrom, twinTo) )
+                {
+                    continue;
+                }
+            }
+            if ( !canMove(from, to) )
+            {
+                continue;
+            }
+
+            move(from, to);
+            if ( twinFrom != from )
+            {
+                move(twinFrom, twinTo);
+            }
+            worstCost = std::max(worstCost, collapse.m_cost);
+
+            // Requeue the collapses around the vertices moved onto, whose quadrics (and
+            // neighbourhoods) changed
+            unsigned int targets[2] = { to, twinTo };
+            for ( size_t targetIdx = 0; targetIdx < (twinTo != to ? 2u : 1u); targetIdx++ )
+            {
+                unsigned int target = targets[targetIdx];
+                auto& targetTris = vertexTris[target];
+                targetTris.erase(std::remove_if(targetTris.begin(), targetTris.end(), [&triAlive](size_t _tri) { return !triAlive[_tri]; }), targetTris.end());
+                for ( size_t tri : targetTris )
+                {
+                    for ( size_t corner = 0; corner < 3; corner++ )
+                    {
+                        unsigned int other = indices[tri * 3 + corner];
+                        if ( other != target )
+                        {
+                            pushCollapse(target, other);
+                            pushCollapse(other, target);
+                        }
+                    }
+                }
+            }
+        }
+
+        Mesh simplified;
+        simplified.m_vertices = vertices;
+        simplified.m_indices.reserve(numAliveTris * 3);
+        for ( size_t tri = 0; tri < numTris; tri++ )
+        {
+            if ( triAlive[tri] )
+            {
+                simplified.m_indices.insert(simplified.m_indices.end(), &indices[tri * 3], &indices[tri * 3] + 3);
+            }
+        }
+        MeshOptimizer::OptimizeVertexFetch(simplified);
+
+        if ( _outError )
+        {
+            *_outError = static_cast<float>(std::sqrt(worstCost));
+        }
+
+        return simplified;
+    }
+
+    ///
+    /// \brief Builds a chain of LODs for _mesh. LOD 0 is _mesh itself, and each next LOD has
+    ///        about _trisRatio as many triangles as the previous one. Each LOD is simplified
+    ///        from _mesh directly so its error is measured against the full detail mesh, and is
+    ///        run through MeshOptimizer.
+    ///
+    ///        The chain stops early once simplification stalls (e.g. everything left is locked)
+    ///        or would exceed _maxError.
+    ///
+    /// \param _mesh       - Full detail mesh
+    /// \param _maxNumLODs - Max number of LODs, including LOD 0
+    /// \param _trisRatio  - Triangle count of each LOD relative to the previous one
+    /// \param _maxError   - Max error of any LOD, in mesh units
+    ///
+    /// \return The LODs, finest first. Their errors never decrease.
+    ///
+    std::vector<MeshLOD> MeshSimplifier::BuildLODChain(const Mesh& _mesh, size_t _maxNumLODs, float _trisRatio, float _maxError)
+    {
+        ZoneScoped;
+
+        ASSERT(_trisRatio > 0.0f && _trisRatio < 1.0f, "LOD triangle ratio must be in (0, 1), but got " << _trisRatio);
+
+        std::vector<MeshLOD> lods;
+        lods.push_back({_mesh, 0.0f});
+
+        size_t prevNumTris = _mesh.m_indices.size() / 3;
+        while ( lods.size() < _maxNumLODs )
+        {
+            size_t targetNumTris = static_cast<size_t>(static_cast<float>(prevNumTris) * _trisRatio);
+            if ( targetNumTris == 0 )
+            {
+                break;
+            }
+
+            MeshLOD lod;
+            lod.m_mesh = Simplify(_mesh, targetNumTris, _maxError, &lod.m_error);
+            size_t numTris = lod.m_mesh.m_indices.size() / 3;
+            if ( numTris == 0 || static_cast<float>(numTris) > 0.9f * static_cast<float>(prevNumTris) )
+            {
+                // Not enough of a reduction to be worth another LOD
+                break;
+            }
+
+            MeshOptimizer::Optimize(lod.m_mesh);
+            lod.m_error = std::max(lod.m_error, lods.back().m_error);
+            lods.push_back(std::move(lod));
+            prevNumTris = numTris;
+        }
+
+        return lods;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <cfloat>
+#include <vector>
+#include "Mesh.h"
+
+namespace blithe
+{
+    ///
+    /// \brief One level of detail of a mesh
+    ///
+    struct MeshLOD
+    {
+        Mesh m_mesh;          //!< Simplified mesh
+        float m_error = 0.0f; //!< Upper bound on how far (in mesh units) the surface moved from the full detail mesh
+    };
+
+    ///
+    /// \brief Simplifies meshes by collapsing edges in order of their quadric error (Garland and
+    ///        Heckbert's "Surface Simplification Using Quadric Error Metrics").
+    ///
+    ///        Collapses are half-edge collapses, i.e. a vertex moves onto a neighbouring vertex,
+    ///        so every remaining vertex keeps its exact position, color and texture coordinates.
+    ///        Vertices on open borders only collapse along the border. Vertices on UV/color seams
+    ///        (two vertices sharing a position) only collapse along the seam, together with their
+    ///        twin on the other side, so the seam stays stitched. Both are penalized by planes
+    ///        through their open edges, so sliding off the border or seam line counts towards
+    ///        the error. Seam junctions, seam ends and non-manifold vertices never move.
+    ///
+    class MeshSimplifier
+    {
+    public:
+        static Mesh Simplify(const Mesh& _mesh,
+                             size_t _targetNumTris,
+                             float _maxError = FLT_MAX,
+                             float* _outError = nullptr);
+
+        static std::vector<MeshLOD> BuildLODChain(const Mesh& _mesh,
+                                                  size_t _maxNumLODs = 5,
+                                                  float _trisRatio = 0.5f,
+                                                  float _maxError = FLT_MAX);
+    };
+}
+
+#endif // MESHSIMPLIFIER_H
@@ -0,0 +1,56 @@
+#include "MeshSoA.h"
+#include "Mesh.h"
+#include <tracy/Tracy.hpp>
+
+namespace blithe
+{
+    ///
+    /// \brief Splits the vertices of _mesh into one array per attribute
+    ///
+    /// \param _mesh - Mesh to convert
+    ///
+    /// \return The same mesh as structure-of-arrays
+    ///
+    MeshSoA MeshSoA::FromMesh(const Mesh& _mesh)
+    {
+        ZoneScoped;
+
+        MeshSoA meshSoA;
+        size_t numVertices = _mesh.m_vertices.size();
+        meshSoA.m_positions.resize(numVertices);
+        meshSoA.m_colors.resize(numVertices);
+        meshSoA.m_texCoords.resize(numVertices);
+        for ( size_t i = 0; i < numVertices; i++ )
+        {
+            const Vertex& vertex = _mesh.m_vertices[i];
+            meshSoA.m_positions[i] = vertex.m_pos;
+            meshSoA.m_colors[i] = vertex.m_color;
+            meshSoA.m_texCoords[i] = vertex.m_texCoords;
+        }
+        meshSoA.m_indices = _mesh.m_indices;
+        meshSoA.m_generation = _mesh.m_generation;
+
+        return meshSoA;
+    }
+
+    ///
+    /// \brief Interleaves the attribute arrays back into Vertex structs
+    ///
+    /// \return The same mesh as a Mesh
+    ///
+    Mesh MeshSoA::ToMesh() const
+    {
+        ZoneScoped;
+
+        Mesh mesh;
+        mesh.m_vertices.resize(GetNumVertices());
+        for ( size_t i = 0; i < mesh.m_vertices.size(); i++ )
+        {
+            mesh.m_vertices[i] = GetVertex(i);
+        }
+        mesh.m_indices = m_indices;
+        mesh.m_generation = m_generation;
+
+        return mesh;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef MESHSOA_H
+#define MESHSOA_H
+
+#include <stddef.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Vertex.h"
+
+namespace blithe
+{
+    struct Mesh;
+
+    ///
+    /// \brief A Mesh stored as structure-of-arrays, with one array per vertex attribute instead
+    ///        of one array of Vertex.
+    ///
+    ///        Kernels that only need the positions (the GeomHelpers bounds and centroid, and
+    ///        TriBSPTree classification) then stream 12 bytes per vertex instead of all 36 of a
+    ///        Vertex. Convert with FromMesh() and ToMesh(), and get triangles through a
+    ///        MeshSoAView.
+    ///
+    ///        As with Mesh, code that changes the vertices or indices of an existing MeshSoA
+    ///        should bump m_generation.
+    ///
+    struct MeshSoA
+    {
+        std::vector<glm::vec3> m_positions;  //!< Position of each vertex
+        std::vector<glm::vec4> m_colors;     //!< Color of each vertex
+        std::vector<glm::vec2> m_texCoords;  //!< Texture coordinates of each vertex
+        std::vector<unsigned int> m_indices; //!< Consecutive triples of vertex indices, one per CCW triangle
+        unsigned int m_generation = 0;       //!< Bumped when the vertices or indices change
+
+        static MeshSoA FromMesh(const Mesh& _mesh);
+        Mesh ToMesh() const;
+
+        size_t GetNumVertices() const { return m_positions.size(); }
+
+        ///
+        /// \brief Gathers the attributes of vertex _idx
+        ///
+        /// \param _idx - Index of the vertex
+        ///
+        /// \return The vertex
+        ///
+        Vertex GetVertex(size_t _idx) const
+        {
+            return { m_positions[_idx], m_colors[_idx], m_texCoords[_idx] };
+        }
+    };
+}
+
+#endif // MESHSOA_H
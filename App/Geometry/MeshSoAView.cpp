@@ -0,0 +1,52 @@
+#include "MeshSoAView.h"
+#include "BlitheAssert.h"
+#include "GeomHelpers.h"
+
+namespace blithe
+{
+    ///
+    /// \brief Constructor
+    ///
+    /// \param _mesh - Const ref to MeshSoA we are a getting a "View" into
+    ///
+    MeshSoAView::MeshSoAView(const MeshSoA& _mesh)
+        : m_mesh(_mesh)
+    {
+        SanityCheck(m_mesh);
+    }
+
+    ///
+    /// \brief Gets the local space AABB of the mesh. Unlike MeshView::GetLocalAABB() this isn't
+    ///        cached, since MeshBoundsCache is keyed on Mesh ids.
+    ///
+    /// \return AABB enclosing all the vertices
+    ///
+    AABB MeshSoAView::GetLocalAABB() const
+    {
+        return GeomHelpers::CalcLocalAABB(m_mesh);
+    }
+
+    ///
+    /// \brief Gets the centroid of the mesh's vertex positions. Not cached, see GetLocalAABB().
+    ///
+    /// \return Centroid of the vertex positions
+    ///
+    glm::vec3 MeshSoAView::GetCentroid() const
+    {
+        return GeomHelpers::CalcCentroid(m_mesh);
+    }
+
+    ///
+    /// \brief Checks that the indices of _mesh are whole triangles and that every vertex has
+    ///        all its attributes
+    ///
+    /// \param _mesh - Mesh to check
+    ///
+    void MeshSoAView::SanityCheck(const MeshSoA& _mesh)
+    {
+        ASSERT(_mesh.m_indices.size() % 3 == 0, "Indices must be a flattened list of triples describing faces. Got Num Indices = " << _mesh.m_indices.size());
+        ASSERT(_mesh.m_colors.size() == _mesh.m_positions.size() && _mesh.m_texCoords.size() == _mesh.m_positions.size(),
+               "Each vertex needs a position, color and tex coords. Got " << _mesh.m_positions.size() << " positions, "
+               << _mesh.m_colors.size() << " colors and " << _mesh.m_texCoords.size() << " tex coords");
+    }
+}
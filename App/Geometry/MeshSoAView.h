@@ -0,0 +1,85 @@
+#ifndef MESHSOAVIEW_H
+#define MESHSOAVIEW_H
+
+#include "AABB.h"
+#include "MeshIterator.h"
+#include "MeshSoA.h"
+#include "Tri.h"
+
+namespace blithe
+{
+    ///
+    /// \brief Gives a "View" into a MeshSoA, with the same triangle, iterator and bounds
+    ///        interface MeshView has for a Mesh.
+    ///
+    ///        GetTrianglePositions() only reads the position array, for code that doesn't need
+    ///        the rest of the vertex (e.g. TriBSPTree::AddTriangle(const MeshSoAView&, size_t)
+    ///        classifying triangles against the node planes). The bounds are computed by the
+    ///        GeomHelpers MeshSoA kernels, which also only stream the positions.
+    ///
+    ///        The mesh is validated once, when the view is made, so the triangle accessors and
+    ///        iterators are unchecked and inline.
+    ///
+    class MeshSoAView
+    {
+    public:
+        explicit MeshSoAView(const MeshSoA& _mesh);
+
+        static Tri GetTriangleAtIndex(const MeshSoA& _mesh, size_t _index);
+        size_t GetNumTriangles() const { return m_mesh.m_indices.size() / 3; }
+        Tri GetTriangle(size_t _index) const { return GetTriangleAtIndex(m_mesh, _index); }
+
+        AABB GetLocalAABB() const;
+        glm::vec3 GetCentroid() const;
+
+        ///
+        /// \brief Gets the corner positions of the _index'th triangle
+        ///
+        /// \param _index - Index of desired triangle
+        /// \param _outP0 - (out) Position of the first vertex
+        /// \param _outP1 - (out) Position of the second vertex
+        /// \param _outP2 - (out) Position of the third vertex
+        ///
+        void GetTrianglePositions(size_t _index, glm::vec3& _outP0, glm::vec3& _outP1, glm::vec3& _outP2) const
+        {
+            const unsigned int* indices = &m_mesh.m_indices[_index * 3];
+            _outP0 = m_mesh.m_positions[indices[0]];
+            _outP1 = m_mesh.m_positions[indices[1]];
+            _outP2 = m_mesh.m_positions[indices[2]];
+        }
+
+        using TriangleIterator = MeshIterator<Tri, MeshSoA, &MeshSoAView::GetTriangleAtIndex>;
+
+        TriangleIterator TriangleBegin() const { return TriangleIterator(m_mesh, 0); }
+        TriangleIterator TriangleEnd() const { return TriangleIterator(m_mesh, GetNumTriangles()); }
+
+    private:
+        static void SanityCheck(const MeshSoA& _mesh);
+
+        const MeshSoA& m_mesh; //!< Const ref to MeshSoA we are a getting a "View" into
+    };
+
+    ///
+    /// \brief Static function to access the _index'th triangle in _mesh, gathering each vertex
+    ///        from the attribute arrays. Nothing is checked, so the _mesh should have been
+    ///        validated (e.g. by making a MeshSoAView of it) and _index should be less than its
+    ///        number of triangles.
+    ///
+    /// \param _mesh  - Mesh to lookup triangle
+    /// \param _index - Index of desired triangle
+    ///
+    /// \return _index'th triangle in _mesh
+    ///
+    inline Tri MeshSoAView::GetTriangleAtIndex(const MeshSoA& _mesh, size_t _index)
+    {
+        Tri tri;
+        size_t startIdx = _index*3;
+        tri.m_v0 = _mesh.GetVertex(_mesh.m_indices[startIdx + 0]);
+        tri.m_v1 = _mesh.GetVertex(_mesh.m_indices[startIdx + 1]);
+        tri.m_v2 = _mesh.GetVertex(_mesh.m_indices[startIdx + 2]);
+
+        return tri;
+    }
+}
+
+#endif // MESHSOAVIEW_H
@@ -1,7 +1,5 @@
 #include "MeshView.h"
 #include "BlitheAssert.h"
-#include "Mesh.h"
-#include <vector>
 
 namespace blithe
 {
@@ -13,75 +11,65 @@ namespace blithe
     MeshView::MeshView(const Mesh& _mesh)
         : m_mesh(_mesh)
     {
+        SanityCheck(m_mesh);
     }
 
     ///
-    /// \brief Static function to access the _index'th triangle in _mesh.
-    ///
-    /// \param _mesh  - Mesh to lookup triangle
-    /// \param _index - Index of desired triangle
+    /// \brief Gets the bounds of the mesh from the shared MeshBoundsCache, which only walks the
+    ///        vertices the first time and after the mesh's m_generation changes.
     ///
-    /// \return _index'th triangle in _mesh
+    /// \return Local space bounds of the mesh
     ///
-    Tri MeshView::GetTriangleAtIndex(const Mesh& _mesh, size_t _index)
+    MeshBounds MeshView::GetBounds() const
     {
-        SanityCheck(_mesh);
-
-        Tri tri;
-        size_t startIdx = _index*3;
-        tri.m_v0 = _mesh.m_vertices[_mesh.m_indices[startIdx + 0]];
-        tri.m_v1 = _mesh.m_vertices[_mesh.m_indices[startIdx + 1]];
-        tri.m_v2 = _mesh.m_vertices[_mesh.m_indices[startIdx + 2]];
-
-        return tri;
+        return MeshBoundsCache::GetShared().Get(m_mesh);
     }
 
     ///
-    /// \brief Returns the total number of triangles in the mesh.
-    ///        Assuming the indices are a list of triples, this is just indices.size()/3.
+    /// \brief Gets the cached local space AABB of the mesh. See GetBounds().
     ///
-    /// \return Total number of triangles in the mesh
+    /// \return AABB enclosing all the vertices
     ///
-    size_t MeshView::GetNumTriangles() const
+    AABB MeshView::GetLocalAABB() const
     {
-        SanityCheck(m_mesh);
-
-        return m_mesh.m_indices.size() / 3;
+        return GetBounds().m_aabb;
     }
 
     ///
-    /// \brief Gets the _index'th triangle in the mesh.
+    /// \brief Gets the cached local space oriented bounding box of the mesh. See GetBounds().
     ///
-    /// \param _index - Index of desired triangle
+    /// \return OBB enclosing all the vertices
     ///
-    /// \return _index'th triangle in the mesh
-    ///
-    Tri MeshView::GetTriangle(size_t _index) const
+    OBB MeshView::GetLocalOBB() const
     {
-        return GetTriangleAtIndex(m_mesh, _index);
+        return GetBounds().m_obb;
     }
 
     ///
-    /// \brief Iterator begin for iterating over triangles
+    /// \brief Gets the cached local space bounding sphere of the mesh. See GetBounds().
     ///
-    /// \return TriangleIterator begin
+    /// \return Sphere enclosing all the vertices
     ///
-    MeshView::TriangleIterator MeshView::TriangleBegin() const
+    Sphere MeshView::GetBoundingSphere() const
     {
-        return TriangleIterator(m_mesh, 0, GetTriangleAtIndex);
+        return GetBounds().m_sphere;
     }
 
     ///
-    /// \brief Iterator end for iterating over triangles
+    /// \brief Gets the cached centroid of the mesh's vertex positions. See GetBounds().
     ///
-    /// \return TriangleIterator end
+    /// \return Centroid of the vertex positions
     ///
-    MeshView::TriangleIterator MeshView::TriangleEnd() const
+    glm::vec3 MeshView::GetCentroid() const
     {
-        return TriangleIterator(m_mesh, GetNumTriangles(), GetTriangleAtIndex);
+        return GetBounds().m_centroid;
     }
 
-
+    ///
+    /// \brief Checks that the indices of _mesh are whole triangles
+    ///
+    /// \param _mesh - Mesh to check
+    ///
     void MeshView::SanityCheck(const Mesh& _mesh)
     {
         ASSERT(_mesh.m_indices.size() % 3 == 0, "Indices must be a flattened list of triples describing faces. Got Num Indices = " << _mesh.m_indices.size());
@@ -1,36 +1,66 @@
 #ifndef MESHVIEW_H
 #define MESHVIEW_H
 
+#include "Mesh.h"
+#include "MeshBoundsCache.h"
 #include "MeshIterator.h"
 #include "Tri.h"
 
 namespace blithe
 {
-    struct Mesh;
-
     ///
     /// \brief Gives a "View" into a Mesh, such as getting its i'th triangle etc.
     ///        Separated out so that the Mesh struct itself can be a lightweight POD.
     ///
+    ///        The mesh is validated once, when the view is made, so the triangle accessors and
+    ///        iterators are unchecked and inline.
+    ///
     class MeshView
     {
     public:
         explicit MeshView(const Mesh& _mesh);
 
         static Tri GetTriangleAtIndex(const Mesh& _mesh, size_t _index);
-        size_t GetNumTriangles() const;
-        Tri GetTriangle(size_t _index) const;
+        size_t GetNumTriangles() const { return m_mesh.m_indices.size() / 3; }
+        Tri GetTriangle(size_t _index) const { return GetTriangleAtIndex(m_mesh, _index); }
+
+        MeshBounds GetBounds() const;
+        AABB GetLocalAABB() const;
+        OBB GetLocalOBB() const;
+        Sphere GetBoundingSphere() const;
+        glm::vec3 GetCentroid() const;
 
-        using TriangleIterator = MeshIterator<Tri, Mesh>;
+        using TriangleIterator = MeshIterator<Tri, Mesh, &MeshView::GetTriangleAtIndex>;
 
-        TriangleIterator TriangleBegin() const;
-        TriangleIterator TriangleEnd() const;
+        TriangleIterator TriangleBegin() const { return TriangleIterator(m_mesh, 0); }
+        TriangleIterator TriangleEnd() const { return TriangleIterator(m_mesh, GetNumTriangles()); }
 
     private:
         static void SanityCheck(const Mesh& _mesh);
 
         const Mesh& m_mesh; //!< Const ref to Mesh we are a getting a "View" into
     };
+
+    ///
+    /// \brief Static function to access the _index'th triangle in _mesh. Nothing is checked, so
+    ///        the _mesh should have been validated (e.g. by making a MeshView of it) and _index
+    ///        should be less than its number of triangles.
+    ///
+    /// \param _mesh  - Mesh to lookup triangle
+    /// \param _index - Index of desired triangle
+    ///
+    /// \return _index'th triangle in _mesh
+    ///
+    inline Tri MeshView::GetTriangleAtIndex(const Mesh& _mesh, size_t _index)
+    {
+        Tri tri;
+        size_t startIdx = _index*3;
+        tri.m_v0 = _mesh.m_vertices[_mesh.m_indices[startIdx + 0]];
+        tri.m_v1 = _mesh.m_vertices[_mesh.m_indices[startIdx + 1]];
+        tri.m_v2 = _mesh.m_vertices[_mesh.m_indices[startIdx + 2]];
+
+        return tri;
+    }
 }
 
 #endif //MESHVIEW_H
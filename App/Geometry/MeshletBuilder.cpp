@@ -0,0 +1,184 @@
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cmath>
+#include <tracy/Tracy.hpp>
+#include "BlitheAssert.h"
+#include "Mesh.h"
+
+namespace blithe
+{
+    constexpr size_t MeshletBuilder::MAX_VERTICES;
+    constexpr size_t MeshletBuilder::MAX_TRIS;
+
+    ///
+    /// \brief Splits _mesh into meshlets, walking the triangles in index order and starting a
+    ///        new meshlet whenever the next triangle would take the current one over a limit.
+    ///
+    /// \param _mesh        - Mesh to split
+    /// \param _maxVertices - Max distinct vertices per meshlet. Must be at least 3.
+    /// \param _maxTris     - Max triangles per meshlet. Must be at least 1.
+    ///
+    /// \return Meshlets covering all of the mesh's triangles, in index order
+    ///
+    std::vector<Meshlet> MeshletBuilder::Build(const Mesh& _mesh, size_t _maxVertices, size_t _maxTris)
+    {
+        ZoneScoped;
+
+        ASSERT(_maxVertices >= 3 && _maxTris >= 1, "Meshlets need room for at least one triangle");
+        const std::vector<unsigned int>& indices = _mesh.m_indices;
+        ASSERT(indices.size() % 3 == 0, "Expected triangle indices, but got " << indices.size() << " indices");
+
+        std::vector<Meshlet> meshlets;
+
+        // Vertices stamped with the current meshlet's number are already in it
+        std::vector<size_t> vertexStamps(_mesh.m_vertices.size(), 0);
+        size_t stamp = 1;
+
+        Meshlet current = {};
+        for ( size_t tri = 0; tri < indices.size() / 3; tri++ )
+        {
+            const unsigned int* corners = &indices[tri * 3];
+            size_t numNewVertices = 0;
+            for ( size_t corner = 0; corner < 3; corner++ )
+            {
+                bool seenInTri = (corner > 0 && corners[corner] == corners[0]) || (corner > 1 && corners[corner] == corners[1]);
+                if ( vertexStamps[corners[corner]] != stamp && !seenInTri )
+                {
+                    numNewVertices++;
+                }
+            }
+
+            if ( current.m_numIndices / 3 == _maxTris || current.m_numVertices + numNewVertices > _maxVertices )
+            {
+                CalcBounds(_mesh, current);
+                meshlets.push_back(current);
+
+                current = {};
+                current.m_firstIndex = tri * 3;
+                stamp++;
+                numNewVertices = 0;
+                for ( size_t corner = 0; corner < 3; corner++ )
+                {
+                    bool seenInTri = (corner > 0 && corners[corner] == corners[0]) || (corner > 1 && corners[corner] == corners[1]);
+                    numNewVertices += seenInTri ? 0 : 1;
+                }
+            }
+
+            for ( size_t corner = 0; corner < 3; corner++ )
+            {
+                vertexStamps[corners[corner]] = stamp;
+            }
+            current.m_numVertices += numNewVertices;
+            current.m_numIndices += 3;
+        }
+
+        if ( current.m_numIndices > 0 )
+        {
+            CalcBounds(_mesh, current);
+            meshlets.push_back(current);
+        }
+
+        return meshlets;
+    }
+
+    ///
+    /// \brief Checks whether every triangle of _meshlet faces away from _cameraPos, using its
+    ///        bounding sphere and normal cone. This is conservative, i.e. it can miss meshlets
+    ///        that are back-facing, but never culls one that isn't.
+    ///
+    ///        A triangle with normal n through a point p faces away when dot(n, p - camera) >= 0.
+    ///        With the normals within angle a of the cone axis, and theta the angle between the
+    ///        axis and the direction from the camera to the sphere's center c, the smallest
+    ///        dot(n, c - camera) is |c - camera| * cos(theta + a), and moving p around the sphere
+    ///        takes off at most the radius.
+    ///
+    /// \param _meshlet   - Meshlet to test
+    /// \param _cameraPos - Camera position, in the same space as the meshlet
+    ///
+    /// \return Whether the meshlet can be culled as back-facing
+    ///
+    bool MeshletBuilder::IsBackFacing(const Meshlet& _meshlet, const glm::vec3& _cameraPos)
+    {
+        if ( _meshlet.m_coneCosAngle <= 0.0f )
+        {
+            return false;
+        }
+
+        glm::vec3 toCenter = _meshlet.m_bounds.m_center - _cameraPos;
+        float distance = glm::length(toCenter);
+        if ( distance <= _meshlet.m_bounds.m_radius )
+        {
+            return false;
+        }
+
+        float cosTheta = glm::dot(toCenter, _meshlet.m_coneAxis) / distance;
+        float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+        float cosA = _meshlet.m_coneCosAngle;
+        float sinA = std::sqrt(std::max(0.0f, 1.0f - cosA * cosA));
+        return distance * (cosTheta * cosA - sinTheta * sinA) >= _meshlet.m_bounds.m_radius;
+    }
+
+    ///
+    /// \brief Calculates the bounding box, bounding sphere and normal cone of _meshlet's
+    ///        triangles.
+    ///
+    /// \param _mesh    - Mesh the meshlet is in
+    /// \param _meshlet - Meshlet whose m_firstIndex and m_numIndices are set
+    ///
+    void MeshletBuilder::CalcBounds(const Mesh& _mesh, Meshlet& _meshlet)
+    {
+        const unsigned int* indices = &_mesh.m_indices[_meshlet.m_firstIndex];
+
+        _meshlet.m_aabb.m_min = _mesh.m_vertices[indices[0]].m_pos;
+        _meshlet.m_aabb.m_max = _meshlet.m_aabb.m_min;
+        for ( size_t i = 1; i < _meshlet.m_numIndices; i++ )
+        {
+            const glm::vec3& p = _mesh.m_vertices[indices[i]].m_pos;
+            _meshlet.m_aabb.m_min = glm::min(_meshlet.m_aabb.m_min, p);
+            _meshlet.m_aabb.m_max = glm::max(_meshlet.m_aabb.m_max, p);
+        }
+
+        // Sphere around the box center, shrunk to the furthest vertex
+        _meshlet.m_bounds.m_center = (_meshlet.m_aabb.m_min + _meshlet.m_aabb.m_max) * 0.5f;
+        float radiusSq = 0.0f;
+        for ( size_t i = 0; i < _meshlet.m_numIndices; i++ )
+        {
+            glm::vec3 offset = _mesh.m_vertices[indices[i]].m_pos - _meshlet.m_bounds.m_center;
+            radiusSq = std::max(radiusSq, glm::dot(offset, offset));
+        }
+        _meshlet.m_bounds.m_radius = std::sqrt(radiusSq);
+
+        // Normal cone. Degenerate triangles have no normal, so they don't constrain it.
+        std::vector<glm::vec3> normals;
+        normals.reserve(_meshlet.m_numIndices / 3);
+        glm::vec3 normalSum(0.0f);
+        for ( size_t i = 0; i < _meshlet.m_numIndices; i += 3 )
+        {
+            const glm::vec3& p0 = _mesh.m_vertices[indices[i]].m_pos;
+            const glm::vec3& p1 = _mesh.m_vertices[indices[i + 1]].m_pos;
+            const glm::vec3& p2 = _mesh.m_vertices[indices[i + 2]].m_pos;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(normal);
+            if ( length > 0.0f )
+            {
+                normals.push_back(normal / length);
+                normalSum += normals.back();
+            }
+        }
+
+        float sumLength = glm::length(normalSum);
+        if ( normals.empty() || sumLength < 1e-6f )
+        {
+            _meshlet.m_coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+            _meshlet.m_coneCosAngle = -1.0f;
+            return;
+        }
+
+        _meshlet.m_coneAxis = normalSum / sumLength;
+        _meshlet.m_coneCosAngle = 1.0f;
+        for ( const glm::vec3& normal : normals )
+        {
+            _meshlet.m_coneCosAngle = std::min(_meshlet.m_coneCosAngle, glm::dot(normal, _meshlet.m_coneAxis));
+        }
+    }
+}
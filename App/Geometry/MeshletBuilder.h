@@ -0,0 +1,49 @@
+#ifndef MESHLETBUILDER_H
+#define MESHLETBUILDER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "AABB.h"
+#include "Sphere.h"
+
+namespace blithe
+{
+    struct Mesh;
+
+    ///
+    /// \brief A small cluster of a mesh's triangles, with bounds for culling it as a whole
+    ///
+    struct Meshlet
+    {
+        size_t m_firstIndex;  //!< Offset (in indices) of the meshlet's first triangle in the mesh's indices
+        size_t m_numIndices;  //!< Number of indices (3 per triangle)
+        size_t m_numVertices; //!< Number of distinct vertices the triangles use
+        Sphere m_bounds;      //!< Bounding sphere of the triangles
+        AABB m_aabb;          //!< Bounding box of the triangles
+        glm::vec3 m_coneAxis; //!< Average direction of the triangle normals
+        float m_coneCosAngle; //!< Cosine of the max angle between m_coneAxis and any triangle normal. <= 0 if the cone is too wide to ever cull.
+    };
+
+    ///
+    /// \brief Splits meshes into meshlets of at most MAX_VERTICES vertices and MAX_TRIS
+    ///        triangles (the sizes mesh shaders commonly use), in index order. So each meshlet
+    ///        is a contiguous run of the mesh's indices and can be drawn by itself, and meshlets
+    ///        are as compact as the triangle order is local. Run the mesh through
+    ///        MeshOptimizer::OptimizeVertexCache() first for tight meshlets.
+    ///
+    class MeshletBuilder
+    {
+    public:
+        static constexpr size_t MAX_VERTICES = 64; //!< Default max vertices per meshlet
+        static constexpr size_t MAX_TRIS = 124;    //!< Default max triangles per meshlet
+
+        static std::vector<Meshlet> Build(const Mesh& _mesh, size_t _maxVertices = MAX_VERTICES, size_t _maxTris = MAX_TRIS);
+
+        static bool IsBackFacing(const Meshlet& _meshlet, const glm::vec3& _cameraPos);
+
+    private:
+        static void CalcBounds(const Mesh& _mesh, Meshlet& _meshlet);
+    };
+}
+
+#endif // MESHLETBUILDER_H
@@ -0,0 +1,36 @@
+#ifndef OBB_H
+#define OBB_H
+
+#include <glm/glm.hpp>
+#include "AABB.h"
+
+namespace blithe
+{
+    ///
+    /// \brief Oriented Bounding Box defined by its center, orthonormal axes and the half
+    ///        extents along each axis
+    ///
+    ///        Unlike an AABB, an OBB stays tight when its object rotates. See
+    ///        GeomHelpers::CalcLocalOBB() and GeomHelpers::TransformOBB().
+    ///
+    struct OBB
+    {
+        glm::vec3 m_center;      //!< Center of the box
+        glm::mat3 m_axes;        //!< Axes of the box, as the columns of a rotation matrix
+        glm::vec3 m_halfExtents; //!< Half the size of the box along each of m_axes
+
+        ///
+        /// \brief Makes an OBB covering the same space as _aabb
+        ///
+        /// \param _aabb - Box to convert
+        ///
+        /// \return OBB with the world axes
+        ///
+        static OBB FromAABB(const AABB& _aabb)
+        {
+            return { (_aabb.m_min + _aabb.m_max) * 0.5f, glm::mat3(1.0f), (_aabb.m_max - _aabb.m_min) * 0.5f };
+        }
+    };
+}
+
+#endif // OBB_H
@@ -0,0 +1,422 @@
+#include "OcclusionBuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <tracy/Tracy.hpp>
+#include "BlitheAssert.h"
+#include "BlitheSIMD.h"
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+namespace blithe
+{
+    constexpr int OcclusionBuffer::TILE_SIZE;
+
+    ///
+    /// \brief Constructor
+    ///
+    /// \param _width  - Width in pixels. Must be a multiple of TILE_SIZE.
+    /// \param _height - Height in pixels. Must be a multiple of TILE_SIZE.
+    ///
+    OcclusionBuffer::OcclusionBuffer(int _width, int _height) :
+        m_width(_width),
+        m_height(_height),
+        m_numTilesX(_width / TILE_SIZE),
+        m_viewProjection(1.0f),
+        m_depths(static_cast<size_t>(_width * _height), 1.0f),
+        m_tileMax(static_cast<size_t>((_width / TILE_SIZE) * (_height / TILE_SIZE)), 1.0f)
+    {
+        ASSERT(_width > 0 && _height > 0 && _width % TILE_SIZE == 0 && _height % TILE_SIZE == 0,
+               "Occlusion buffer size must be a positive multiple of " << TILE_SIZE << ", but got " << _width << "x" << _height);
+    }
+
+    ///
+    /// \brief Clears the buffer and the queued occluders, for rendering from a new camera.
+    ///
+    /// \param _viewProjection - View-projection matrix of the camera
+    ///
+    void OcclusionBuffer::Begin(const glm::mat4& _viewProjection)
+    {
+        m_viewProjection = _viewProjection;
+        m_tris.clear();
+        std::fill(m_depths.begin(), m_depths.end(), 1.0f);
+        std::fill(m_tileMax.begin(), m_tileMax.end(), 1.0f);
+    }
+
+    ///
+    /// \brief Queues the front-facing triangles of _mesh to be rasterized, clipping them
+    ///        against the near plane.
+    ///
+    /// \param _mesh  - Closed occluder mesh with counter-clockwise front faces
+    /// \param _model - Model matrix of the occluder
+    ///
+    void OcclusionBuffer::AddOccluder(const Mesh& _mesh, const glm::mat4& _model)
+    {
+        ZoneScoped;
+
+        glm::mat4 modelViewProjection = m_viewProjection * _model;
+        std::vector<glm::vec4> clipVerts(_mesh.m_vertices.size());
+        for ( size_t i = 0; i < _mesh.m_vertices.size(); i++ )
+        {
+            clipVerts[i] = modelViewProjection * glm::vec4(_mesh.m_vertices[i].m_pos, 1.0f);
+        }
+
+        for ( size_t i = 0; i + 2 < _mesh.m_indices.size(); i += 3 )
+        {
+            glm::vec4 tri[3] = { clipVerts[_mesh.m_indices[i]], clipVerts[_mesh.m_indices[i + 1]], clipVerts[_mesh.m_indices[i + 2]] };
+
+            // Signed distances from the near plane, z = -w
+            float dists[3] = { tri[0].z + tri[0].w, tri[1].z + tri[1].w, tri[2].z + tri[2].w };
+            int numInside = (dists[0] >= 0.0f) + (dists[1] >= 0.0f) + (dists[2] >= 0.0f);
+            if ( numInside == 3 )
+            {
+                AddClippedTri(tri, 3);
+            }
+            else if ( numInside > 0 )
+            {
+                // Sutherland-Hodgman against the near plane leaves 3 or 4 corners
+                glm::vec4 clipped[4];
+                size_t numClipped = 0;
+                for ( int corner = 0; corner < 3; corner++ )
+                {
+                    int next = (corner + 1) % 3;
+                    if ( dists[corner] >= 0.0f )
+                    {
+                        clipped[numClipped++] = tri[corner];
+                    }
+                    if ( (dists[corner] >= 0.0f) != (dists[next] >= 0.0f) )
+                    {
+                        float t = dists[corner] / (dists[corner] - dists[next]);
+                        clipped[numClipped++] = tri[corner] + (tri[next] - tri[corner]) * t;
+                    }
+                }
+                AddClippedTri(clipped, numClipped);
+            }
+        }
+    }
+
+    ///
+    /// \brief Rasterizes the queued occluders into the buffer and updates the tile depths.
+    ///        The rows are split into bands of whole tiles that are rasterized in parallel,
+    ///        with the first band on the calling thread.
+    ///
+    void OcclusionBuffer::Rasterize()
+    {
+        ZoneScoped;
+
+        int numTilesY = m_height / TILE_SIZE;
+        int numBands = std::min(static_cast<int>(ThreadPool::GetShared().GetNumThreads()) + 1, numTilesY);
+        auto getBandRow = [numTilesY, numBands](int _band) { return _band * numTilesY / numBands * TILE_SIZE; };
+
+        std::vector<std::future<void>> futures;
+        for ( int band = 1; band < numBands; band++ )
+        {
+            int firstRow = getBandRow(band);
+            int lastRow = getBandRow(band + 1);
+            futures.push_back(ThreadPool::GetShared().Submit([this, firstRow, lastRow]() { RasterizeBand(firstRow, lastRow); }));
+        }
+        RasterizeBand(0, getBandRow(1));
+        for ( std::future<void>& future : futures )
+        {
+            future.wait();
+        }
+    }
+
+    ///
+    /// \brief Checks whether _bounds is entirely hidden behind the rasterized occluders, by
+    ///        comparing the nearest depth of its corners with the occluder depths over the
+    ///        screen rectangle its corners span. Boxes that cross the near plane or are off
+    ///        screen are never occluded.
+    ///
+    /// \param _bounds - Box to test
+    /// \param _model  - Matrix taking _bounds to world space
+    ///
+    /// \return Whether the box is certainly occluded
+    ///
+    bool OcclusionBuffer::IsOccluded(const AABB& _bounds, const glm::mat4& _model) const
+    {
+        glm::mat4 modelViewProjection = m_viewProjection * _model;
+
+        glm::vec2 screenMin(std::numeric_limits<float>::infinity());
+        glm::vec2 screenMax(-std::numeric_limits<float>::infinity());
+        float minDepth = std::numeric_limits<float>::infinity();
+        for ( int corner = 0; corner < 8; corner++ )
+        {
+            glm::vec3 pos((corner & 1) ? _bounds.m_max.x : _bounds.m_min.x,
+                          (corner & 2) ? _bounds.m_max.y : _bounds.m_min.y,
+                          (corner & 4) ? _bounds.m_max.z : _bounds.m_min.z);
+            glm::vec4 clip = modelViewProjection * glm::vec4(pos, 1.0f);
+            if ( clip.z < -clip.w || clip.w <= 0.0f )
+            {
+                return false;
+            }
+
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            glm::vec2 screen((ndc.x * 0.5f + 0.5f) * static_cast<float>(m_width), (ndc.y * 0.5f + 0.5f) * static_cast<float>(m_height));
+            screenMin = glm::min(screenMin, screen);
+            screenMax = glm::max(screenMax, screen);
+            minDepth = std::min(minDepth, ndc.z);
+        }
+
+        if ( screenMax.x < 0.0f || screenMax.y < 0.0f || screenMin.x >= static_cast<float>(m_width) || screenMin.y >= static_cast<float>(m_height) )
+        {
+            return false;
+        }
+
+        // Every pixel the rectangle touches, plus a border of one pixel. Occluder coverage is
+        // sampled at pixel centers, so a pixel can be covered while part of it isn't, but next to
+        // an occluder edge there's always an uncovered pixel center within a pixel of the box.
+        // The rectangle is clamped to the screen first, since corners near the camera plane
+        // project very far out.
+        screenMin = glm::max(screenMin, glm::vec2(0.0f));
+        screenMax = glm::min(screenMax, glm::vec2(static_cast<float>(m_width), static_cast<float>(m_height)));
+        int x0 = std::max(0, static_cast<int>(screenMin.x) - 1);
+        int y0 = std::max(0, static_cast<int>(screenMin.y) - 1);
+        int x1 = std::min(m_width - 1, static_cast<int>(screenMax.x) + 1);
+        int y1 = std::min(m_height - 1, static_cast<int>(screenMax.y) + 1);
+
+        for ( int tileY = y0 / TILE_SIZE; tileY <= y1 / TILE_SIZE; tileY++ )
+        {
+            for ( int tileX = x0 / TILE_SIZE; tileX <= x1 / TILE_SIZE; tileX++ )
+            {
+                // The whole tile is nearer than the box
+                if ( m_tileMax[static_cast<size_t>(tileY * m_numTilesX + tileX)] < minDepth )
+                {
+                    continue;
+                }
+
+                int rowEnd = std::min(y1, tileY * TILE_SIZE + TILE_SIZE - 1);
+                int colEnd = std::min(x1, tileX * TILE_SIZE + TILE_SIZE - 1);
+                for ( int y = std::max(y0, tileY * TILE_SIZE); y <= rowEnd; y++ )
+                {
+                    const float* row = &m_depths[static_cast<size_t>(y * m_width)];
+                    for ( int x = std::max(x0, tileX * TILE_SIZE); x <= colEnd; x++ )
+                    {
+                        if ( row[x] >= minDepth )
+                        {
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    ///
+    /// \brief Tests the world bounding box of each instance against the buffer.
+    ///
+    /// \param _localBounds - Bounding box of the instanced mesh, in its local space
+    /// \param _transforms  - Instance transforms
+    /// \param _outVisible  - Overwritten with the transforms of the instances that aren't
+    ///                       occluded, in order
+    ///
+    /// \return Number of occluded instances
+    ///
+    size_t OcclusionBuffer::CullInstances(const AABB& _localBounds, const std::vector<glm::mat4>& _transforms, std::vector<glm::mat4>& _outVisible) const
+    {
+        ZoneScoped;
+
+        _outVisible.clear();
+        for ( const glm::mat4& transform : _transforms )
+        {
+            if ( !IsOccluded(_localBounds, transform) )
+            {
+                _outVisible.push_back(transform);
+            }
+        }
+        return _transforms.size() - _outVisible.size();
+    }
+
+    ///
+    /// \brief Projects a clipped convex polygon to the screen and queues it as a triangle fan,
+    ///        dropping it if it faces away or is off screen.
+    ///
+    /// \param _clipVerts - Corners of the polygon in clip space, all in front of the near plane
+    /// \param _numVerts  - Number of corners (3 or 4)
+    ///
+    void OcclusionBuffer::AddClippedTri(const glm::vec4* _clipVerts, size_t _numVerts)
+    {
+        glm::vec3 screenVerts[4];
+        glm::vec2 screenMin(std::numeric_limits<float>::infinity());
+        glm::vec2 screenMax(-std::numeric_limits<float>::infinity());
+        for ( size_t i = 0; i < _numVerts; i++ )
+        {
+            glm::vec3 ndc = glm::vec3(_clipVerts[i]) / _clipVerts[i].w;
+            screenVerts[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * static_cast<float>(m_width),
+                                       (ndc.y * 0.5f + 0.5f) * static_cast<float>(m_height),
+                                       ndc.z);
+            screenMin = glm::min(screenMin, glm::vec2(screenVerts[i]));
+            screenMax = glm::max(screenMax, glm::vec2(screenVerts[i]));
+        }
+
+        if ( screenMax.x < 0.0f || screenMax.y < 0.0f || screenMin.x > static_cast<float>(m_width) || screenMin.y > static_cast<float>(m_height) )
+        {
+            return;
+        }
+
+        for ( size_t i = 1; i + 1 < _numVerts; i++ )
+        {
+            const glm::vec3& v0 = screenVerts[0];
+            const glm::vec3& v1 = screenVerts[i];
+            const glm::vec3& v2 = screenVerts[i + 1];
+            float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+            if ( area > 0.0f )
+            {
+                m_tris.push_back({ { v0, v1, v2 } });
+            }
+        }
+    }
+
+    ///
+    /// \brief Rasterizes all the queued triangles that overlap rows [_firstRow, _lastRow), then
+    ///        updates the tile depths of those rows.
+    ///
+    /// \param _firstRow - First row. A multiple of TILE_SIZE.
+    /// \param _lastRow  - One past the last row. A multiple of TILE_SIZE.
+    ///
+    void OcclusionBuffer::RasterizeBand(int _firstRow, int _lastRow)
+    {
+        ZoneScoped;
+
+        for ( const ScreenTri& tri : m_tris )
+        {
+            RasterizeTri(tri, _firstRow, _lastRow);
+        }
+
+        for ( int tileY = _firstRow / TILE_SIZE; tileY < _lastRow / TILE_SIZE; tileY++ )
+        {
+            for ( int tileX = 0; tileX < m_numTilesX; tileX++ )
+            {
+                float tileMax = 0.0f;
+                for ( int y = tileY * TILE_SIZE; y < (tileY + 1) * TILE_SIZE; y++ )
+                {
+                    const float* row = &m_depths[static_cast<size_t>(y * m_width + tileX * TILE_SIZE)];
+                    tileMax = std::max(tileMax, *std::max_element(row, row + TILE_SIZE));
+                }
+                m_tileMax[static_cast<size_t>(tileY * m_numTilesX + tileX)] = tileMax;
+            }
+        }
+    }
+
+    ///
+    /// \brief Rasterizes the part of _tri in rows [_firstRow, _lastRow), keeping the nearest
+    ///        depth per pixel. Pixels are covered if their centers are strictly inside the
+    ///        triangle. Depth is linear in screen space, so it's stepped along with the edge
+    ///        functions.
+    ///
+    /// \param _tri      - Triangle to rasterize
+    /// \param _firstRow - First row to rasterize
+    /// \param _lastRow  - One past the last row to rasterize
+    ///
+    void OcclusionBuffer::RasterizeTri(const ScreenTri& _tri, int _firstRow, int _lastRow)
+    {
+        const glm::vec3& v0 = _tri.m_verts[0];
+        const glm::vec3& v1 = _tri.m_verts[1];
+        const glm::vec3& v2 = _tri.m_verts[2];
+
+        // Bounds are clamped in float first, since they can be far off screen
+        float width = static_cast<float>(m_width);
+        float height = static_cast<float>(m_height);
+        float triMinY = std::max(-1.0f, std::min(v0.y, std::min(v1.y, v2.y)));
+        float triMaxY = std::min(height, std::max(v0.y, std::max(v1.y, v2.y)));
+        float triMinX = std::max(-1.0f, std::min(v0.x, std::min(v1.x, v2.x)));
+        float triMaxX = std::min(width, std::max(v0.x, std::max(v1.x, v2.x)));
+
+        int minY = std::max(_firstRow, static_cast<int>(std::floor(triMinY)));
+        int maxY = std::min(_lastRow - 1, static_cast<int>(std::floor(triMaxY)));
+        if ( minY > maxY )
+        {
+            return;
+        }
+        // Start on a multiple of 4 so the SIMD path can step 4 pixels at a time. The width is a
+        // multiple of TILE_SIZE, so it never runs off the end of a row.
+        int minX = std::max(0, static_cast<int>(std::floor(triMinX))) & ~3;
+        int maxX = std::min(m_width - 1, static_cast<int>(std::floor(triMaxX)));
+        if ( minX > maxX )
+        {
+            return;
+        }
+
+        // Edge function of edge ab at p is (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x),
+        // positive inside for a counter-clockwise triangle.
+        const glm::vec3* edgeStarts[3] = { &v0, &v1, &v2 };
+        const glm::vec3* edgeEnds[3] = { &v1, &v2, &v0 };
+        float edgeStepX[3];
+        float edgeStepY[3];
+        float edgeRowStart[3];
+        float startX = static_cast<float>(minX) + 0.5f;
+        float startY = static_cast<float>(minY) + 0.5f;
+        for ( int edge = 0; edge < 3; edge++ )
+        {
+            const glm::vec3& a = *edgeStarts[edge];
+            const glm::vec3& b = *edgeEnds[edge];
+            edgeStepX[edge] = -(b.y - a.y);
+            edgeStepY[edge] = b.x - a.x;
+            edgeRowStart[edge] = (b.x - a.x) * (startY - a.y) - (b.y - a.y) * (startX - a.x);
+        }
+
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        float depthStepX = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+        float depthStepY = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+        float depthRowStart = v0.z + depthStepX * (startX - v0.x) + depthStepY * (startY - v0.y);
+
+        for ( int y = minY; y <= maxY; y++ )
+        {
+            float* row = &m_depths[static_cast<size_t>(y * m_width)];
+
+#if defined(BLITHE_SIMD_SSE2)
+            const __m128 laneOffsets = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+            const __m128 zero = _mm_setzero_ps();
+            __m128 edges[3];
+            __m128 edgeSteps[3];
+            for ( int edge = 0; edge < 3; edge++ )
+            {
+                edges[edge] = _mm_add_ps(_mm_set1_ps(edgeRowStart[edge]), _mm_mul_ps(laneOffsets, _mm_set1_ps(edgeStepX[edge])));
+                edgeSteps[edge] = _mm_set1_ps(4.0f * edgeStepX[edge]);
+            }
+            __m128 depth = _mm_add_ps(_mm_set1_ps(depthRowStart), _mm_mul_ps(laneOffsets, _mm_set1_ps(depthStepX)));
+            const __m128 depthStep = _mm_set1_ps(4.0f * depthStepX);
+
+            for ( int x = minX; x <= maxX; x += 4 )
+            {
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(edges[0], zero), _mm_cmpgt_ps(edges[1], zero)), _mm_cmpgt_ps(edges[2], zero));
+                if ( _mm_movemask_ps(inside) != 0 )
+                {
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_min_ps(old, depth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+                }
+                for ( int edge = 0; edge < 3; edge++ )
+                {
+                    edges[edge] = _mm_add_ps(edges[edge], edgeSteps[edge]);
+                }
+                depth = _mm_add_ps(depth, depthStep);
+            }
+#else
+            float edges[3] = { edgeRowStart[0], edgeRowStart[1], edgeRowStart[2] };
+            float depth = depthRowStart;
+            for ( int x = minX; x <= maxX; x++ )
+            {
+                if ( edges[0] > 0.0f && edges[1] > 0.0f && edges[2] > 0.0f )
+                {
+                    row[x] = std::min(row[x], depth);
+                }
+                for ( int edge = 0; edge < 3; edge++ )
+                {
+                    edges[edge] += edgeStepX[edge];
+                }
+                depth += depthStepX;
+            }
+#endif
+
+            for ( int edge = 0; edge < 3; edge++ )
+            {
+                edgeRowStart[edge] += edgeStepY[edge];
+            }
+            depthRowStart += depthStepY;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef OCCLUSIONBUFFER_H
+#define OCCLUSIONBUFFER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "AABB.h"
+
+namespace blithe
+{
+    struct Mesh;
+
+    ///
+    /// \brief Low resolution depth buffer rasterized on the CPU, for culling objects hidden
+    ///        behind a few big occluders before they are submitted to the GPU.
+    ///
+    ///        Each frame, Begin() clears it for a camera, AddOccluder() queues the triangles of
+    ///        closed occluder meshes, Rasterize() draws them into the buffer in horizontal bands
+    ///        on the shared ThreadPool (4 pixels at a time with SSE2), and IsOccluded() tests
+    ///        bounding boxes against it. The buffer keeps the farthest depth of each
+    ///        TILE_SIZE x TILE_SIZE tile too, so most tests are settled per tile rather than
+    ///        per pixel.
+    ///
+    ///        Occluders should lie inside the objects they stand in for, e.g. lower-poly
+    ///        versions with slightly smaller radii, or visible objects might get culled. No GPU
+    ///        is involved, so this also runs headless.
+    ///
+    class OcclusionBuffer
+    {
+    public:
+        static constexpr int TILE_SIZE = 8; //!< Width and height of the tiles, in pixels
+
+        OcclusionBuffer(int _width = 256, int _height = 128);
+
+        void Begin(const glm::mat4& _viewProjection);
+        void AddOccluder(const Mesh& _mesh, const glm::mat4& _model);
+        void Rasterize();
+
+        bool IsOccluded(const AABB& _bounds, const glm::mat4& _model = glm::mat4(1.0f)) const;
+        size_t CullInstances(const AABB& _localBounds, const std::vector<glm::mat4>& _transforms, std::vector<glm::mat4>& _outVisible) const;
+
+        int GetWidth() const { return m_width; }
+        int GetHeight() const { return m_height; }
+        size_t GetNumOccluderTris() const { return m_tris.size(); }
+        const std::vector<float>& GetDepths() const { return m_depths; }
+
+    private:
+        ///
+        /// \brief Occluder triangle in screen space, counter-clockwise
+        ///
+        struct ScreenTri
+        {
+            glm::vec3 m_verts[3]; //!< Pixel x, pixel y and NDC depth of the corners
+        };
+
+        void AddClippedTri(const glm::vec4* _clipVerts, size_t _numVerts);
+        void RasterizeBand(int _firstRow, int _lastRow);
+        void RasterizeTri(const ScreenTri& _tri, int _firstRow, int _lastRow);
+
+        int m_width;                   //!< Width in pixels. A multiple of TILE_SIZE.
+        int m_height;                  //!< Height in pixels. A multiple of TILE_SIZE.
+        int m_numTilesX;               //!< Number of tiles along the width
+        glm::mat4 m_viewProjection;    //!< View-projection matrix given to Begin()
+        std::vector<ScreenTri> m_tris; //!< Occluder triangles queued since Begin()
+        std::vector<float> m_depths;   //!< Nearest occluder depth (NDC) of each pixel, row by row from the bottom
+        std::vector<float> m_tileMax;  //!< Farthest depth in each tile
+    };
+}
+
+#endif // OCCLUSIONBUFFER_H
@@ -0,0 +1,475 @@
+#include "PickingScene.h"
+#include <algorithm>
+#include <iterator>
+#include <unordered_set>
+#include <tracy/Tracy.hpp>
+#include "BlitheAssert.h"
+#include "Frustum.h"
+#include "GeomHelpers.h"
+#include "Mesh.h"
+#include "MeshView.h"
+#include "RayAABBIntersecter.h"
+
+namespace blithe
+{
+    constexpr float PickingScene::MAX_REFIT_GROWTH;
+
+    static_assert(BVH::MAX_LEAF_SIZE <= RayAABBIntersecter::BATCH_SIZE, "A leaf's boxes must fit in one batch");
+
+    ///
+    /// \brief Sets the meshes to pick from, calculates their bounding boxes and builds the BVH
+    ///        over them
+    ///
+    /// \param _meshes    - Meshes to pick from
+    /// \param _modelMats - Corresponding model matrices for each mesh
+    ///
+    void PickingScene::SetMeshes(const std::vector<const Mesh*>& _meshes, const std::vector<glm::mat4*>& _modelMats)
+    {
+        ZoneScoped;
+
+        ASSERT(_meshes.size() == _modelMats.size(), "There should be one model matrix per mesh");
+
+        m_meshes = _meshes;
+        m_modelMats.resize(_meshes.size());
+        m_invModelMats.resize(_meshes.size());
+        m_generations.resize(_meshes.size());
+        m_localBounds.resize(_meshes.size());
+        m_worldBounds.resize(_meshes.size());
+        m_localOBBs.resize(_meshes.size());
+        m_worldOBBs.resize(_meshes.size());
+        m_rayTestOBBs.resize(_meshes.size());
+        for ( size_t i = 0; i < _meshes.size(); i++ )
+        {
+            m_modelMats[i] = *_modelMats[i];
+            m_invModelMats[i] = glm::inverse(m_modelMats[i]);
+            MeshBounds bounds = MeshView(*_meshes[i]).GetBounds();
+            m_localBounds[i] = bounds.m_aabb;
+            m_localOBBs[i] = bounds.m_obb;
+            m_rayTestOBBs[i] = bounds.m_obb.m_axes != glm::mat3(1.0f);
+            m_generations[i] = _meshes[i]->m_generation;
+            m_worldBounds[i] = GeomHelpers::TransformAABB(m_localBounds[i], m_modelMats[i]);
+            m_worldOBBs[i] = GeomHelpers::TransformOBB(m_localOBBs[i], m_modelMats[i]);
+        }
+
+        m_bvh.Build(m_worldBounds);
+        m_builtNodesArea = CalcNodesArea();
+        m_needsRefit = false;
+        GatherLeafBounds();
+
+        // Drop the triangle BVHs of meshes that left, so they don't pile up
+        std::unordered_set<uint64_t> meshSet;
+        for ( const Mesh* mesh : _meshes )
+        {
+            meshSet.insert(mesh->m_id.GetValue());
+        }
+        for ( auto it = m_triangleBVHs.begin(); it != m_triangleBVHs.end(); )
+        {
+            it = meshSet.count(it->first) ? std::next(it) : m_triangleBVHs.erase(it);
+        }
+    }
+
+    ///
+    /// \brief Updates the model matrices of all the meshes. Only the meshes whose matrix
+    ///        changed get their world box recalculated.
+    ///
+    /// \param _modelMats - Model matrix of each mesh, as many as SetMeshes() got
+    ///
+    /// \return Whether any matrix changed
+    ///
+    bool PickingScene::SetModelMats(const std::vector<glm::mat4*>& _modelMats)
+    {
+        ASSERT(_modelMats.size() == m_meshes.size(), "Scene has " << m_meshes.size() << " meshes but got " << _modelMats.size() << " model matrices");
+
+        bool changed = false;
+        for ( size_t i = 0; i < _modelMats.size(); i++ )
+        {
+            if ( *_modelMats[i] != m_modelMats[i] )
+            {
+                SetModelMat(i, *_modelMats[i]);
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    ///
+    /// \brief Updates the model matrix of one mesh. The BVH is refit on the next
+    ///        IntersectRay(), so moving many meshes at once costs a single refit.
+    ///
+    /// \param _idx      - Index of the mesh
+    /// \param _modelMat - New model matrix
+    ///
+    void PickingScene::SetModelMat(size_t _idx, const glm::mat4& _modelMat)
+    {
+        ASSERT(_idx < m_meshes.size(), "Mesh " << _idx << " out of range. Scene has " << m_meshes.size() << " meshes.");
+
+        m_modelMats[_idx] = _modelMat;
+        m_invModelMats[_idx] = glm::inverse(_modelMat);
+        m_worldBounds[_idx] = GeomHelpers::TransformAABB(m_localBounds[_idx], _modelMat);
+        m_worldOBBs[_idx] = GeomHelpers::TransformOBB(m_localOBBs[_idx], _modelMat);
+        m_needsRefit = true;
+    }
+
+    ///
+    /// \brief Checks whether the scene was set up with _meshes, and none of them have changed
+    ///        (see Mesh::m_generation) since
+    ///
+    /// \param _meshes - Meshes to compare with
+    ///
+    /// \return Whether SetMeshes() can be skipped for _meshes
+    ///
+    bool PickingScene::HasMeshes(const std::vector<const Mesh*>& _meshes) const
+    {
+        if ( _meshes != m_meshes )
+        {
+            return false;
+        }
+        for ( size_t i = 0; i < m_meshes.size(); i++ )
+        {
+            if ( m_meshes[i]->m_generation != m_generations[i] )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ///
+    /// \brief Finds the mesh whose bounding box the ray enters first
+    ///
+    /// \param _ray  - Ray to cast
+    /// \param _maxT - Max distance along the ray
+    ///
+    /// \return Optional Hit if the ray hits any box between 0 and _maxT
+    ///
+    tl::optional<PickingScene::Hit> PickingScene::IntersectRay(const Ray& _ray, float _maxT)
+    {
+        ZoneScoped;
+
+        Update();
+
+        tl::optional<Hit> result;
+        BatchRay batchRay(_ray);
+        float tNears[RayAABBIntersecter::BATCH_SIZE];
+        float tFars[RayAABBIntersecter::BATCH_SIZE];
+        float closestT = _maxT;
+        m_numNodesVisited = m_bvh.IntersectRayLeaves(_ray, closestT, [&](uint32_t _first, uint32_t _count, float _leafMaxT)
+        {
+            uint32_t mask = RayAABBIntersecter::IntersectBatch(batchRay, m_leafBounds, _first, _count, 0.0f, _leafMaxT, tNears, tFars);
+            for ( uint32_t lane = 0; mask != 0; lane++, mask >>= 1 )
+            {
+                uint32_t prim = m_bvh.GetPrimIndices()[_first + lane];
+                float tNear = tNears[lane];
+                // Ties go to the lower index, like a linear scan over the meshes would
+                if ( (mask & 1) && (!result || tNear < result->m_tNear || (tNear == result->m_tNear && prim < result->m_idx)) )
+                {
+                    result = Hit{ prim, tNear };
+                }
+            }
+            return result ? result->m_tNear : _leafMaxT;
+        });
+
+        return result;
+    }
+
+    ///
+    /// \brief Finds the mesh triangle the ray hits first. Meshes whose boxes start beyond the
+    ///        closest hit so far are skipped.
+    ///
+    /// \param _ray  - Ray to cast
+    /// \param _maxT - Max distance along the ray
+    ///
+    /// \return Optional TriangleHit if the ray hits any triangle between 0 and _maxT
+    ///
+    tl::optional<PickingScene::TriangleHit> PickingScene::IntersectRayTriangles(const Ray& _ray, float _maxT)
+    {
+        ZoneScoped;
+
+        Update();
+
+        tl::optional<TriangleHit> result;
+        BatchRay batchRay(_ray);
+        float tNears[RayAABBIntersecter::BATCH_SIZE];
+        float tFars[RayAABBIntersecter::BATCH_SIZE];
+        float closestT = _maxT;
+        m_numTriangleBVHsCast = 0;
+        m_numNodesVisited = m_bvh.IntersectRayLeaves(_ray, closestT, [&](uint32_t _first, uint32_t _count, float _leafMaxT)
+        {
+            float leafClosestT = _leafMaxT;
+            uint32_t mask = RayAABBIntersecter::IntersectBatch(batchRay, m_leafBounds, _first, _count, 0.0f, _leafMaxT, tNears, tFars);
+            for ( uint32_t lane = 0; mask != 0; lane++, mask >>= 1 )
+            {
+                uint32_t prim = m_bvh.GetPrimIndices()[_first + lane];
+                if ( !(mask & 1) || tNears[lane] > leafClosestT || !HitsWorldOBB(_ray, prim, leafClosestT) )
+                {
+                    continue;
+                }
+
+                m_numTriangleBVHsCast++;
+
+                // The local ray's direction isn't normalized, so distances along it are world distances
+                const glm::mat4& invModelMat = m_invModelMats[prim];
+                Ray localRay{ glm::vec3(invModelMat * glm::vec4(_ray.m_origin, 1.0f)),
+                              glm::vec3(invModelMat * glm::vec4(_ray.m_dir, 0.0f)) };
+                tl::optional<TriangleBVH::Hit> hit = GetTriangleBVH(*m_meshes[prim]).IntersectRay(localRay, leafClosestT);
+                if ( hit.has_value() )
+                {
+                    result = TriangleHit{ prim, hit->m_triIdx, hit->m_t, hit->m_barycentrics };
+                    leafClosestT = hit->m_t;
+                }
+            }
+            return leafClosestT;
+        });
+
+        return result;
+    }
+
+    ///
+    /// \brief Same as IntersectRay() for many rays, cast RayPacket::SIZE at a time
+    ///
+    /// \param _rays    - Rays to cast. Consecutive rays should be close together.
+    /// \param _outHits - Set to the closest hit of each ray, if any
+    /// \param _maxT    - Max distance along the rays
+    ///
+    void PickingScene::IntersectRays(const std::vector<Ray>& _rays, std::vector<tl::optional<Hit>>& _outHits, float _maxT)
+    {
+        ZoneScoped;
+
+        Update();
+
+        _outHits.assign(_rays.size(), tl::nullopt);
+        m_numNodesVisited = 0;
+
+        std::vector<BatchRay> batchRays(_rays.begin(), _rays.end());
+        float tNears[RayAABBIntersecter::BATCH_SIZE];
+        float tFars[RayAABBIntersecter::BATCH_SIZE];
+        for ( size_t base = 0; base < _rays.size(); base += RayPacket::SIZE )
+        {
+            RayPacket packet(&_rays[base], std::min(RayPacket::SIZE, _rays.size() - base));
+            tl::optional<Hit>* hits = &_outHits[base];
+            float closestT[RayPacket::SIZE];
+            std::fill(closestT, closestT + RayPacket::SIZE, _maxT);
+            m_numNodesVisited += m_bvh.IntersectRayPacket(packet, closestT, [&](uint32_t _first, uint32_t _count, uint32_t _mask)
+            {
+                for ( uint32_t lane = 0; _mask != 0; lane++, _mask >>= 1 )
+                {
+                    if ( !(_mask & 1) )
+                    {
+                        continue;
+                    }
+
+                    tl::optional<Hit>& result = hits[lane];
+                    uint32_t boxMask = RayAABBIntersecter::IntersectBatch(batchRays[base + lane], m_leafBounds, _first, _count, 0.0f, closestT[lane], tNears, tFars);
+                    for ( uint32_t box = 0; boxMask != 0; box++, boxMask >>= 1 )
+                    {
+                        uint32_t prim = m_bvh.GetPrimIndices()[_first + box];
+                        float tNear = tNears[box];
+                        // Same tie breaking as IntersectRay()
+                        if ( (boxMask & 1) && (!result || tNear < result->m_tNear || (tNear == result->m_tNear && prim < result->m_idx)) )
+                        {
+                            result = Hit{ prim, tNear };
+                        }
+                    }
+                    if ( result )
+                    {
+                        closestT[lane] = result->m_tNear;
+                    }
+                }
+            });
+        }
+    }
+
+    ///
+    /// \brief Same as IntersectRayTriangles() for many rays, cast RayPacket::SIZE at a time.
+    ///        The rays of a packet that reach a mesh's box go through its TriangleBVH together.
+    ///
+    /// \param _rays    - Rays to cast. Consecutive rays should be close together.
+    /// \param _outHits - Set to the closest hit of each ray, if any
+    /// \param _maxT    - Max distance along the rays
+    ///
+    void PickingScene::IntersectRaysTriangles(const std::vector<Ray>& _rays, std::vector<tl::optional<TriangleHit>>& _outHits, float _maxT)
+    {
+        ZoneScoped;
+
+        Update();
+
+        _outHits.assign(_rays.size(), tl::nullopt);
+        m_numNodesVisited = 0;
+        m_numTriangleBVHsCast = 0;
+
+        for ( size_t base = 0; base < _rays.size(); base += RayPacket::SIZE )
+        {
+            RayPacket packet(&_rays[base], std::min(RayPacket::SIZE, _rays.size() - base));
+            tl::optional<TriangleHit>* hits = &_outHits[base];
+            float closestT[RayPacket::SIZE];
+            std::fill(closestT, closestT + RayPacket::SIZE, _maxT);
+            m_numNodesVisited += m_bvh.IntersectRayPacket(packet, closestT, [&](uint32_t _first, uint32_t _count, uint32_t _mask)
+            {
+                for ( uint32_t entry = _first; entry < _first + _count; entry++ )
+                {
+                    float tNear = 0.0f;
+                    uint32_t meshMask = packet.IntersectAABB(m_leafBounds.Get(entry), closestT, _mask, tNear);
+                    uint32_t prim = m_bvh.GetPrimIndices()[entry];
+                    for ( uint32_t lane = 0, bits = meshMask; bits != 0; lane++, bits >>= 1 )
+                    {
+                        if ( (bits & 1) && !HitsWorldOBB(packet.m_rays[lane], prim, closestT[lane]) )
+                        {
+                            meshMask &= ~(1u << lane);
+                        }
+                    }
+                    if ( meshMask == 0 )
+                    {
+                        continue;
+                    }
+
+                    m_numTriangleBVHsCast++;
+
+                    // As in IntersectRayTriangles(), the local rays keep world distances
+                    const glm::mat4& invModelMat = m_invModelMats[prim];
+                    Ray localRays[RayPacket::SIZE];
+                    for ( size_t lane = 0; lane < RayPacket::SIZE; lane++ )
+                    {
+                        const Ray& ray = packet.m_rays[lane];
+                        localRays[lane] = Ray{ glm::vec3(invModelMat * glm::vec4(ray.m_origin, 1.0f)),
+                                               glm::vec3(invModelMat * glm::vec4(ray.m_dir, 0.0f)) };
+                    }
+                    RayPacket localPacket(localRays, RayPacket::SIZE);
+                    localPacket.m_activeMask = meshMask;
+
+                    TriangleBVH::Hit triHits[RayPacket::SIZE];
+                    uint32_t hitMask = GetTriangleBVH(*m_meshes[prim]).IntersectRayPacket(localPacket, closestT, triHits);
+                    for ( uint32_t lane = 0; hitMask != 0; lane++, hitMask >>= 1 )
+                    {
+                        if ( hitMask & 1 )
+                        {
+                            const TriangleBVH::Hit& hit = triHits[lane];
+                            hits[lane] = TriangleHit{ prim, hit.m_triIdx, hit.m_t, hit.m_barycentrics };
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+    ///
+    /// \brief Finds the meshes whose world bounding boxes overlap _frustum, through the BVH.
+    ///        The meshes whose boxes straddle a plane must also have their world OBBs overlap
+    ///        it. Like Frustum::Intersects(), boxes just outside a corner of the frustum can pass.
+    ///
+    /// \param _frustum    - Frustum to test against
+    /// \param _outIndices - Overwritten with the indices of the meshes, in no particular order
+    ///
+    void PickingScene::QueryFrustum(const Frustum& _frustum, std::vector<size_t>& _outIndices)
+    {
+        ZoneScoped;
+
+        Update();
+
+        m_queryPrims.clear();
+        m_straddlingPrims.clear();
+        m_numNodesVisited = m_bvh.QueryFrustum(_frustum, m_queryPrims, &m_straddlingPrims);
+        _outIndices.assign(m_queryPrims.begin(), m_queryPrims.end());
+        for ( uint32_t prim : m_straddlingPrims )
+        {
+            if ( _frustum.Intersects(m_worldOBBs[prim]) )
+            {
+                _outIndices.push_back(prim);
+            }
+        }
+    }
+
+    ///
+    /// \brief Checks whether _ray hits a mesh's world OBB before _maxT, to weed out the meshes
+    ///        whose world box the ray only grazes before their triangles are tested.
+    ///
+    ///        The root of a mesh's TriangleBVH is its local AABB, which already rejects the
+    ///        same rays as an OBB with the local axes. So the OBB is only tested for the meshes
+    ///        whose local OBB is tilted (and so tighter), and the rest always pass.
+    ///
+    /// \param _ray  - Ray to test
+    /// \param _idx  - Index of the mesh
+    /// \param _maxT - Max distance along the ray
+    ///
+    /// \return Whether the ray hits the OBB between 0 and _maxT
+    ///
+    bool PickingScene::HitsWorldOBB(const Ray& _ray, size_t _idx, float _maxT) const
+    {
+        if ( !m_rayTestOBBs[_idx] )
+        {
+            return true;
+        }
+
+        tl::optional<RayIntersectionResult> hit = RayAABBIntersecter::Intersect(_ray, m_worldOBBs[_idx]);
+        return hit.has_value() && hit->m_tFar >= 0.0f && hit->m_tClose <= _maxT;
+    }
+
+    ///
+    /// \brief Gets the triangle BVH of _mesh, building it if this is the first time it's needed
+    ///        or the mesh has changed since
+    ///
+    /// \param _mesh - One of the scene's meshes
+    ///
+    /// \return BVH over the triangles of _mesh
+    ///
+    const TriangleBVH& PickingScene::GetTriangleBVH(const Mesh& _mesh)
+    {
+        TriangleBVHEntry& entry = m_triangleBVHs[_mesh.m_id.GetValue()];
+        if ( !entry.m_bvh || entry.m_generation != _mesh.m_generation )
+        {
+            entry.m_bvh.reset(new TriangleBVH());
+            entry.m_bvh->Build(_mesh);
+            entry.m_generation = _mesh.m_generation;
+        }
+        return *entry.m_bvh;
+    }
+
+    ///
+    /// \brief Refits the BVH if meshes have moved since it was last fit, or rebuilds it if
+    ///        refitting has made it too loose
+    ///
+    void PickingScene::Update()
+    {
+        if ( !m_needsRefit )
+        {
+            return;
+        }
+
+        m_bvh.Refit(m_worldBounds);
+        if ( CalcNodesArea() > MAX_REFIT_GROWTH * m_builtNodesArea )
+        {
+            m_bvh.Build(m_worldBounds);
+            m_builtNodesArea = CalcNodesArea();
+        }
+        m_needsRefit = false;
+        GatherLeafBounds();
+    }
+
+    ///
+    /// \brief Sums the surface areas of the BVH's nodes, which is proportional to the expected
+    ///        cost of a random ray through it
+    ///
+    float PickingScene::CalcNodesArea() const
+    {
+        float area = 0.0f;
+        for ( const BVHNode& node : m_bvh.GetNodes() )
+        {
+            glm::vec3 size = node.m_bounds.m_max - node.m_bounds.m_min;
+            area += size.x * size.y + size.y * size.z + size.z * size.x;
+        }
+        return area;
+    }
+
+    ///
+    /// \brief Copies the world boxes into m_leafBounds in the BVH's leaf order, so each leaf's
+    ///        boxes can be tested with one RayAABBIntersecter::IntersectBatch()
+    ///
+    void PickingScene::GatherLeafBounds()
+    {
+        const std::vector<uint32_t>& leafOrder = m_bvh.GetPrimIndices();
+        m_leafBounds.Resize(leafOrder.size());
+        for ( size_t entry = 0; entry < leafOrder.size(); entry++ )
+        {
+            m_leafBounds.Set(entry, m_worldBounds[leafOrder[entry]]);
+        }
+    }
+}
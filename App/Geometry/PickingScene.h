@@ -0,0 +1,125 @@
+#ifndef PICKINGSCENE_H
+#define PICKINGSCENE_H
+
+#include <optional.hpp>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stddef.h>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "AABB.h"
+#include "AABBArrays.h"
+#include "BVH.h"
+#include "OBB.h"
+#include "Ray.h"
+#include "TriangleBVH.h"
+
+namespace blithe
+{
+    struct Frustum;
+    struct Mesh;
+
+    ///
+    /// \brief Set of meshes to pick from, with a BVH over their world-space bounding boxes so a
+    ///        ray only visits the meshes near it.
+    ///
+    ///        SetMeshes() gets each mesh's local box from the MeshBoundsCache and builds the
+    ///        BVH. When meshes move, SetModelMat() or SetModelMats() only transform the cached
+    ///        local boxes, and the BVH is refit rather than rebuilt on the next IntersectRay().
+    ///        Refitting lets the nodes grow, so the BVH is rebuilt when they have grown too
+    ///        much. The boxes are also kept in leaf order as AABBArrays, so each leaf reached is
+    ///        tested with one RayAABBIntersecter::IntersectBatch().
+    ///
+    ///        IntersectRayTriangles() goes on to find the exact triangle hit, by casting the ray
+    ///        in each mesh's local space through a TriangleBVH. These are built the first time
+    ///        a ray reaches the mesh's box, shared by all the entries for the same Mesh and kept
+    ///        across SetMeshes() calls as long as the mesh is unchanged. Meshes whose world OBB
+    ///        the ray misses are skipped first, since rotating a mesh inflates its world box.
+    ///
+    ///        If a mesh's vertices change, HasMeshes() is false until SetMeshes() is called again.
+    ///
+    class PickingScene
+    {
+    public:
+        ///
+        /// \brief Closest mesh box a ray hit
+        ///
+        struct Hit
+        {
+            size_t m_idx;  //!< Index of the mesh in the vector given to SetMeshes()
+            float m_tNear; //!< Distance along the ray at which it enters the box. 0 if it starts inside.
+        };
+
+        ///
+        /// \brief Closest mesh triangle a ray hit
+        ///
+        struct TriangleHit
+        {
+            size_t m_idx;             //!< Index of the mesh in the vector given to SetMeshes()
+            uint32_t m_triIdx;        //!< Index of the triangle in the mesh
+            float m_t;                //!< Distance along the ray to the hit
+            glm::vec3 m_barycentrics; //!< Weights of the triangle's corners at the hit point
+        };
+
+        void SetMeshes(const std::vector<const Mesh*>& _meshes, const std::vector<glm::mat4*>& _modelMats);
+        bool SetModelMats(const std::vector<glm::mat4*>& _modelMats);
+        void SetModelMat(size_t _idx, const glm::mat4& _modelMat);
+
+        bool HasMeshes(const std::vector<const Mesh*>& _meshes) const;
+
+        tl::optional<Hit> IntersectRay(const Ray& _ray, float _maxT = std::numeric_limits<float>::max());
+        tl::optional<TriangleHit> IntersectRayTriangles(const Ray& _ray, float _maxT = std::numeric_limits<float>::max());
+        void IntersectRays(const std::vector<Ray>& _rays, std::vector<tl::optional<Hit>>& _outHits, float _maxT = std::numeric_limits<float>::max());
+        void IntersectRaysTriangles(const std::vector<Ray>& _rays, std::vector<tl::optional<TriangleHit>>& _outHits, float _maxT = std::numeric_limits<float>::max());
+        void QueryFrustum(const Frustum& _frustum, std::vector<size_t>& _outIndices);
+
+        size_t GetNumMeshes() const { return m_meshes.size(); }
+        const AABB& GetWorldBounds(size_t _idx) const { return m_worldBounds[_idx]; }
+        const OBB& GetWorldOBB(size_t _idx) const { return m_worldOBBs[_idx]; }
+        const BVH& GetBVH() const { return m_bvh; }
+        size_t GetNumNodesVisited() const { return m_numNodesVisited; }
+        size_t GetNumTriangleBVHsCast() const { return m_numTriangleBVHsCast; }
+
+    private:
+        void Update();
+        float CalcNodesArea() const;
+        const TriangleBVH& GetTriangleBVH(const Mesh& _mesh);
+        void GatherLeafBounds();
+        bool HitsWorldOBB(const Ray& _ray, size_t _idx, float _maxT) const;
+
+        static constexpr float MAX_REFIT_GROWTH = 2.0f; //!< Rebuild once refitting has grown the nodes' total surface area by this factor
+
+        std::vector<const Mesh*> m_meshes;       //!< Meshes given to SetMeshes()
+        std::vector<glm::mat4> m_modelMats;      //!< Model matrix of each mesh
+        std::vector<glm::mat4> m_invModelMats;   //!< Inverse of each model matrix, for casting rays in the meshes' local spaces
+        std::vector<unsigned int> m_generations; //!< m_generation of each mesh when its local box was taken
+        std::vector<AABB> m_localBounds;         //!< Bounding box of each mesh in its local space
+        std::vector<AABB> m_worldBounds;         //!< Bounding box of each mesh in world space
+        std::vector<OBB> m_localOBBs;            //!< Oriented bounding box of each mesh in its local space
+        std::vector<OBB> m_worldOBBs;            //!< Oriented bounding box of each mesh in world space
+        std::vector<uint8_t> m_rayTestOBBs;      //!< Whether each mesh's local OBB is tighter than its local box, so worth testing rays against
+        BVH m_bvh;                               //!< BVH over m_worldBounds
+        AABBArrays m_leafBounds;                 //!< m_worldBounds in m_bvh's leaf order
+        float m_builtNodesArea = 0.0f;           //!< Total surface area of the nodes right after the last build
+        bool m_needsRefit = false;               //!< Whether meshes have moved since m_bvh was last fit
+        size_t m_numNodesVisited = 0;            //!< BVH nodes the last query visited
+        size_t m_numTriangleBVHsCast = 0;        //!< Times the last triangle query went down a mesh's TriangleBVH
+        std::vector<uint32_t> m_queryPrims;      //!< Scratch space for the primitives a BVH query finds
+        std::vector<uint32_t> m_straddlingPrims; //!< Scratch space for the primitives a frustum query finds straddling a plane
+
+        ///
+        /// \brief Triangle BVH of a mesh and the mesh's m_generation when it was built
+        ///
+        struct TriangleBVHEntry
+        {
+            std::unique_ptr<TriangleBVH> m_bvh; //!< BVH over the mesh's triangles
+            unsigned int m_generation = 0;      //!< Mesh's m_generation when m_bvh was built
+        };
+
+        std::unordered_map<uint64_t, TriangleBVHEntry> m_triangleBVHs; //!< Triangle BVHs of the meshes reached so far, by Mesh::m_id
+    };
+}
+
+#endif // PICKINGSCENE_H
@@ -1,6 +1,8 @@
 #ifndef PLANE_H
 #define PLANE_H
 
+#include <cmath>
+#include <limits>
 #include <glm/glm.hpp>
 
 namespace blithe
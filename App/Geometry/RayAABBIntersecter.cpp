@@ -1,9 +1,40 @@
 #include "RayAABBIntersecter.h"
 #include "AABB.h"
+#include <algorithm>
+#include <cmath>
+#include <tracy/Tracy.hpp>
+#include "BlitheAssert.h"
+#include "BlitheSIMD.h"
 // #include <iostream>
 
 namespace blithe
 {
+    constexpr size_t RayAABBIntersecter::BATCH_SIZE;
+    constexpr float RayAABBIntersecter::PARALLEL_EPSILON;
+
+    ///
+    /// \brief Prepares _ray for IntersectBatch()
+    ///
+    /// \param _ray - Ray (Origin + Normalized direction)
+    ///
+    BatchRay::BatchRay(const Ray& _ray)
+        : m_origin(_ray.m_origin),
+          m_invDir(0.0f),
+          m_parallelAxes(0)
+    {
+        for ( int i = 0; i < 3; i++ )
+        {
+            if ( std::abs(_ray.m_dir[i]) < RayAABBIntersecter::PARALLEL_EPSILON )
+            {
+                m_parallelAxes |= 1 << i;
+            }
+            else
+            {
+                m_invDir[i] = 1.0f / _ray.m_dir[i];
+            }
+        }
+    }
+
 
     ///
     /// \brief Uses the Slab method (https://en.wikipedia.org/wiki/Slab_method) for intersecting the
@@ -27,7 +58,7 @@ namespace blithe
         {
             // Check if ray is parallel to the ith slab by checking dir's ith component.
             // (Example: if dir were locked in the yz plane, dir's x component would be 0.)
-            if ( std::abs(_ray.m_dir[i]) < 1e-8f )
+            if ( std::abs(_ray.m_dir[i]) < PARALLEL_EPSILON )
             {
                 // The ray is parallel to the ith slab. Check if origin's ith coord is inside.
                 if (_ray.m_origin[i] < _aabb.m_min[i] || _ray.m_origin[i] > _aabb.m_max[i])
@@ -65,4 +96,244 @@ namespace blithe
 
         return result;
     }
+
+    ///
+    /// \brief Intersects _ray with an oriented box, by running the slab method on the ray in
+    ///        the box's frame. The box's axes are orthonormal, so distances along the ray are
+    ///        the same in both frames.
+    ///
+    /// \param _ray - Ray (Origin + Normalized direction)
+    /// \param _obb - OBB to intersect with
+    ///
+    /// \return Optional RayIntersectionResult if the ray intersects the OBB, with the points in
+    ///         world space
+    ///
+    tl::optional<RayIntersectionResult> RayAABBIntersecter::Intersect(const Ray& _ray, const OBB& _obb)
+    {
+        glm::vec3 offset = _ray.m_origin - _obb.m_center;
+        Ray boxRay;
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            boxRay.m_origin[axis] = glm::dot(offset, _obb.m_axes[axis]);
+            boxRay.m_dir[axis] = glm::dot(_ray.m_dir, _obb.m_axes[axis]);
+        }
+
+        tl::optional<RayIntersectionResult> result = Intersect(boxRay, AABB{ -_obb.m_halfExtents, _obb.m_halfExtents });
+        if ( result.has_value() )
+        {
+            result->m_entryPt = _ray.m_origin + result->m_tClose * _ray.m_dir;
+            result->m_exitPt = _ray.m_origin + result->m_tFar * _ray.m_dir;
+        }
+        return result;
+    }
+
+    ///
+    /// \brief Slab tests _ray against up to BATCH_SIZE consecutive boxes at once. Like
+    ///        Intersect(), axes the ray is parallel to only check that the origin is between
+    ///        the slabs. The entry and exit distances are clamped to [_tMin, _tMax], so with the
+    ///        default infinite range the hits are the same as Intersect()'s.
+    ///
+    /// \param _ray      - Ray to test
+    /// \param _boxes    - Boxes to test against
+    /// \param _first    - Index of the first box to test
+    /// \param _count    - Number of boxes to test, at most BATCH_SIZE
+    /// \param _tMin     - Min distance along the ray
+    /// \param _tMax     - Max distance along the ray
+    /// \param _outTNear - BATCH_SIZE floats, set to the distance at which the ray enters each box
+    /// \param _outTFar  - BATCH_SIZE floats, set to the distance at which the ray exits each box
+    ///
+    /// \return Mask with bit i set if the ray hits box _first + i
+    ///
+    uint32_t RayAABBIntersecter::IntersectBatch(const BatchRay& _ray,
+                                                const AABBArrays& _boxes,
+                                                size_t _first,
+                                                size_t _count,
+                                                float _tMin,
+                                                float _tMax,
+                                                float* _outTNear,
+                                                float* _outTFar)
+    {
+        ASSERT(_count <= BATCH_SIZE, "Can test at most " << BATCH_SIZE << " boxes at once, but got " << _count);
+        ASSERT(_first + _count <= _boxes.GetSize(), "Boxes " << _first << " to " << _first + _count << " out of range. There are " << _boxes.GetSize() << " boxes.");
+
+        if ( _count == 0 )
+        {
+            return 0;
+        }
+
+        const float* mins[3] = { &_boxes.m_minX[_first], &_boxes.m_minY[_first], &_boxes.m_minZ[_first] };
+        const float* maxs[3] = { &_boxes.m_maxX[_first], &_boxes.m_maxY[_first], &_boxes.m_maxZ[_first] };
+        uint32_t mask = 0;
+
+#if defined(BLITHE_SIMD_AVX2)
+        __m256 tNear = _mm256_set1_ps(_tMin);
+        __m256 tFar = _mm256_set1_ps(_tMax);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            __m256 lo = _mm256_loadu_ps(mins[axis]);
+            __m256 hi = _mm256_loadu_ps(maxs[axis]);
+            __m256 origin = _mm256_set1_ps(_ray.m_origin[axis]);
+            if ( _ray.m_parallelAxes & (1 << axis) )
+            {
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(lo, origin, _CMP_LE_OQ));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(origin, hi, _CMP_LE_OQ));
+            }
+            else
+            {
+                __m256 invDir = _mm256_set1_ps(_ray.m_invDir[axis]);
+                __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(lo, origin), invDir);
+                __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(hi, origin), invDir);
+                tNear = _mm256_max_ps(tNear, _mm256_min_ps(t0, t1));
+                tFar = _mm256_min_ps(tFar, _mm256_max_ps(t0, t1));
+            }
+        }
+        mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_and_ps(inside, _mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ))));
+        _mm256_storeu_ps(_outTNear, tNear);
+        _mm256_storeu_ps(_outTFar, tFar);
+#elif defined(BLITHE_SIMD_SSE2)
+        for ( size_t half = 0; half < BATCH_SIZE; half += 4 )
+        {
+            __m128 tNear = _mm_set1_ps(_tMin);
+            __m128 tFar = _mm_set1_ps(_tMax);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for ( int axis = 0; axis < 3; axis++ )
+            {
+                __m128 lo = _mm_loadu_ps(mins[axis] + half);
+                __m128 hi = _mm_loadu_ps(maxs[axis] + half);
+                __m128 origin = _mm_set1_ps(_ray.m_origin[axis]);
+                if ( _ray.m_parallelAxes & (1 << axis) )
+                {
+                    inside = _mm_and_ps(inside, _mm_cmple_ps(lo, origin));
+                    inside = _mm_and_ps(inside, _mm_cmple_ps(origin, hi));
+                }
+                else
+                {
+                    __m128 invDir = _mm_set1_ps(_ray.m_invDir[axis]);
+                    __m128 t0 = _mm_mul_ps(_mm_sub_ps(lo, origin), invDir);
+                    __m128 t1 = _mm_mul_ps(_mm_sub_ps(hi, origin), invDir);
+                    tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+                    tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+                }
+            }
+            mask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_and_ps(inside, _mm_cmple_ps(tNear, tFar)))) << half;
+            _mm_storeu_ps(_outTNear + half, tNear);
+            _mm_storeu_ps(_outTFar + half, tFar);
+        }
+#else
+        for ( size_t lane = 0; lane < BATCH_SIZE; lane++ )
+        {
+            float tNear = _tMin;
+            float tFar = _tMax;
+            bool inside = true;
+            for ( int axis = 0; axis < 3; axis++ )
+            {
+                float lo = mins[axis][lane];
+                float hi = maxs[axis][lane];
+                float origin = _ray.m_origin[axis];
+                if ( _ray.m_parallelAxes & (1 << axis) )
+                {
+                    inside = inside && lo <= origin && origin <= hi;
+                }
+                else
+                {
+                    float t0 = (lo - origin) * _ray.m_invDir[axis];
+                    float t1 = (hi - origin) * _ray.m_invDir[axis];
+                    tNear = std::max(tNear, std::min(t0, t1));
+                    tFar = std::min(tFar, std::max(t0, t1));
+                }
+            }
+            mask |= static_cast<uint32_t>(inside && tNear <= tFar) << lane;
+            _outTNear[lane] = tNear;
+            _outTFar[lane] = tFar;
+        }
+#endif
+
+        return mask & ((1u << _count) - 1);
+    }
+
+    ///
+    /// \brief Slab tests _ray against all of _boxes, BATCH_SIZE at a time
+    ///
+    /// \param _ray         - Ray to test
+    /// \param _boxes       - Boxes to test against
+    /// \param _outTNear    - Set to the distance at which the ray enters each box. May be
+    ///                       resized past the number of boxes.
+    /// \param _outTFar     - Set to the distance at which the ray exits each box. May be resized
+    ///                       past the number of boxes.
+    /// \param _outHitMasks - Set to one mask per BATCH_SIZE boxes, with bit i of mask j set if
+    ///                       the ray hits box j * BATCH_SIZE + i
+    ///
+    /// \return Number of boxes hit
+    ///
+    size_t RayAABBIntersecter::IntersectAll(const BatchRay& _ray,
+                                            const AABBArrays& _boxes,
+                                            std::vector<float>& _outTNear,
+                                            std::vector<float>& _outTFar,
+                                            std::vector<uint8_t>& _outHitMasks)
+    {
+        ZoneScoped;
+
+        const float inf = std::numeric_limits<float>::infinity();
+        size_t numBatches = (_boxes.GetSize() + BATCH_SIZE - 1) / BATCH_SIZE;
+        _outTNear.resize(numBatches * BATCH_SIZE);
+        _outTFar.resize(numBatches * BATCH_SIZE);
+        _outHitMasks.resize(numBatches);
+
+        size_t numHits = 0;
+        for ( size_t batch = 0; batch < numBatches; batch++ )
+        {
+            size_t first = batch * BATCH_SIZE;
+            size_t count = std::min(BATCH_SIZE, _boxes.GetSize() - first);
+            uint32_t mask = IntersectBatch(_ray, _boxes, first, count, -inf, inf, &_outTNear[first], &_outTFar[first]);
+            _outHitMasks[batch] = static_cast<uint8_t>(mask);
+            for ( ; mask != 0; mask &= mask - 1 )
+            {
+                numHits++;
+            }
+        }
+
+        return numHits;
+    }
+
+    ///
+    /// \brief Finds the box _ray enters first by testing all of _boxes, BATCH_SIZE at a time.
+    ///        Ties go to the lower index.
+    ///
+    /// \param _ray      - Ray to test
+    /// \param _boxes    - Boxes to test against
+    /// \param _tMin     - Min distance along the ray. -infinity to also hit boxes behind the
+    ///                    origin, like Intersect() does.
+    /// \param _tMax     - Max distance along the ray
+    /// \param _outTNear - Set to the distance at which the ray enters the closest box
+    ///
+    /// \return Index of the closest box hit, if any
+    ///
+    tl::optional<size_t> RayAABBIntersecter::FindClosest(const BatchRay& _ray,
+                                                         const AABBArrays& _boxes,
+                                                         float _tMin,
+                                                         float _tMax,
+                                                         float& _outTNear)
+    {
+        ZoneScoped;
+
+        tl::optional<size_t> result;
+        float tNears[BATCH_SIZE];
+        float tFars[BATCH_SIZE];
+        for ( size_t first = 0; first < _boxes.GetSize(); first += BATCH_SIZE )
+        {
+            size_t count = std::min(BATCH_SIZE, _boxes.GetSize() - first);
+            uint32_t mask = IntersectBatch(_ray, _boxes, first, count, _tMin, _tMax, tNears, tFars);
+            for ( size_t lane = 0; mask != 0; lane++, mask >>= 1 )
+            {
+                if ( (mask & 1) && (!result || tNears[lane] < _outTNear) )
+                {
+                    result = first + lane;
+                    _outTNear = tNears[lane];
+                }
+            }
+        }
+
+        return result;
+    }
 }
@@ -3,12 +3,16 @@
 
 #include <glm/glm.hpp>
 #include <optional.hpp>
+#include <cstdint>
+#include <limits>
+#include <stddef.h>
+#include <vector>
+#include "AABBArrays.h"
+#include "OBB.h"
 #include "Ray.h"
 
 namespace blithe
 {
-    struct AABB;
-
     ///
     /// \brief Represents the result of a ray-AABB intersection
     ///
@@ -20,13 +24,57 @@ namespace blithe
         float m_tFar;        //!< Distance along the ray to the exit point
     };
 
+    ///
+    /// \brief Ray prepared for testing against many boxes, with the divisions of the slab
+    ///        method done once up front
+    ///
+    struct BatchRay
+    {
+        explicit BatchRay(const Ray& _ray);
+
+        glm::vec3 m_origin; //!< Ray's origin
+        glm::vec3 m_invDir; //!< 1 / the ray's direction, per component. 0 for parallel axes.
+        int m_parallelAxes; //!< Bit i is set if the ray is parallel to the slabs of axis i
+    };
+
     ///
     /// \brief Utility class to perform ray-AABB intersection tests
     ///
+    ///        Intersect() tests one box, axis-aligned or oriented. IntersectBatch() tests 8
+    ///        boxes stored in AABBArrays at once (one AVX2 or two SSE2 instruction streams),
+    ///        with the same handling of parallel axes. IntersectAll() and FindClosest() run it
+    ///        over a whole array.
+    ///
     class RayAABBIntersecter
     {
     public:
+        static constexpr size_t BATCH_SIZE = 8; //!< Number of boxes IntersectBatch() tests at once
+
         static tl::optional<RayIntersectionResult> Intersect(const Ray& _ray, const AABB& _aabb);
+        static tl::optional<RayIntersectionResult> Intersect(const Ray& _ray, const OBB& _obb);
+
+        static uint32_t IntersectBatch(const BatchRay& _ray,
+                                       const AABBArrays& _boxes,
+                                       size_t _first,
+                                       size_t _count,
+                                       float _tMin,
+                                       float _tMax,
+                                       float* _outTNear,
+                                       float* _outTFar);
+
+        static size_t IntersectAll(const BatchRay& _ray,
+                                   const AABBArrays& _boxes,
+                                   std::vector<float>& _outTNear,
+                                   std::vector<float>& _outTFar,
+                                   std::vector<uint8_t>& _outHitMasks);
+
+        static tl::optional<size_t> FindClosest(const BatchRay& _ray,
+                                                const AABBArrays& _boxes,
+                                                float _tMin,
+                                                float _tMax,
+                                                float& _outTNear);
+
+        static constexpr float PARALLEL_EPSILON = 1e-8f; //!< Direction components smaller than this are treated as parallel to their slabs
     };
 }
 
@@ -1,11 +1,20 @@
 #include "RayMeshPicker.h"
 #include <algorithm>
+#include <limits>
 #include "BlitheAssert.h"
-#include "GeomHelpers.h"
-#include "RayAABBIntersecter.h"
+#include "InstanceCuller.h"
+#include "RayPacket.h"
 
 namespace blithe
 {
+    namespace
+    {
+        bool Overlaps(const AABB& _a, const AABB& _b)
+        {
+            return glm::all(glm::lessThanEqual(_a.m_min, _b.m_max)) && glm::all(glm::lessThanEqual(_b.m_min, _a.m_max));
+        }
+    }
+
     ///
     /// \brief Default constructor
     ///
@@ -28,8 +37,8 @@ namespace blithe
     }
 
     ///
-    ///
-    /// \brief Picks the closest mesh whose AABB intersects with the ray cast from mouse position
+    /// \brief Picks the closest mesh whose AABB intersects with the ray cast from mouse position.
+    ///        The meshes' AABBs are only recalculated if the meshes differ from the last call.
     ///
     /// \param _mousePos  - Mouse position in screen coordinates
     /// \param _meshes    - Vector of meshes to test
@@ -42,16 +51,272 @@ namespace blithe
             const std::vector<const Mesh*>& _meshes,
             const std::vector<glm::mat4*>& _modelMats)
     {
-        ASSERT(m_viewPortWidth > 0 && m_viewPortHeight > 0, "RayMeshPicker not setup correctly");
-        ASSERT(_meshes.size() == _modelMats.size(), "There should be one model matrix per mesh");
+        UpdateScene(_meshes, _modelMats);
+        return PickSingleMeshAABB(_mousePos, m_scene);
+    }
 
+    ///
+    /// \brief Picks the closest mesh of _scene whose AABB intersects with the ray cast from
+    ///        mouse position
+    ///
+    /// \param _mousePos - Mouse position in screen coordinates
+    /// \param _scene    - Meshes to test
+    ///
+    /// \return Optional Result if a mesh was hit. m_idx indexes the scene's meshes.
+    ///
+    tl::optional<RayMeshPicker::Result> RayMeshPicker::PickSingleMeshAABB(glm::vec2 _mousePos, PickingScene& _scene) const
+    {
         tl::optional<Result> result;
 
-        // Convert mousePos from [0,w]x[0,h] to [-1,1]x[-1,1], so we can unproject with invViewProj
-        glm::vec2 mouseNDC;
-        mouseNDC.x = (2.0f * _mousePos.x) / m_viewPortWidth - 1.0f;
-        mouseNDC.y = 1.0f - (2.0f * _mousePos.y) / m_viewPortHeight;
-        // std::cout << "Mouse NDC: " << mouseNDC.x << ", " << mouseNDC.y << std::endl;
+        Ray ray = CalcRay(_mousePos);
+        tl::optional<PickingScene::Hit> hit = _scene.IntersectRay(ray);
+        if ( hit.has_value() )
+        {
+            Result r;
+            r.m_entryPt = ray.m_origin + hit->m_tNear * ray.m_dir;
+            r.m_tClose = hit->m_tNear;
+            r.m_idx = hit->m_idx;
+            r.m_ray = ray;
+            result = r;
+        }
+
+        return result;
+    }
+
+    ///
+    /// \brief Picks the closest mesh triangle that intersects with the ray cast from mouse
+    ///        position. Like PickSingleMeshAABB(), the meshes' bounds and triangle BVHs are kept
+    ///        between calls.
+    ///
+    /// \param _mousePos  - Mouse position in screen coordinates
+    /// \param _meshes    - Vector of meshes to test
+    /// \param _modelMats - Corresponding model matrices for each mesh
+    ///
+    /// \return Optional TriangleResult if a triangle was hit.
+    ///
+    tl::optional<RayMeshPicker::TriangleResult> RayMeshPicker::PickSingleMeshTriangle(
+            glm::vec2 _mousePos,
+            const std::vector<const Mesh*>& _meshes,
+            const std::vector<glm::mat4*>& _modelMats)
+    {
+        UpdateScene(_meshes, _modelMats);
+        return PickSingleMeshTriangle(_mousePos, m_scene);
+    }
+
+    ///
+    /// \brief Picks the closest triangle of _scene that intersects with the ray cast from
+    ///        mouse position
+    ///
+    /// \param _mousePos - Mouse position in screen coordinates
+    /// \param _scene    - Meshes to test
+    ///
+    /// \return Optional TriangleResult if a triangle was hit. m_idx indexes the scene's meshes.
+    ///
+    tl::optional<RayMeshPicker::TriangleResult> RayMeshPicker::PickSingleMeshTriangle(glm::vec2 _mousePos, PickingScene& _scene) const
+    {
+        tl::optional<TriangleResult> result;
+
+        Ray ray = CalcRay(_mousePos);
+        tl::optional<PickingScene::TriangleHit> hit = _scene.IntersectRayTriangles(ray);
+        if ( hit.has_value() )
+        {
+            TriangleResult r;
+            r.m_idx = hit->m_idx;
+            r.m_triIdx = hit->m_triIdx;
+            r.m_barycentrics = hit->m_barycentrics;
+            r.m_hitPt = ray.m_origin + hit->m_t * ray.m_dir;
+            r.m_ray = ray;
+            r.m_t = hit->m_t;
+            result = r;
+        }
+
+        return result;
+    }
+
+    ///
+    /// \brief Picks the closest mesh box under each of many screen positions
+    ///
+    /// \param _screenPositions - Positions in screen coordinates. Consecutive positions should
+    ///                           be close together, see CalcGridPositions().
+    /// \param _meshes          - Vector of meshes to test
+    /// \param _modelMats       - Corresponding model matrices for each mesh
+    ///
+    /// \return Optional Result for each position, set if a mesh was hit
+    ///
+    std::vector<tl::optional<RayMeshPicker::Result>> RayMeshPicker::PickMeshesAABB(
+            const std::vector<glm::vec2>& _screenPositions,
+            const std::vector<const Mesh*>& _meshes,
+            const std::vector<glm::mat4*>& _modelMats)
+    {
+        UpdateScene(_meshes, _modelMats);
+        return PickMeshesAABB(_screenPositions, m_scene);
+    }
+
+    ///
+    /// \brief Picks the closest mesh box of _scene under each of many screen positions, casting
+    ///        the rays in packets
+    ///
+    /// \param _screenPositions - Positions in screen coordinates. Consecutive positions should
+    ///                           be close together, see CalcGridPositions().
+    /// \param _scene           - Meshes to test
+    ///
+    /// \return Optional Result for each position, set if a mesh was hit. m_idx indexes the
+    ///         scene's meshes.
+    ///
+    std::vector<tl::optional<RayMeshPicker::Result>> RayMeshPicker::PickMeshesAABB(const std::vector<glm::vec2>& _screenPositions, PickingScene& _scene) const
+    {
+        std::vector<Ray> rays = CalcRays(_screenPositions);
+        std::vector<tl::optional<PickingScene::Hit>> hits;
+        _scene.IntersectRays(rays, hits);
+
+        std::vector<tl::optional<Result>> results(rays.size());
+        for ( size_t i = 0; i < rays.size(); i++ )
+        {
+            if ( hits[i].has_value() )
+            {
+                Result r;
+                r.m_entryPt = rays[i].m_origin + hits[i]->m_tNear * rays[i].m_dir;
+                r.m_tClose = hits[i]->m_tNear;
+                r.m_idx = hits[i]->m_idx;
+                r.m_ray = rays[i];
+                results[i] = r;
+            }
+        }
+
+        return results;
+    }
+
+    ///
+    /// \brief Picks the closest mesh triangle under each of many screen positions
+    ///
+    /// \param _screenPositions - Positions in screen coordinates. Consecutive positions should
+    ///                           be close together, see CalcGridPositions().
+    /// \param _meshes          - Vector of meshes to test
+    /// \param _modelMats       - Corresponding model matrices for each mesh
+    ///
+    /// \return Optional TriangleResult for each position, set if a triangle was hit
+    ///
+    std::vector<tl::optional<RayMeshPicker::TriangleResult>> RayMeshPicker::PickMeshTriangles(
+            const std::vector<glm::vec2>& _screenPositions,
+            const std::vector<const Mesh*>& _meshes,
+            const std::vector<glm::mat4*>& _modelMats)
+    {
+        UpdateScene(_meshes, _modelMats);
+        return PickMeshTriangles(_screenPositions, m_scene);
+    }
+
+    ///
+    /// \brief Picks the closest triangle of _scene under each of many screen positions, casting
+    ///        the rays in packets
+    ///
+    /// \param _screenPositions - Positions in screen coordinates. Consecutive positions should
+    ///                           be close together, see CalcGridPositions().
+    /// \param _scene           - Meshes to test
+    ///
+    /// \return Optional TriangleResult for each position, set if a triangle was hit. m_idx
+    ///         indexes the scene's meshes.
+    ///
+    std::vector<tl::optional<RayMeshPicker::TriangleResult>> RayMeshPicker::PickMeshTriangles(const std::vector<glm::vec2>& _screenPositions, PickingScene& _scene) const
+    {
+        std::vector<Ray> rays = CalcRays(_screenPositions);
+        std::vector<tl::optional<PickingScene::TriangleHit>> hits;
+        _scene.IntersectRaysTriangles(rays, hits);
+
+        std::vector<tl::optional<TriangleResult>> results(rays.size());
+        for ( size_t i = 0; i < rays.size(); i++ )
+        {
+            if ( hits[i].has_value() )
+            {
+                TriangleResult r;
+                r.m_idx = hits[i]->m_idx;
+                r.m_triIdx = hits[i]->m_triIdx;
+                r.m_barycentrics = hits[i]->m_barycentrics;
+                r.m_hitPt = rays[i].m_origin + hits[i]->m_t * rays[i].m_dir;
+                r.m_ray = rays[i];
+                r.m_t = hits[i]->m_t;
+                results[i] = r;
+            }
+        }
+
+        return results;
+    }
+
+    ///
+    /// \brief Selects the meshes whose bounding boxes show in a marquee
+    ///
+    /// \param _corner0   - One corner of the marquee in screen coordinates, e.g. where the drag
+    ///                     started
+    /// \param _corner1   - Opposite corner of the marquee in screen coordinates
+    /// \param _meshes    - Vector of meshes to select from
+    /// \param _modelMats - Corresponding model matrices for each mesh
+    ///
+    /// \return Indices of the selected meshes, in no particular order
+    ///
+    std::vector<size_t> RayMeshPicker::SelectMeshes(glm::vec2 _corner0, glm::vec2 _corner1,
+                                                    const std::vector<const Mesh*>& _meshes,
+                                                    const std::vector<glm::mat4*>& _modelMats)
+    {
+        UpdateScene(_meshes, _modelMats);
+        return SelectMeshes(_corner0, _corner1, m_scene);
+    }
+
+    ///
+    /// \brief Selects the meshes of _scene whose bounding boxes show in a marquee, through the
+    ///        scene's BVH
+    ///
+    /// \param _corner0 - One corner of the marquee in screen coordinates
+    /// \param _corner1 - Opposite corner of the marquee in screen coordinates
+    /// \param _scene   - Meshes to select from
+    ///
+    /// \return Indices of the selected meshes in the scene, in no particular order
+    ///
+    std::vector<size_t> RayMeshPicker::SelectMeshes(glm::vec2 _corner0, glm::vec2 _corner1, PickingScene& _scene) const
+    {
+        std::vector<size_t> selected;
+        _scene.QueryFrustum(CalcMarqueeFrustum(_corner0, _corner1), selected);
+
+        AABB marqueeBounds = CalcMarqueeBounds(_corner0, _corner1);
+        selected.erase(std::remove_if(selected.begin(), selected.end(), [&](size_t _idx) {
+            return !Overlaps(_scene.GetWorldBounds(_idx), marqueeBounds);
+        }), selected.end());
+        return selected;
+    }
+
+    ///
+    /// \brief Selects the instances of _culler whose bounding boxes show in a marquee, with
+    ///        its SIMD frustum test over all the instances or through its BVH
+    ///
+    /// \param _corner0 - One corner of the marquee in screen coordinates
+    /// \param _corner1 - Opposite corner of the marquee in screen coordinates
+    /// \param _culler  - Instances to select from
+    /// \param _useBVH  - Whether to walk the culler's BVH rather than test every instance.
+    ///                   Faster for small marquees over many instances.
+    ///
+    /// \return Indices of the selected instances. In order unless _useBVH is set.
+    ///
+    std::vector<uint32_t> RayMeshPicker::SelectInstances(glm::vec2 _corner0, glm::vec2 _corner1, InstanceCuller& _culler, bool _useBVH) const
+    {
+        std::vector<uint32_t> selected;
+        _culler.Query(CalcMarqueeFrustum(_corner0, _corner1), _useBVH, selected);
+
+        AABB marqueeBounds = CalcMarqueeBounds(_corner0, _corner1);
+        selected.erase(std::remove_if(selected.begin(), selected.end(), [&](uint32_t _instance) {
+            return !Overlaps(_culler.GetWorldBounds(_instance), marqueeBounds);
+        }), selected.end());
+        return selected;
+    }
+
+    ///
+    /// \brief Calculates the world space ray under the mouse, from the near plane towards the
+    ///        far plane
+    ///
+    /// \param _mousePos - Mouse position in screen coordinates
+    ///
+    /// \return Ray starting on the near plane
+    ///
+    Ray RayMeshPicker::CalcRay(glm::vec2 _mousePos) const
+    {
+        glm::vec2 mouseNDC = ScreenToNDC(_mousePos);
 
         // Near and far points are at NDC z=-1 and z=1. Convert them to world space to get our ray.
         glm::vec4 rayStartNDC(mouseNDC, -1.0f, 1.0f);
@@ -62,41 +327,150 @@ namespace blithe
         rayEndWorld   /= rayEndWorld.w;
         glm::vec3 rayOrigin = glm::vec3(rayStartWorld);
         glm::vec3 rayDir = glm::normalize(glm::vec3(rayEndWorld - rayStartWorld));
-        Ray ray { rayOrigin, rayDir };
-        //std::cout << "Ray dir: " << rayDir.x << ", " << rayDir.y << ", " << rayDir.z << std::endl;
+        return Ray{ rayOrigin, rayDir };
+    }
+
+    ///
+    /// \brief Calculates the sub-frustum of the view behind a marquee, holding everything that
+    ///        projects into it
+    ///
+    /// \param _corner0 - One corner of the marquee in screen coordinates
+    /// \param _corner1 - Opposite corner of the marquee in screen coordinates
+    ///
+    /// \return World space frustum, cut off by the view's near and far planes
+    ///
+    Frustum RayMeshPicker::CalcMarqueeFrustum(glm::vec2 _corner0, glm::vec2 _corner1) const
+    {
+        glm::vec2 ndc0 = ScreenToNDC(_corner0);
+        glm::vec2 ndc1 = ScreenToNDC(_corner1);
+        return Frustum::FromMatrix(glm::inverse(m_invViewProj), glm::min(ndc0, ndc1), glm::max(ndc0, ndc1));
+    }
+
+    ///
+    /// \brief Converts a screen position to normalized device coordinates
+    ///
+    /// \param _screenPos - Position in screen coordinates, with y going down
+    ///
+    /// \return Position in [-1,1]x[-1,1], with y going up
+    ///
+    glm::vec2 RayMeshPicker::ScreenToNDC(glm::vec2 _screenPos) const
+    {
+        ASSERT(m_viewPortWidth > 0 && m_viewPortHeight > 0, "RayMeshPicker not setup correctly");
 
-        std::vector<float> candidateTNears;
-        std::vector<size_t> candidateIndices;
-        std::vector<RayIntersectionResult> candidateIntersectionResults;
-        for ( size_t i = 0; i < _meshes.size(); i++ )
+        // Convert from [0,w]x[0,h] to [-1,1]x[-1,1], so we can unproject with invViewProj
+        glm::vec2 ndc;
+        ndc.x = (2.0f * _screenPos.x) / m_viewPortWidth - 1.0f;
+        ndc.y = 1.0f - (2.0f * _screenPos.y) / m_viewPortHeight;
+        return ndc;
+    }
+
+    ///
+    /// \brief Calculates the bounding box of a marquee's sub-frustum, from its corners on the
+    ///        near and far planes. A box missing it is separated from the sub-frustum by one of
+    ///        its own faces, which the sub-frustum's planes alone can miss.
+    ///
+    /// \param _corner0 - One corner of the marquee in screen coordinates
+    /// \param _corner1 - Opposite corner of the marquee in screen coordinates
+    ///
+    /// \return World space bounding box of the sub-frustum
+    ///
+    AABB RayMeshPicker::CalcMarqueeBounds(glm::vec2 _corner0, glm::vec2 _corner1) const
+    {
+        glm::vec2 ndc0 = ScreenToNDC(_corner0);
+        glm::vec2 ndc1 = ScreenToNDC(_corner1);
+
+        AABB bounds{ glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()) };
+        for ( int i = 0; i < 8; i++ )
+        {
+            glm::vec4 cornerNDC((i & 1) ? ndc1.x : ndc0.x, (i & 2) ? ndc1.y : ndc0.y, (i & 4) ? 1.0f : -1.0f, 1.0f);
+            glm::vec4 cornerWorld = m_invViewProj * cornerNDC;
+            glm::vec3 corner = glm::vec3(cornerWorld) / cornerWorld.w;
+            bounds.m_min = glm::min(bounds.m_min, corner);
+            bounds.m_max = glm::max(bounds.m_max, corner);
+        }
+        return bounds;
+    }
+
+    ///
+    /// \brief Calculates the world space rays under many screen positions, as CalcRay() does
+    ///
+    /// \param _screenPositions - Positions in screen coordinates
+    ///
+    /// \return One ray per position, in the same order
+    ///
+    std::vector<Ray> RayMeshPicker::CalcRays(const std::vector<glm::vec2>& _screenPositions) const
+    {
+        std::vector<Ray> rays;
+        rays.reserve(_screenPositions.size());
+        for ( const glm::vec2& pos : _screenPositions )
+        {
+            rays.push_back(CalcRay(pos));
+        }
+        return rays;
+    }
+
+    ///
+    /// \brief Spreads _numSamples.x by _numSamples.y positions evenly over a screen rectangle,
+    ///        e.g. a marquee, at the centers of the cells of a grid.
+    ///
+    ///        The positions are ordered in tiles of 4 by 2 cells (row by row within a tile),
+    ///        so each RayPacket gets a compact block of neighbouring rays rather than a thin
+    ///        strip of a row.
+    ///
+    /// \param _min        - Top left corner of the rectangle in screen coordinates
+    /// \param _max        - Bottom right corner of the rectangle in screen coordinates
+    /// \param _numSamples - Number of columns and rows of positions
+    ///
+    /// \return The positions, tile by tile
+    ///
+    std::vector<glm::vec2> RayMeshPicker::CalcGridPositions(glm::vec2 _min, glm::vec2 _max, glm::ivec2 _numSamples)
+    {
+        static_assert(RayPacket::SIZE == 8, "Tiles are sized to fill a packet");
+        const int TILE_WIDTH = 4;
+        const int TILE_HEIGHT = 2;
+
+        std::vector<glm::vec2> positions;
+        if ( _numSamples.x <= 0 || _numSamples.y <= 0 )
+        {
+            return positions;
+        }
+
+        positions.reserve(static_cast<size_t>(_numSamples.x) * _numSamples.y);
+        glm::vec2 cellSize = (_max - _min) / glm::vec2(_numSamples.x, _numSamples.y);
+        for ( int tileY = 0; tileY < _numSamples.y; tileY += TILE_HEIGHT )
         {
-            const Mesh& mesh = *_meshes[i];
-            AABB localAABB = GeomHelpers::CalcLocalAABB(mesh);
-            const glm::mat4& modelMat = *_modelMats[i];
-            AABB worldAABB = GeomHelpers::TransformAABB(localAABB, modelMat);
-            tl::optional<RayIntersectionResult> intersection =
-                    RayAABBIntersecter::Intersect(ray, worldAABB);
-            if ( intersection.has_value() )
+            for ( int tileX = 0; tileX < _numSamples.x; tileX += TILE_WIDTH )
             {
-                candidateTNears.push_back(intersection->m_tClose);
-                candidateIndices.push_back(i);
-                candidateIntersectionResults.push_back(intersection.value());
+                for ( int y = tileY; y < std::min(tileY + TILE_HEIGHT, _numSamples.y); y++ )
+                {
+                    for ( int x = tileX; x < std::min(tileX + TILE_WIDTH, _numSamples.x); x++ )
+                    {
+                        positions.push_back(_min + (glm::vec2(x, y) + 0.5f) * cellSize);
+                    }
+                }
             }
         }
+        return positions;
+    }
 
-        if ( !candidateTNears.empty() )
+    ///
+    /// \brief Points m_scene at _meshes, only rebuilding it if the meshes are different from
+    ///        last time
+    ///
+    /// \param _meshes    - Vector of meshes to pick from
+    /// \param _modelMats - Corresponding model matrices for each mesh
+    ///
+    void RayMeshPicker::UpdateScene(const std::vector<const Mesh*>& _meshes, const std::vector<glm::mat4*>& _modelMats)
+    {
+        ASSERT(_meshes.size() == _modelMats.size(), "There should be one model matrix per mesh");
+
+        if ( m_scene.HasMeshes(_meshes) )
         {
-            Result r;
-            std::vector<float>::iterator minIt = std::min_element(candidateTNears.begin(),
-                                                                  candidateTNears.end());
-            int minTNearsIdx = std::distance(candidateTNears.begin(), minIt);
-            r.m_entryPt = candidateIntersectionResults[minTNearsIdx].m_entryPt;
-            r.m_tClose = candidateTNears[minTNearsIdx];
-            r.m_idx = candidateIndices[minTNearsIdx];
-            r.m_ray = ray;
-            result = r;
+            m_scene.SetModelMats(_modelMats);
+        }
+        else
+        {
+            m_scene.SetMeshes(_meshes, _modelMats);
         }
-
-        return result;
     }
 }
@@ -2,17 +2,30 @@
 #define RAYMESHPICKER_H
 
 #include <optional.hpp>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <stddef.h>
 #include <vector>
+#include "AABB.h"
+#include "Frustum.h"
 #include "Mesh.h"
+#include "PickingScene.h"
 #include "Ray.h"
 
 namespace blithe
 {
+    class InstanceCuller;
+
     ///
     /// \brief Class for selecting mesh AABBs using ray picking based on screen-space mouse position
     ///
+    ///        Picking goes through a PickingScene, so a pick only visits the meshes near the
+    ///        ray. PickSingleMeshAABB() reports the first mesh box the ray enters, which is cheap
+    ///        but lets big boxes in front steal picks. PickSingleMeshTriangle() reports the
+    ///        exact triangle under the mouse instead. The overload taking vectors of meshes
+    ///        keeps its own scene, which is only rebuilt when the meshes change and refit when
+    ///        their model matrices do.
+    ///
     class RayMeshPicker
     {
     public:
@@ -27,16 +40,62 @@ namespace blithe
             float m_tClose;      //!< Distance along ray where entry point is
         };
 
+        ///
+        /// \brief Represents the result of a successful triangle pick
+        ///
+        struct TriangleResult
+        {
+            size_t m_idx;             //!< Index of the picked mesh in the input vector
+            uint32_t m_triIdx;        //!< Index of the picked triangle in the mesh
+            glm::vec3 m_barycentrics; //!< Weights of the triangle's corners at the hit point
+            glm::vec3 m_hitPt;        //!< World space point where the ray hits the triangle
+            Ray m_ray;                //!< Ray that was calculated from the mouse pos
+            float m_t;                //!< Distance along ray where the hit point is
+        };
+
         RayMeshPicker();
         RayMeshPicker(int _viewPortWidth, int _viewPortHeight, glm::mat4 _invViewProj);
 
         tl::optional<Result> PickSingleMeshAABB(glm::vec2 _mousePos,
                                                 const std::vector<const Mesh*>& _meshes,
                                                 const std::vector<glm::mat4*>& _modelMats);
+        tl::optional<Result> PickSingleMeshAABB(glm::vec2 _mousePos, PickingScene& _scene) const;
+        tl::optional<TriangleResult> PickSingleMeshTriangle(glm::vec2 _mousePos,
+                                                            const std::vector<const Mesh*>& _meshes,
+                                                            const std::vector<glm::mat4*>& _modelMats);
+        tl::optional<TriangleResult> PickSingleMeshTriangle(glm::vec2 _mousePos, PickingScene& _scene) const;
+
+        std::vector<tl::optional<Result>> PickMeshesAABB(const std::vector<glm::vec2>& _screenPositions,
+                                                         const std::vector<const Mesh*>& _meshes,
+                                                         const std::vector<glm::mat4*>& _modelMats);
+        std::vector<tl::optional<Result>> PickMeshesAABB(const std::vector<glm::vec2>& _screenPositions, PickingScene& _scene) const;
+        std::vector<tl::optional<TriangleResult>> PickMeshTriangles(const std::vector<glm::vec2>& _screenPositions,
+                                                                    const std::vector<const Mesh*>& _meshes,
+                                                                    const std::vector<glm::mat4*>& _modelMats);
+        std::vector<tl::optional<TriangleResult>> PickMeshTriangles(const std::vector<glm::vec2>& _screenPositions, PickingScene& _scene) const;
+
+        std::vector<size_t> SelectMeshes(glm::vec2 _corner0, glm::vec2 _corner1,
+                                         const std::vector<const Mesh*>& _meshes,
+                                         const std::vector<glm::mat4*>& _modelMats);
+        std::vector<size_t> SelectMeshes(glm::vec2 _corner0, glm::vec2 _corner1, PickingScene& _scene) const;
+        std::vector<uint32_t> SelectInstances(glm::vec2 _corner0, glm::vec2 _corner1, InstanceCuller& _culler, bool _useBVH) const;
+
+        Ray CalcRay(glm::vec2 _mousePos) const;
+        Frustum CalcMarqueeFrustum(glm::vec2 _corner0, glm::vec2 _corner1) const;
+        std::vector<Ray> CalcRays(const std::vector<glm::vec2>& _screenPositions) const;
+
+        static std::vector<glm::vec2> CalcGridPositions(glm::vec2 _min, glm::vec2 _max, glm::ivec2 _numSamples);
 
         int m_viewPortWidth = 0;   //!< Width of the viewport in pixels
         int m_viewPortHeight = 0;  //!< Height of the viewport in pixels
         glm::mat4 m_invViewProj = glm::mat4(1.0); //!< Inverse of the view-projection matrix
+
+    private:
+        glm::vec2 ScreenToNDC(glm::vec2 _screenPos) const;
+        AABB CalcMarqueeBounds(glm::vec2 _corner0, glm::vec2 _corner1) const;
+        void UpdateScene(const std::vector<const Mesh*>& _meshes, const std::vector<glm::mat4*>& _modelMats);
+
+        PickingScene m_scene;      //!< Scene for the meshes last given to PickSingleMeshAABB()
     };
 }
 
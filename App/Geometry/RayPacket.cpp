@@ -0,0 +1,147 @@
+#include "RayPacket.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "BlitheAssert.h"
+#include "BlitheSIMD.h"
+#include "RayAABBIntersecter.h"
+
+namespace blithe
+{
+    constexpr size_t RayPacket::SIZE;
+
+    ///
+    /// \brief Packs _count rays. The unused lanes get copies of the first ray and are left out
+    ///        of m_activeMask.
+    ///
+    /// \param _rays  - Rays to pack
+    /// \param _count - Number of rays, 1 to SIZE
+    ///
+    RayPacket::RayPacket(const Ray* _rays, size_t _count)
+    {
+        ASSERT(_count >= 1 && _count <= SIZE, "A packet holds 1 to " << SIZE << " rays, but got " << _count);
+
+        float* invDirs[3] = { m_invDirX, m_invDirY, m_invDirZ };
+        for ( size_t lane = 0; lane < SIZE; lane++ )
+        {
+            const Ray& ray = _rays[lane < _count ? lane : 0];
+            m_rays[lane] = ray;
+            m_originX[lane] = ray.m_origin.x;
+            m_originY[lane] = ray.m_origin.y;
+            m_originZ[lane] = ray.m_origin.z;
+            for ( int axis = 0; axis < 3; axis++ )
+            {
+                // Same handling of parallel axes as RayAABBIntersecter
+                bool parallel = std::abs(ray.m_dir[axis]) < RayAABBIntersecter::PARALLEL_EPSILON;
+                invDirs[axis][lane] = parallel ? 0.0f : 1.0f / ray.m_dir[axis];
+                m_parallel[axis][lane] = parallel ? ~0u : 0u;
+            }
+        }
+        m_activeMask = (1u << _count) - 1;
+    }
+
+    ///
+    /// \brief Slab tests the rays in _mask against _aabb
+    ///
+    /// \param _aabb        - Box to test
+    /// \param _maxT        - SIZE floats with the max distance along each ray
+    /// \param _mask        - Rays to test
+    /// \param _outMinTNear - Set to the smallest distance at which a ray hitting the box enters it
+    ///
+    /// \return Mask of the rays in _mask that hit the box between 0 and their _maxT
+    ///
+    uint32_t RayPacket::IntersectAABB(const AABB& _aabb, const float* _maxT, uint32_t _mask, float& _outMinTNear) const
+    {
+        const float* origins[3] = { m_originX, m_originY, m_originZ };
+        const float* invDirs[3] = { m_invDirX, m_invDirY, m_invDirZ };
+        const float inf = std::numeric_limits<float>::infinity();
+        float tNears[SIZE];
+        uint32_t hits = 0;
+
+#if defined(BLITHE_SIMD_AVX2)
+        __m256 tNear = _mm256_setzero_ps();
+        __m256 tFar = _mm256_loadu_ps(_maxT);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            __m256 lo = _mm256_set1_ps(_aabb.m_min[axis]);
+            __m256 hi = _mm256_set1_ps(_aabb.m_max[axis]);
+            __m256 origin = _mm256_loadu_ps(origins[axis]);
+            __m256 invDir = _mm256_loadu_ps(invDirs[axis]);
+            __m256 parallel = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(m_parallel[axis])));
+            __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(lo, origin), invDir);
+            __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(hi, origin), invDir);
+            // Parallel rays don't limit the distances, but must start between the slabs
+            __m256 tMin = _mm256_blendv_ps(_mm256_min_ps(t0, t1), _mm256_set1_ps(-inf), parallel);
+            __m256 tMax = _mm256_blendv_ps(_mm256_max_ps(t0, t1), _mm256_set1_ps(inf), parallel);
+            __m256 between = _mm256_and_ps(_mm256_cmp_ps(lo, origin, _CMP_LE_OQ), _mm256_cmp_ps(origin, hi, _CMP_LE_OQ));
+            inside = _mm256_andnot_ps(_mm256_andnot_ps(between, parallel), inside);
+            tNear = _mm256_max_ps(tNear, tMin);
+            tFar = _mm256_min_ps(tFar, tMax);
+        }
+        hits = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_and_ps(inside, _mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ))));
+        _mm256_storeu_ps(tNears, tNear);
+#elif defined(BLITHE_SIMD_SSE2)
+        for ( size_t half = 0; half < SIZE; half += 4 )
+        {
+            __m128 tNear = _mm_setzero_ps();
+            __m128 tFar = _mm_loadu_ps(_maxT + half);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for ( int axis = 0; axis < 3; axis++ )
+            {
+                __m128 lo = _mm_set1_ps(_aabb.m_min[axis]);
+                __m128 hi = _mm_set1_ps(_aabb.m_max[axis]);
+                __m128 origin = _mm_loadu_ps(origins[axis] + half);
+                __m128 invDir = _mm_loadu_ps(invDirs[axis] + half);
+                __m128 parallel = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(m_parallel[axis] + half)));
+                __m128 t0 = _mm_mul_ps(_mm_sub_ps(lo, origin), invDir);
+                __m128 t1 = _mm_mul_ps(_mm_sub_ps(hi, origin), invDir);
+                // Parallel rays don't limit the distances, but must start between the slabs
+                __m128 tMin = _mm_or_ps(_mm_and_ps(parallel, _mm_set1_ps(-inf)), _mm_andnot_ps(parallel, _mm_min_ps(t0, t1)));
+                __m128 tMax = _mm_or_ps(_mm_and_ps(parallel, _mm_set1_ps(inf)), _mm_andnot_ps(parallel, _mm_max_ps(t0, t1)));
+                __m128 between = _mm_and_ps(_mm_cmple_ps(lo, origin), _mm_cmple_ps(origin, hi));
+                inside = _mm_andnot_ps(_mm_andnot_ps(between, parallel), inside);
+                tNear = _mm_max_ps(tNear, tMin);
+                tFar = _mm_min_ps(tFar, tMax);
+            }
+            hits |= static_cast<uint32_t>(_mm_movemask_ps(_mm_and_ps(inside, _mm_cmple_ps(tNear, tFar)))) << half;
+            _mm_storeu_ps(tNears + half, tNear);
+        }
+#else
+        for ( size_t lane = 0; lane < SIZE; lane++ )
+        {
+            float tNear = 0.0f;
+            float tFar = _maxT[lane];
+            bool inside = true;
+            for ( int axis = 0; axis < 3; axis++ )
+            {
+                float origin = origins[axis][lane];
+                if ( m_parallel[axis][lane] )
+                {
+                    inside = inside && _aabb.m_min[axis] <= origin && origin <= _aabb.m_max[axis];
+                }
+                else
+                {
+                    float t0 = (_aabb.m_min[axis] - origin) * invDirs[axis][lane];
+                    float t1 = (_aabb.m_max[axis] - origin) * invDirs[axis][lane];
+                    tNear = std::max(tNear, std::min(t0, t1));
+                    tFar = std::min(tFar, std::max(t0, t1));
+                }
+            }
+            hits |= static_cast<uint32_t>(inside && tNear <= tFar) << lane;
+            tNears[lane] = tNear;
+        }
+#endif
+
+        hits &= _mask;
+        _outMinTNear = inf;
+        for ( uint32_t lane = 0, bits = hits; bits != 0; lane++, bits >>= 1 )
+        {
+            if ( bits & 1 )
+            {
+                _outMinTNear = std::min(_outMinTNear, tNears[lane]);
+            }
+        }
+        return hits;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef RAYPACKET_H
+#define RAYPACKET_H
+
+#include <cstdint>
+#include <stddef.h>
+#include "AABB.h"
+#include "Ray.h"
+
+namespace blithe
+{
+    ///
+    /// \brief Up to SIZE rays stored as structure-of-arrays, so a box can be tested against all
+    ///        of them at once (one AVX2 or two SSE2 instruction streams).
+    ///
+    ///        Coherent rays, e.g. from neighbouring pixels, tend to visit the same BVH nodes, so
+    ///        BVH::IntersectRayPacket() walks the tree once for the whole packet and skips the
+    ///        nodes that none of its rays hit.
+    ///
+    struct RayPacket
+    {
+        static constexpr size_t SIZE = 8; //!< Max rays per packet
+
+        RayPacket(const Ray* _rays, size_t _count);
+
+        uint32_t IntersectAABB(const AABB& _aabb, const float* _maxT, uint32_t _mask, float& _outMinTNear) const;
+
+        Ray m_rays[SIZE];             //!< The rays
+        float m_originX[SIZE];        //!< X of each ray's origin
+        float m_originY[SIZE];        //!< Y of each ray's origin
+        float m_originZ[SIZE];        //!< Z of each ray's origin
+        float m_invDirX[SIZE];        //!< 1 / the x of each ray's direction. 0 if parallel to the x slabs.
+        float m_invDirY[SIZE];        //!< 1 / the y of each ray's direction. 0 if parallel to the y slabs.
+        float m_invDirZ[SIZE];        //!< 1 / the z of each ray's direction. 0 if parallel to the z slabs.
+        uint32_t m_parallel[3][SIZE]; //!< All bits set for the rays parallel to the slabs of each axis
+        uint32_t m_activeMask;        //!< Bit i is set if ray i is in use
+    };
+}
+
+#endif // RAYPACKET_H
@@ -0,0 +1,490 @@
+#include "SpatialHashGrid.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include "BlitheAssert.h"
+#include "BVH.h"
+
+namespace blithe
+{
+    namespace
+    {
+        const size_t MIN_BUCKETS = 64;                        // Buckets of an empty grid. A power of 2.
+        const int CELL_KEY_BITS = 21;                         // Bits of each cell coordinate in a cell key
+        const int CELL_KEY_OFFSET = 1 << (CELL_KEY_BITS - 1); // Added to the cell coordinates to make them unsigned
+
+        bool Overlaps(const AABB& _a, const AABB& _b)
+        {
+            return glm::all(glm::lessThanEqual(_a.m_min, _b.m_max)) && glm::all(glm::lessThanEqual(_b.m_min, _a.m_max));
+        }
+
+        bool Overlaps(const AABB& _aabb, const Sphere& _sphere)
+        {
+            glm::vec3 closest = glm::clamp(_sphere.m_center, _aabb.m_min, _aabb.m_max);
+            glm::vec3 offset = closest - _sphere.m_center;
+            return glm::dot(offset, offset) <= _sphere.m_radius * _sphere.m_radius;
+        }
+    }
+
+    ///
+    /// \brief Calls _func(id) for each object whose center is in the cell with key _cellKey.
+    ///        Its bucket may also hold objects of other cells, which are skipped.
+    ///
+    template<typename Func>
+    void SpatialHashGrid::ForEachInCell(uint64_t _cellKey, Func&& _func) const
+    {
+        for ( uint32_t id : m_buckets[CalcBucket(_cellKey)] )
+        {
+            if ( m_objects[id].m_cellKey == _cellKey )
+            {
+                _func(id);
+            }
+        }
+    }
+
+    ///
+    /// \brief Calls _func(id) for each object whose bounds may overlap _region, i.e. each
+    ///        object in the cells within m_maxHalfExtent of it. If that's more cells than
+    ///        objects, it's called for every object instead.
+    ///
+    template<typename Func>
+    void SpatialHashGrid::ForEachCandidate(const AABB& _region, Func&& _func) const
+    {
+        if ( m_numObjects == 0 )
+        {
+            return;
+        }
+
+        glm::ivec3 first = glm::max(CalcCell(_region.m_min - m_maxHalfExtent), m_minCell);
+        glm::ivec3 last = glm::min(CalcCell(_region.m_max + m_maxHalfExtent), m_maxCell);
+        if ( first.x > last.x || first.y > last.y || first.z > last.z )
+        {
+            return;
+        }
+
+        glm::ivec3 size = last - first + glm::ivec3(1);
+        size_t numCells = static_cast<size_t>(size.x) * static_cast<size_t>(size.y) * static_cast<size_t>(size.z);
+        if ( numCells > m_numObjects )
+        {
+            for ( uint32_t id = 0; id < m_objects.size(); id++ )
+            {
+                if ( m_objects[id].m_inserted )
+                {
+                    _func(id);
+                }
+            }
+            return;
+        }
+
+        for ( int z = first.z; z <= last.z; z++ )
+        {
+            for ( int y = first.y; y <= last.y; y++ )
+            {
+                for ( int x = first.x; x <= last.x; x++ )
+                {
+                    ForEachInCell(CalcCellKey(glm::ivec3(x, y, z)), _func);
+                }
+            }
+        }
+    }
+
+    ///
+    /// \brief Constructor
+    ///
+    /// \param _cellSize - Width of the cells. About twice the typical object size works well.
+    ///
+    SpatialHashGrid::SpatialHashGrid(float _cellSize)
+        : m_cellSize(_cellSize), m_invCellSize(1.0f / _cellSize)
+    {
+        ASSERT(_cellSize > 0.0f, "Cell size must be positive, but got " << _cellSize);
+        Clear();
+    }
+
+    ///
+    /// \brief Adds an object
+    ///
+    /// \param _id     - Id the queries report the object as. Must not be in the grid already.
+    ///                  The ids index an array, so keep them small, e.g. instance indices.
+    /// \param _bounds - Bounds of the object
+    ///
+    void SpatialHashGrid::Insert(uint32_t _id, const AABB& _bounds)
+    {
+        ASSERT(!Contains(_id), "Object " << _id << " is already in the grid");
+
+        if ( _id >= m_objects.size() )
+        {
+            m_objects.resize(_id + 1);
+        }
+        glm::ivec3 cell = CalcCell((_bounds.m_min + _bounds.m_max) * 0.5f);
+        Object& object = m_objects[_id];
+        object.m_bounds = _bounds;
+        object.m_cellKey = CalcCellKey(cell);
+        object.m_inserted = true;
+        Grow(_bounds, cell);
+        AddToBucket(_id);
+
+        m_numObjects++;
+        if ( m_numObjects > m_buckets.size() )
+        {
+            Rehash(m_buckets.size() * 2);
+        }
+    }
+
+    ///
+    /// \brief Takes an object out
+    ///
+    /// \param _id - Id of an object in the grid
+    ///
+    void SpatialHashGrid::Remove(uint32_t _id)
+    {
+        ASSERT(Contains(_id), "Object " << _id << " is not in the grid");
+
+        RemoveFromBucket(_id);
+        m_objects[_id].m_inserted = false;
+        m_numObjects--;
+    }
+
+    ///
+    /// \brief Updates the bounds of an object. The buckets are only touched if the center of
+    ///        the bounds moves to another cell.
+    ///
+    /// \param _id     - Id of an object in the grid
+    /// \param _bounds - New bounds of the object
+    ///
+    void SpatialHashGrid::Move(uint32_t _id, const AABB& _bounds)
+    {
+        ASSERT(Contains(_id), "Object " << _id << " is not in the grid");
+
+        glm::ivec3 cell = CalcCell((_bounds.m_min + _bounds.m_max) * 0.5f);
+        Object& object = m_objects[_id];
+        object.m_bounds = _bounds;
+        Grow(_bounds, cell);
+        uint64_t cellKey = CalcCellKey(cell);
+        if ( cellKey != object.m_cellKey )
+        {
+            RemoveFromBucket(_id);
+            object.m_cellKey = cellKey;
+            AddToBucket(_id);
+        }
+    }
+
+    ///
+    /// \brief Takes all the objects out
+    ///
+    void SpatialHashGrid::Clear()
+    {
+        m_objects.clear();
+        m_buckets.assign(MIN_BUCKETS, std::vector<uint32_t>());
+        m_numObjects = 0;
+        m_maxHalfExtent = 0.0f;
+        m_minCell = glm::ivec3(std::numeric_limits<int>::max());
+        m_maxCell = glm::ivec3(std::numeric_limits<int>::min());
+    }
+
+    ///
+    /// \brief Finds the objects whose bounds overlap _aabb
+    ///
+    /// \param _aabb   - Box to test against
+    /// \param _outIds - Ids of the objects are appended to this
+    ///
+    /// \return Number of objects tested
+    ///
+    size_t SpatialHashGrid::QueryAABB(const AABB& _aabb, std::vector<uint32_t>& _outIds) const
+    {
+        size_t numTested = 0;
+        ForEachCandidate(_aabb, [&](uint32_t _id)
+        {
+            numTested++;
+            if ( Overlaps(m_objects[_id].m_bounds, _aabb) )
+            {
+                _outIds.push_back(_id);
+            }
+        });
+        return numTested;
+    }
+
+    ///
+    /// \brief Finds the objects whose bounds overlap _sphere
+    ///
+    /// \param _sphere - Sphere to test against
+    /// \param _outIds - Ids of the objects are appended to this
+    ///
+    /// \return Number of objects tested
+    ///
+    size_t SpatialHashGrid::QuerySphere(const Sphere& _sphere, std::vector<uint32_t>& _outIds) const
+    {
+        AABB sphereBounds = { _sphere.m_center - _sphere.m_radius, _sphere.m_center + _sphere.m_radius };
+        size_t numTested = 0;
+        ForEachCandidate(sphereBounds, [&](uint32_t _id)
+        {
+            numTested++;
+            if ( Overlaps(m_objects[_id].m_bounds, _sphere) )
+            {
+                _outIds.push_back(_id);
+            }
+        });
+        return numTested;
+    }
+
+    ///
+    /// \brief Finds the objects whose bounds _ray passes through within _maxT, in no particular
+    ///        order.
+    ///
+    ///        Marches the ray through the cells (Amanatides & Woo) over the part of it that
+    ///        passes the occupied cells, and tests the objects of each cell it passes and of
+    ///        the neighbours that objects can stick out of.
+    ///
+    /// \cite Amanatides, J., & Woo, A. (1987). A Fast Voxel Traversal Algorithm for Ray Tracing.
+    ///       Eurographics.
+    ///
+    /// \param _ray    - Ray to test against
+    /// \param _maxT   - Max distance along the ray
+    /// \param _outIds - Ids of the objects are appended to this
+    ///
+    /// \return Number of objects tested
+    ///
+    size_t SpatialHashGrid::QueryRay(const Ray& _ray, float _maxT, std::vector<uint32_t>& _outIds) const
+    {
+        if ( m_numObjects == 0 )
+        {
+            return 0;
+        }
+
+        glm::vec3 invDir = 1.0f / _ray.m_dir;
+        size_t numTested = 0;
+        auto testObject = [&](uint32_t _id)
+        {
+            numTested++;
+            float tNear = 0.0f;
+            if ( BVH::RayHitsAABB(m_objects[_id].m_bounds, _ray.m_origin, invDir, _maxT, tNear) )
+            {
+                _outIds.push_back(_id);
+            }
+        };
+
+        // Clip the ray to the occupied cells, grown by as far as the objects can stick out
+        AABB occupied = { glm::vec3(m_minCell) * m_cellSize - m_maxHalfExtent, glm::vec3(m_maxCell + glm::ivec3(1)) * m_cellSize + m_maxHalfExtent };
+        glm::vec3 t0 = (occupied.m_min - _ray.m_origin) * invDir;
+        glm::vec3 t1 = (occupied.m_max - _ray.m_origin) * invDir;
+        glm::vec3 tMin = glm::min(t0, t1);
+        glm::vec3 tMax = glm::max(t0, t1);
+        float tEnter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+        float tExit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, _maxT));
+        if ( !(tEnter <= tExit) )
+        {
+            return 0;
+        }
+
+        // At least the direct neighbours, in case rounding puts the march a cell off
+        int radius = std::max(1, static_cast<int>(std::ceil(m_maxHalfExtent * m_invCellSize)));
+        glm::ivec3 cell = CalcCell(_ray.m_origin + _ray.m_dir * tEnter);
+        glm::ivec3 endCell = CalcCell(_ray.m_origin + _ray.m_dir * tExit);
+        size_t numSteps = 1;
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            numSteps += static_cast<size_t>(std::abs(endCell[axis] - cell[axis]));
+        }
+        size_t cellsPerStep = static_cast<size_t>((2 * radius + 1) * (2 * radius + 1) * (2 * radius + 1));
+        if ( numSteps * cellsPerStep > m_numObjects )
+        {
+            for ( uint32_t id = 0; id < m_objects.size(); id++ )
+            {
+                if ( m_objects[id].m_inserted )
+                {
+                    testObject(id);
+                }
+            }
+            return numTested;
+        }
+
+        glm::ivec3 step;
+        glm::vec3 tNext;
+        glm::vec3 tDelta;
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            float inf = std::numeric_limits<float>::infinity();
+            step[axis] = _ray.m_dir[axis] > 0.0f ? 1 : (_ray.m_dir[axis] < 0.0f ? -1 : 0);
+            float boundary = static_cast<float>(cell[axis] + (step[axis] > 0 ? 1 : 0)) * m_cellSize;
+            tNext[axis] = step[axis] != 0 ? (boundary - _ray.m_origin[axis]) * invDir[axis] : inf;
+            tDelta[axis] = step[axis] != 0 ? m_cellSize * std::abs(invDir[axis]) : inf;
+        }
+
+        // Gather the cells to look in first, since neighbouring steps share most of them
+        std::vector<uint64_t> cellKeys;
+        auto addNeighbourhood = [&](const glm::ivec3& _cell)
+        {
+            glm::ivec3 first = glm::max(_cell - glm::ivec3(radius), m_minCell);
+            glm::ivec3 last = glm::min(_cell + glm::ivec3(radius), m_maxCell);
+            for ( int z = first.z; z <= last.z; z++ )
+            {
+                for ( int y = first.y; y <= last.y; y++ )
+                {
+                    for ( int x = first.x; x <= last.x; x++ )
+                    {
+                        cellKeys.push_back(CalcCellKey(glm::ivec3(x, y, z)));
+                    }
+                }
+            }
+        };
+        for ( size_t i = 0; i < numSteps && cell != endCell; i++ )
+        {
+            addNeighbourhood(cell);
+            int axis = tNext.x < tNext.y ? (tNext.x < tNext.z ? 0 : 2) : (tNext.y < tNext.z ? 1 : 2);
+            cell[axis] += step[axis];
+            tNext[axis] += tDelta[axis];
+        }
+        addNeighbourhood(endCell);
+
+        std::sort(cellKeys.begin(), cellKeys.end());
+        cellKeys.erase(std::unique(cellKeys.begin(), cellKeys.end()), cellKeys.end());
+        for ( uint64_t cellKey : cellKeys )
+        {
+            ForEachInCell(cellKey, testObject);
+        }
+
+        return numTested;
+    }
+
+    ///
+    /// \brief Finds every pair of objects whose bounds overlap, e.g. as the broad phase of
+    ///        collision detection between moving instances
+    ///
+    /// \param _outPairs - Each overlapping pair is appended to this once, smaller id first
+    ///
+    /// \return Number of pairs tested
+    ///
+    size_t SpatialHashGrid::FindOverlappingPairs(std::vector<std::pair<uint32_t, uint32_t>>& _outPairs) const
+    {
+        size_t numTested = 0;
+        for ( uint32_t id = 0; id < m_objects.size(); id++ )
+        {
+            const Object& object = m_objects[id];
+            if ( !object.m_inserted )
+            {
+                continue;
+            }
+
+            ForEachCandidate(object.m_bounds, [&](uint32_t _otherId)
+            {
+                if ( _otherId > id )
+                {
+                    numTested++;
+                    if ( Overlaps(object.m_bounds, m_objects[_otherId].m_bounds) )
+                    {
+                        _outPairs.emplace_back(id, _otherId);
+                    }
+                }
+            });
+        }
+        return numTested;
+    }
+
+    ///
+    /// \brief Finds the cell holding _pos. Clamps in float space to the cells CalcCellKey() can
+    ///        pack before converting to int, so huge or infinite query regions don't overflow
+    ///        the conversion. Objects beyond that range share the outermost cells, which keeps
+    ///        the queries right, if slow.
+    ///
+    /// \param _pos - Position to find the cell of
+    ///
+    /// \return Cell coordinates, each within +-2^20
+    ///
+    glm::ivec3 SpatialHashGrid::CalcCell(const glm::vec3& _pos) const
+    {
+        glm::vec3 cell = glm::floor(_pos * m_invCellSize);
+        cell = glm::clamp(cell, static_cast<float>(-CELL_KEY_OFFSET), static_cast<float>(CELL_KEY_OFFSET - 1));
+        return glm::ivec3(cell);
+    }
+
+    ///
+    /// \brief Packs the coordinates of _cell into one integer, to hash and to compare cells by
+    ///
+    /// \param _cell - Cell coordinates, each within +-2^20
+    ///
+    /// \return Key of the cell
+    ///
+    uint64_t SpatialHashGrid::CalcCellKey(const glm::ivec3& _cell)
+    {
+        uint64_t key = 0;
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            ASSERT(_cell[axis] >= -CELL_KEY_OFFSET && _cell[axis] < CELL_KEY_OFFSET, "Cell " << _cell[axis] << " is too far from the origin. Use bigger cells.");
+            key = (key << CELL_KEY_BITS) | static_cast<uint64_t>(_cell[axis] + CELL_KEY_OFFSET);
+        }
+        return key;
+    }
+
+    ///
+    /// \brief Hashes a cell key to a bucket with Fibonacci hashing
+    ///
+    /// \param _cellKey - Key of the cell
+    ///
+    /// \return Index of the bucket in m_buckets
+    ///
+    size_t SpatialHashGrid::CalcBucket(uint64_t _cellKey) const
+    {
+        return static_cast<size_t>((_cellKey * 0x9E3779B97F4A7C15ull) >> 32) & (m_buckets.size() - 1);
+    }
+
+    ///
+    /// \brief Widens m_maxHalfExtent and the occupied cell range to cover _bounds. They never
+    ///        shrink until Clear(), which keeps the queries right at the cost of looking in
+    ///        more cells than needed after big objects go away.
+    ///
+    /// \param _bounds - Bounds of an object being inserted or moved
+    /// \param _cell   - Cell holding the center of _bounds
+    ///
+    void SpatialHashGrid::Grow(const AABB& _bounds, const glm::ivec3& _cell)
+    {
+        glm::vec3 halfExtents = (_bounds.m_max - _bounds.m_min) * 0.5f;
+        m_maxHalfExtent = std::max(m_maxHalfExtent, std::max(halfExtents.x, std::max(halfExtents.y, halfExtents.z)));
+        m_minCell = glm::min(m_minCell, _cell);
+        m_maxCell = glm::max(m_maxCell, _cell);
+    }
+
+    ///
+    /// \brief Appends _id to the bucket of its cell, and records where in the bucket it went
+    ///
+    /// \param _id - Id of an object whose m_cellKey is set
+    ///
+    void SpatialHashGrid::AddToBucket(uint32_t _id)
+    {
+        Object& object = m_objects[_id];
+        std::vector<uint32_t>& bucket = m_buckets[CalcBucket(object.m_cellKey)];
+        object.m_slot = static_cast<uint32_t>(bucket.size());
+        bucket.push_back(_id);
+    }
+
+    ///
+    /// \brief Takes _id out of its bucket by moving the bucket's last id into its slot
+    ///
+    /// \param _id - Id of an object in the grid
+    ///
+    void SpatialHashGrid::RemoveFromBucket(uint32_t _id)
+    {
+        const Object& object = m_objects[_id];
+        std::vector<uint32_t>& bucket = m_buckets[CalcBucket(object.m_cellKey)];
+        uint32_t lastId = bucket.back();
+        bucket[object.m_slot] = lastId;
+        m_objects[lastId].m_slot = object.m_slot;
+        bucket.pop_back();
+    }
+
+    ///
+    /// \brief Redistributes the objects over _numBuckets buckets
+    ///
+    /// \param _numBuckets - New number of buckets. A power of 2.
+    ///
+    void SpatialHashGrid::Rehash(size_t _numBuckets)
+    {
+        m_buckets.assign(_numBuckets, std::vector<uint32_t>());
+        for ( uint32_t id = 0; id < m_objects.size(); id++ )
+        {
+            if ( m_objects[id].m_inserted )
+            {
+                AddToBucket(id);
+            }
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef SPATIALHASHGRID_H
+#define SPATIALHASHGRID_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "AABB.h"
+#include "Ray.h"
+#include "Sphere.h"
+
+namespace blithe
+{
+    ///
+    /// \brief Loose uniform grid over object bounds, stored as a spatial hash, for objects that
+    ///        move every frame.
+    ///
+    ///        Each object goes in the one cell holding the center of its bounds, so Insert(),
+    ///        Remove() and Move() are O(1), and Move() doesn't touch the cells at all while the
+    ///        center stays in its cell. Only occupied cells take memory, since the cells are
+    ///        hashed into buckets.
+    ///
+    ///        Objects can stick out of their cell by up to the largest half extent inserted so
+    ///        far, so queries look that far into the neighbouring cells. Any object size works,
+    ///        but a cell size of about twice the typical object size keeps it to the direct
+    ///        neighbours. Queries over regions with more cells than objects just test every
+    ///        object.
+    ///
+    ///        Unlike a BVH there is nothing to refit or rebuild when the objects move, at the
+    ///        cost of slower queries over big or sparse regions.
+    ///
+    class SpatialHashGrid
+    {
+    public:
+        explicit SpatialHashGrid(float _cellSize);
+
+        void Insert(uint32_t _id, const AABB& _bounds);
+        void Remove(uint32_t _id);
+        void Move(uint32_t _id, const AABB& _bounds);
+        void Clear();
+
+        bool Contains(uint32_t _id) const { return _id < m_objects.size() && m_objects[_id].m_inserted; }
+        const AABB& GetBounds(uint32_t _id) const { return m_objects[_id].m_bounds; }
+        size_t GetNumObjects() const { return m_numObjects; }
+        float GetCellSize() const { return m_cellSize; }
+
+        size_t QueryAABB(const AABB& _aabb, std::vector<uint32_t>& _outIds) const;
+        size_t QuerySphere(const Sphere& _sphere, std::vector<uint32_t>& _outIds) const;
+        size_t QueryRay(const Ray& _ray, float _maxT, std::vector<uint32_t>& _outIds) const;
+        size_t FindOverlappingPairs(std::vector<std::pair<uint32_t, uint32_t>>& _outPairs) const;
+
+    private:
+        struct Object
+        {
+            AABB m_bounds;            //!< Bounds of the object
+            uint64_t m_cellKey = 0;   //!< Key of the cell holding the center of m_bounds. See CalcCellKey().
+            uint32_t m_slot = 0;      //!< Index of the object in its bucket
+            bool m_inserted = false;  //!< Whether the id is in the grid
+        };
+
+        glm::ivec3 CalcCell(const glm::vec3& _pos) const;
+        static uint64_t CalcCellKey(const glm::ivec3& _cell);
+        size_t CalcBucket(uint64_t _cellKey) const;
+        void Grow(const AABB& _bounds, const glm::ivec3& _cell);
+        void AddToBucket(uint32_t _id);
+        void RemoveFromBucket(uint32_t _id);
+        void Rehash(size_t _numBuckets);
+
+        template<typename Func>
+        void ForEachInCell(uint64_t _cellKey, Func&& _func) const;
+        template<typename Func>
+        void ForEachCandidate(const AABB& _region, Func&& _func) const;
+
+        float m_cellSize;                             //!< Width of the cells
+        float m_invCellSize;                          //!< 1 / m_cellSize
+        std::vector<Object> m_objects;                //!< Objects, indexed by id
+        std::vector<std::vector<uint32_t>> m_buckets; //!< Ids of the objects in the cells hashed to each bucket. A power of 2 of them.
+        size_t m_numObjects = 0;                      //!< Number of ids in the grid
+        float m_maxHalfExtent = 0.0f;                 //!< Largest half extent of any object since the last Clear()
+        glm::ivec3 m_minCell;                         //!< Lowest cell of any object since the last Clear(), per axis
+        glm::ivec3 m_maxCell;                         //!< Highest cell of any object since the last Clear(), per axis
+    };
+}
+
+#endif // SPATIALHASHGRID_H
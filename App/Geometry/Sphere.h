@@ -0,0 +1,18 @@
+#ifndef SPHERE_H
+#define SPHERE_H
+
+#include <glm/glm.hpp>
+
+namespace blithe
+{
+    ///
+    /// \brief Sphere defined by its center and radius
+    ///
+    struct Sphere
+    {
+        glm::vec3 m_center; //!< Center of the sphere
+        float m_radius;     //!< Radius of the sphere
+    };
+}
+
+#endif // SPHERE_H
@@ -1,5 +1,6 @@
 #include "TriBSPTree.h"
 #include "BlitheAssert.h"
+#include "MeshSoAView.h"
 #include <vector>
 
 #define MIN_F_VAL 1e-5f
@@ -97,6 +98,51 @@ namespace blithe
         }
     }
 
+    ///
+    /// \brief Inserts the _triIdx'th triangle of _mesh into this BSP Tree, like
+    ///        AddTriangle(const Tri&), but only reading the triangle's positions while it
+    ///        lies wholly in front of or behind the node planes on its way down.
+    ///
+    ///        The whole triangle is only gathered from the attribute arrays once it reaches the
+    ///        node it's stored in or a node whose plane it spans, which AddTriangle(const Tri&)
+    ///        then takes over from. The tree ends up the same as adding _mesh.GetTriangle(_triIdx).
+    ///
+    /// \param _mesh   - View of the mesh holding the triangle
+    /// \param _triIdx - Index of the triangle in _mesh
+    ///
+    void TriBSPTree::AddTriangle(const MeshSoAView& _mesh, size_t _triIdx)
+    {
+        glm::vec3 p0, p1, p2;
+        _mesh.GetTrianglePositions(_triIdx, p0, p1, p2);
+
+        // AddTriToFront() and AddTriToBack() drop tiny triangles rather than recursing
+        float area = 0.5f * glm::length(glm::cross(p1 - p0, p2 - p0));
+
+        TriBSPTree* node = this;
+        while ( !node->m_coplanarTris.empty() )
+        {
+            enTriSide side = ClassifyTriangle(p0, p1, p2, node->m_plane);
+            if ( side == enTriSide::COPLANAR || side == enTriSide::SPANNING )
+            {
+                break;
+            }
+
+            if ( area <= 1e-3f )
+            {
+                return;
+            }
+
+            TriBSPTree*& child = (side == enTriSide::BACK) ? node->m_backTree : node->m_frontTree;
+            if ( !child )
+            {
+                child = new TriBSPTree();
+            }
+            node = child;
+        }
+
+        node->AddTriangle(_mesh.GetTriangle(_triIdx));
+    }
+
     ///
     /// \brief Traverses the BSP tree starting at _root such that triangles in the output _outTris
     ///        are priority listed from farthest to closest w.r.t. _cameraPos.
@@ -267,6 +313,41 @@ namespace blithe
         CountTotalNumTris(_root->m_frontTree, _outNumTris);
     }
 
+    ///
+    /// \brief Classifies the triangle with corners _p0, _p1 and _p2 against _plane, the same way
+    ///        SplitTriangle() does before splitting.
+    ///
+    /// \param _p0    - Position of the first vertex
+    /// \param _p1    - Position of the second vertex
+    /// \param _p2    - Position of the third vertex
+    /// \param _plane - Plane to classify against
+    ///
+    /// \return Side of _plane the triangle is on
+    ///
+    TriBSPTree::enTriSide TriBSPTree::ClassifyTriangle(const glm::vec3& _p0,
+                                                       const glm::vec3& _p1,
+                                                       const glm::vec3& _p2,
+                                                       const Plane* _plane)
+    {
+        float fa = CalcImplicitFunc(_p0, _plane, MIN_F_VAL);
+        float fb = CalcImplicitFunc(_p1, _plane, MIN_F_VAL);
+        float fc = CalcImplicitFunc(_p2, _plane, MIN_F_VAL);
+
+        if ( fa == 0.0f && fb == 0.0f && fc == 0.0f )
+        {
+            return enTriSide::COPLANAR;
+        }
+        else if ( fa <= 0.0f && fb <= 0.0f && fc <= 0.0f )
+        {
+            return enTriSide::BACK;
+        }
+        else if ( fa >= 0.0f && fb >= 0.0f && fc >= 0.0f )
+        {
+            return enTriSide::FRONT;
+        }
+        return enTriSide::SPANNING;
+    }
+
     ///
     /// \brief Splits the given triangle _tri using the plane _splitter.
     ///
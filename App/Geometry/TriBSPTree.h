@@ -8,6 +8,7 @@
 
 namespace blithe
 {
+    class MeshSoAView;
     class TriBSPTree;
 
     //! Entry in stack for data recursion
@@ -25,6 +26,7 @@ namespace blithe
         ~TriBSPTree();
 
         void AddTriangle(const Tri& _tri);
+        void AddTriangle(const MeshSoAView& _mesh, size_t _triIdx);
         static void TraverseRecursively(TriBSPTree* _root,
                                         const glm::vec3& _cameraPos,
                                         std::vector<std::vector<Tri>>& _outTris);
@@ -52,6 +54,21 @@ namespace blithe
             std::vector<Tri> m_coplanarBackTris; //!< Coplanar tris but with normal backwards
         };
 
+        ///
+        /// \brief Where a triangle lies w.r.t. a node's plane
+        ///
+        enum class enTriSide
+        {
+            COPLANAR, //!< All vertices on the plane
+            FRONT,    //!< No vertex behind the plane
+            BACK,     //!< No vertex in front of the plane
+            SPANNING, //!< Vertices on both sides, so the triangle needs splitting
+        };
+
+        static enTriSide ClassifyTriangle(const glm::vec3& _p0,
+                                          const glm::vec3& _p1,
+                                          const glm::vec3& _p2,
+                                          const Plane* _plane);
         static void SplitTriangle(const Tri& _tri, const Plane* _splitter, SplitResult& _res);
         void AddTriToFront(const Tri& _tri);
         void AddTriToBack(const Tri& _tri);
@@ -0,0 +1,325 @@
+#include "TriangleBVH.h"
+#include <tracy/Tracy.hpp>
+#include "BlitheAssert.h"
+#include "BlitheSIMD.h"
+#include "Mesh.h"
+
+namespace blithe
+{
+    constexpr size_t TriangleBVH::MAX_LEAF_SIZE;
+
+    namespace
+    {
+        const size_t SIMD_WIDTH = 8; // Triangle arrays are padded by this, so a leaf can be loaded whole by any of the paths
+    }
+
+    ///
+    /// \brief Builds the BVH over the triangles of _mesh and copies them out in leaf order
+    ///
+    /// \param _mesh - Mesh whose triangles are to be picked. Indices must be triples.
+    ///
+    void TriangleBVH::Build(const Mesh& _mesh)
+    {
+        ZoneScoped;
+
+        ASSERT(_mesh.m_indices.size() % 3 == 0, "Indices must be a flattened list of triples describing faces. Got Num Indices = " << _mesh.m_indices.size());
+
+        size_t numTris = _mesh.m_indices.size() / 3;
+        std::vector<AABB> triBounds(numTris);
+        for ( size_t tri = 0; tri < numTris; tri++ )
+        {
+            const glm::vec3& p0 = _mesh.m_vertices[_mesh.m_indices[tri * 3]].m_pos;
+            const glm::vec3& p1 = _mesh.m_vertices[_mesh.m_indices[tri * 3 + 1]].m_pos;
+            const glm::vec3& p2 = _mesh.m_vertices[_mesh.m_indices[tri * 3 + 2]].m_pos;
+            triBounds[tri] = { glm::min(p0, glm::min(p1, p2)), glm::max(p0, glm::max(p1, p2)) };
+        }
+        m_bvh.Build(triBounds, MAX_LEAF_SIZE);
+
+        // Padding triangles are degenerate, which the test never hits
+        size_t paddedSize = numTris + SIMD_WIDTH;
+        std::vector<float>* arrays[] = { &m_v0X, &m_v0Y, &m_v0Z, &m_e1X, &m_e1Y, &m_e1Z, &m_e2X, &m_e2Y, &m_e2Z };
+        for ( std::vector<float>* array : arrays )
+        {
+            array->assign(paddedSize, 0.0f);
+        }
+
+        const std::vector<uint32_t>& leafOrder = m_bvh.GetPrimIndices();
+        for ( size_t entry = 0; entry < numTris; entry++ )
+        {
+            size_t tri = leafOrder[entry];
+            const glm::vec3& p0 = _mesh.m_vertices[_mesh.m_indices[tri * 3]].m_pos;
+            glm::vec3 e1 = _mesh.m_vertices[_mesh.m_indices[tri * 3 + 1]].m_pos - p0;
+            glm::vec3 e2 = _mesh.m_vertices[_mesh.m_indices[tri * 3 + 2]].m_pos - p0;
+            m_v0X[entry] = p0.x;
+            m_v0Y[entry] = p0.y;
+            m_v0Z[entry] = p0.z;
+            m_e1X[entry] = e1.x;
+            m_e1Y[entry] = e1.y;
+            m_e1Z[entry] = e1.z;
+            m_e2X[entry] = e2.x;
+            m_e2Y[entry] = e2.y;
+            m_e2Z[entry] = e2.z;
+        }
+    }
+
+    ///
+    /// \brief Finds the closest triangle _ray hits
+    ///
+    /// \param _ray  - Ray in the mesh's local space. The direction needn't be normalized.
+    /// \param _maxT - Max distance along the ray, in units of the ray's direction
+    ///
+    /// \return Optional Hit if the ray hits a triangle between 0 and _maxT
+    ///
+    tl::optional<TriangleBVH::Hit> TriangleBVH::IntersectRay(const Ray& _ray, float _maxT) const
+    {
+        tl::optional<Hit> result;
+
+        uint32_t closestEntry = 0;
+        glm::vec2 closestUV(0.0f);
+        float closestT = _maxT;
+        m_bvh.IntersectRayLeaves(_ray, closestT, [&](uint32_t _first, uint32_t _count, float _leafMaxT)
+        {
+            return IntersectLeaf(_ray, _first, _count, _leafMaxT, closestEntry, closestUV);
+        });
+
+        if ( closestT < _maxT )
+        {
+            Hit hit;
+            hit.m_triIdx = m_bvh.GetPrimIndices()[closestEntry];
+            hit.m_t = closestT;
+            hit.m_barycentrics = glm::vec3(1.0f - closestUV.x - closestUV.y, closestUV.x, closestUV.y);
+            result = hit;
+        }
+
+        return result;
+    }
+
+    ///
+    /// \brief Finds the closest triangles the rays of a packet hit, walking the BVH once for the
+    ///        whole packet
+    ///
+    /// \param _packet  - Rays in the mesh's local space. The directions needn't be normalized.
+    /// \param _ioMaxT  - RayPacket::SIZE floats with the max distance along each ray, in units
+    ///                   of the ray's direction. Lowered to the distance to each hit.
+    /// \param _outHits - RayPacket::SIZE hits. Set for the rays that hit a triangle before
+    ///                   their _ioMaxT, and left alone for the others.
+    ///
+    /// \return Mask of the rays that hit a triangle
+    ///
+    uint32_t TriangleBVH::IntersectRayPacket(const RayPacket& _packet, float* _ioMaxT, Hit* _outHits) const
+    {
+        uint32_t closestEntries[RayPacket::SIZE] = {};
+        glm::vec2 closestUVs[RayPacket::SIZE];
+        uint32_t hitMask = 0;
+        m_bvh.IntersectRayPacket(_packet, _ioMaxT, [&](uint32_t _first, uint32_t _count, uint32_t _mask)
+        {
+            for ( uint32_t lane = 0; _mask != 0; lane++, _mask >>= 1 )
+            {
+                if ( !(_mask & 1) )
+                {
+                    continue;
+                }
+                float t = IntersectLeaf(_packet.m_rays[lane], _first, _count, _ioMaxT[lane], closestEntries[lane], closestUVs[lane]);
+                if ( t < _ioMaxT[lane] )
+                {
+                    _ioMaxT[lane] = t;
+                    hitMask |= 1u << lane;
+                }
+            }
+        });
+
+        for ( uint32_t lane = 0, bits = hitMask; bits != 0; lane++, bits >>= 1 )
+        {
+            if ( bits & 1 )
+            {
+                const glm::vec2& uv = closestUVs[lane];
+                _outHits[lane].m_triIdx = m_bvh.GetPrimIndices()[closestEntries[lane]];
+                _outHits[lane].m_t = _ioMaxT[lane];
+                _outHits[lane].m_barycentrics = glm::vec3(1.0f - uv.x - uv.y, uv.x, uv.y);
+            }
+        }
+
+        return hitMask;
+    }
+
+    ///
+    /// \brief Möller–Trumbore test of _ray against the triangles of a leaf
+    ///
+    /// \param _ray     - Ray in the mesh's local space
+    /// \param _first   - Entry of the leaf's first triangle
+    /// \param _count   - Number of triangles in the leaf
+    /// \param _maxT    - Distance to the closest hit so far
+    /// \param _ioEntry - Set to the entry of the hit triangle, if one is closer than _maxT
+    /// \param _ioUV    - Set to the barycentrics of v1 and v2 at the hit, if one is closer than _maxT
+    ///
+    /// \return Distance to the closest hit in the leaf, or _maxT if none is closer
+    ///
+    float TriangleBVH::IntersectLeaf(const Ray& _ray, uint32_t _first, uint32_t _count, float _maxT, uint32_t& _ioEntry, glm::vec2& _ioUV) const
+    {
+        float closestT = _maxT;
+
+#if defined(BLITHE_SIMD_AVX2)
+        const __m256 dirX = _mm256_set1_ps(_ray.m_dir.x);
+        const __m256 dirY = _mm256_set1_ps(_ray.m_dir.y);
+        const __m256 dirZ = _mm256_set1_ps(_ray.m_dir.z);
+        const __m256 orgX = _mm256_set1_ps(_ray.m_origin.x);
+        const __m256 orgY = _mm256_set1_ps(_ray.m_origin.y);
+        const __m256 orgZ = _mm256_set1_ps(_ray.m_origin.z);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 laneIndices = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+
+        for ( uint32_t i = _first; i < _first + _count; i += 8 )
+        {
+            __m256 e1x = _mm256_loadu_ps(&m_e1X[i]);
+            __m256 e1y = _mm256_loadu_ps(&m_e1Y[i]);
+            __m256 e1z = _mm256_loadu_ps(&m_e1Z[i]);
+            __m256 e2x = _mm256_loadu_ps(&m_e2X[i]);
+            __m256 e2y = _mm256_loadu_ps(&m_e2Y[i]);
+            __m256 e2z = _mm256_loadu_ps(&m_e2Z[i]);
+
+            // p = dir x e2, det = e1 . p
+            __m256 px = _mm256_sub_ps(_mm256_mul_ps(dirY, e2z), _mm256_mul_ps(dirZ, e2y));
+            __m256 py = _mm256_sub_ps(_mm256_mul_ps(dirZ, e2x), _mm256_mul_ps(dirX, e2z));
+            __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dirX, e2y), _mm256_mul_ps(dirY, e2x));
+            __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+            __m256 invDet = _mm256_div_ps(one, det);
+
+            // s = origin - v0, u = (s . p) / det
+            __m256 sx = _mm256_sub_ps(orgX, _mm256_loadu_ps(&m_v0X[i]));
+            __m256 sy = _mm256_sub_ps(orgY, _mm256_loadu_ps(&m_v0Y[i]));
+            __m256 sz = _mm256_sub_ps(orgZ, _mm256_loadu_ps(&m_v0Z[i]));
+            __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), invDet);
+
+            // q = s x e1, v = (dir . q) / det, t = (e2 . q) / det
+            __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+            __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+            __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+            __m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dirX, qx), _mm256_mul_ps(dirY, qy)), _mm256_mul_ps(dirZ, qz)), invDet);
+            __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), invDet);
+
+            // Degenerate triangles have det = 0, which makes u NaN and fails every compare
+            __m256 hits = _mm256_cmp_ps(laneIndices, _mm256_set1_ps(static_cast<float>(_first + _count - i)), _CMP_LT_OQ);
+            hits = _mm256_and_ps(hits, _mm256_cmp_ps(det, zero, _CMP_NEQ_OQ));
+            hits = _mm256_and_ps(hits, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+            hits = _mm256_and_ps(hits, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+            hits = _mm256_and_ps(hits, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+            hits = _mm256_and_ps(hits, _mm256_cmp_ps(t, zero, _CMP_GE_OQ));
+            hits = _mm256_and_ps(hits, _mm256_cmp_ps(t, _mm256_set1_ps(closestT), _CMP_LT_OQ));
+            int mask = _mm256_movemask_ps(hits);
+            if ( mask == 0 )
+            {
+                continue;
+            }
+
+            float ts[8], us[8], vs[8];
+            _mm256_storeu_ps(ts, t);
+            _mm256_storeu_ps(us, u);
+            _mm256_storeu_ps(vs, v);
+            for ( int lane = 0; mask != 0; lane++, mask >>= 1 )
+            {
+                if ( (mask & 1) && ts[lane] < closestT )
+                {
+                    closestT = ts[lane];
+                    _ioEntry = i + static_cast<uint32_t>(lane);
+                    _ioUV = glm::vec2(us[lane], vs[lane]);
+                }
+            }
+        }
+#elif defined(BLITHE_SIMD_SSE2)
+        const __m128 dirX = _mm_set1_ps(_ray.m_dir.x);
+        const __m128 dirY = _mm_set1_ps(_ray.m_dir.y);
+        const __m128 dirZ = _mm_set1_ps(_ray.m_dir.z);
+        const __m128 orgX = _mm_set1_ps(_ray.m_origin.x);
+        const __m128 orgY = _mm_set1_ps(_ray.m_origin.y);
+        const __m128 orgZ = _mm_set1_ps(_ray.m_origin.z);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 laneIndices = _mm_setr_ps(0, 1, 2, 3);
+
+        for ( uint32_t i = _first; i < _first + _count; i += 4 )
+        {
+            __m128 e1x = _mm_loadu_ps(&m_e1X[i]);
+            __m128 e1y = _mm_loadu_ps(&m_e1Y[i]);
+            __m128 e1z = _mm_loadu_ps(&m_e1Z[i]);
+            __m128 e2x = _mm_loadu_ps(&m_e2X[i]);
+            __m128 e2y = _mm_loadu_ps(&m_e2Y[i]);
+            __m128 e2z = _mm_loadu_ps(&m_e2Z[i]);
+
+            // p = dir x e2, det = e1 . p
+            __m128 px = _mm_sub_ps(_mm_mul_ps(dirY, e2z), _mm_mul_ps(dirZ, e2y));
+            __m128 py = _mm_sub_ps(_mm_mul_ps(dirZ, e2x), _mm_mul_ps(dirX, e2z));
+            __m128 pz = _mm_sub_ps(_mm_mul_ps(dirX, e2y), _mm_mul_ps(dirY, e2x));
+            __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+            __m128 invDet = _mm_div_ps(one, det);
+
+            // s = origin - v0, u = (s . p) / det
+            __m128 sx = _mm_sub_ps(orgX, _mm_loadu_ps(&m_v0X[i]));
+            __m128 sy = _mm_sub_ps(orgY, _mm_loadu_ps(&m_v0Y[i]));
+            __m128 sz = _mm_sub_ps(orgZ, _mm_loadu_ps(&m_v0Z[i]));
+            __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+
+            // q = s x e1, v = (dir . q) / det, t = (e2 . q) / det
+            __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+            __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+            __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+            __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dirX, qx), _mm_mul_ps(dirY, qy)), _mm_mul_ps(dirZ, qz)), invDet);
+            __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+            // Degenerate triangles have det = 0, which makes u NaN and fails every compare
+            __m128 hits = _mm_cmplt_ps(laneIndices, _mm_set1_ps(static_cast<float>(_first + _count - i)));
+            hits = _mm_and_ps(hits, _mm_cmpneq_ps(det, zero));
+            hits = _mm_and_ps(hits, _mm_cmpge_ps(u, zero));
+            hits = _mm_and_ps(hits, _mm_cmpge_ps(v, zero));
+            hits = _mm_and_ps(hits, _mm_cmple_ps(_mm_add_ps(u, v), one));
+            hits = _mm_and_ps(hits, _mm_cmpge_ps(t, zero));
+            hits = _mm_and_ps(hits, _mm_cmplt_ps(t, _mm_set1_ps(closestT)));
+            int mask = _mm_movemask_ps(hits);
+            if ( mask == 0 )
+            {
+                continue;
+            }
+
+            float ts[4], us[4], vs[4];
+            _mm_storeu_ps(ts, t);
+            _mm_storeu_ps(us, u);
+            _mm_storeu_ps(vs, v);
+            for ( int lane = 0; mask != 0; lane++, mask >>= 1 )
+            {
+                if ( (mask & 1) && ts[lane] < closestT )
+                {
+                    closestT = ts[lane];
+                    _ioEntry = i + static_cast<uint32_t>(lane);
+                    _ioUV = glm::vec2(us[lane], vs[lane]);
+                }
+            }
+        }
+#else
+        for ( uint32_t i = _first; i < _first + _count; i++ )
+        {
+            glm::vec3 e1(m_e1X[i], m_e1Y[i], m_e1Z[i]);
+            glm::vec3 e2(m_e2X[i], m_e2Y[i], m_e2Z[i]);
+            glm::vec3 p = glm::cross(_ray.m_dir, e2);
+            float det = glm::dot(e1, p);
+            if ( det == 0.0f )
+            {
+                continue;
+            }
+            float invDet = 1.0f / det;
+            glm::vec3 s = _ray.m_origin - glm::vec3(m_v0X[i], m_v0Y[i], m_v0Z[i]);
+            float u = glm::dot(s, p) * invDet;
+            glm::vec3 q = glm::cross(s, e1);
+            float v = glm::dot(_ray.m_dir, q) * invDet;
+            float t = glm::dot(e2, q) * invDet;
+            if ( u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t < closestT )
+            {
+                closestT = t;
+                _ioEntry = i;
+                _ioUV = glm::vec2(u, v);
+            }
+        }
+#endif
+
+        return closestT;
+    }
+}
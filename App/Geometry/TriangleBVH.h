@@ -0,0 +1,67 @@
+#ifndef TRIANGLEBVH_H
+#define TRIANGLEBVH_H
+
+#include <optional.hpp>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+#include "BVH.h"
+#include "Ray.h"
+#include "RayPacket.h"
+
+namespace blithe
+{
+    struct Mesh;
+
+    ///
+    /// \brief BVH over the triangles of a mesh, in the mesh's local space, for finding exactly
+    ///        where a ray hits the mesh.
+    ///
+    ///        The triangles are copied out in the BVH's leaf order as structure-of-arrays (a
+    ///        corner and two edges each), so the triangles of a leaf are tested against the ray
+    ///        8 (AVX2) or 4 (SSE2) at a time with the Möller–Trumbore test. Leaves hold up to
+    ///        MAX_LEAF_SIZE triangles to fill those registers.
+    ///
+    ///        Both sides of the triangles are hit. Build it again if the mesh changes.
+    ///
+    class TriangleBVH
+    {
+    public:
+        static constexpr size_t MAX_LEAF_SIZE = 8; //!< Max triangles per leaf
+
+        ///
+        /// \brief Closest triangle a ray hit
+        ///
+        struct Hit
+        {
+            uint32_t m_triIdx;         //!< Index of the triangle in the mesh
+            float m_t;                 //!< Distance along the ray, in units of the ray's direction
+            glm::vec3 m_barycentrics;  //!< Weights of the triangle's corners at the hit point
+        };
+
+        void Build(const Mesh& _mesh);
+
+        tl::optional<Hit> IntersectRay(const Ray& _ray, float _maxT = std::numeric_limits<float>::max()) const;
+        uint32_t IntersectRayPacket(const RayPacket& _packet, float* _ioMaxT, Hit* _outHits) const;
+
+        size_t GetNumTriangles() const { return m_bvh.GetPrimIndices().size(); }
+        const BVH& GetBVH() const { return m_bvh; }
+
+    private:
+        float IntersectLeaf(const Ray& _ray, uint32_t _first, uint32_t _count, float _maxT, uint32_t& _ioEntry, glm::vec2& _ioUV) const;
+
+        BVH m_bvh;                 //!< BVH over the triangle bounds
+        std::vector<float> m_v0X;  //!< X of each triangle's first corner, in leaf order, padded by 8
+        std::vector<float> m_v0Y;  //!< Y of each triangle's first corner, in leaf order, padded by 8
+        std::vector<float> m_v0Z;  //!< Z of each triangle's first corner, in leaf order, padded by 8
+        std::vector<float> m_e1X;  //!< X of each triangle's first edge (v1 - v0), in leaf order, padded by 8
+        std::vector<float> m_e1Y;  //!< Y of each triangle's first edge (v1 - v0), in leaf order, padded by 8
+        std::vector<float> m_e1Z;  //!< Z of each triangle's first edge (v1 - v0), in leaf order, padded by 8
+        std::vector<float> m_e2X;  //!< X of each triangle's second edge (v2 - v0), in leaf order, padded by 8
+        std::vector<float> m_e2Y;  //!< Y of each triangle's second edge (v2 - v0), in leaf order, padded by 8
+        std::vector<float> m_e2Z;  //!< Z of each triangle's second edge (v2 - v0), in leaf order, padded by 8
+    };
+}
+
+#endif // TRIANGLEBVH_H
@@ -3,6 +3,7 @@
 #include "BlitheAssert.h"
 #include "IGLBufferCache.h"
 #include "Mesh.h"
+#include "VertexPacker.h"
 
 namespace blithe
 {
@@ -33,17 +34,20 @@ namespace blithe
                                                       m_mesh->m_vertices.data(),
                                                       m_mesh->m_vertices.size() * sizeof(Vertex));
 
+        GLenum indexType = GL_UNSIGNED_INT;
         GLuint ebo = m_glBufferCache->GetIndexBuffer(m_name,
-                                                     m_mesh->m_indices);
+                                                     m_mesh->m_indices,
+                                                     m_mesh->m_vertices.size(),
+                                                     indexType);
 
         GLuint vao = m_glBufferCache->GetVertexArray(m_name,
                                                      vbo,
                                                      ebo,
-                                                     m_format_xyz_rgba_uv);
+                                                     VertexPacker::GetXyzRgbaUvFormat());
 
         glBindVertexArray(vao);
         GLsizei numIndices = static_cast<GLsizei>(m_mesh->m_indices.size());
-        glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, reinterpret_cast<void*>(0));
+        glDrawElements(GL_TRIANGLES, numIndices, indexType, reinterpret_cast<void*>(0));
         glBindVertexArray(0);
     }
 }
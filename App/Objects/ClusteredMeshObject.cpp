@@ -0,0 +1,183 @@
+#include "ClusteredMeshObject.h"
+#include <cstdint>
+#include <tracy/Tracy.hpp>
+#include "BlitheAssert.h"
+#include "Frustum.h"
+#include "IndexPacker.h"
+#include "MeshOptimizer.h"
+#include "OcclusionBuffer.h"
+#include "VertexPacker.h"
+
+namespace blithe
+{
+    /*!
+     * \brief Constructor. Optimizes the triangle order of _mesh so its meshlets come out
+     *        compact, splits it into meshlets and creates the VAO, VBO and EBO for it.
+     *
+     * \param _mesh - The mesh geometry
+     */
+    ClusteredMeshObject::ClusteredMeshObject(const Mesh& _mesh) :
+        m_vao(0),
+        m_vbo(0),
+        m_ebo(0),
+        m_indexType(GL_UNSIGNED_INT),
+        m_numFrustumCulled(0),
+        m_numBackFaceCulled(0),
+        m_numOccluded(0),
+        m_numTrisDrawn(0),
+        m_mesh(_mesh)
+    {
+        ASSERT(!m_mesh.m_indices.empty(), "Can't cluster an empty mesh");
+
+        MeshOptimizer::OptimizeVertexCache(m_mesh);
+        MeshOptimizer::OptimizeVertexFetch(m_mesh);
+        m_meshlets = MeshletBuilder::Build(m_mesh);
+
+        SetupMesh();
+
+        // Draw everything until the first Cull()
+        m_drawCounts.push_back(static_cast<GLsizei>(m_mesh.m_indices.size()));
+        m_drawOffsets.push_back(nullptr);
+        m_numTrisDrawn = GetNumTris();
+    }
+
+    /*!
+     * \brief Destructor
+     */
+    ClusteredMeshObject::~ClusteredMeshObject()
+    {
+        CleanUp();
+    }
+
+    ///
+    /// \brief Picks the meshlets to draw. Culling happens in model space, with the frustum
+    ///        extracted from the model-view-projection matrix and the camera moved into model
+    ///        space, so the meshlet bounds never need transforming. The back-face test assumes
+    ///        _model has no non-uniform scale.
+    ///
+    ///        Meshlets that pass both are then tested against _occlusion, which is the most
+    ///        expensive test, since it projects the meshlet's box.
+    ///
+    ///        Consecutive visible meshlets are merged into a single draw range.
+    ///
+    /// \param _model          - Model matrix of the mesh
+    /// \param _viewProjection - View-projection matrix of the camera
+    /// \param _cameraPos      - World position of the camera
+    /// \param _frustumCull    - Whether to cull meshlets outside the frustum
+    /// \param _backFaceCull   - Whether to cull meshlets that entirely face away from the camera
+    /// \param _occlusion      - Rasterized occluders to cull hidden meshlets against, if any.
+    ///                          It must have been rasterized for _viewProjection.
+    ///
+    void ClusteredMeshObject::Cull(const glm::mat4& _model, const glm::mat4& _viewProjection, const glm::vec3& _cameraPos,
+                                   bool _frustumCull, bool _backFaceCull, const OcclusionBuffer* _occlusion)
+    {
+        ZoneScoped;
+
+        Frustum frustum = Frustum::FromMatrix(_viewProjection * _model);
+        glm::vec3 cameraPos = glm::vec3(glm::inverse(_model) * glm::vec4(_cameraPos, 1.0f));
+        size_t indexSize = IndexPacker::GetIndexSize(m_indexType);
+
+        m_drawCounts.clear();
+        m_drawOffsets.clear();
+        m_numFrustumCulled = 0;
+        m_numBackFaceCulled = 0;
+        m_numOccluded = 0;
+        m_numTrisDrawn = 0;
+
+        size_t runEnd = SIZE_MAX; // End index of the last draw range, to extend it if the next meshlet is adjacent
+        for ( const Meshlet& meshlet : m_meshlets )
+        {
+            if ( _frustumCull && !frustum.Intersects(meshlet.m_bounds) )
+            {
+                m_numFrustumCulled++;
+                continue;
+            }
+            if ( _backFaceCull && MeshletBuilder::IsBackFacing(meshlet, cameraPos) )
+            {
+                m_numBackFaceCulled++;
+                continue;
+            }
+            if ( _occlusion && _occlusion->IsOccluded(meshlet.m_aabb, _model) )
+            {
+                m_numOccluded++;
+                continue;
+            }
+
+            if ( meshlet.m_firstIndex == runEnd )
+            {
+                m_drawCounts.back() += static_cast<GLsizei>(meshlet.m_numIndices);
+            }
+            else
+            {
+                m_drawCounts.push_back(static_cast<GLsizei>(meshlet.m_numIndices));
+                m_drawOffsets.push_back(reinterpret_cast<const void*>(meshlet.m_firstIndex * indexSize));
+            }
+            runEnd = meshlet.m_firstIndex + meshlet.m_numIndices;
+            m_numTrisDrawn += meshlet.m_numIndices / 3;
+        }
+    }
+
+    /*!
+     * \brief Draws the meshlets picked by the last Cull().
+     */
+    void ClusteredMeshObject::Render()
+    {
+        if ( m_drawCounts.empty() )
+        {
+            return;
+        }
+
+        glBindVertexArray(m_vao);
+        glMultiDrawElements(GL_TRIANGLES,
+                            m_drawCounts.data(),
+                            m_indexType,
+                            m_drawOffsets.data(),
+                            static_cast<GLsizei>(m_drawCounts.size()));
+        glBindVertexArray(0);
+    }
+
+    /*!
+     * \brief Creates the VAO, VBO and EBO. The indices are packed to 16 bits when the mesh is
+     *        small enough, but never split, since the meshlet draw ranges share one base vertex.
+     */
+    void ClusteredMeshObject::SetupMesh()
+    {
+        const VBOVertexFormat& format = VertexPacker::GetXyzRgbaUvFormat();
+        PackedIndices packedIndices = IndexPacker::Pack(m_mesh.m_indices, m_mesh.m_vertices.size(), false);
+        m_indexType = packedIndices.m_type;
+
+        glGenVertexArrays(1, &m_vao);
+        glBindVertexArray(m_vao);
+
+        glGenBuffers(1, &m_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_mesh.m_vertices.size() * sizeof(Vertex)), m_mesh.m_vertices.data(), GL_STATIC_DRAW);
+
+        glGenBuffers(1, &m_ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(packedIndices.m_data.size()), packedIndices.m_data.data(), GL_STATIC_DRAW);
+
+        for (const auto& attr : format.m_attributes)
+        {
+            glEnableVertexAttribArray(attr.m_index);
+            glVertexAttribPointer(attr.m_index,
+                                  attr.m_size,
+                                  attr.m_type,
+                                  attr.m_normalized,
+                                  static_cast<GLsizei>(format.m_stride),
+                                  reinterpret_cast<void*>(attr.m_offset));
+        }
+
+        glBindVertexArray(0);
+    }
+
+    /*!
+     * \brief Deletes the VAO, VBO and EBO.
+     */
+    void ClusteredMeshObject::CleanUp()
+    {
+        glDeleteVertexArrays(1, &m_vao);
+        glDeleteBuffers(1, &m_vbo);
+        glDeleteBuffers(1, &m_ebo);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef CLUSTEREDMESHOBJECT_H
+#define CLUSTEREDMESHOBJECT_H
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "Mesh.h"
+#include "MeshletBuilder.h"
+
+namespace blithe
+{
+    class OcclusionBuffer;
+
+    /*!
+     * \brief Renderable triangle mesh split into meshlets (see MeshletBuilder), so that the
+     *        parts of it that are off screen or facing away can be skipped. Cull() picks the
+     *        visible meshlets on the CPU and Render() draws them with one multi-draw.
+     */
+    class ClusteredMeshObject
+    {
+    public:
+        explicit ClusteredMeshObject(const Mesh& _mesh);
+        ~ClusteredMeshObject();
+
+        ClusteredMeshObject(const ClusteredMeshObject&) = delete;
+        ClusteredMeshObject& operator=(const ClusteredMeshObject&) = delete;
+
+        void Cull(const glm::mat4& _model, const glm::mat4& _viewProjection, const glm::vec3& _cameraPos,
+                  bool _frustumCull, bool _backFaceCull, const OcclusionBuffer* _occlusion = nullptr);
+
+        void Render();
+
+        size_t GetNumMeshlets() const { return m_meshlets.size(); }
+        size_t GetNumFrustumCulled() const { return m_numFrustumCulled; }
+        size_t GetNumBackFaceCulled() const { return m_numBackFaceCulled; }
+        size_t GetNumOccluded() const { return m_numOccluded; }
+        size_t GetNumTrisDrawn() const { return m_numTrisDrawn; }
+        size_t GetNumTris() const { return m_mesh.m_indices.size() / 3; }
+
+        const Mesh& GetMesh() const { return m_mesh; }
+
+    private:
+        void SetupMesh();
+        void CleanUp();
+
+        unsigned int m_vao;                     //!< ID of Vertex Array Object holding the vertex layout
+        unsigned int m_vbo;                     //!< ID of Vertex Buffer Object holding the vertex data
+        unsigned int m_ebo;                     //!< ID of Element Buffer Object holding the mesh layout
+        GLenum m_indexType;                     //!< Type of the indices in m_ebo
+        std::vector<Meshlet> m_meshlets;        //!< Meshlets, in index order
+        std::vector<GLsizei> m_drawCounts;      //!< Index counts of the runs of visible meshlets
+        std::vector<const void*> m_drawOffsets; //!< Byte offsets of the runs of visible meshlets in m_ebo
+        size_t m_numFrustumCulled;              //!< Meshlets culled by the last Cull() for being outside the frustum
+        size_t m_numBackFaceCulled;             //!< Meshlets culled by the last Cull() for facing away
+        size_t m_numOccluded;                   //!< Meshlets culled by the last Cull() for being hidden behind occluders
+        size_t m_numTrisDrawn;                  //!< Triangles in the meshlets that survived the last Cull()
+        Mesh m_mesh;                            //!< The mesh geometry, in meshlet order
+    };
+}
+
+#endif // CLUSTEREDMESHOBJECT_H
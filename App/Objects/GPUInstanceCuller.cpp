@@ -0,0 +1,262 @@
+#include "GPUInstanceCuller.h"
+#include <algorithm>
+#include <cstddef>
+#include <tracy/Tracy.hpp>
+#include "BlitheAssert.h"
+#include "IndexPacker.h"
+#include "InstanceEncoding.h"
+#include "MeshObject.h"
+#include "ShaderProgram.h"
+
+namespace blithe
+{
+    /*!
+     * \brief Constructor. Loads the compute shaders and creates the buffers. Check
+     *        IsSupported() first.
+     *
+     * \param _shaderDir - Directory holding HiZCull.comp and HiZBuild.comp
+     */
+    GPUInstanceCuller::GPUInstanceCuller(const std::string& _shaderDir)
+    {
+        ASSERT(IsSupported(), "GPU instance culling needs OpenGL 4.3");
+
+        m_cullShader = new ShaderProgram(_shaderDir + "/HiZCull.comp");
+        m_hiZShader = new ShaderProgram(_shaderDir + "/HiZBuild.comp");
+        glGenBuffers(1, &m_instanceBuffer);
+        glGenBuffers(1, &m_indirectBuffer);
+    }
+
+    /*!
+     * \brief Destructor
+     */
+    GPUInstanceCuller::~GPUInstanceCuller()
+    {
+        delete m_cullShader;
+        delete m_hiZShader;
+        glDeleteBuffers(1, &m_instanceBuffer);
+        glDeleteBuffers(1, &m_indirectBuffer);
+        if ( m_hiZTexture != 0 )
+        {
+            glDeleteTextures(1, &m_hiZTexture);
+        }
+    }
+
+    ///
+    /// \brief Whether the current context can run the culling, i.e. has OpenGL 4.3.
+    ///
+    bool GPUInstanceCuller::IsSupported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    ///
+    /// \brief Uploads the instances to cull. The buffer only grows, geometrically, so this is
+    ///        cheap enough to call when the instance count changes.
+    ///
+    /// \param _localBounds - Bounding box of the instanced mesh, in its local space
+    /// \param _transforms  - Instance transforms
+    ///
+    void GPUInstanceCuller::SetInstances(const AABB& _localBounds, const std::vector<glm::mat4>& _transforms)
+    {
+        m_localBounds = _localBounds;
+        m_numInstances = _transforms.size();
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+        if ( m_numInstances > m_instanceCapacity )
+        {
+            m_instanceCapacity = std::max(m_numInstances, m_instanceCapacity * 2);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(m_instanceCapacity * sizeof(glm::mat4)), nullptr, GL_DYNAMIC_DRAW);
+        }
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(m_numInstances * sizeof(glm::mat4)), _transforms.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    ///
+    /// \brief Overwrites the _count instances starting at _firstInstance.
+    ///
+    /// \param _firstInstance - Index of the first instance to overwrite
+    /// \param _transforms    - Pointer to _count transforms
+    /// \param _count         - Number of instances to overwrite. They must all exist already.
+    ///
+    void GPUInstanceCuller::UpdateInstances(size_t _firstInstance, const glm::mat4* _transforms, size_t _count)
+    {
+        ASSERT(_firstInstance + _count <= m_numInstances, "Can only update existing instances, but got " << _firstInstance + _count << " of " << m_numInstances);
+
+        if ( _count == 0 )
+        {
+            return;
+        }
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                        static_cast<GLintptr>(_firstInstance * sizeof(glm::mat4)),
+                        static_cast<GLsizeiptr>(_count * sizeof(glm::mat4)),
+                        _transforms);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    ///
+    /// \brief Writes the instances that pass the frustum test and, if _useHiZ is set and a
+    ///        pyramid has been built, the Hi-Z test, into the instance buffer of _mesh, and
+    ///        their count into GetIndirectBuffer(). Draw them with
+    ///        _mesh.RenderIndirect(GetIndirectBuffer()).
+    ///
+    /// \param _viewProjection - View-projection matrix of the camera
+    /// \param _mesh           - Mesh whose instances these are. Its instances must be plain,
+    ///                          unquantized mat4s, and it must have room for all of them (e.g.
+    ///                          from SetInstances() with all the transforms).
+    /// \param _useHiZ         - Whether to cull against the pyramid, or only the frustum
+    ///
+    void GPUInstanceCuller::Cull(const glm::mat4& _viewProjection, MeshObject& _mesh, bool _useHiZ)
+    {
+        ZoneScoped;
+
+        ASSERT(_mesh.GetInstanceEncoding() == enInstanceEncoding::MAT4 && !_mesh.GetPositionsQuantized(),
+               "GPU culling writes plain mat4 instances");
+        ASSERT(_mesh.GetNumInstances() >= m_numInstances, "The mesh has room for " << _mesh.GetNumInstances() << " instances, but " << m_numInstances << " are being culled");
+
+        ReadBackNumVisible();
+
+        // One command per index range, with no instances until the shader adds them
+        const std::vector<IndexRange>& indexRanges = _mesh.GetIndexRanges();
+        m_commands.resize(indexRanges.size());
+        for ( size_t rangeIdx = 0; rangeIdx < indexRanges.size(); rangeIdx++ )
+        {
+            const IndexRange& range = indexRanges[rangeIdx];
+            m_commands[rangeIdx] = { static_cast<GLuint>(range.m_count), 0, static_cast<GLuint>(range.m_firstIndex), range.m_baseVertex, 0 };
+        }
+        m_numCommands = m_commands.size();
+
+        // The buffer is only reallocated when a mesh with more ranges comes along, otherwise the
+        // commands are rewritten in place
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+        if ( m_numCommands > m_commandCapacity )
+        {
+            m_commandCapacity = m_numCommands;
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, static_cast<GLsizeiptr>(m_commandCapacity * sizeof(DrawElementsIndirectCommand)), nullptr, GL_DYNAMIC_DRAW);
+        }
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, static_cast<GLsizeiptr>(m_numCommands * sizeof(DrawElementsIndirectCommand)), m_commands.data());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        if ( m_numInstances == 0 )
+        {
+            m_numVisible = 0;
+            return;
+        }
+
+        m_cullShader->Bind();
+        m_cullShader->SetUniformMat4f("viewProjection", _viewProjection);
+        m_cullShader->SetUniformVec3f("boundsMin", m_localBounds.m_min);
+        m_cullShader->SetUniformVec3f("boundsMax", m_localBounds.m_max);
+        m_cullShader->SetUniform1i("numInstances", static_cast<int>(m_numInstances));
+        m_cullShader->SetUniform1i("numCommands", static_cast<int>(m_numCommands));
+        m_cullShader->SetUniformBool("useHiZ", _useHiZ && m_hiZValid);
+        m_cullShader->SetUniform1i("hiZ", 0);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_hiZTexture);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_instanceBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _mesh.GetInstanceBuffer());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_indirectBuffer);
+
+        glDispatchCompute(static_cast<GLuint>((m_numInstances + 63) / 64), 1, 1);
+
+        // The draw reads the count as a command and the transforms as vertex attributes
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        m_cullShader->Unbind();
+
+        m_pendingReadBack = true;
+    }
+
+    ///
+    /// \brief Builds the max-depth pyramid from a depth buffer, for the next Cull(). Level 0 is
+    ///        a copy of the depth buffer and every level after it halves the size, keeping the
+    ///        farthest depth of each 2x2 block (3 wide at the odd edges, so nothing is dropped).
+    ///
+    /// \param _depthTexture - Depth texture the frame was rendered with
+    /// \param _width        - Width of _depthTexture
+    /// \param _height       - Height of _depthTexture
+    ///
+    void GPUInstanceCuller::BuildHiZ(GLuint _depthTexture, int _width, int _height)
+    {
+        ZoneScoped;
+
+        if ( _depthTexture == 0 || _width <= 0 || _height <= 0 )
+        {
+            m_hiZValid = false;
+            return;
+        }
+
+        glm::ivec2 size(_width, _height);
+        if ( size != m_hiZSize )
+        {
+            if ( m_hiZTexture != 0 )
+            {
+                glDeleteTextures(1, &m_hiZTexture);
+            }
+
+            m_hiZSize = size;
+            m_numHiZLevels = 1;
+            while ( (std::max(_width, _height) >> m_numHiZLevels) > 0 )
+            {
+                m_numHiZLevels++;
+            }
+
+            glGenTextures(1, &m_hiZTexture);
+            glBindTexture(GL_TEXTURE_2D, m_hiZTexture);
+            glTexStorage2D(GL_TEXTURE_2D, m_numHiZLevels, GL_R32F, _width, _height);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+        m_hiZShader->Bind();
+        m_hiZShader->SetUniform1i("src", 0);
+        glActiveTexture(GL_TEXTURE0);
+        for ( int level = 0; level < m_numHiZLevels; level++ )
+        {
+            // Level 0 reads the depth buffer, the others the level before them
+            glBindTexture(GL_TEXTURE_2D, level == 0 ? _depthTexture : m_hiZTexture);
+            m_hiZShader->SetUniform1i("srcLevel", std::max(level - 1, 0));
+            m_hiZShader->SetUniformBool("copyDepth", level == 0);
+            glBindImageTexture(0, m_hiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+            glm::ivec2 levelSize = glm::max(m_hiZSize >> level, glm::ivec2(1));
+            glDispatchCompute(static_cast<GLuint>((levelSize.x + 7) / 8), static_cast<GLuint>((levelSize.y + 7) / 8), 1);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+        glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        m_hiZShader->Unbind();
+
+        m_hiZValid = true;
+    }
+
+    ///
+    /// \brief Reads the visible count of the last Cull() back from the indirect buffer. It's
+    ///        done at the start of the next Cull(), a frame later, so the GPU has usually
+    ///        finished by then and it doesn't stall.
+    ///
+    void GPUInstanceCuller::ReadBackNumVisible()
+    {
+        if ( !m_pendingReadBack )
+        {
+            return;
+        }
+
+        GLuint numVisible = 0;
+        glBindBuffer(GL_COPY_READ_BUFFER, m_indirectBuffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, offsetof(DrawElementsIndirectCommand, m_instanceCount), sizeof(GLuint), &numVisible);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+        m_numVisible = numVisible;
+        m_pendingReadBack = false;
+    }
+}
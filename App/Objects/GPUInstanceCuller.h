@@ -0,0 +1,78 @@
+#ifndef GPUINSTANCECULLER_H
+#define GPUINSTANCECULLER_H
+
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "AABB.h"
+#include "DrawElementsIndirectCommand.h"
+
+namespace blithe
+{
+    class MeshObject;
+    class ShaderProgram;
+
+    /*!
+     * \brief Culls the instances of a MeshObject on the GPU, against the frustum and against a
+     *        hierarchical depth (Hi-Z) pyramid built from the previous frame's depth buffer.
+     *
+     *        Cull() runs a compute shader over all the instances that writes the visible ones,
+     *        packed, into the mesh's instance buffer and counts them in an indirect draw
+     *        command, so MeshObject::RenderIndirect() draws them without the CPU ever seeing the
+     *        count. BuildHiZ() then reduces the frame's depth buffer to a max-depth mip chain for
+     *        the next Cull(). A box is occluded if its nearest depth is behind the farthest depth
+     *        of the 2x2 pyramid texels that cover it.
+     *
+     *        Testing against the previous frame's depth means instances that come out from
+     *        behind an occluder can show up a frame late while the camera moves.
+     *
+     *        Needs OpenGL 4.3 for compute and storage buffers (see IsSupported()), which Mesa's
+     *        llvmpipe provides too.
+     */
+    class GPUInstanceCuller
+    {
+    public:
+        explicit GPUInstanceCuller(const std::string& _shaderDir);
+        ~GPUInstanceCuller();
+
+        GPUInstanceCuller(const GPUInstanceCuller&) = delete;
+        GPUInstanceCuller& operator=(const GPUInstanceCuller&) = delete;
+
+        static bool IsSupported();
+
+        void SetInstances(const AABB& _localBounds, const std::vector<glm::mat4>& _transforms);
+        void UpdateInstances(size_t _firstInstance, const glm::mat4* _transforms, size_t _count);
+
+        void Cull(const glm::mat4& _viewProjection, MeshObject& _mesh, bool _useHiZ);
+        void BuildHiZ(GLuint _depthTexture, int _width, int _height);
+
+        unsigned int GetIndirectBuffer() const { return m_indirectBuffer; }
+        size_t GetNumInstances() const { return m_numInstances; }
+        size_t GetNumVisible() const { return m_numVisible; }
+
+    private:
+        void ReadBackNumVisible();
+
+        ShaderProgram* m_cullShader = nullptr; //!< Compute shader that tests the instances and packs the visible ones
+        ShaderProgram* m_hiZShader = nullptr;  //!< Compute shader that builds a level of the pyramid
+        GLuint m_instanceBuffer = 0;           //!< Storage buffer with all the instance transforms
+        GLuint m_indirectBuffer = 0;           //!< One DrawElementsIndirectCommand per index range of the culled mesh
+        GLuint m_hiZTexture = 0;               //!< R32F max-depth pyramid
+        glm::ivec2 m_hiZSize = glm::ivec2(0);  //!< Size of level 0 of m_hiZTexture
+        int m_numHiZLevels = 0;                //!< Number of levels in m_hiZTexture
+        bool m_hiZValid = false;               //!< Whether m_hiZTexture holds a depth buffer yet
+        AABB m_localBounds;                    //!< Bounding box of the instanced mesh
+        size_t m_numInstances = 0;             //!< Number of instances in m_instanceBuffer
+        size_t m_instanceCapacity = 0;         //!< Number of instances m_instanceBuffer has room for
+        size_t m_numCommands = 0;              //!< Number of commands in m_indirectBuffer
+        size_t m_commandCapacity = 0;          //!< Number of commands m_indirectBuffer has room for
+        size_t m_numVisible = 0;               //!< Instances that passed the previous Cull()
+        bool m_pendingReadBack = false;        //!< Whether a Cull() has run whose count hasn't been read back
+
+        //! Scratch commands reused by Cull() so we don't hit the heap every frame
+        std::vector<DrawElementsIndirectCommand> m_commands;
+    };
+}
+
+#endif // GPUINSTANCECULLER_H
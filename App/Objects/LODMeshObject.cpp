@@ -0,0 +1,191 @@
+#include "LODMeshObject.h"
+#include <algorithm>
+#include <cmath>
+#include <tracy/Tracy.hpp>
+#include "BlitheAssert.h"
+#include "MeshView.h"
+#include "MeshObject.h"
+
+namespace blithe
+{
+    /*!
+     * \brief Constructor. Takes ownership of the _lods.
+     *
+     * \param _lods      - MeshObjects of the LODs, finest first
+     * \param _lodErrors - Error bound of each LOD in mesh units (see MeshLOD::m_error). Must
+     *                     not decrease.
+     */
+    LODMeshObject::LODMeshObject(const std::vector<MeshObject*>& _lods, const std::vector<float>& _lodErrors) :
+        m_lods(_lods),
+        m_lodErrors(_lodErrors),
+        m_lodNumTris(_lods.size()),
+        m_lodNumInstances(_lods.size(), 0),
+        m_lodBuckets(_lods.size()),
+        m_boundsCenter(0.0f),
+        m_boundsRadius(0.0f)
+    {
+        ASSERT(!m_lods.empty(), "Must provide at least one LOD");
+        ASSERT(m_lods.size() == m_lodErrors.size(), "Got " << m_lods.size() << " LODs but " << m_lodErrors.size() << " LOD errors");
+
+        for ( size_t lod = 0; lod < m_lods.size(); lod++ )
+        {
+            m_lodNumTris[lod] = m_lods[lod]->GetMesh().m_indices.size() / 3;
+        }
+
+        MeshBounds bounds = MeshView(m_lods[0]->GetMesh()).GetBounds();
+        m_bounds = bounds.m_aabb;
+        m_obb = bounds.m_obb;
+        m_boundsCenter = bounds.m_sphere.m_center;
+        m_boundsRadius = bounds.m_sphere.m_radius;
+    }
+
+    /*!
+     * \brief Destructor. Deletes the LODs.
+     */
+    LODMeshObject::~LODMeshObject()
+    {
+        for ( MeshObject* lod : m_lods )
+        {
+            delete lod;
+        }
+    }
+
+    ///
+    /// \brief Sets the instance encoding of all the LODs (see MeshObject::SetInstanceEncoding()).
+    ///
+    /// \param _encoding - Instance encoding
+    ///
+    void LODMeshObject::SetInstanceEncoding(enInstanceEncoding _encoding)
+    {
+        for ( MeshObject* lod : m_lods )
+        {
+            lod->SetInstanceEncoding(_encoding);
+        }
+        std::fill(m_lodNumInstances.begin(), m_lodNumInstances.end(), 0);
+    }
+
+    ///
+    /// \brief Sets the instance transforms. They are all drawn with LOD 0 until SelectLODs() is
+    ///        called.
+    ///
+    /// \param _transforms - Instance transforms
+    ///
+    void LODMeshObject::SetInstances(const std::vector<glm::mat4>& _transforms)
+    {
+        m_culler.SetInstances(m_bounds, _transforms, m_obb);
+        std::fill(m_lodNumInstances.begin(), m_lodNumInstances.end(), 0);
+        if ( !_transforms.empty() )
+        {
+            m_lods[0]->SetInstances(_transforms);
+            m_lodNumInstances[0] = _transforms.size();
+        }
+    }
+
+    ///
+    /// \brief Frustum culls the instances, then picks the coarsest LOD for each visible
+    ///        instance whose error, projected at the nearest point of the instance's bounding
+    ///        sphere, is at most _maxPixelError pixels, and uploads the instances of each LOD.
+    ///        So only the visible instances cost anything past the culling.
+    ///
+    /// \param _viewProjection  - View-projection matrix of the camera
+    /// \param _cameraPos       - World position of the camera
+    /// \param _projectionScale - Pixels per world unit at a distance of 1 (see
+    ///                           CalcProjectionScale())
+    /// \param _maxPixelError   - Max screen-space error in pixels. Below a pixel, switching
+    ///                           LODs doesn't visibly pop.
+    /// \param _cullWithBVH     - Whether to cull with a BVH over the instances (see
+    ///                           InstanceCuller::Cull())
+    ///
+    void LODMeshObject::SelectLODs(const glm::mat4& _viewProjection, const glm::vec3& _cameraPos, float _projectionScale, float _maxPixelError,
+                                   bool _cullWithBVH)
+    {
+        ZoneScoped;
+
+        for ( std::vector<glm::mat4>& bucket : m_lodBuckets )
+        {
+            bucket.clear();
+        }
+
+        for ( const glm::mat4& transform : m_culler.Cull(_viewProjection, _cullWithBVH) )
+        {
+            // Errors scale with the largest axis scale of the instance
+            float scale = std::max(glm::length(glm::vec3(transform[0])),
+                                   std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+            glm::vec3 center = glm::vec3(transform * glm::vec4(m_boundsCenter, 1.0f));
+            float distance = glm::length(center - _cameraPos) - m_boundsRadius * scale;
+
+            size_t chosenLod = 0;
+            if ( distance > 0.0f )
+            {
+                float pixelsPerUnit = scale * _projectionScale / distance;
+                for ( size_t lod = m_lods.size() - 1; lod > 0; lod-- )
+                {
+                    if ( m_lodErrors[lod] * pixelsPerUnit <= _maxPixelError )
+                    {
+                        chosenLod = lod;
+                        break;
+                    }
+                }
+            }
+            m_lodBuckets[chosenLod].push_back(transform);
+        }
+
+        for ( size_t lod = 0; lod < m_lods.size(); lod++ )
+        {
+            m_lodNumInstances[lod] = m_lodBuckets[lod].size();
+            if ( !m_lodBuckets[lod].empty() )
+            {
+                m_lods[lod]->SetInstances(m_lodBuckets[lod]);
+            }
+        }
+    }
+
+    ///
+    /// \brief Draws each LOD that has instances.
+    ///
+    void LODMeshObject::Render()
+    {
+        for ( size_t lod = 0; lod < m_lods.size(); lod++ )
+        {
+            if ( m_lodNumInstances[lod] > 0 )
+            {
+                m_lods[lod]->Render();
+            }
+        }
+    }
+
+    ///
+    /// \brief Gets the number of triangles drawn by Render() with the current LOD selection.
+    ///
+    size_t LODMeshObject::GetNumTrisDrawn() const
+    {
+        size_t numTris = 0;
+        for ( size_t lod = 0; lod < m_lods.size(); lod++ )
+        {
+            numTris += m_lodNumTris[lod] * m_lodNumInstances[lod];
+        }
+        return numTris;
+    }
+
+    ///
+    /// \brief Gets the number of triangles it would take to draw all instances at full detail.
+    ///
+    size_t LODMeshObject::GetNumTrisFullDetail() const
+    {
+        return m_lodNumTris[0] * m_culler.GetNumInstances();
+    }
+
+    ///
+    /// \brief Calculates how many pixels a unit long object spans at a distance of 1 with a
+    ///        perspective projection.
+    ///
+    /// \param _fovYRad        - Vertical field of view in radians
+    /// \param _viewportHeight - Height of the viewport in pixels
+    ///
+    /// \return Pixels per world unit at unit distance
+    ///
+    float LODMeshObject::CalcProjectionScale(float _fovYRad, int _viewportHeight)
+    {
+        return static_cast<float>(_viewportHeight) / (2.0f * std::tan(_fovYRad * 0.5f));
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef LODMESHOBJECT_H
+#define LODMESHOBJECT_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "AABB.h"
+#include "InstanceCuller.h"
+#include "InstanceEncoding.h"
+#include "OBB.h"
+
+namespace blithe
+{
+    class MeshObject;
+
+    /*!
+     * \brief Instanced mesh with several levels of detail (see MeshSimplifier::BuildLODChain()).
+     *        SelectLODs() picks the coarsest LOD per instance whose error, projected onto the
+     *        screen, stays under a pixel threshold, and Render() draws each LOD once with the
+     *        instances that picked it. Instances outside the view frustum aren't drawn at all.
+     */
+    class LODMeshObject
+    {
+    public:
+        LODMeshObject(const std::vector<MeshObject*>& _lods, const std::vector<float>& _lodErrors);
+        ~LODMeshObject();
+
+        LODMeshObject(const LODMeshObject&) = delete;
+        LODMeshObject& operator=(const LODMeshObject&) = delete;
+
+        void SetInstanceEncoding(enInstanceEncoding _encoding);
+        void SetInstances(const std::vector<glm::mat4>& _transforms);
+
+        void SelectLODs(const glm::mat4& _viewProjection, const glm::vec3& _cameraPos, float _projectionScale, float _maxPixelError,
+                        bool _cullWithBVH = false);
+
+        void Render();
+
+        size_t GetNumLODs() const { return m_lods.size(); }
+        size_t GetNumInstances(size_t _lod) const { return m_lodNumInstances[_lod]; }
+        size_t GetNumVisible() const { return m_culler.GetNumVisible(); }
+        size_t GetNumNodesVisited() const { return m_culler.GetNumNodesVisited(); }
+        size_t GetNumTrisDrawn() const;
+        size_t GetNumTrisFullDetail() const;
+
+        static float CalcProjectionScale(float _fovYRad, int _viewportHeight);
+
+    private:
+        std::vector<MeshObject*> m_lods;                  //!< LOD meshes, finest first. Owned.
+        std::vector<float> m_lodErrors;                   //!< Error bound of each LOD, in mesh units
+        std::vector<size_t> m_lodNumTris;                 //!< Number of triangles of each LOD
+        std::vector<size_t> m_lodNumInstances;            //!< Number of instances currently drawn with each LOD
+        std::vector<std::vector<glm::mat4>> m_lodBuckets; //!< Scratch space for sorting the instances into LODs
+        InstanceCuller m_culler;                          //!< Holds the instance transforms and frustum culls them
+        AABB m_bounds;                                    //!< Bounding box of the full detail mesh
+        OBB m_obb;                                        //!< Oriented bounding box of the full detail mesh
+        glm::vec3 m_boundsCenter;                         //!< Center of the bounding sphere of the full detail mesh
+        float m_boundsRadius;                             //!< Radius of the bounding sphere of the full detail mesh
+    };
+}
+
+#endif // LODMESHOBJECT_H
@@ -1,6 +1,8 @@
 #include "MeshObject.h"
 #include "BlitheAssert.h"
+#include "DrawElementsIndirectCommand.h"
 #include <glad/glad.h>
+#include <algorithm>
 
 namespace blithe
 {
@@ -15,9 +17,84 @@ namespace blithe
         m_ebo(0),
         m_ibo(0),
         m_numInstances(0),
+        m_instanceCapacity(0),
+        m_instanceEncoding(enInstanceEncoding::MAT4),
+        m_vertexFormat(VertexPacker::GetXyzRgbaUvFormat()),
+        m_dequantizeTransform(1.0f),
+        m_positionsQuantized(false),
+        m_indexType(GL_UNSIGNED_INT),
         m_mesh(_mesh)
     {
-        SetupMesh();
+        SetupMesh(m_mesh.m_vertices.data(), m_mesh.m_vertices.size() * sizeof(Vertex));
+    }
+
+    /*!
+     * \brief Constructor. Packs the vertices of _mesh according to _packOptions (see
+     *        VertexPacker) and creates the VAO, VBO and EBO for them.
+     *
+     *        If the positions are quantized, the dequantize transform is folded into the
+     *        instance transforms, so the mesh must be rendered with instances.
+     *
+     * \param _mesh        - The mesh geometry
+     * \param _packOptions - How to pack the vertices
+     */
+    MeshObject::MeshObject(const Mesh& _mesh, const VertexPackOptions& _packOptions) :
+        m_vao(0),
+        m_vbo(0),
+        m_ebo(0),
+        m_ibo(0),
+        m_numInstances(0),
+        m_instanceCapacity(0),
+        m_instanceEncoding(enInstanceEncoding::MAT4),
+        m_vertexFormat(VertexPacker::GetXyzRgbaUvFormat()),
+        m_dequantizeTransform(1.0f),
+        m_positionsQuantized(false),
+        m_indexType(GL_UNSIGNED_INT),
+        m_mesh(_mesh)
+    {
+        PackedVertices packed = VertexPacker::Pack(m_mesh, _packOptions);
+        m_vertexFormat = packed.m_format;
+        m_dequantizeTransform = packed.m_dequantizeTransform;
+        m_positionsQuantized = packed.m_positionsQuantized;
+        SetupMesh(packed.m_data.data(), packed.m_data.size());
+    }
+
+    /*!
+     * \brief Constructor. Adopts a VBO and EBO that already hold the uploaded _mesh data
+     *        (e.g. streamed in by a MeshUploadService) and only creates the VAO for them.
+     *        The MeshObject takes ownership of the buffers.
+     *
+     * \param _mesh           - The mesh geometry
+     * \param _vbo            - ID of a buffer holding all the vertices of _mesh
+     * \param _ebo            - ID of a buffer holding all the indices of _mesh
+     * \param _packedVertices - Format of the vertices in _vbo, and their dequantize
+     *                          transform. Its m_data is not used.
+     * \param _packedIndices  - Type and draw ranges of the indices in _ebo. Its m_data is
+     *                          not used.
+     */
+    MeshObject::MeshObject(Mesh&& _mesh, unsigned int _vbo, unsigned int _ebo, const PackedVertices& _packedVertices, const PackedIndices& _packedIndices) :
+        m_vao(0),
+        m_vbo(_vbo),
+        m_ebo(_ebo),
+        m_ibo(0),
+        m_numInstances(0),
+        m_instanceCapacity(0),
+        m_instanceEncoding(enInstanceEncoding::MAT4),
+        m_vertexFormat(_packedVertices.m_format),
+        m_dequantizeTransform(_packedVertices.m_dequantizeTransform),
+        m_positionsQuantized(_packedVertices.m_positionsQuantized),
+        m_indexType(_packedIndices.m_type),
+        m_indexRanges(_packedIndices.m_ranges),
+        m_mesh(std::move(_mesh))
+    {
+        ASSERT(m_vbo != 0 && m_ebo != 0, "Must provide valid buffers to adopt");
+
+        glGenVertexArrays(1, &m_vao);
+        glBindVertexArray(m_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+        SetupVertexAttributes();
+        glBindVertexArray(0);
     }
 
     /*!
@@ -29,8 +106,12 @@ namespace blithe
     }
 
     ///
-    /// \brief Recreates the instance buffer and uploads the matrix _transforms so that the mesh
-    ///        can be rendered with instanced rendering.
+    /// \brief Uploads the matrix _transforms so that the mesh can be rendered with instanced
+    ///        rendering. This replaces any previous instances.
+    ///
+    ///        The instance buffer is kept around between calls and only reallocated (growing
+    ///        geometrically) when it runs out of room, so this is cheap enough to call every frame
+    ///        to animate the instances.
     ///
     /// \param _transforms - Transforms to use for rendering instances of the mesh. Typically these
     ///                      are the model matrices, but generally the vertex shader must know what
@@ -41,47 +122,106 @@ namespace blithe
         ASSERT(m_vao != 0, "The MeshObject needs to have been setup before adding instances");
         ASSERT(_transforms.size() > 0, "Must provide a non-zero number of transforms for instancing.");
 
-        if ( m_ibo != 0 )
+        bool reallocated = ReserveInstances(_transforms.size(), false);
+        m_numInstances = _transforms.size();
+
+        const glm::mat4* transforms = FoldDequantizeTransform(_transforms.data(), _transforms.size());
+        const void* data = transforms;
+        if ( m_instanceEncoding != enInstanceEncoding::MAT4 )
         {
-            ASSERT(m_numInstances == 0, "Instance buffer previously generated even though num transforms was 0.");
-            glDeleteBuffers(1, &m_ibo);
+            m_packedInstances.resize(_transforms.size() * InstancePacker::GetNumAttributes(m_instanceEncoding));
+            InstancePacker::Pack(m_instanceEncoding, transforms, _transforms.size(), m_packedInstances.data());
+            data = m_packedInstances.data();
         }
 
-        m_numInstances = _transforms.size();
+        // Orphan the old storage so the driver can hand us fresh memory rather than stalling
+        // on draws that are still reading it, then write all the instances in one go. A buffer
+        // that was just reallocated is already fresh, so it doesn't need orphaning.
+        size_t stride = InstancePacker::GetStride(m_instanceEncoding);
+        glBindBuffer(GL_ARRAY_BUFFER, m_ibo);
+        if ( !reallocated )
+        {
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_instanceCapacity * stride), nullptr, GL_STREAM_DRAW);
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(m_numInstances * stride), data);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
 
-        // Bind the same vertex array object as we do for the setup and upload of the mesh
-        glBindVertexArray(m_vao);
+    ///
+    /// \brief Overwrites the _count instances starting at _firstInstance, leaving the others
+    ///        untouched. Writing past the last instance appends new instances.
+    ///
+    /// \param _firstInstance - Index of the first instance to overwrite. Must not be more than
+    ///                         the current number of instances.
+    /// \param _transforms    - Pointer to _count transforms
+    /// \param _count         - Number of instances to overwrite
+    ///
+    void MeshObject::UpdateInstances(size_t _firstInstance, const glm::mat4* _transforms, size_t _count)
+    {
+        ASSERT(m_ibo != 0, "SetInstances() must be called before updating instances");
+        ASSERT(_firstInstance <= m_numInstances, "Updated instances would leave a gap after instance " << m_numInstances);
 
-        // Generate a buffer for the instances data and upload the instances data
-        glGenBuffers(1, &m_ibo);
-        glBindBuffer(GL_ARRAY_BUFFER, m_ibo);
-        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(_transforms.size() * sizeof(glm::mat4)), _transforms.data(), GL_STATIC_DRAW);
-
-        // Goal: Set transformation matrices as an instance vertex attribute (with divisor 1)
-        // The instance's matrix will be available in the next available layout location on the
-        // vertex shader (so after the texture coords for our m_format_xyz_rgba_uv format).
-        // We're going to upload the matrix as 4 vec4s. But from I understand, on the shader side we
-        // can just compactly use "out mat4 InstanceMatrix".
-        // (AFAIU, we could use 4 "out vec4 InstanceMatColN" lines consecutively where N=0,1,2,3.
-        // But that's so much typing)
-        const GLuint NumExistingAttrs = m_format_xyz_rgba_uv.m_attributes.size();
-        for (GLuint colIdx = 0; colIdx < 4; colIdx++)
-        {
-            // Upload the columns after the existing vertex attribute layout locations
-            GLuint attrIdx = NumExistingAttrs + colIdx;
-            glEnableVertexAttribArray(attrIdx);
-            glVertexAttribPointer(attrIdx, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(colIdx * sizeof(glm::vec4)));
+        if ( _count == 0 )
+        {
+            return;
         }
 
-        // The divisor of 1 means we only change the attribute per instance, not per vertex
-        for (GLuint colIdx = 0; colIdx < 4; colIdx++)
+        size_t endInstance = _firstInstance + _count;
+        ReserveInstances(endInstance, true);
+        m_numInstances = std::max(m_numInstances, endInstance);
+
+        const glm::mat4* transforms = FoldDequantizeTransform(_transforms, _count);
+        const void* data = transforms;
+        if ( m_instanceEncoding != enInstanceEncoding::MAT4 )
         {
-            GLuint attrIdx = NumExistingAttrs + colIdx;
-            glVertexAttribDivisor(attrIdx, 1);
+            m_packedInstances.resize(_count * InstancePacker::GetNumAttributes(m_instanceEncoding));
+            InstancePacker::Pack(m_instanceEncoding, transforms, _count, m_packedInstances.data());
+            data = m_packedInstances.data();
         }
 
-        glBindVertexArray(0);
+        size_t stride = InstancePacker::GetStride(m_instanceEncoding);
+        glBindBuffer(GL_ARRAY_BUFFER, m_ibo);
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        static_cast<GLintptr>(_firstInstance * stride),
+                        static_cast<GLsizeiptr>(_count * stride),
+                        data);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ///
+    /// \brief Selects how the instance transforms are encoded in the instance buffer. The
+    ///        shader used to render must decode the same encoding (see
+    ///        InstancePacker::GetVertexShaderName()).
+    ///
+    ///        Changing the encoding drops the current instances, so SetInstances() must be called
+    ///        again afterwards.
+    ///
+    /// \param _encoding - Instance encoding
+    ///
+    void MeshObject::SetInstanceEncoding(enInstanceEncoding _encoding)
+    {
+        if ( _encoding == m_instanceEncoding )
+        {
+            return;
+        }
+
+        if ( m_ibo != 0 )
+        {
+            // Turn off the attributes of the old encoding so they don't linger in the VAO
+            glBindVertexArray(m_vao);
+            for (GLuint vecIdx = 0; vecIdx < InstancePacker::GetNumAttributes(m_instanceEncoding); vecIdx++)
+            {
+                glDisableVertexAttribArray(InstancePacker::ATTRIB_LOCATION + vecIdx);
+            }
+            glBindVertexArray(0);
+
+            glDeleteBuffers(1, &m_ibo);
+            m_ibo = 0;
+            m_numInstances = 0;
+            m_instanceCapacity = 0;
+        }
 
+        m_instanceEncoding = _encoding;
     }
 
     /*!
@@ -90,49 +230,206 @@ namespace blithe
      */
     void MeshObject::Render()
     {
+        ASSERT(m_ibo != 0 || !m_positionsQuantized, "Meshes with quantized positions must be rendered with instances");
+
         glBindVertexArray(m_vao);
-        GLsizei numIndices = static_cast<GLsizei>(m_mesh.m_indices.size());
-        if ( m_ibo == 0 )
+        DrawRanges(m_ibo == 0 ? 0 : static_cast<GLsizei>(m_numInstances));
+        glBindVertexArray(0);
+    }
+
+    ///
+    /// \brief Draws the instances with the instance counts held on the GPU, so they can be
+    ///        decided there (see GPUInstanceCuller) without reading them back. Needs GL 4.0.
+    ///
+    /// \param _indirectBuffer - Buffer with one DrawElementsIndirectCommand per index range
+    ///                          (see GetIndexRanges()), in order
+    ///
+    void MeshObject::RenderIndirect(unsigned int _indirectBuffer)
+    {
+        ASSERT(m_ibo != 0, "SetInstances() must be called before rendering indirectly");
+
+        glBindVertexArray(m_vao);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirectBuffer);
+        for ( size_t rangeIdx = 0; rangeIdx < m_indexRanges.size(); rangeIdx++ )
         {
-            glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, reinterpret_cast<void*>(0));
+            const void* offset = reinterpret_cast<const void*>(rangeIdx * sizeof(DrawElementsIndirectCommand));
+            glDrawElementsIndirect(GL_TRIANGLES, m_indexType, offset);
         }
-        else
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    ///
+    /// \brief Issues the draw calls for the index ranges of the bound VAO. A single range
+    ///        without a base vertex uses the plain draw calls, split meshes need the base vertex
+    ///        variants (GL 3.2).
+    ///
+    /// \param _numInstances - Number of instances to draw, or 0 for a non-instanced draw
+    ///
+    void MeshObject::DrawRanges(GLsizei _numInstances)
+    {
+        size_t indexSize = IndexPacker::GetIndexSize(m_indexType);
+        for ( const IndexRange& range : m_indexRanges )
         {
-            glDrawElementsInstanced(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT,
-                                    reinterpret_cast<void*>(0),
-                                    static_cast<GLsizei>(m_numInstances));
+            void* offset = reinterpret_cast<void*>(range.m_firstIndex * indexSize);
+            if ( range.m_baseVertex == 0 )
+            {
+                if ( _numInstances == 0 )
+                {
+                    glDrawElements(GL_TRIANGLES, range.m_count, m_indexType, offset);
+                }
+                else
+                {
+                    glDrawElementsInstanced(GL_TRIANGLES, range.m_count, m_indexType, offset, _numInstances);
+                }
+            }
+            else
+            {
+                if ( _numInstances == 0 )
+                {
+                    glDrawElementsBaseVertex(GL_TRIANGLES, range.m_count, m_indexType, offset, range.m_baseVertex);
+                }
+                else
+                {
+                    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.m_count, m_indexType, offset, _numInstances, range.m_baseVertex);
+                }
+            }
         }
-        glBindVertexArray(0);
     }
 
     /*!
      * \brief Sets up mesh.
+     *
+     * \param _vertexData - Vertex data in m_vertexFormat
+     * \param _numBytes   - Size of _vertexData
      */
-    void MeshObject::SetupMesh()
+    void MeshObject::SetupMesh(const void* _vertexData, size_t _numBytes)
     {
         glGenVertexArrays(1, &m_vao);
         glBindVertexArray(m_vao);
 
         glGenBuffers(1, &m_vbo);
         glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_mesh.m_vertices.size() * sizeof(Vertex)), m_mesh.m_vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(_numBytes), _vertexData, GL_STATIC_DRAW);
+
+        PackedIndices packedIndices = IndexPacker::Pack(m_mesh.m_indices, m_mesh.m_vertices.size());
+        m_indexType = packedIndices.m_type;
+        m_indexRanges = std::move(packedIndices.m_ranges);
 
         glGenBuffers(1, &m_ebo);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_mesh.m_indices.size() * sizeof(unsigned int)), m_mesh.m_indices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(packedIndices.m_data.size()), packedIndices.m_data.data(), GL_STATIC_DRAW);
 
-        for (const auto& attr : m_format_xyz_rgba_uv.m_attributes)
+        SetupVertexAttributes();
+
+        glBindVertexArray(0);
+    }
+
+    /*!
+     * \brief Points the vertex attributes of the bound VAO at the bound VBO.
+     */
+    void MeshObject::SetupVertexAttributes()
+    {
+        for (const auto& attr : m_vertexFormat.m_attributes)
         {
             glEnableVertexAttribArray(attr.m_index);
             glVertexAttribPointer(attr.m_index,
                                   attr.m_size,
                                   attr.m_type,
                                   attr.m_normalized,
-                                  m_format_xyz_rgba_uv.m_stride,
+                                  static_cast<GLsizei>(m_vertexFormat.m_stride),
                                   reinterpret_cast<void*>(attr.m_offset));
         }
+    }
+
+    ///
+    /// \brief Applies the dequantize transform of quantized positions to _transforms.
+    ///
+    /// \param _transforms - Pointer to _count instance transforms
+    /// \param _count      - Number of transforms
+    ///
+    /// \return _transforms if the positions aren't quantized, otherwise the folded transforms in
+    ///         scratch space that is valid until the next call
+    ///
+    const glm::mat4* MeshObject::FoldDequantizeTransform(const glm::mat4* _transforms, size_t _count)
+    {
+        if ( !m_positionsQuantized )
+        {
+            return _transforms;
+        }
+
+        m_foldedInstances.resize(_count);
+        for ( size_t i = 0; i < _count; i++ )
+        {
+            m_foldedInstances[i] = _transforms[i] * m_dequantizeTransform;
+        }
+        return m_foldedInstances.data();
+    }
+
+    ///
+    /// \brief Makes sure the instance buffer can hold _count instances. If it can't, a new
+    ///        buffer of at least double the capacity replaces it and the instance attributes are
+    ///        pointed at the new buffer.
+    ///
+    /// \param _count        - Number of instances the buffer must hold
+    /// \param _keepContents - Whether to copy the current instances over to the new buffer
+    ///
+    /// \return True if a new buffer was allocated, false if the current one was big enough
+    ///
+    bool MeshObject::ReserveInstances(size_t _count, bool _keepContents)
+    {
+        if ( _count <= m_instanceCapacity )
+        {
+            return false;
+        }
+
+        size_t newCapacity = std::max(_count, m_instanceCapacity * 2);
+        size_t stride = InstancePacker::GetStride(m_instanceEncoding);
+        GLuint oldBuffer = m_ibo;
+
+        glGenBuffers(1, &m_ibo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibo);
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(newCapacity * stride), nullptr, GL_STREAM_DRAW);
+        if ( oldBuffer != 0 )
+        {
+            if ( _keepContents && m_numInstances > 0 )
+            {
+                glBindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(m_numInstances * stride));
+                glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            }
+            glDeleteBuffers(1, &oldBuffer);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        m_instanceCapacity = newCapacity;
+
+        // Bind the same vertex array object as we do for the setup and upload of the mesh
+        glBindVertexArray(m_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_ibo);
+
+        // Goal: Set the encoded transforms as instance vertex attributes (with divisor 1)
+        // Every encoding is a run of vec4s starting at the reserved instance attribute location,
+        // which ShaderProgram binds to "InstanceMatrix" (a mat4 takes up 4 consecutive
+        // locations) and to "InstanceData0".."InstanceData3".
+        const GLuint NumInstanceAttrs = InstancePacker::GetNumAttributes(m_instanceEncoding);
+        for (GLuint vecIdx = 0; vecIdx < NumInstanceAttrs; vecIdx++)
+        {
+            GLuint attrIdx = InstancePacker::ATTRIB_LOCATION + vecIdx;
+            glEnableVertexAttribArray(attrIdx);
+            glVertexAttribPointer(attrIdx, 4, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(stride), (void*)(vecIdx * sizeof(glm::vec4)));
+        }
+
+        // The divisor of 1 means we only change the attribute per instance, not per vertex
+        for (GLuint vecIdx = 0; vecIdx < NumInstanceAttrs; vecIdx++)
+        {
+            GLuint attrIdx = InstancePacker::ATTRIB_LOCATION + vecIdx;
+            glVertexAttribDivisor(attrIdx, 1);
+        }
 
         glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return true;
     }
 
     /*!
@@ -148,5 +445,6 @@ namespace blithe
             glDeleteBuffers(1, &m_ibo);
         }
         m_numInstances = 0;
+        m_instanceCapacity = 0;
     }
 }
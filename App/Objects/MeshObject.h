@@ -1,7 +1,10 @@
 #ifndef MESHOBJECT_H
 #define MESHOBJECT_H
 
+#include "IndexPacker.h"
+#include "InstanceEncoding.h"
 #include "VBOVertexFormat.h"
+#include "VertexPacker.h"
 #include "Mesh.h"
 
 namespace blithe
@@ -16,34 +19,50 @@ namespace blithe
     {
     public:
         explicit MeshObject(const Mesh& _mesh);
+        MeshObject(const Mesh& _mesh, const VertexPackOptions& _packOptions);
+        MeshObject(Mesh&& _mesh, unsigned int _vbo, unsigned int _ebo, const PackedVertices& _packedVertices, const PackedIndices& _packedIndices);
         ~MeshObject();
 
         void SetInstances(const std::vector<glm::mat4>& _transforms);
+        void UpdateInstances(size_t _firstInstance, const glm::mat4* _transforms, size_t _count);
+
+        size_t GetNumInstances() const { return m_numInstances; }
+        unsigned int GetInstanceBuffer() const { return m_ibo; }
+        GLenum GetIndexType() const { return m_indexType; }
+        bool GetPositionsQuantized() const { return m_positionsQuantized; }
+        const std::vector<IndexRange>& GetIndexRanges() const { return m_indexRanges; }
+
+        void SetInstanceEncoding(enInstanceEncoding _encoding);
+        enInstanceEncoding GetInstanceEncoding() const { return m_instanceEncoding; }
 
         void Render();
+        void RenderIndirect(unsigned int _indirectBuffer);
 
         const Mesh& GetMesh() const { return m_mesh; }
 
     private:
-        void SetupMesh();
+        void SetupMesh(const void* _vertexData, size_t _numBytes);
+        void DrawRanges(GLsizei _numInstances);
+        void SetupVertexAttributes();
+        const glm::mat4* FoldDequantizeTransform(const glm::mat4* _transforms, size_t _count);
+        bool ReserveInstances(size_t _count, bool _keepContents);
         void CleanUp();
 
-        unsigned int m_vao;    //!< ID of Vertex Array Object holding the vertex layout
-        unsigned int m_vbo;    //!< ID of Vertex Buffer Object holding the vertex data
-        unsigned int m_ebo;    //!< ID of Element Buffer Object holding the mesh layout
-        unsigned int m_ibo;    //!< ID of Vertex Buffer Object holding any instances data
-        size_t m_numInstances; //!< Number of instances, equal to the number of transforms given for instancing
-        Mesh m_mesh;           //!< The mesh geometry
-
-        ///
-        /// \brief Vertex format for the Mesh data
-        ///
-        VBOVertexFormat m_format_xyz_rgba_uv = {
-            { {0, 3, GL_FLOAT, GL_FALSE, 0},                   // position
-              {1, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 3},   // color
-              {2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 7} }, // texture coords
-            sizeof(float) * 9
-        };
+        unsigned int m_vao;                       //!< ID of Vertex Array Object holding the vertex layout
+        unsigned int m_vbo;                       //!< ID of Vertex Buffer Object holding the vertex data
+        unsigned int m_ebo;                       //!< ID of Element Buffer Object holding the mesh layout
+        unsigned int m_ibo;                       //!< ID of Vertex Buffer Object holding any instances data
+        size_t m_numInstances;                    //!< Number of instances, equal to the number of transforms given for instancing
+        size_t m_instanceCapacity;                //!< Number of instances m_ibo has room for
+        enInstanceEncoding m_instanceEncoding;    //!< How the instance transforms are laid out in m_ibo
+        std::vector<glm::vec4> m_packedInstances; //!< Scratch space for encoding the instance transforms
+        std::vector<glm::mat4> m_foldedInstances; //!< Scratch space for the instance transforms with m_dequantizeTransform applied
+        VBOVertexFormat m_vertexFormat;           //!< Vertex format of the data in m_vbo
+        glm::mat4 m_dequantizeTransform;          //!< Maps quantized positions back to the mesh's space
+        bool m_positionsQuantized;                //!< Whether the positions in m_vbo are quantized
+        GLenum m_indexType;                       //!< Type of the indices in m_ebo (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT)
+        std::vector<IndexRange> m_indexRanges;    //!< Ranges of m_ebo to draw, each with its own base vertex
+        Mesh m_mesh;                              //!< The mesh geometry
     };
 }
 
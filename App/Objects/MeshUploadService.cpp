@@ -0,0 +1,238 @@
+#include "MeshUploadService.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <glad/glad.h>
+#include <tracy/Tracy.hpp>
+#include "BlitheAssert.h"
+#include "MeshObject.h"
+#include "ThreadPool.h"
+
+namespace blithe
+{
+    ///
+    /// \brief Destructor. Deletes the MeshObject if the caller never took it.
+    ///
+    MeshUploadService::Ticket::~Ticket()
+    {
+        delete m_meshObject;
+    }
+
+    ///
+    /// \brief Hands the finished MeshObject over to the caller, who then owns it.
+    ///
+    /// \return The MeshObject, or nullptr if it isn't ready or was already taken
+    ///
+    MeshObject* MeshUploadService::Ticket::TakeMeshObject()
+    {
+        MeshObject* meshObject = m_meshObject;
+        m_meshObject = nullptr;
+        return meshObject;
+    }
+
+    ///
+    /// \brief Constructor. Builds the meshes on the shared ThreadPool.
+    ///
+    /// \param _bytesPerFrame - Max number of bytes to upload per ProcessUploads() call
+    ///
+    MeshUploadService::MeshUploadService(size_t _bytesPerFrame) :
+        MeshUploadService(_bytesPerFrame, ThreadPool::GetShared())
+    {
+    }
+
+    ///
+    /// \brief Constructor
+    ///
+    /// \param _bytesPerFrame - Max number of bytes to upload per ProcessUploads() call
+    /// \param _threadPool    - Pool to build the meshes on
+    ///
+    MeshUploadService::MeshUploadService(size_t _bytesPerFrame, ThreadPool& _threadPool) :
+        m_threadPool(_threadPool),
+        m_bytesPerFrame(0)
+    {
+        SetBytesPerFrame(_bytesPerFrame);
+    }
+
+    ///
+    /// \brief Destructor. Waits for any builders still running (they may reference the
+    ///        caller's data) and deletes the buffers of unfinished uploads.
+    ///
+    MeshUploadService::~MeshUploadService()
+    {
+        for ( PendingUpload& upload : m_pending )
+        {
+            if ( upload.m_futureMesh.valid() )
+            {
+                upload.m_futureMesh.wait();
+            }
+            glDeleteBuffers(1, &upload.m_vbo);
+            glDeleteBuffers(1, &upload.m_ebo);
+        }
+    }
+
+    ///
+    /// \brief Queues _builder to be run on a worker thread. The mesh it returns gets uploaded
+    ///        by later ProcessUploads() calls.
+    ///
+    /// \param _builder     - Function building the mesh. Must not make any GL calls.
+    /// \param _packOptions - How to pack the vertices of the built mesh
+    ///
+    /// \return Ticket to poll for the finished MeshObject
+    ///
+    std::shared_ptr<MeshUploadService::Ticket> MeshUploadService::Enqueue(MeshBuilder _builder, const VertexPackOptions& _packOptions)
+    {
+        ASSERT(_builder, "Must provide a mesh builder");
+
+        PendingUpload upload;
+        upload.m_ticket = std::make_shared<Ticket>();
+        upload.m_futureMesh = m_threadPool.Submit([_builder, _packOptions]() {
+            BuiltMesh builtMesh;
+            builtMesh.m_mesh = _builder();
+            builtMesh.m_packedVertices = VertexPacker::Pack(builtMesh.m_mesh, _packOptions);
+            builtMesh.m_packedIndices = IndexPacker::Pack(builtMesh.m_mesh.m_indices, builtMesh.m_mesh.m_vertices.size());
+            return builtMesh;
+        });
+        m_pending.push_back(std::move(upload));
+
+        return m_pending.back().m_ticket;
+    }
+
+    ///
+    /// \brief Uploads up to the per-frame byte budget of the built meshes, oldest first, and
+    ///        completes the tickets of the meshes that are fully uploaded. Meshes still being
+    ///        built are skipped over, and meshes whose builder failed are dropped with their
+    ///        tickets marked failed. Call once per frame on the render thread.
+    ///
+    void MeshUploadService::ProcessUploads()
+    {
+        ZoneScoped;
+
+        size_t budget = m_bytesPerFrame;
+        auto it = m_pending.begin();
+        while ( it != m_pending.end() && budget > 0 )
+        {
+            PendingUpload& upload = *it;
+            if ( !upload.m_hasMesh )
+            {
+                if ( upload.m_futureMesh.wait_for(std::chrono::seconds(0)) != std::future_status::ready )
+                {
+                    ++it;
+                    continue;
+                }
+
+                // get() rethrows whatever the builder threw
+                bool failed = false;
+                std::string error;
+                try
+                {
+                    upload.m_mesh = upload.m_futureMesh.get();
+                    if ( upload.m_mesh.m_mesh.m_vertices.empty() || upload.m_mesh.m_mesh.m_indices.empty() )
+                    {
+                        failed = true;
+                        error = "Mesh builder returned an empty mesh";
+                    }
+                }
+                catch ( const std::exception& _exception )
+                {
+                    failed = true;
+                    error = _exception.what();
+                }
+                catch ( ... )
+                {
+                    failed = true;
+                    error = "Mesh builder threw an unknown exception";
+                }
+                if ( failed )
+                {
+                    std::cerr << "Mesh upload failed: " << error << std::endl;
+                    upload.m_ticket->m_failed = true;
+                    upload.m_ticket->m_error = error;
+                    it = m_pending.erase(it);
+                    continue;
+                }
+                upload.m_hasMesh = true;
+
+                // Allocating storage doesn't copy anything, so it's not counted against the budget
+                upload.m_vbo = CreateBuffer(upload.m_mesh.m_packedVertices.m_data.size());
+                upload.m_ebo = CreateBuffer(upload.m_mesh.m_packedIndices.m_data.size());
+            }
+
+            const std::vector<unsigned char>& vertexData = upload.m_mesh.m_packedVertices.m_data;
+            const std::vector<unsigned char>& indexData = upload.m_mesh.m_packedIndices.m_data;
+            size_t vertexBytes = vertexData.size();
+            size_t indexBytes = indexData.size();
+            budget -= UploadChunk(upload.m_vbo, vertexData.data(), vertexBytes, upload.m_vertexBytesDone, budget);
+            budget -= UploadChunk(upload.m_ebo, indexData.data(), indexBytes, upload.m_indexBytesDone, budget);
+
+            if ( upload.m_vertexBytesDone < vertexBytes || upload.m_indexBytesDone < indexBytes )
+            {
+                // Out of budget for this frame
+                break;
+            }
+
+            upload.m_ticket->m_meshObject = new MeshObject(std::move(upload.m_mesh.m_mesh), upload.m_vbo, upload.m_ebo, upload.m_mesh.m_packedVertices, upload.m_mesh.m_packedIndices);
+            it = m_pending.erase(it);
+        }
+    }
+
+    ///
+    /// \brief Sets the max number of bytes uploaded per ProcessUploads() call. Smaller budgets
+    ///        spread an upload over more frames.
+    ///
+    /// \param _bytesPerFrame - Max bytes per frame. Must be non-zero.
+    ///
+    void MeshUploadService::SetBytesPerFrame(size_t _bytesPerFrame)
+    {
+        ASSERT(_bytesPerFrame > 0, "The per-frame upload budget must be non-zero");
+        m_bytesPerFrame = _bytesPerFrame;
+    }
+
+    ///
+    /// \brief Creates a buffer with _numBytes of uninitialized storage.
+    ///
+    /// \param _numBytes - Size of the buffer
+    ///
+    /// \return ID of the buffer
+    ///
+    unsigned int MeshUploadService::CreateBuffer(size_t _numBytes)
+    {
+        GLuint buffer = 0;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(_numBytes), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return buffer;
+    }
+
+    ///
+    /// \brief Uploads the next chunk of _data into _buffer, no bigger than _budget.
+    ///
+    /// \param _buffer     - Buffer to upload to
+    /// \param _data       - All the data for the buffer
+    /// \param _totalBytes - Size of _data
+    /// \param _bytesDone  - Bytes of _data already uploaded. Advanced by the chunk size.
+    /// \param _budget     - Max bytes to upload
+    ///
+    /// \return Number of bytes uploaded
+    ///
+    size_t MeshUploadService::UploadChunk(unsigned int _buffer, const void* _data, size_t _totalBytes, size_t& _bytesDone, size_t _budget)
+    {
+        size_t chunkBytes = std::min(_totalBytes - _bytesDone, _budget);
+        if ( chunkBytes == 0 )
+        {
+            return 0;
+        }
+
+        // Upload through the copy-write target so we don't disturb whatever VAO is bound
+        glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER,
+                        static_cast<GLintptr>(_bytesDone),
+                        static_cast<GLsizeiptr>(chunkBytes),
+                        static_cast<const char*>(_data) + _bytesDone);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        _bytesDone += chunkBytes;
+        return chunkBytes;
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef MESHUPLOADSERVICE_H
+#define MESHUPLOADSERVICE_H
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include "IndexPacker.h"
+#include "Mesh.h"
+#include "VertexPacker.h"
+
+namespace blithe
+{
+    class MeshObject;
+    class ThreadPool;
+
+    ///
+    /// \brief Builds meshes on worker threads and streams them to the GPU in small chunks so that
+    ///        loading a big model doesn't stall a frame.
+    ///
+    ///        Enqueue() hands a mesh building function (file parsing, procedural generation etc.)
+    ///        to a ThreadPool and returns a Ticket. The worker also packs the built mesh's vertices
+    ///        (see VertexPacker), which become the CPU staging copy. Once
+    ///        per frame, on the render thread, ProcessUploads() copies at most the per-frame byte
+    ///        budget of the finished meshes into their buffers. When all of a mesh's data is
+    ///        on the GPU, a MeshObject is created over the buffers and handed to the Ticket.
+    ///        If the builder throws or returns an empty mesh, the Ticket is marked failed
+    ///        instead and the upload is dropped.
+    ///
+    ///        Only the builders run off the render thread. Every GL call, and everything to do
+    ///        with Tickets, happens on the render thread.
+    ///
+    class MeshUploadService
+    {
+    public:
+        ///
+        /// \brief Handle to a queued mesh that the caller polls for the finished MeshObject
+        ///
+        class Ticket
+        {
+        public:
+            ~Ticket();
+
+            bool IsReady() const { return m_meshObject != nullptr; }
+            bool HasFailed() const { return m_failed; }
+            const std::string& GetError() const { return m_error; }
+            MeshObject* TakeMeshObject();
+
+        private:
+            friend class MeshUploadService;
+
+            MeshObject* m_meshObject = nullptr; //!< Finished object, until taken by the caller
+            bool m_failed = false;              //!< Whether building the mesh failed, in which case it never becomes ready
+            std::string m_error;                //!< Why building the mesh failed, if m_failed
+        };
+
+        using MeshBuilder = std::function<Mesh()>;
+
+        explicit MeshUploadService(size_t _bytesPerFrame);
+        MeshUploadService(size_t _bytesPerFrame, ThreadPool& _threadPool);
+        ~MeshUploadService();
+
+        std::shared_ptr<Ticket> Enqueue(MeshBuilder _builder, const VertexPackOptions& _packOptions = VertexPackOptions());
+
+        void ProcessUploads();
+
+        void SetBytesPerFrame(size_t _bytesPerFrame);
+        size_t GetBytesPerFrame() const { return m_bytesPerFrame; }
+        size_t GetNumPending() const { return m_pending.size(); }
+
+    private:
+        ///
+        /// \brief A mesh built by a worker, along with its packed vertices and indices
+        ///
+        struct BuiltMesh
+        {
+            Mesh m_mesh;                     //!< The mesh geometry
+            PackedVertices m_packedVertices; //!< Packed vertices of m_mesh
+            PackedIndices m_packedIndices;   //!< Packed indices of m_mesh
+        };
+
+        ///
+        /// \brief A mesh that is being built or uploaded
+        ///
+        struct PendingUpload
+        {
+            std::shared_ptr<Ticket> m_ticket;    //!< Ticket to hand the finished object to
+            std::future<BuiltMesh> m_futureMesh; //!< Mesh being built on a worker
+            BuiltMesh m_mesh;                    //!< Built mesh, once m_hasMesh
+            bool m_hasMesh = false;              //!< Whether m_futureMesh has been collected
+            unsigned int m_vbo = 0;              //!< Vertex buffer being filled
+            unsigned int m_ebo = 0;              //!< Index buffer being filled
+            size_t m_vertexBytesDone = 0;        //!< Bytes of vertex data uploaded so far
+            size_t m_indexBytesDone = 0;         //!< Bytes of index data uploaded so far
+        };
+
+        static unsigned int CreateBuffer(size_t _numBytes);
+        static size_t UploadChunk(unsigned int _buffer, const void* _data, size_t _totalBytes, size_t& _bytesDone, size_t _budget);
+
+        ThreadPool& m_threadPool;            //!< Pool the mesh builders run on
+        size_t m_bytesPerFrame;              //!< Max bytes uploaded per ProcessUploads() call
+        std::deque<PendingUpload> m_pending; //!< Queued meshes, oldest first
+    };
+}
+
+#endif // MESHUPLOADSERVICE_H
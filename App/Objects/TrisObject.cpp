@@ -1,5 +1,6 @@
 #include "TrisObject.h"
 #include <glad/glad.h>
+#include "VertexPacker.h"
 
 namespace blithe
 {
@@ -19,14 +20,15 @@ namespace blithe
         glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
         glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(_tris.size() * sizeof(Tri)), _tris.data(), GL_STATIC_DRAW);
 
-        for (const auto& attr : m_format_xyz_rgba_uv.m_attributes)
+        const VBOVertexFormat& format = VertexPacker::GetXyzRgbaUvFormat();
+        for (const auto& attr : format.m_attributes)
         {
             glEnableVertexAttribArray(attr.m_index);
             glVertexAttribPointer(attr.m_index,
                                   attr.m_size,
                                   attr.m_type,
                                   attr.m_normalized,
-                                  m_format_xyz_rgba_uv.m_stride,
+                                  format.m_stride,
                                   reinterpret_cast<void*>(attr.m_offset));
         }
 
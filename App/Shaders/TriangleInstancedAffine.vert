@@ -0,0 +1,20 @@
+#version 330 core
+
+in highp vec3 VertexPosition;
+in lowp vec4 VertexColor;
+in vec2 VertexTexCoords;
+in vec4 InstanceData0; // Row 0 of the 3x4 affine model matrix
+in vec4 InstanceData1; // Row 1
+in vec4 InstanceData2; // Row 2
+out lowp vec4 col;
+out vec2 TexCoords;
+uniform highp mat4 viewProjection;
+
+void main()
+{
+   vec4 localPos = vec4(VertexPosition, 1.0);
+   vec3 worldPos = vec3(dot(InstanceData0, localPos), dot(InstanceData1, localPos), dot(InstanceData2, localPos));
+   col = VertexColor;
+   gl_Position = viewProjection * vec4(worldPos, 1.0);
+   TexCoords = VertexTexCoords;
+}
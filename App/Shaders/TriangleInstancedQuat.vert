@@ -0,0 +1,20 @@
+#version 330 core
+
+in highp vec3 VertexPosition;
+in lowp vec4 VertexColor;
+in vec2 VertexTexCoords;
+in vec4 InstanceData0; // Rotation quaternion (x, y, z, w)
+in vec4 InstanceData1; // Translation (xyz) and uniform scale (w)
+out lowp vec4 col;
+out vec2 TexCoords;
+uniform highp mat4 viewProjection;
+
+void main()
+{
+   vec4 q = InstanceData0;
+   vec3 scaled = VertexPosition * InstanceData1.w;
+   vec3 rotated = scaled + 2.0 * cross(q.xyz, cross(q.xyz, scaled) + q.w * scaled);
+   col = VertexColor;
+   gl_Position = viewProjection * vec4(rotated + InstanceData1.xyz, 1.0);
+   TexCoords = VertexTexCoords;
+}
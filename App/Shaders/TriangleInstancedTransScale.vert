@@ -0,0 +1,16 @@
+#version 330 core
+
+in highp vec3 VertexPosition;
+in lowp vec4 VertexColor;
+in vec2 VertexTexCoords;
+in vec4 InstanceData0; // Translation (xyz) and uniform scale (w)
+out lowp vec4 col;
+out vec2 TexCoords;
+uniform highp mat4 viewProjection;
+
+void main()
+{
+   col = VertexColor;
+   gl_Position = viewProjection * vec4(VertexPosition * InstanceData0.w + InstanceData0.xyz, 1.0);
+   TexCoords = VertexTexCoords;
+}
@@ -16,8 +16,8 @@ namespace blithe
     struct MouseButtonDragInfo
     {
         bool m_dragging = false;    //!< Whether the button is currently being dragged
-        glm::vec2 m_dragStart = {}; //!< Starting position of the drag
-        glm::vec2 m_lastPos = {};   //!< Last recorded mouse position during drag
+        glm::vec2 m_dragStart = {}; //!< Starting position of the drag, relative to the viewport
+        glm::vec2 m_lastPos = {};   //!< Last recorded mouse position during drag, relative to the viewport
         glm::vec2 m_delta = {};     //!< Delta since last frame while dragging
     };
 
@@ -188,6 +188,7 @@ namespace blithe
         int m_viewportWidth = 0;
         int m_viewPortHeight = 0;
         float m_aspect = FLT_MIN;   //!< The main viewport aspect ratio
+        unsigned int m_viewPortDepthTexture = 0; //!< Depth texture of the standard viewport, or 0 if the demo isn't rendering to it
         ImVec4 m_clearColor;        //!< The main clear color
         std::unordered_set<enPressedKey> m_pressedKeys; //!< The pressed keys, per glfw
         MouseInputState m_mouseInput; //!< Mouse input data
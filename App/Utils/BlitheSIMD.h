@@ -0,0 +1,23 @@
+#ifndef BLITHESIMD_H
+#define BLITHESIMD_H
+
+///
+/// Picks the widest SIMD instruction set the compiler is targeting, so that hot loops can
+/// have an AVX2, SSE2 and plain scalar path:
+///
+///   BLITHE_SIMD_AVX2 - 8 floats per register. Needs the BLITHE_ENABLE_AVX2 CMake option.
+///   BLITHE_SIMD_SSE2 - 4 floats per register. Always there on x64.
+///
+/// Neither is defined on other architectures (e.g. ARM Macs), which use the scalar path.
+///
+#if defined(__AVX2__)
+    #define BLITHE_SIMD_AVX2 1
+    #include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define BLITHE_SIMD_SSE2 1
+    #include <emmintrin.h>
+#endif
+
+#endif // BLITHESIMD_H
@@ -0,0 +1,123 @@
+#include "RangeAllocator.h"
+#include "BlitheAssert.h"
+#include <iterator>
+
+namespace blithe
+{
+    ///
+    /// \brief Constructor. The whole [0, _capacity) space starts out as a single free block.
+    ///
+    /// \param _capacity - Size of the space to allocate from
+    ///
+    RangeAllocator::RangeAllocator(size_t _capacity)
+        : m_capacity(_capacity)
+    {
+        Reset();
+    }
+
+    ///
+    /// \brief Finds the first free block that can fit _size and carves the range out of its
+    ///        start.
+    ///
+    /// \param _size - Size of the range to allocate. Must be non-zero.
+    ///
+    /// \return Offset of the allocated range, or nothing if there is no block big enough.
+    ///
+    tl::optional<size_t> RangeAllocator::Allocate(size_t _size)
+    {
+        ASSERT(_size > 0, "Cannot allocate an empty range");
+
+        tl::optional<size_t> result;
+
+        for ( auto it = m_freeBlocks.begin(); it != m_freeBlocks.end(); ++it )
+        {
+            if ( it->second >= _size )
+            {
+                size_t offset = it->first;
+                size_t remaining = it->second - _size;
+                m_freeBlocks.erase(it);
+                if ( remaining > 0 )
+                {
+                    m_freeBlocks[offset + _size] = remaining;
+                }
+                m_used += _size;
+                result = offset;
+                break;
+            }
+        }
+
+        return result;
+    }
+
+    ///
+    /// \brief Returns the range [_offset, _offset + _size) to the free list, merging it with the
+    ///        free blocks directly before and after it if they are adjacent.
+    ///
+    /// \param _offset - Offset of the range, as returned by Allocate()
+    /// \param _size   - Size of the range, as passed to Allocate()
+    ///
+    void RangeAllocator::Free(size_t _offset, size_t _size)
+    {
+        ASSERT(_offset + _size <= m_capacity, "Freeing a range outside the allocator's capacity");
+        ASSERT(m_used >= _size, "Freeing more than was allocated");
+
+        m_used -= _size;
+
+        auto next = m_freeBlocks.lower_bound(_offset);
+        ASSERT(next == m_freeBlocks.end() || next->first >= _offset + _size, "Double free of range at " << _offset);
+
+        // Merge with the following free block
+        if ( next != m_freeBlocks.end() && next->first == _offset + _size )
+        {
+            _size += next->second;
+            next = m_freeBlocks.erase(next);
+        }
+
+        // Merge with the preceding free block
+        if ( next != m_freeBlocks.begin() )
+        {
+            auto prev = std::prev(next);
+            ASSERT(prev->first + prev->second <= _offset, "Double free of range at " << _offset);
+            if ( prev->first + prev->second == _offset )
+            {
+                prev->second += _size;
+                return;
+            }
+        }
+
+        m_freeBlocks[_offset] = _size;
+    }
+
+    ///
+    /// \brief Extends the space to _newCapacity. The new tail is added as free space (merged with
+    ///        any free block already at the end).
+    ///
+    /// \param _newCapacity - New capacity. Must not be smaller than the current one.
+    ///
+    void RangeAllocator::Grow(size_t _newCapacity)
+    {
+        ASSERT(_newCapacity >= m_capacity, "RangeAllocator can only grow");
+
+        if ( _newCapacity > m_capacity )
+        {
+            size_t oldCapacity = m_capacity;
+            m_capacity = _newCapacity;
+            // Free() expects the range to have been counted as used
+            m_used += _newCapacity - oldCapacity;
+            Free(oldCapacity, _newCapacity - oldCapacity);
+        }
+    }
+
+    ///
+    /// \brief Frees everything. The whole capacity becomes a single free block again.
+    ///
+    void RangeAllocator::Reset()
+    {
+        m_freeBlocks.clear();
+        m_used = 0;
+        if ( m_capacity > 0 )
+        {
+            m_freeBlocks[0] = m_capacity;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef RANGEALLOCATOR_H
+#define RANGEALLOCATOR_H
+
+#include <map>
+#include <optional.hpp>
+#include <stddef.h>
+
+namespace blithe
+{
+    ///
+    /// \brief Free-list allocator handing out [offset, offset + size) ranges from a linear space of
+    ///        some capacity. It doesn't own any memory itself, so the ranges can be used to
+    ///        sub-allocate from anything linear like a big GL buffer.
+    ///
+    ///        Allocation is first-fit over a list of free blocks sorted by offset. Freed blocks are
+    ///        merged with their free neighbours, so fragmentation stays low as long as meshes are
+    ///        roughly the same order of size.
+    ///
+    class RangeAllocator
+    {
+    public:
+        explicit RangeAllocator(size_t _capacity);
+
+        tl::optional<size_t> Allocate(size_t _size);
+        void Free(size_t _offset, size_t _size);
+        void Grow(size_t _newCapacity);
+        void Reset();
+
+        size_t GetCapacity() const { return m_capacity; }
+        size_t GetUsed() const { return m_used; }
+
+    private:
+        std::map<size_t, size_t> m_freeBlocks; //!< Free blocks as offset -> size, sorted by offset
+        size_t m_capacity = 0;                 //!< Total size of the space being allocated from
+        size_t m_used = 0;                     //!< Total size of the currently allocated ranges
+    };
+}
+
+#endif // RANGEALLOCATOR_H
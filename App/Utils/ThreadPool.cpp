@@ -0,0 +1,71 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace blithe
+{
+    ///
+    /// \brief Constructor. Starts _numThreads worker threads (at least 1).
+    ///
+    /// \param _numThreads - Number of worker threads
+    ///
+    ThreadPool::ThreadPool(size_t _numThreads)
+    {
+        _numThreads = std::max<size_t>(_numThreads, 1);
+        for ( size_t i = 0; i < _numThreads; i++ )
+        {
+            m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+        }
+    }
+
+    ///
+    /// \brief Destructor. Lets the workers finish the queued tasks and joins them.
+    ///
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_condition.notify_all();
+
+        for ( std::thread& worker : m_workers )
+        {
+            worker.join();
+        }
+    }
+
+    ///
+    /// \brief Gets the pool shared by the whole app. It is created on first use with one thread
+    ///        less than the hardware concurrency, leaving a core for the render thread.
+    ///
+    /// \return The shared thread pool
+    ///
+    ThreadPool& ThreadPool::GetShared()
+    {
+        static ThreadPool s_sharedPool(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+        return s_sharedPool;
+    }
+
+    ///
+    /// \brief Loop run by each worker. Pops and runs tasks until the pool is stopping and the
+    ///        queue has been drained.
+    ///
+    void ThreadPool::WorkerLoop()
+    {
+        while ( true )
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+                if ( m_stopping && m_tasks.empty() )
+                {
+                    return;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop();
+            }
+            task();
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace blithe
+{
+    ///
+    /// \brief Simple fixed-size pool of worker threads pulling tasks off a shared FIFO queue.
+    ///
+    ///        Tasks must not make any OpenGL calls, since the GL context is only current on the
+    ///        main (render) thread.
+    ///
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(size_t _numThreads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        static ThreadPool& GetShared();
+
+        size_t GetNumThreads() const { return m_workers.size(); }
+
+        ///
+        /// \brief Queues _func to be run on one of the worker threads.
+        ///
+        /// \param _func - Callable taking no arguments
+        ///
+        /// \return Future for the result of _func
+        ///
+        template<typename F>
+        auto Submit(F&& _func) -> std::future<decltype(_func())>
+        {
+            using ResultType = decltype(_func());
+
+            // std::function needs to be copyable, but packaged_task isn't, so share it.
+            auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(_func));
+            std::future<ResultType> future = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.push([task]() { (*task)(); });
+            }
+            m_condition.notify_one();
+
+            return future;
+        }
+
+    private:
+        void WorkerLoop();
+
+        std::vector<std::thread> m_workers;        //!< Worker threads
+        std::queue<std::function<void()>> m_tasks; //!< Tasks waiting to be picked up by a worker
+        std::mutex m_mutex;                        //!< Guards m_tasks and m_stopping
+        std::condition_variable m_condition;       //!< Signalled when there's a task or we're stopping
+        bool m_stopping = false;                   //!< Set on destruction to tell workers to exit
+    };
+}
+
+#endif // THREADPOOL_H
@@ -66,10 +66,11 @@ int main(int, char**)
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);  // 3.2+ only
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);            // Required on Mac
 #else
-    // GL 3.0 + GLSL 130
-    const char* glsl_version = "#version 130";
+    // GL 3.3 + GLSL 150. The demo shaders are #version 330 and the mesh arena and instanced
+    // meshes draw with glDrawElementsBaseVertex (3.2+).
+    const char* glsl_version = "#version 150";
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     //glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);  // 3.2+ only
     //glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);            // 3.0+ only
 #endif
@@ -93,6 +94,14 @@ int main(int, char**)
         return -1;
     }
 
+#if !defined(IMGUI_IMPL_OPENGL_ES2)
+    if (!GLAD_GL_VERSION_3_3)
+    {
+        std::cout << "OpenGL 3.3 or later is required, got " << glGetString(GL_VERSION) << std::endl;
+        return -1;
+    }
+#endif
+
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();